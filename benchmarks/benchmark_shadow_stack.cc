@@ -0,0 +1,120 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+// Cost of the shadow stack capture backend.
+//
+// This file is built with -finstrument-functions, so every function here
+// pays for the enter and exit hooks unless it is explicitly excluded.
+// Capture latency is compared against backtrace() at different depths.
+
+#include <cstdio>
+#include <cstdlib>
+#include <time.h>
+
+#include "backtrace/stacktrace.h"
+
+namespace {
+
+__attribute__((no_instrument_function))
+double time_get() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+__attribute__((noinline)) int instrumented_call(int value) {
+  __asm__ volatile("" : : : "memory");
+  return value + 1;
+}
+
+__attribute__((noinline, no_instrument_function)) int plain_call(int value) {
+  __asm__ volatile("" : : : "memory");
+  return value + 1;
+}
+
+__attribute__((no_instrument_function))
+double benchmark_load(bt::StackTrace *stacktrace, int num_iterations) {
+  double start_time = time_get();
+  for (int i = 0; i < num_iterations; ++i) {
+    stacktrace->load(NULL, BACKTRACE_SHADOW_STACK_DEPTH);
+  }
+  return (time_get() - start_time) / num_iterations;
+}
+
+// Recurse through instrumented functions and run the benchmark at the
+// given depth.
+__attribute__((noinline)) double at_depth(int depth,
+                                          bt::StackTrace *stacktrace,
+                                          int num_iterations) {
+  if (depth > 0) {
+    double result = at_depth(depth - 1, stacktrace, num_iterations);
+    // Prevent tail call, so every level gets its own frame.
+    __asm__ volatile("" : : : "memory");
+    return result;
+  }
+  return benchmark_load(stacktrace, num_iterations);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  int num_iterations = (argc > 1) ? atoi(argv[1]) : 1000000;
+  printf("Iterations: %d\n", num_iterations);
+
+  // Overhead of the enter and exit hooks.
+  int value = 0;
+  double start_time = time_get();
+  for (int i = 0; i < num_iterations; ++i) {
+    value = plain_call(value);
+  }
+  double plain_time = (time_get() - start_time) / num_iterations;
+  start_time = time_get();
+  for (int i = 0; i < num_iterations; ++i) {
+    value = instrumented_call(value);
+  }
+  double instrumented_time = (time_get() - start_time) / num_iterations;
+  printf("Call: plain %.2f ns, instrumented %.2f ns, hooks %.2f ns\n",
+         plain_time * 1e9,
+         instrumented_time * 1e9,
+         (instrumented_time - plain_time) * 1e9);
+
+  // Capture latency.
+  // Library is built with the shadow stack, so this is the shadow stack
+  // backend, and the fallback is never used from instrumented code.
+  bt::StackTrace *shadow_stack = bt::StackTrace::create();
+  bt::StackTrace *execinfo = bt::internal::stacktrace_create_execinfo();
+  printf("%-8s %14s %14s\n", "depth", "shadow stack", "execinfo");
+  const int depths[] = {8, 32, 128};
+  for (size_t i = 0; i < sizeof(depths) / sizeof(*depths); ++i) {
+    double shadow_stack_time = at_depth(depths[i],
+                                        shadow_stack,
+                                        num_iterations);
+    double execinfo_time = at_depth(depths[i],
+                                    execinfo,
+                                    num_iterations / 10);
+    printf("%-8d %11.2f ns %11.2f ns\n",
+           depths[i],
+           shadow_stack_time * 1e9,
+           execinfo_time * 1e9);
+  }
+  delete shadow_stack;
+  delete execinfo;
+  return value == 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,121 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+// Symbolization latency benchmark.
+//
+// The same source is built into executables with uncompressed and
+// compressed debug sections, compare their output to see how much
+// compression costs.
+
+#include <cstdio>
+#include <cstdlib>
+#include <time.h>
+
+#include "backtrace/backtrace.h"
+#include "backtrace/section_cache.h"
+#include "backtrace/stacktrace.h"
+#include "backtrace/symbol_cache.h"
+#include "backtrace/symbolize.h"
+
+using bt::StackTrace;
+using bt::Symbolize;
+
+namespace {
+
+double time_get() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+__attribute__((noinline)) StackTrace *capture(int depth) {
+  if (depth > 0) {
+    StackTrace *stacktrace = capture(depth - 1);
+    // Prevent tail call, so every level gets its own frame.
+    __asm__ volatile("" : : "r"(stacktrace) : "memory");
+    return stacktrace;
+  }
+  StackTrace *stacktrace = StackTrace::create();
+  stacktrace->load(NULL, BACKTRACE_MAX_DEPTH);
+  return stacktrace;
+}
+
+void clear_section_cache() {
+#ifdef BACKTRACE_HAS_ELF
+  bt::internal::SectionCache::instance().clear();
+#endif
+}
+
+// Symbolize given trace with a new symbolizer every iteration.
+void benchmark_new_symbolizer(const char *name,
+                              const StackTrace& stacktrace,
+                              int num_iterations,
+                              bool clear_sections,
+                              bool clear_symbols) {
+  double total_time = 0.0;
+  for (int i = 0; i < num_iterations; ++i) {
+    if (clear_sections) {
+      clear_section_cache();
+    }
+    if (clear_symbols) {
+      bt::internal::symbol_cache_clear();
+    }
+    double start_time = time_get();
+    Symbolize *symbolize = Symbolize::create();
+    symbolize->resolve(stacktrace);
+    delete symbolize;
+    total_time += time_get() - start_time;
+  }
+  printf("%-24s %12.2f us\n", name, total_time / num_iterations * 1e6);
+}
+
+// Symbolize given trace with the same symbolizer every iteration.
+void benchmark_warm_symbolizer(const char *name,
+                               const StackTrace& stacktrace,
+                               int num_iterations) {
+  Symbolize *symbolize = Symbolize::create();
+  symbolize->resolve(stacktrace);
+  double start_time = time_get();
+  for (int i = 0; i < num_iterations; ++i) {
+    symbolize->resolve(stacktrace);
+  }
+  double total_time = time_get() - start_time;
+  delete symbolize;
+  printf("%-24s %12.2f us\n", name, total_time / num_iterations * 1e6);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  int num_iterations = (argc > 1) ? atoi(argv[1]) : 100;
+  StackTrace *stacktrace = capture(16);
+  printf("Frames: %d, iterations: %d\n",
+         (int)stacktrace->size(), num_iterations);
+  benchmark_new_symbolizer("cold", *stacktrace, num_iterations,
+                           true, true);
+  benchmark_new_symbolizer("shared section cache", *stacktrace,
+                           num_iterations, false, true);
+  benchmark_new_symbolizer("shared symbol cache", *stacktrace,
+                           num_iterations, false, false);
+  benchmark_warm_symbolizer("warm symbolizer", *stacktrace,
+                            num_iterations);
+  delete stacktrace;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,80 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+// Cost of capturing throw site stack traces.
+//
+// Exceptions are thrown from different call depths with capturing enabled
+// and disabled, difference is the overhead added to the throw path.
+
+#include <cstdio>
+#include <cstdlib>
+#include <time.h>
+
+#include "backtrace/throw_trace.h"
+
+namespace {
+
+double time_get() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+__attribute__((noinline)) void throw_at(int depth) {
+  if (depth > 0) {
+    throw_at(depth - 1);
+    // Prevent tail call, so every level gets its own frame.
+    __asm__ volatile("" : : : "memory");
+    return;
+  }
+  throw depth;
+}
+
+double benchmark_throw(int depth, int num_iterations) {
+  double start_time = time_get();
+  for (int i = 0; i < num_iterations; ++i) {
+    try {
+      throw_at(depth);
+    } catch (int) {
+    }
+  }
+  return (time_get() - start_time) / num_iterations;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  int num_iterations = (argc > 1) ? atoi(argv[1]) : 100000;
+  printf("Iterations: %d\n", num_iterations);
+  printf("%-8s %14s %14s %14s\n", "depth", "plain", "captured", "overhead");
+  const int depths[] = {0, 8, 32, 128};
+  for (size_t i = 0; i < sizeof(depths) / sizeof(*depths); ++i) {
+    bt::throw_trace_set_enabled(false);
+    double plain_time = benchmark_throw(depths[i], num_iterations);
+    bt::throw_trace_set_enabled(true);
+    double captured_time = benchmark_throw(depths[i], num_iterations);
+    printf("%-8d %11.2f us %11.2f us %11.2f us\n",
+           depths[i],
+           plain_time * 1e6,
+           captured_time * 1e6,
+           (captured_time - plain_time) * 1e6);
+  }
+  return EXIT_SUCCESS;
+}
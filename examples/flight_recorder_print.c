@@ -0,0 +1,41 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "backtrace/backtrace.h"
+
+int main(int argc, char **argv) {
+  size_t last_events = 16;
+  if (argc != 2 && argc != 3) {
+    fprintf(stderr, "Usage: %s <recorder file> [<events per thread>]\n",
+            argv[0]);
+    return EXIT_FAILURE;
+  }
+  if (argc == 3) {
+    last_events = (size_t)strtoul(argv[2], NULL, 10);
+  }
+  if (backtrace_flight_recorder_print(argv[1], last_events, stdout) != 0) {
+    fprintf(stderr, "Unable to read flight recorder %s\n", argv[1]);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
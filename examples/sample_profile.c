@@ -0,0 +1,64 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "backtrace/backtrace.h"
+
+// Functions which should show up in the profile, roughly in proportion to
+// the number of iterations they run.
+__attribute__((noinline)) static double spin(long num_iterations) {
+  volatile double sum = 0.0;
+  for (long i = 0; i < num_iterations; ++i) {
+    sum += (double)i * 0.5;
+  }
+  return sum;
+}
+
+__attribute__((noinline)) static double spin_short(void) {
+  return spin(100000000L);
+}
+
+__attribute__((noinline)) static double spin_long(void) {
+  return spin(300000000L);
+}
+
+int main(int argc, char **argv) {
+  if (argc > 2) {
+    fprintf(stderr, "Usage: %s [<pprof output>]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  if (backtrace_sampler_start(0) < 0) {
+    fprintf(stderr, "Sampler is not available\n");
+    return EXIT_FAILURE;
+  }
+  double result = spin_short() + spin_long();
+  backtrace_sampler_stop();
+  if (argc == 2) {
+    if (backtrace_sampler_write_pprof(argv[1]) < 0) {
+      fprintf(stderr, "Unable to write profile to %s\n", argv[1]);
+      return EXIT_FAILURE;
+    }
+  } else {
+    backtrace_sampler_print(stdout);
+  }
+  return result > 0.0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
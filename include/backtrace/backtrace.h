@@ -23,16 +23,337 @@
 #ifndef __BACKTRACE_H__
 #define __BACKTRACE_H__
 
+#include <stddef.h>
 #include <stdio.h>
 
 #define BACKTRACE_MAX_DEPTH 100
 
+/* Size of the string fields of backtrace_symbol, including terminator. */
+#define BACKTRACE_SYMBOL_STRING_SIZE 256
+
+/* Number of buckets of the latency histograms. */
+#define BACKTRACE_STATS_NUM_BUCKETS 32
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 void backtrace_print(FILE *fp);
 
+/* Symbol information of a single address, filled in by the library.
+ * Strings are truncated to fit and are always null-terminated.
+ *
+ * New fields are only ever appended, and size of the structure the caller
+ * was compiled with is passed along with it, so the layout is stable
+ * across library versions.
+ */
+typedef struct backtrace_symbol {
+  void *address;
+  /* Offset of the address within the function, (size_t)-1 if unknown. */
+  size_t function_offset;
+  /* Line number, -1 if unknown. */
+  int line_number;
+  char function_name[BACKTRACE_SYMBOL_STRING_SIZE];
+  char file_name[BACKTRACE_SYMBOL_STRING_SIZE];
+  char object_name[BACKTRACE_SYMBOL_STRING_SIZE];
+} backtrace_symbol;
+
+typedef void (*backtrace_symbol_callback)(const backtrace_symbol *symbol,
+                                          int index,
+                                          void *user_data);
+
+/* Capture return addresses of the calling thread into the buffer, without
+ * symbolizing them. The innermost skip frames of the caller are omitted.
+ *
+ * Returns number of stored addresses.
+ */
+int backtrace_capture(void **addresses, int max_depth, int skip);
+
+/* Symbolize addresses captured by backtrace_capture() into an array of
+ * records, symbol_size is to be sizeof(backtrace_symbol).
+ *
+ * Returns number of symbolized records, or -1 if symbol_size is not
+ * supported.
+ */
+int backtrace_symbolize(void * const *addresses,
+                        int num_addresses,
+                        backtrace_symbol *symbols,
+                        size_t symbol_size);
+
+/* Same as above, but call the callback with every resolved frame instead
+ * of storing them. Record is only valid during the call.
+ */
+int backtrace_symbolize_callback(void * const *addresses,
+                                 int num_addresses,
+                                 backtrace_symbol_callback callback,
+                                 void *user_data);
+
+/* Symbolize addresses and format them the same way backtrace_print()
+ * does. Output is truncated to fit the buffer and is null-terminated
+ * unless size is zero.
+ *
+ * Returns length of the full text, like snprintf() does.
+ */
+int backtrace_format(void * const *addresses,
+                     int num_addresses,
+                     char *buffer,
+                     size_t size);
+
+/* Capture backtrace of the calling thread and print it to the given file
+ * from a background thread, once it is symbolized. Backtraces are printed
+ * in the order this function was called.
+ */
+void backtrace_print_async(FILE *fp);
+
+/* Wait until all the asynchronously printed backtraces are printed. */
+void backtrace_async_flush(void);
+
+/* Same as backtrace_print(), but stop symbolizing once budget_ms have
+ * passed since the call. Frames are symbolized from the top of the stack,
+ * the ones which were not reached in time are printed as the object name
+ * and offset within it. If finish_in_background is non-zero, those frames
+ * are then symbolized on the background thread of backtrace_print_async(),
+ * so backtraces printed later find them in the symbol cache. Nothing is
+ * done in the background while the symbol cache is disabled.
+ *
+ * Returns number of frames which were not symbolized in time.
+ */
+int backtrace_print_deadline(FILE *fp, int budget_ms, int finish_in_background);
+
+/* Fork a helper process which symbolizes stack traces on behalf of this
+ * one. Is to be called at initialization time, before any threads are
+ * created and after all the libraries are loaded.
+ *
+ * Returns zero on success.
+ */
+int backtrace_helper_start(void);
+
+/* Stop the helper process. */
+void backtrace_helper_stop(void);
+
+/* Print backtrace of the calling thread to a file descriptor using the
+ * helper process. Only async-signal-safe calls are used, so it is safe to
+ * be used from a crash handler.
+ *
+ * If the helper is not running raw addresses are printed.
+ */
+void backtrace_helper_print(int fd);
+
+/* Print backtraces of all threads of the process. Threads are interrupted
+ * with a real-time signal, so threads which are blocking it or are stuck in
+ * the kernel for longer than the timeout are reported as not responding.
+ * Threads with identical stacks are printed as a single group.
+ *
+ * Returns number of threads which were captured, or -1 if dump is not
+ * supported on this platform.
+ */
+int backtrace_print_all_threads(FILE *fp, int timeout_ms);
+
+/* Print backtraces of all threads of another process, like pstack does.
+ * Every thread is only stopped for as long as it takes to copy its
+ * registers and top of the stack, unwinding and symbolization happen
+ * afterwards. Requires permission to ptrace the process.
+ *
+ * Returns number of threads which were captured, or -1 if process could
+ * not be inspected or this is not supported on this platform.
+ */
+int backtrace_print_process(int pid, FILE *fp);
+
+/* Install handlers of fatal signals which write a compact minidump to the
+ * given file: registers and top of the stack of every thread, and the list
+ * of loaded objects with their build IDs. The signal is then passed on to
+ * the previously installed handler.
+ *
+ * Returns zero on success, -1 if minidumps are not supported on this
+ * platform.
+ */
+int backtrace_minidump_install(const char *filename);
+
+/* Unwind and symbolize threads of a minidump and print them. Objects of
+ * the crashed process are to be available on this machine, either at the
+ * same paths or as separate debug files found by their build IDs.
+ *
+ * Returns zero on success, -1 if the file is not a valid minidump.
+ */
+int backtrace_minidump_print(const char *filename, FILE *fp);
+
+/* Allocate the flight recorder, which keeps most recent events of every
+ * thread in rings. If filename is not NULL rings are kept in a file mapped
+ * into memory, so they survive a crash of the process. Recorder is opened
+ * in memory with default sizes on the first event otherwise.
+ *
+ * Returns zero on success, -1 if the recorder is already open or it is not
+ * supported on this platform.
+ */
+int backtrace_flight_recorder_open(const char *filename,
+                                   size_t events_per_thread,
+                                   size_t max_threads);
+
+/* Record an event with the stack of the caller into the calling thread's
+ * ring. Stack is captured by following frame pointers only. Takes no locks
+ * after the first event of the thread.
+ */
+void backtrace_flight_record(const char *tag);
+
+/* Store the current table of loaded objects in the recorder, so stacks in
+ * the file could be symbolized after more objects were loaded.
+ */
+void backtrace_flight_recorder_update_modules(void);
+
+/* Symbolize and print up to last_events most recent events of every
+ * thread, either of this process if filename is NULL, or from a recorder
+ * file of another process.
+ *
+ * Returns zero on success, -1 if there's no valid recorder.
+ */
+int backtrace_flight_recorder_print(const char *filename,
+                                    size_t last_events,
+                                    FILE *fp);
+
+/* Latency histogram, bucket i counts latencies below 2^i nanoseconds and
+ * the last bucket counts everything above.
+ */
+typedef struct backtrace_stats_histogram {
+  unsigned long long count;
+  unsigned long long sum_ns;
+  unsigned long long buckets[BACKTRACE_STATS_NUM_BUCKETS];
+} backtrace_stats_histogram;
+
+/* Statistics of the library's own activity, collected with atomic counters
+ * only. Like backtrace_symbol, fields are only ever appended.
+ */
+typedef struct backtrace_stats {
+  /* Objects opened by the symbolizers to read their symbols. */
+  unsigned long long objects_opened;
+  /* Lookups of per-object symbol data. */
+  unsigned long long cache_hits;
+  unsigned long long cache_misses;
+  unsigned long long cache_evictions;
+  unsigned long long demangle_calls;
+  /* Estimated bytes of symbol data currently held. */
+  unsigned long long symbol_memory_bytes;
+  /* Stack trace capture latency, per backend. */
+  backtrace_stats_histogram capture_execinfo;
+  backtrace_stats_histogram capture_capture_stack_backtrace;
+  backtrace_stats_histogram capture_stack_walk;
+  /* Latency of symbolizing a whole stack trace, once per trace. */
+  backtrace_stats_histogram symbolize;
+  backtrace_stats_histogram capture_shadow_stack;
+  /* Lookups of the process-wide address to symbol cache. */
+  unsigned long long symbol_cache_hits;
+  unsigned long long symbol_cache_misses;
+  /* Addresses currently held by the cache. */
+  unsigned long long symbol_cache_entries;
+} backtrace_stats;
+
+/* Get current statistics, stats_size is to be sizeof(backtrace_stats).
+ *
+ * Returns zero on success, -1 if stats_size is not supported.
+ */
+int backtrace_stats_get(backtrace_stats *stats, size_t stats_size);
+
+/* Reset all the statistics, except of the currently held memory. */
+void backtrace_stats_reset(void);
+
+/* Print statistics as a human-readable text or as a JSON object. */
+void backtrace_stats_print(FILE *fp);
+void backtrace_stats_print_json(FILE *fp);
+
+/* Set number of addresses kept in the process-wide cache of resolved
+ * symbols, zero disables the cache. Cached symbols are dropped, memory of
+ * the previous cache is released once lookups in progress are done.
+ */
+void backtrace_symbol_cache_set_size(size_t size);
+
+/* Set order in which symbolizer backends are tried, as a comma-separated
+ * list of their names: execinfo, elf, bfd, sym_from_addr and perf_map.
+ * Affects symbolizers created afterwards.
+ *
+ * Returns zero on success, -1 if any of the backends is unknown or not
+ * available in this build.
+ */
+int backtrace_symbolize_set_backends(const char *backends);
+
+/* Information which is required for a frame to be considered resolved,
+ * frames which are missing it are passed on to the next backend.
+ */
+#define BACKTRACE_DETAIL_FUNCTION 0
+#define BACKTRACE_DETAIL_LINE 1
+
+void backtrace_symbolize_set_detail(int detail);
+
+/* Print backtrace of the calling thread, unless the same backtrace was
+ * already printed within the current window. Repeated backtraces are only
+ * counted, and number of suppressed ones is printed once window is over
+ * or at exit, whichever comes first.
+ *
+ * Returns 1 if backtrace was printed, 0 if it was suppressed.
+ */
+int backtrace_log(FILE *fp);
+
+/* Set length of the window used by backtrace_log(), default is 60 seconds. */
+void backtrace_log_set_window(int window_ms);
+
+/* Print number of suppressed backtraces which were not reported yet. */
+void backtrace_log_flush(void);
+
+/* Print backtrace of the place where the exception which is currently
+ * being handled was thrown. Only available when library is built with
+ * throw trace support and exception was thrown by the calling thread.
+ *
+ * Returns zero on success, -1 if throw site is not known.
+ */
+int backtrace_print_throw_trace(FILE *fp);
+
+/* Start recording stacks of threads waiting for pthread mutexes and rwlocks.
+ * Waits longer than threshold are always recorded, and every
+ * sample_period-th contended acquisition is recorded regardless of its
+ * wait time, zero disables sampling. Only available when library is built
+ * with lock profiler support.
+ *
+ * Returns zero on success, -1 if profiler is not available.
+ */
+int backtrace_lock_profiler_start(int threshold_us, int sample_period);
+
+/* Stop recording waits, already collected ones are kept. */
+void backtrace_lock_profiler_stop(void);
+
+/* Print total wait time in nanoseconds per unique waiter stack, in the
+ * folded stacks format.
+ *
+ * Returns zero on success, -1 if profiler is not available.
+ */
+int backtrace_lock_profiler_print(FILE *fp);
+
+/* Write collected waits as a pprof profile.
+ *
+ * Returns zero on success, -1 on error or if profiler is not available.
+ */
+int backtrace_lock_profiler_write_pprof(const char *filename);
+
+/* Start sampling stacks of all threads, frequency times per second of CPU
+ * time, zero picks the default of 99. Perf events are used when they are
+ * permitted, SIGPROF timer otherwise. Only available on Linux.
+ *
+ * Returns zero on success, -1 if sampler is not available or is running.
+ */
+int backtrace_sampler_start(int frequency);
+
+/* Stop sampling, already collected samples are kept. */
+void backtrace_sampler_stop(void);
+
+/* Print number of samples per unique stack, in the folded stacks format.
+ *
+ * Returns zero on success, -1 if sampler is not available.
+ */
+int backtrace_sampler_print(FILE *fp);
+
+/* Write collected samples as a pprof profile.
+ *
+ * Returns zero on success, -1 on error or if sampler is not available.
+ */
+int backtrace_sampler_write_pprof(const char *filename);
+
 #ifdef __cplusplus
 }
 #endif
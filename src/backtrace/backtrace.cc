@@ -22,11 +22,30 @@
 
 #include "backtrace/backtrace.h"
 
-#include <iomanip>
-#include <sstream>
-
+#include "backtrace/backtrace_log.h"
+#include "backtrace/flight_recorder.h"
+#include "backtrace/lock_profiler.h"
+#include "backtrace/minidump.h"
+#include "backtrace/pprof.h"
+#include "backtrace/relative_stacktrace.h"
+#include "backtrace/remote_backtrace.h"
+#include "backtrace/sampler.h"
 #include "backtrace/stacktrace.h"
+#include "backtrace/stats.h"
 #include "backtrace/symbolize.h"
+#include "backtrace/symbolize_helper.h"
+#include "backtrace/symbolize_queue.h"
+#include "backtrace/thread_dump.h"
+#include "backtrace/throw_trace.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef BACKTRACE_HAS_EXECINFO
+#  include <execinfo.h>
+#endif
 
 namespace bt {
 
@@ -37,47 +56,575 @@ string backtrace_get_string() {
   stacktrace->load(NULL, BACKTRACE_MAX_DEPTH);
   Symbolize *symbolize = Symbolize::create(stacktrace);
 
-  std::stringstream ss;
-  for (size_t i = 0; i < symbolize->size(); ++i) {
-    const Symbol& symbol = symbolize->at(i);
-    // Frame index.
-    ss << std::right << std::setw(8) << i;
-    // TODO(sergey): Show object name in some nice format,
-    // which doesn't screw alignment up.
-    // Frame address.
-    ss << "  " << std::right << std::setw(16)
-       << ((symbol.address != Symbol::ADDRESS_NONE)
-                   ? hex_cast(symbol.address)
-                   : "(nil)");
-    // Function name.
-    string function_name = ((symbol.function_name.size() > 0)
-                                   ? symbol.function_name
-                                   : "(unknown)");
-    ss << "    " << function_name;
-    // Source file or function offset.
-    if (symbol.file_name.size() == 0) {
-      if (symbol.function_offset != Symbol::OFFSET_NONE) {
-        ss << "+" << hex_cast(symbol.function_offset);
+  string result = internal::symbolize_format(*symbolize);
+  delete symbolize;
+  return result;
+}
+
+void backtrace_print(FILE *fp) {
+  string backtrace = backtrace_get_string();
+  fputs(backtrace.c_str(), fp);
+}
+
+// Symbolizer shared by the buffer-oriented functions, so loaded objects
+// are kept between calls. Never destroyed at exit, but re-created when the
+// backends configuration changes.
+internal::Mutex symbolize_mutex;
+Symbolize *shared_symbolize = NULL;
+
+Symbolize& backtrace_symbolize_get() {
+  if (shared_symbolize == NULL) {
+    shared_symbolize = Symbolize::create();
+  }
+  return *shared_symbolize;
+}
+
+void backtrace_symbolize_reset() {
+  internal::MutexLock lock(&symbolize_mutex);
+  delete shared_symbolize;
+  shared_symbolize = NULL;
+}
+
+void symbol_string_copy(const string& source, char *destination) {
+  size_t length = source.size();
+  if (length > BACKTRACE_SYMBOL_STRING_SIZE - 1) {
+    length = BACKTRACE_SYMBOL_STRING_SIZE - 1;
+  }
+  memcpy(destination, source.data(), length);
+  destination[length] = '\0';
+}
+
+void symbol_to_c(const Symbol& symbol, void *address, backtrace_symbol *c) {
+  c->address = address;
+  c->function_offset = symbol.function_offset;
+  c->line_number = symbol.line_number;
+  symbol_string_copy(symbol.function_name, c->function_name);
+  symbol_string_copy(symbol.file_name, c->file_name);
+  symbol_string_copy(symbol.object_name, c->object_name);
+}
+
+int backtrace_symbolize_callback(void * const *addresses,
+                                 int num_addresses,
+                                 backtrace_symbol_callback callback,
+                                 void *user_data) {
+  if (num_addresses <= 0) {
+    return 0;
+  }
+  StackTraceAddresses stacktrace(addresses, (size_t)num_addresses);
+  backtrace_symbol symbol;
+  internal::MutexLock lock(&symbolize_mutex);
+  Symbolize& symbolize = backtrace_symbolize_get();
+  symbolize.resolve(stacktrace);
+  for (int i = 0; i < num_addresses; ++i) {
+    symbol_to_c(symbolize.at(i), addresses[i], &symbol);
+    callback(&symbol, i, user_data);
+  }
+  return num_addresses;
+}
+
+struct SymbolizeArray {
+  backtrace_symbol *symbols;
+  size_t symbol_size;
+};
+
+void backtrace_symbolize_array_cb(const backtrace_symbol *symbol,
+                                  int index,
+                                  void *user_data) {
+  SymbolizeArray *array = reinterpret_cast<SymbolizeArray *>(user_data);
+  // Stride is the caller's size of the record, which might be larger.
+  char *record = reinterpret_cast<char *>(array->symbols) +
+                 (size_t)index * array->symbol_size;
+  memcpy(record, symbol, sizeof(*symbol));
+}
+
+int backtrace_symbolize(void * const *addresses,
+                        int num_addresses,
+                        backtrace_symbol *symbols,
+                        size_t symbol_size) {
+  // Records are only ever extended.
+  if (symbol_size < sizeof(backtrace_symbol)) {
+    return -1;
+  }
+  SymbolizeArray array;
+  array.symbols = symbols;
+  array.symbol_size = symbol_size;
+  return bt::backtrace_symbolize_callback(addresses,
+                                          num_addresses,
+                                          backtrace_symbolize_array_cb,
+                                          &array);
+}
+
+int backtrace_format(void * const *addresses,
+                     int num_addresses,
+                     char *buffer,
+                     size_t size) {
+  string text;
+  if (num_addresses > 0) {
+    StackTraceAddresses stacktrace(addresses, (size_t)num_addresses);
+    internal::MutexLock lock(&symbolize_mutex);
+    Symbolize& symbolize = backtrace_symbolize_get();
+    symbolize.resolve(stacktrace);
+    text = internal::symbolize_format(symbolize);
+  }
+  if (size != 0) {
+    size_t length = text.size() < size - 1 ? text.size() : size - 1;
+    memcpy(buffer, text.data(), length);
+    buffer[length] = '\0';
+  }
+  return (int)text.size();
+}
+
+void stats_histogram_to_c(internal::StatsHistogram histogram,
+                          backtrace_stats_histogram *c) {
+  internal::StatsHistogramData data;
+  internal::stats_get(histogram, &data);
+  c->count = data.count;
+  c->sum_ns = data.sum_ns;
+  for (int i = 0; i < BACKTRACE_STATS_NUM_BUCKETS; ++i) {
+    c->buckets[i] = data.buckets[i];
+  }
+}
+
+int backtrace_stats_get(backtrace_stats *stats, size_t stats_size) {
+  // Callers built against older headers get the fields they know about,
+  // shadow stack histogram is the first appended one.
+  if (stats_size < offsetof(backtrace_stats, capture_shadow_stack)) {
+    return -1;
+  }
+  using namespace internal;
+  backtrace_stats result;
+  result.objects_opened = stats_get(STATS_OBJECTS_OPENED);
+  result.cache_hits = stats_get(STATS_CACHE_HITS);
+  result.cache_misses = stats_get(STATS_CACHE_MISSES);
+  result.cache_evictions = stats_get(STATS_CACHE_EVICTIONS);
+  result.demangle_calls = stats_get(STATS_DEMANGLE_CALLS);
+  result.symbol_memory_bytes = stats_get(STATS_SYMBOL_MEMORY);
+  stats_histogram_to_c(STATS_CAPTURE_EXECINFO, &result.capture_execinfo);
+  stats_histogram_to_c(STATS_CAPTURE_CAPTURE_STACK_BACKTRACE,
+                       &result.capture_capture_stack_backtrace);
+  stats_histogram_to_c(STATS_CAPTURE_STACK_WALK, &result.capture_stack_walk);
+  stats_histogram_to_c(STATS_SYMBOLIZE, &result.symbolize);
+  stats_histogram_to_c(STATS_CAPTURE_SHADOW_STACK,
+                       &result.capture_shadow_stack);
+  result.symbol_cache_hits = stats_get(STATS_SYMBOL_CACHE_HITS);
+  result.symbol_cache_misses = stats_get(STATS_SYMBOL_CACHE_MISSES);
+  result.symbol_cache_entries = stats_get(STATS_SYMBOL_CACHE_ENTRIES);
+  memcpy(stats, &result, std::min(stats_size, sizeof(result)));
+  return 0;
+}
+
+void backtrace_stats_reset() {
+  internal::stats_reset();
+}
+
+void backtrace_stats_print(FILE *fp) {
+  fputs(internal::stats_format_text().c_str(), fp);
+}
+
+void backtrace_stats_print_json(FILE *fp) {
+  fputs(internal::stats_format_json().c_str(), fp);
+}
+
+void backtrace_symbol_cache_set_size(size_t size) {
+  Symbolize::set_symbol_cache_size(size);
+}
+
+int backtrace_symbolize_set_backends(const char *names) {
+  vector<SymbolizeBackend> backends;
+  string list = names;
+  size_t start = 0;
+  while (start <= list.size()) {
+    size_t end = list.find(',', start);
+    if (end == string::npos) {
+      end = list.size();
+    }
+    string name = list.substr(start, end - start);
+    int backend = 0;
+    while (backend < SYMBOLIZE_NUM_BACKENDS &&
+           name != Symbolize::backend_name((SymbolizeBackend)backend)) {
+      ++backend;
+    }
+    if (backend == SYMBOLIZE_NUM_BACKENDS) {
+      return -1;
+    }
+    backends.push_back((SymbolizeBackend)backend);
+    start = end + 1;
+  }
+  if (!Symbolize::set_backends(backends)) {
+    return -1;
+  }
+  backtrace_symbolize_reset();
+  return 0;
+}
+
+void backtrace_symbolize_set_detail(int detail) {
+  Symbolize::set_detail(detail == BACKTRACE_DETAIL_FUNCTION
+                            ? SYMBOLIZE_DETAIL_FUNCTION
+                            : SYMBOLIZE_DETAIL_LINE);
+  backtrace_symbolize_reset();
+}
+
+SymbolizeQueue& backtrace_queue_get() {
+  static SymbolizeQueue queue;
+  return queue;
+}
+
+void backtrace_print_async_cb(const vector<Symbol>& symbols,
+                              void *user_data) {
+  FILE *fp = reinterpret_cast<FILE *>(user_data);
+  string backtrace = internal::symbolize_format(symbols);
+  fputs(backtrace.c_str(), fp);
+}
+
+void backtrace_print_async(FILE *fp) {
+  StackTrace *stacktrace = StackTrace::create();
+  stacktrace->load(NULL, BACKTRACE_MAX_DEPTH);
+  backtrace_queue_get().submit(stacktrace, backtrace_print_async_cb, fp);
+}
+
+void backtrace_async_flush() {
+  backtrace_queue_get().flush();
+}
+
+// Nothing to print, symbols only end up in the symbol cache.
+void backtrace_warm_cb(const vector<Symbol>& /*symbols*/,
+                       void * /*user_data*/) {
+}
+
+// Object and offset within it of every frame, which is enough to
+// symbolize them offline.
+string backtrace_unresolved_format(const StackTrace& stacktrace) {
+  // Call sites rather than return addresses, same as the backends do.
+  StackTraceAddresses addresses;
+  for (size_t i = 0; i < stacktrace.size(); ++i) {
+    addresses.push_back(
+        static_cast<unsigned char *>(stacktrace[i].address) - 1);
+  }
+  RelativeStackTrace relative(addresses);
+  vector<Symbol> symbols(relative.size());
+  for (size_t i = 0; i < relative.size(); ++i) {
+    symbols[i].address = reinterpret_cast<size_t>(addresses[i].address);
+    if (relative[i].module == RelativeFrame::MODULE_NONE) {
+      continue;
+    }
+    symbols[i].object_name = relative_module_get(relative[i].module).path;
+    symbols[i].object_offset = (size_t)relative[i].offset;
+  }
+  return internal::symbolize_format(symbols);
+}
+
+int backtrace_print_deadline(FILE *fp,
+                             int budget_ms,
+                             int finish_in_background) {
+  uint64_t deadline = internal::time_monotonic_ns() +
+                      (uint64_t)(budget_ms > 0 ? budget_ms : 0) * 1000000;
+  StackTrace *stacktrace = StackTrace::create();
+  stacktrace->load(NULL, BACKTRACE_MAX_DEPTH);
+  string backtrace;
+  StackTraceAddresses *skipped = NULL;
+  size_t num_skipped;
+  // Shared symbolizer keeps objects loaded, so they don't eat up the
+  // budget of every call. It might be busy with a call which has no
+  // deadline though, waiting for it is within the budget as well.
+  if (symbolize_mutex.lock_until(deadline)) {
+    Symbolize& symbolize = backtrace_symbolize_get();
+    num_skipped = symbolize.resolve_until(*stacktrace, deadline);
+    backtrace = internal::symbolize_format(symbolize);
+    // Finishing only pays off through the cache.
+    if (num_skipped != 0 && finish_in_background &&
+        Symbolize::symbol_cache_size() != 0) {
+      skipped = new StackTraceAddresses();
+      for (size_t i = 0; i < symbolize.size(); ++i) {
+        if (symbolize.at(i).object_offset != Symbol::OFFSET_NONE) {
+          skipped->push_back((*stacktrace)[i].address);
+        }
       }
-    } else {
-      const int N = 8;
-      size_t pad = ((size_t)((function_name.size() + N - 1) / N)) * N
-                   - function_name.size();
-      ss << std::setfill(' ') << std::setw(pad) << ""
-         << " " << symbol.file_name;
-      if (symbol.line_number != Symbol::LINE_NONE) {
-         ss << ":" << symbol.line_number;
+    }
+    symbolize_mutex.unlock();
+  } else {
+    backtrace = backtrace_unresolved_format(*stacktrace);
+    num_skipped = stacktrace->size();
+    if (num_skipped != 0 && finish_in_background &&
+        Symbolize::symbol_cache_size() != 0) {
+      skipped = new StackTraceAddresses();
+      for (size_t i = 0; i < stacktrace->size(); ++i) {
+        skipped->push_back((*stacktrace)[i].address);
       }
     }
-    ss << "\n";
   }
-  delete symbolize;
-  return ss.str();
+  delete stacktrace;
+  fputs(backtrace.c_str(), fp);
+  if (skipped != NULL) {
+    backtrace_queue_get().submit(skipped, backtrace_warm_cb, NULL);
+  }
+  return (int)num_skipped;
 }
 
-void backtrace_print(FILE *fp) {
-  string backtrace = backtrace_get_string();
+int backtrace_helper_start() {
+#ifdef BACKTRACE_HAS_EXECINFO
+  return internal::SymbolizeHelper::instance().start() ? 0 : -1;
+#else
+  return -1;
+#endif
+}
+
+void backtrace_helper_stop() {
+#ifdef BACKTRACE_HAS_EXECINFO
+  internal::SymbolizeHelper::instance().stop();
+#endif
+}
+
+void backtrace_helper_print(int fd) {
+#ifdef BACKTRACE_HAS_EXECINFO
+  // Use backtrace() directly, StackTrace allocates memory.
+  void *addresses[BACKTRACE_MAX_DEPTH];
+  int num_addresses = ::backtrace(addresses, BACKTRACE_MAX_DEPTH);
+  internal::SymbolizeHelper::instance().print(addresses, num_addresses, fd);
+#else
+  (void) fd;  // Ignored.
+#endif
+}
+
+int backtrace_print_all_threads(FILE *fp, int timeout_ms) {
+#ifdef BACKTRACE_HAS_THREAD_DUMP
+  vector<internal::ThreadStackTrace> threads;
+  if (!internal::thread_dump_capture(timeout_ms, &threads)) {
+    return -1;
+  }
+  string dump = internal::thread_dump_format(threads);
+  fputs(dump.c_str(), fp);
+  int num_captured = 0;
+  for (size_t i = 0; i < threads.size(); ++i) {
+    if (threads[i].captured) {
+      ++num_captured;
+    }
+  }
+  return num_captured;
+#else
+  (void) fp;  // Ignored.
+  (void) timeout_ms;  // Ignored.
+  return -1;
+#endif
+}
+
+int backtrace_print_process(int pid, FILE *fp) {
+#ifdef BACKTRACE_HAS_REMOTE_BACKTRACE
+  vector<internal::Module> modules;
+  vector<internal::RemoteThreadStackTrace> threads;
+  if (!internal::remote_backtrace_capture(pid, &modules, &threads)) {
+    return -1;
+  }
+  string dump = internal::remote_backtrace_format(modules, threads);
+  fputs(dump.c_str(), fp);
+  int num_captured = 0;
+  for (size_t i = 0; i < threads.size(); ++i) {
+    if (threads[i].captured) {
+      ++num_captured;
+    }
+  }
+  return num_captured;
+#else
+  (void) pid;  // Ignored.
+  (void) fp;  // Ignored.
+  return -1;
+#endif
+}
+
+int backtrace_minidump_install(const char *filename) {
+#ifdef BACKTRACE_HAS_MINIDUMP
+  return internal::minidump_install(filename) ? 0 : -1;
+#else
+  (void) filename;  // Ignored.
+  return -1;
+#endif
+}
+
+int backtrace_minidump_print(const char *filename, FILE *fp) {
+#ifdef BACKTRACE_HAS_MINIDUMP
+  internal::Minidump dump;
+  if (!internal::minidump_read(filename, &dump)) {
+    return -1;
+  }
+  string text = internal::minidump_format(dump);
+  fputs(text.c_str(), fp);
+  return 0;
+#else
+  (void) filename;  // Ignored.
+  (void) fp;  // Ignored.
+  return -1;
+#endif
+}
+
+int backtrace_flight_recorder_open(const char *filename,
+                                   size_t events_per_thread,
+                                   size_t max_threads) {
+#ifdef BACKTRACE_HAS_FLIGHT_RECORDER
+  return internal::flight_recorder_open(filename,
+                                        events_per_thread,
+                                        max_threads) ? 0 : -1;
+#else
+  (void) filename;  // Ignored.
+  (void) events_per_thread;  // Ignored.
+  (void) max_threads;  // Ignored.
+  return -1;
+#endif
+}
+
+void backtrace_flight_recorder_update_modules() {
+#ifdef BACKTRACE_HAS_FLIGHT_RECORDER
+  internal::flight_recorder_update_modules();
+#endif
+}
+
+int backtrace_flight_recorder_print(const char *filename,
+                                    size_t last_events,
+                                    FILE *fp) {
+#ifdef BACKTRACE_HAS_FLIGHT_RECORDER
+  internal::FlightRecording recording;
+  bool ok = (filename == NULL)
+                ? internal::flight_recorder_snapshot(&recording)
+                : internal::flight_recorder_read(filename, &recording);
+  if (!ok) {
+    return -1;
+  }
+  string text = internal::flight_recorder_format(recording, last_events);
+  fputs(text.c_str(), fp);
+  return 0;
+#else
+  (void) filename;  // Ignored.
+  (void) last_events;  // Ignored.
+  (void) fp;  // Ignored.
+  return -1;
+#endif
+}
+
+void backtrace_log_at_exit();
+
+BacktraceLog *backtrace_log_create() {
+  // Suppressed counts are printed by an exit handler, which runs before
+  // standard streams are closed.
+  atexit(backtrace_log_at_exit);
+  return new BacktraceLog();
+}
+
+BacktraceLog& backtrace_log_get() {
+  // Never destroyed, files it prints to might be closed at exit already.
+  static BacktraceLog *log = backtrace_log_create();
+  return *log;
+}
+
+void backtrace_log_at_exit() {
+  backtrace_log_get().stop();
+}
+
+int backtrace_log(FILE *fp) {
+  return backtrace_log_get().log(fp) ? 1 : 0;
+}
+
+void backtrace_log_set_window(int window_ms) {
+  backtrace_log_get().set_window(window_ms);
+}
+
+void backtrace_log_flush() {
+  backtrace_log_get().flush();
+}
+
+int backtrace_print_throw_trace(FILE *fp) {
+#if defined(BACKTRACE_HAS_THROW_TRACE) && __cplusplus >= 201103L
+  StackTraceAddresses stacktrace;
+  if (!throw_trace_current(&stacktrace)) {
+    return -1;
+  }
+  Symbolize *symbolize = Symbolize::create();
+  symbolize->resolve(stacktrace);
+  string backtrace = internal::symbolize_format(*symbolize);
+  delete symbolize;
   fputs(backtrace.c_str(), fp);
+  return 0;
+#else
+  (void) fp;  // Ignored.
+  return -1;
+#endif
+}
+
+int backtrace_lock_profiler_start(int threshold_us, int sample_period) {
+#ifdef BACKTRACE_HAS_LOCK_PROFILER
+  lock_profiler_start((uint64_t)threshold_us * 1000, sample_period);
+  return 0;
+#else
+  (void) threshold_us;  // Ignored.
+  (void) sample_period;  // Ignored.
+  return -1;
+#endif
+}
+
+void backtrace_lock_profiler_stop() {
+#ifdef BACKTRACE_HAS_LOCK_PROFILER
+  lock_profiler_stop();
+#endif
+}
+
+int backtrace_lock_profiler_print(FILE *fp) {
+#ifdef BACKTRACE_HAS_LOCK_PROFILER
+  CallingContextTree tree;
+  lock_profiler_get(&tree);
+  string folded = tree.folded();
+  fputs(folded.c_str(), fp);
+  return 0;
+#else
+  (void) fp;  // Ignored.
+  return -1;
+#endif
+}
+
+int backtrace_lock_profiler_write_pprof(const char *filename) {
+#ifdef BACKTRACE_HAS_LOCK_PROFILER
+  CallingContextTree tree;
+  lock_profiler_get(&tree);
+  return pprof_write(tree, filename, "delay", "nanoseconds") ? 0 : -1;
+#else
+  (void) filename;  // Ignored.
+  return -1;
+#endif
+}
+
+int backtrace_sampler_start(int frequency) {
+#ifdef BACKTRACE_HAS_SAMPLER
+  return sampler_profile_start(frequency > 0 ? frequency : 99) ? 0 : -1;
+#else
+  (void) frequency;  // Ignored.
+  return -1;
+#endif
+}
+
+void backtrace_sampler_stop() {
+#ifdef BACKTRACE_HAS_SAMPLER
+  sampler_profile_stop();
+#endif
+}
+
+int backtrace_sampler_print(FILE *fp) {
+#ifdef BACKTRACE_HAS_SAMPLER
+  CallingContextTree tree;
+  sampler_profile_get(&tree);
+  string folded = tree.folded();
+  fputs(folded.c_str(), fp);
+  return 0;
+#else
+  (void) fp;  // Ignored.
+  return -1;
+#endif
+}
+
+int backtrace_sampler_write_pprof(const char *filename) {
+#ifdef BACKTRACE_HAS_SAMPLER
+  CallingContextTree tree;
+  sampler_profile_get(&tree);
+  return pprof_write(tree, filename) ? 0 : -1;
+#else
+  (void) filename;  // Ignored.
+  return -1;
+#endif
 }
 
 }  // namespace
@@ -87,3 +634,222 @@ void backtrace_print(FILE *fp) {
 void backtrace_print(FILE *fp) {
   bt::backtrace_print(fp);
 }
+
+int backtrace_capture(void **addresses, int max_depth, int skip) {
+  // Captured here rather than in a forwarded call, so there's exactly one
+  // frame of the library to skip.
+  if (max_depth <= 0) {
+    return 0;
+  }
+  int num_skip = (skip > 0 ? skip : 0) + 1;
+#ifdef BACKTRACE_HAS_SHADOW_STACK
+  if (bt::internal::shadow_stack_is_active()) {
+    // Library is not instrumented, so there's no frame of it to skip.
+    bt::StackTrace *stacktrace = bt::StackTrace::create();
+    stacktrace->load(NULL, (size_t)(max_depth + num_skip - 1));
+    int num_frames = 0;
+    for (size_t i = num_skip - 1; i < stacktrace->size(); ++i) {
+      addresses[num_frames++] = (*stacktrace)[i].address;
+    }
+    delete stacktrace;
+    return num_frames;
+  }
+#endif
+#ifdef BACKTRACE_HAS_EXECINFO
+  bt::internal::StatsTimer timer(bt::internal::STATS_CAPTURE_EXECINFO);
+  void *frames[2 * BACKTRACE_MAX_DEPTH];
+  int depth = max_depth + num_skip;
+  void **buffer = frames;
+  if (depth > (int)(sizeof(frames) / sizeof(*frames))) {
+    // Deep traces are captured in place and lose the skipped frames.
+    depth = max_depth;
+    buffer = addresses;
+  }
+  int num_frames = ::backtrace(buffer, depth);
+  num_frames = (num_frames > num_skip) ? num_frames - num_skip : 0;
+  memmove(addresses, buffer + num_skip, num_frames * sizeof(void *));
+  return num_frames;
+#else
+  bt::StackTrace *stacktrace = bt::StackTrace::create();
+  stacktrace->load(NULL, (size_t)(max_depth + num_skip));
+  int num_frames = 0;
+  for (size_t i = num_skip; i < stacktrace->size(); ++i) {
+    addresses[num_frames++] = (*stacktrace)[i].address;
+  }
+  delete stacktrace;
+  return num_frames;
+#endif
+}
+
+int backtrace_symbolize(void * const *addresses,
+                        int num_addresses,
+                        backtrace_symbol *symbols,
+                        size_t symbol_size) {
+  return bt::backtrace_symbolize(addresses,
+                                 num_addresses,
+                                 symbols,
+                                 symbol_size);
+}
+
+int backtrace_symbolize_callback(void * const *addresses,
+                                 int num_addresses,
+                                 backtrace_symbol_callback callback,
+                                 void *user_data) {
+  return bt::backtrace_symbolize_callback(addresses,
+                                          num_addresses,
+                                          callback,
+                                          user_data);
+}
+
+int backtrace_format(void * const *addresses,
+                     int num_addresses,
+                     char *buffer,
+                     size_t size) {
+  return bt::backtrace_format(addresses, num_addresses, buffer, size);
+}
+
+int backtrace_stats_get(backtrace_stats *stats, size_t stats_size) {
+  return bt::backtrace_stats_get(stats, stats_size);
+}
+
+void backtrace_stats_reset(void) {
+  bt::backtrace_stats_reset();
+}
+
+void backtrace_stats_print(FILE *fp) {
+  bt::backtrace_stats_print(fp);
+}
+
+void backtrace_stats_print_json(FILE *fp) {
+  bt::backtrace_stats_print_json(fp);
+}
+
+void backtrace_symbol_cache_set_size(size_t size) {
+  bt::backtrace_symbol_cache_set_size(size);
+}
+
+int backtrace_symbolize_set_backends(const char *backends) {
+  return bt::backtrace_symbolize_set_backends(backends);
+}
+
+void backtrace_symbolize_set_detail(int detail) {
+  bt::backtrace_symbolize_set_detail(detail);
+}
+
+void backtrace_print_async(FILE *fp) {
+  bt::backtrace_print_async(fp);
+}
+
+void backtrace_async_flush(void) {
+  bt::backtrace_async_flush();
+}
+
+int backtrace_print_deadline(FILE *fp,
+                             int budget_ms,
+                             int finish_in_background) {
+  return bt::backtrace_print_deadline(fp, budget_ms, finish_in_background);
+}
+
+int backtrace_helper_start(void) {
+  return bt::backtrace_helper_start();
+}
+
+void backtrace_helper_stop(void) {
+  bt::backtrace_helper_stop();
+}
+
+void backtrace_helper_print(int fd) {
+  bt::backtrace_helper_print(fd);
+}
+
+int backtrace_print_all_threads(FILE *fp, int timeout_ms) {
+  return bt::backtrace_print_all_threads(fp, timeout_ms);
+}
+
+int backtrace_print_process(int pid, FILE *fp) {
+  return bt::backtrace_print_process(pid, fp);
+}
+
+int backtrace_minidump_install(const char *filename) {
+  return bt::backtrace_minidump_install(filename);
+}
+
+int backtrace_minidump_print(const char *filename, FILE *fp) {
+  return bt::backtrace_minidump_print(filename, fp);
+}
+
+int backtrace_flight_recorder_open(const char *filename,
+                                   size_t events_per_thread,
+                                   size_t max_threads) {
+  return bt::backtrace_flight_recorder_open(filename,
+                                            events_per_thread,
+                                            max_threads);
+}
+
+void backtrace_flight_record(const char *tag) {
+#ifdef BACKTRACE_HAS_FLIGHT_RECORDER
+  // Recorded stack starts at the caller of this function, so this one is
+  // not a forwarder like the rest.
+  bt::internal::flight_recorder_record(tag, __builtin_frame_address(0));
+#else
+  (void) tag;  // Ignored.
+#endif
+}
+
+void backtrace_flight_recorder_update_modules(void) {
+  bt::backtrace_flight_recorder_update_modules();
+}
+
+int backtrace_flight_recorder_print(const char *filename,
+                                    size_t last_events,
+                                    FILE *fp) {
+  return bt::backtrace_flight_recorder_print(filename, last_events, fp);
+}
+
+int backtrace_log(FILE *fp) {
+  return bt::backtrace_log(fp);
+}
+
+void backtrace_log_set_window(int window_ms) {
+  bt::backtrace_log_set_window(window_ms);
+}
+
+void backtrace_log_flush(void) {
+  bt::backtrace_log_flush();
+}
+
+int backtrace_print_throw_trace(FILE *fp) {
+  return bt::backtrace_print_throw_trace(fp);
+}
+
+int backtrace_lock_profiler_start(int threshold_us, int sample_period) {
+  return bt::backtrace_lock_profiler_start(threshold_us, sample_period);
+}
+
+void backtrace_lock_profiler_stop(void) {
+  bt::backtrace_lock_profiler_stop();
+}
+
+int backtrace_lock_profiler_print(FILE *fp) {
+  return bt::backtrace_lock_profiler_print(fp);
+}
+
+int backtrace_lock_profiler_write_pprof(const char *filename) {
+  return bt::backtrace_lock_profiler_write_pprof(filename);
+}
+
+int backtrace_sampler_start(int frequency) {
+  return bt::backtrace_sampler_start(frequency);
+}
+
+void backtrace_sampler_stop(void) {
+  bt::backtrace_sampler_stop();
+}
+
+int backtrace_sampler_print(FILE *fp) {
+  return bt::backtrace_sampler_print(fp);
+}
+
+int backtrace_sampler_write_pprof(const char *filename) {
+  return bt::backtrace_sampler_write_pprof(filename);
+}
@@ -0,0 +1,200 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "backtrace/backtrace_log.h"
+
+#include <inttypes.h>
+
+#include "backtrace/backtrace.h"
+#include "backtrace/symbolize.h"
+
+namespace bt {
+
+namespace {
+
+// Innermost location with line information, which is most likely the code
+// which logged the backtrace and not the logging machinery.
+string location_get(Symbolize& symbolize) {
+  for (size_t i = 0; i < symbolize.size(); ++i) {
+    const Symbol& symbol = symbolize.at(i);
+    if (symbol.file_name != "" && symbol.line_number != Symbol::LINE_NONE) {
+      std::stringstream ss;
+      ss << symbol.file_name << ":" << symbol.line_number;
+      return ss.str();
+    }
+  }
+  return "unknown location";
+}
+
+}  // namespace
+
+BacktraceLog::BacktraceLog(int window_ms)
+    : window_ns_((uint64_t)window_ms * 1000000),
+      last_flush_time_(internal::time_monotonic_ns()),
+      flush_thread_started_(false),
+      stop_(false),
+      flush_thread_(flush_thread_main, this) {
+}
+
+BacktraceLog::~BacktraceLog() {
+  stop();
+}
+
+void BacktraceLog::set_window(int window_ms) {
+  internal::MutexLock lock(&mutex_);
+  window_ns_ = (uint64_t)window_ms * 1000000;
+  flush_condition_.notify_one();
+}
+
+bool BacktraceLog::log(FILE *fp) {
+  StackTrace *stacktrace = StackTrace::create();
+  stacktrace->load(NULL, BACKTRACE_MAX_DEPTH);
+  bool printed = log(*stacktrace, fp);
+  delete stacktrace;
+  return printed;
+}
+
+bool BacktraceLog::log(const StackTrace& stacktrace, FILE *fp) {
+  uint64_t hash = internal::stacktrace_hash(stacktrace);
+  uint64_t now = internal::time_monotonic_ns();
+  {
+    internal::MutexLock lock(&mutex_);
+    if (now - last_flush_time_ >= window_ns_) {
+      flush_locked(now, false);
+    }
+    EntryMap::iterator it = entries_.find(hash);
+    if (it != entries_.end()) {
+      Entry& entry = it->second;
+      if (now - entry.print_time < window_ns_) {
+        if (entry.num_suppressed++ == 0 && !stop_) {
+          // Only the first suppression within the window needs to tell
+          // the thread when to print the summary.
+          if (flush_thread_started_) {
+            flush_condition_.notify_one();
+          } else {
+            flush_thread_started_ = flush_thread_.start();
+          }
+        }
+        return false;
+      }
+      // Window is over, report what was suppressed and print again.
+      if (entry.num_suppressed != 0) {
+        print_summary(hash, entry);
+      }
+    }
+    Entry& entry = entries_[hash];
+    entry.print_time = now;
+    entry.num_suppressed = 0;
+    entry.fp = fp;
+  }
+  // Symbolize outside of the lock, so other threads hitting the same stack
+  // are not blocked.
+  Symbolize *symbolize = Symbolize::create();
+  symbolize->resolve(stacktrace);
+  string backtrace = internal::symbolize_format(*symbolize);
+  string location = location_get(*symbolize);
+  delete symbolize;
+  {
+    internal::MutexLock lock(&mutex_);
+    EntryMap::iterator it = entries_.find(hash);
+    if (it != entries_.end()) {
+      it->second.location = location;
+    }
+  }
+  fprintf(fp, "Backtrace %016" PRIx64 ":\n", hash);
+  fputs(backtrace.c_str(), fp);
+  return true;
+}
+
+void BacktraceLog::flush() {
+  internal::MutexLock lock(&mutex_);
+  flush_locked(internal::time_monotonic_ns(), true);
+}
+
+void BacktraceLog::stop() {
+  {
+    internal::MutexLock lock(&mutex_);
+    stop_ = true;
+    flush_condition_.notify_one();
+  }
+  flush_thread_.join();
+  flush();
+}
+
+void BacktraceLog::flush_locked(uint64_t now, bool force) {
+  EntryMap::iterator it = entries_.begin();
+  while (it != entries_.end()) {
+    Entry& entry = it->second;
+    bool expired = (now - entry.print_time >= window_ns_);
+    if (entry.num_suppressed != 0 && (expired || force)) {
+      print_summary(it->first, entry);
+      entry.num_suppressed = 0;
+    }
+    if (expired) {
+      // Next occurrence will be printed in full anyway.
+      entries_.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+  last_flush_time_ = now;
+}
+
+void BacktraceLog::flush_thread_main(void *log_v) {
+  BacktraceLog *log = reinterpret_cast<BacktraceLog *>(log_v);
+  log->flush_run();
+}
+
+void BacktraceLog::flush_run() {
+  internal::MutexLock lock(&mutex_);
+  while (!stop_) {
+    // Earliest end of a window with suppressed occurrences.
+    bool has_suppressed = false;
+    uint64_t expiry = 0;
+    for (EntryMap::const_iterator it = entries_.begin();
+         it != entries_.end();
+         ++it) {
+      const Entry& entry = it->second;
+      if (entry.num_suppressed != 0 &&
+          (!has_suppressed || entry.print_time + window_ns_ < expiry)) {
+        has_suppressed = true;
+        expiry = entry.print_time + window_ns_;
+      }
+    }
+    uint64_t now = internal::time_monotonic_ns();
+    if (!has_suppressed) {
+      flush_condition_.wait(&mutex_);
+    } else if (now < expiry) {
+      flush_condition_.wait_for(&mutex_, expiry - now);
+    } else {
+      flush_locked(now, false);
+    }
+  }
+}
+
+void BacktraceLog::print_summary(uint64_t hash, const Entry& entry) {
+  fprintf(entry.fp,
+          "Backtrace %016" PRIx64 " at %s repeated %" PRIu64 " more times\n",
+          hash,
+          entry.location.c_str(),
+          entry.num_suppressed);
+}
+
+}  // namespace bt
@@ -0,0 +1,102 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef __BACKTRACE_LOG_H__
+#define __BACKTRACE_LOG_H__
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "backtrace/backtrace_util.h"
+#include "backtrace/stacktrace.h"
+
+namespace bt {
+
+// Log of backtraces which prints every unique stack only once per time
+// window.
+//
+// Logging a backtrace only costs capturing raw addresses and a hash table
+// lookup, symbolization only happens for the first occurrence of a stack
+// within the window. Later occurrences are counted and the number of
+// suppressed backtraces is printed once the window is over, by a
+// background thread which is started once the first stack is suppressed.
+//
+// Stacks are identified by a 64 bit hash of their addresses, so collisions
+// are ignored.
+class BacktraceLog {
+ public:
+  explicit BacktraceLog(int window_ms = 60000);
+
+  // Prints all the suppressed counts which were not printed yet.
+  ~BacktraceLog();
+
+  // Change length of the window, in milliseconds.
+  void set_window(int window_ms);
+
+  // Capture backtrace of the calling thread and log it.
+  bool log(FILE *fp);
+
+  // Log stack trace which was captured elsewhere. Returns true if the
+  // trace was printed, false if it was suppressed.
+  bool log(const StackTrace& stacktrace, FILE *fp);
+
+  // Print number of suppressed occurrences of every stack since it was
+  // printed last time and forget stacks which were not seen within the
+  // window.
+  void flush();
+
+  // Same as flush(), but also stop the background thread, so nothing is
+  // printed from it afterwards. Meant to be called at exit, while files
+  // are still open, later suppressed counts are only printed by flush()
+  // or by the destructor.
+  void stop();
+
+ private:
+  struct Entry {
+    // Time at which the stack was printed last time.
+    uint64_t print_time;
+    // Number of occurrences since then.
+    uint64_t num_suppressed;
+    // Location which logged the backtrace, to make summary readable.
+    string location;
+    FILE *fp;
+  };
+  typedef map<uint64_t, Entry> EntryMap;
+
+  void flush_locked(uint64_t now, bool force);
+  static void print_summary(uint64_t hash, const Entry& entry);
+  static void flush_thread_main(void *log_v);
+  void flush_run();
+
+  internal::Mutex mutex_;
+  EntryMap entries_;
+  uint64_t window_ns_;
+  uint64_t last_flush_time_;
+
+  // Prints suppressed counts as soon as their window is over.
+  internal::ConditionVariable flush_condition_;
+  bool flush_thread_started_;
+  bool stop_;
+  internal::Thread flush_thread_;
+};
+
+}  // namespace bt
+
+#endif  // __BACKTRACE_LOG_H__
@@ -25,6 +25,8 @@
 #if defined(_MSC_VER)
 #  include <windows.h>
 #  include <dbghelp.h>
+#else
+#  include <time.h>
 #endif
 
 namespace bt {
@@ -44,6 +46,35 @@ void init_symbol_handler() {
 }
 #endif
 
+uint64_t time_monotonic_ns() {
+#if defined(_MSC_VER)
+  LARGE_INTEGER frequency, counter;
+  QueryPerformanceFrequency(&frequency);
+  QueryPerformanceCounter(&counter);
+  return (uint64_t)(counter.QuadPart / (double)frequency.QuadPart * 1e9);
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+bool Mutex::lock_until(uint64_t deadline_ns) {
+  // Polling, there is no timed lock on a monotonic clock everywhere.
+  while (!try_lock()) {
+    if (time_monotonic_ns() >= deadline_ns) {
+      return false;
+    }
+#if defined(_MSC_VER)
+    Sleep(0);
+#else
+    struct timespec ts = {0, 50000};
+    nanosleep(&ts, NULL);
+#endif
+  }
+  return true;
+}
+
 }  // namespace internal
 
 }  // namespace bt
@@ -25,10 +25,18 @@
 
 #include <cassert>
 #include <map>
+#include <stdint.h>
 #include <string>
 #include <sstream>
 #include <vector>
 
+#if defined(_MSC_VER)
+#  include <windows.h>
+#else
+#  include <pthread.h>
+#  include <time.h>
+#endif
+
 namespace bt {
 
 using std::string;
@@ -57,6 +65,162 @@ namespace internal {
 void init_symbol_handler();
 #endif
 
+// Monotonic time in nanoseconds, only differences are meaningful.
+uint64_t time_monotonic_ns();
+
+// Simple non-recursive mutex, for the platforms we care about.
+class Mutex {
+ public:
+#if defined(_MSC_VER)
+  Mutex() { InitializeCriticalSection(&mutex_); }
+  ~Mutex() { DeleteCriticalSection(&mutex_); }
+  void lock() { EnterCriticalSection(&mutex_); }
+  bool try_lock() { return TryEnterCriticalSection(&mutex_) != 0; }
+  void unlock() { LeaveCriticalSection(&mutex_); }
+#else
+  Mutex() { pthread_mutex_init(&mutex_, NULL); }
+  ~Mutex() { pthread_mutex_destroy(&mutex_); }
+  void lock() { pthread_mutex_lock(&mutex_); }
+  bool try_lock() { return pthread_mutex_trylock(&mutex_) == 0; }
+  void unlock() { pthread_mutex_unlock(&mutex_); }
+#endif
+
+  // Returns false if the mutex could not be locked before
+  // time_monotonic_ns() reached the deadline.
+  bool lock_until(uint64_t deadline_ns);
+
+ private:
+  friend class ConditionVariable;
+
+  // Mutex is not copyable.
+  Mutex(const Mutex& other);
+  Mutex& operator=(const Mutex& other);
+
+#if defined(_MSC_VER)
+  CRITICAL_SECTION mutex_;
+#else
+  pthread_mutex_t mutex_;
+#endif
+};
+
+// Condition variable which works together with the Mutex. Wakeups might
+// be spurious, wait_for() also returns once the timeout is over.
+class ConditionVariable {
+ public:
+#if defined(_MSC_VER)
+  ConditionVariable() { InitializeConditionVariable(&cond_); }
+  ~ConditionVariable() {}
+  void wait(Mutex *mutex) {
+    SleepConditionVariableCS(&cond_, &mutex->mutex_, INFINITE);
+  }
+  void wait_for(Mutex *mutex, uint64_t timeout_ns) {
+    uint64_t timeout_ms = timeout_ns / 1000000 + 1;
+    SleepConditionVariableCS(&cond_, &mutex->mutex_,
+                             timeout_ms < INFINITE ? (DWORD)timeout_ms
+                                                   : INFINITE - 1);
+  }
+  void notify_one() { WakeConditionVariable(&cond_); }
+  void notify_all() { WakeAllConditionVariable(&cond_); }
+#else
+  ConditionVariable() { pthread_cond_init(&cond_, NULL); }
+  ~ConditionVariable() { pthread_cond_destroy(&cond_); }
+  void wait(Mutex *mutex) { pthread_cond_wait(&cond_, &mutex->mutex_); }
+  void wait_for(Mutex *mutex, uint64_t timeout_ns) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    uint64_t nsec = deadline.tv_nsec + timeout_ns % 1000000000;
+    deadline.tv_sec += timeout_ns / 1000000000 + nsec / 1000000000;
+    deadline.tv_nsec = nsec % 1000000000;
+    pthread_cond_timedwait(&cond_, &mutex->mutex_, &deadline);
+  }
+  void notify_one() { pthread_cond_signal(&cond_); }
+  void notify_all() { pthread_cond_broadcast(&cond_); }
+#endif
+
+ private:
+  ConditionVariable(const ConditionVariable& other);
+  ConditionVariable& operator=(const ConditionVariable& other);
+
+#if defined(_MSC_VER)
+  CONDITION_VARIABLE cond_;
+#else
+  pthread_cond_t cond_;
+#endif
+};
+
+// Thread which runs given function until it returns.
+class Thread {
+ public:
+  typedef void (*Function)(void *arg);
+
+  Thread(Function function, void *arg)
+  : function_(function),
+    arg_(arg),
+    started_(false) {}
+
+  ~Thread() { join(); }
+
+  bool start() {
+#if defined(_MSC_VER)
+    thread_ = CreateThread(NULL, 0, thread_main, this, 0, NULL);
+    started_ = (thread_ != NULL);
+#else
+    started_ = (pthread_create(&thread_, NULL, thread_main, this) == 0);
+#endif
+    return started_;
+  }
+
+  void join() {
+    if (!started_) {
+      return;
+    }
+#if defined(_MSC_VER)
+    WaitForSingleObject(thread_, INFINITE);
+    CloseHandle(thread_);
+#else
+    pthread_join(thread_, NULL);
+#endif
+    started_ = false;
+  }
+
+ private:
+  Thread(const Thread& other);
+  Thread& operator=(const Thread& other);
+
+#if defined(_MSC_VER)
+  static DWORD WINAPI thread_main(LPVOID data) {
+    Thread *thread = reinterpret_cast<Thread *>(data);
+    thread->function_(thread->arg_);
+    return 0;
+  }
+  HANDLE thread_;
+#else
+  static void *thread_main(void *data) {
+    Thread *thread = reinterpret_cast<Thread *>(data);
+    thread->function_(thread->arg_);
+    return NULL;
+  }
+  pthread_t thread_;
+#endif
+
+  Function function_;
+  void *arg_;
+  bool started_;
+};
+
+// Keeps mutex locked for the lifetime of the object.
+class MutexLock {
+ public:
+  explicit MutexLock(Mutex *mutex) : mutex_(mutex) { mutex_->lock(); }
+  ~MutexLock() { mutex_->unlock(); }
+
+ private:
+  MutexLock(const MutexLock& other);
+  MutexLock& operator=(const MutexLock& other);
+
+  Mutex *mutex_;
+};
+
 }  // namespace internal
 
 }  // namespace bt
@@ -79,5 +243,17 @@ void init_symbol_handler();
 #ifdef WITH_UCONTEXT
 #  define BACKTRACE_HAS_UCONTEXT
 #endif
+#ifdef WITH_ELF
+#  define BACKTRACE_HAS_ELF
+#endif
+#ifdef WITH_ZLIB
+#  define BACKTRACE_HAS_ZLIB
+#endif
+#ifdef WITH_ZSTD
+#  define BACKTRACE_HAS_ZSTD
+#endif
+#if defined(WITH_SHADOW_STACK) && defined(__GNUC__)
+#  define BACKTRACE_HAS_SHADOW_STACK
+#endif
 
 #endif  /* __BACKTRACE_UTIL_H__ */
@@ -0,0 +1,191 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "backtrace/calling_context_tree.h"
+
+#include "backtrace/symbolize.h"
+
+#define INITIAL_TABLE_SIZE 1024
+
+namespace bt {
+
+const uint32_t CallingContextTree::ROOT;
+const uint32_t CallingContextTree::NONE;
+
+CallingContextTree::CallingContextTree()
+    : total_value_(0) {
+  clear();
+}
+
+uint32_t CallingContextTree::add(const StackTrace& stacktrace,
+                                 uint64_t value) {
+  uint32_t index = ROOT;
+  for (size_t i = stacktrace.size(); i > 0; --i) {
+    index = child_get(index, stacktrace[i - 1].address);
+  }
+  nodes_[index].self_value += value;
+  total_value_ += value;
+  return index;
+}
+
+uint32_t CallingContextTree::add(void * const *addresses,
+                                 size_t size,
+                                 uint64_t value) {
+  uint32_t index = ROOT;
+  for (size_t i = size; i > 0; --i) {
+    index = child_get(index, addresses[i - 1]);
+  }
+  nodes_[index].self_value += value;
+  total_value_ += value;
+  return index;
+}
+
+void CallingContextTree::merge(const CallingContextTree& other) {
+  // Parents always precede children, so mapping of other's nodes is known
+  // by the time their children are visited.
+  vector<uint32_t> mapping(other.nodes_.size());
+  mapping[ROOT] = ROOT;
+  for (size_t i = 1; i < other.nodes_.size(); ++i) {
+    const Node& node = other.nodes_[i];
+    mapping[i] = child_get(mapping[node.parent], node.address);
+  }
+  for (size_t i = 0; i < other.nodes_.size(); ++i) {
+    nodes_[mapping[i]].self_value += other.nodes_[i].self_value;
+  }
+  total_value_ += other.total_value_;
+}
+
+void CallingContextTree::clear() {
+  nodes_.clear();
+  Node root;
+  root.address = NULL;
+  root.parent = NONE;
+  root.self_value = 0;
+  nodes_.push_back(root);
+  table_.clear();
+  table_.resize(INITIAL_TABLE_SIZE, 0);
+  total_value_ = 0;
+}
+
+size_t CallingContextTree::slot_hash(uint32_t parent, void *address) {
+  uint64_t key = reinterpret_cast<uintptr_t>(address) ^
+                 ((uint64_t)parent << 32 | parent);
+  // Mixing step of the MurmurHash3 finalizer.
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdULL;
+  key ^= key >> 33;
+  return (size_t)key;
+}
+
+uint32_t CallingContextTree::child_get(uint32_t parent, void *address) {
+  size_t mask = table_.size() - 1;
+  size_t slot = slot_hash(parent, address) & mask;
+  while (table_[slot] != 0) {
+    const Node& node = nodes_[table_[slot] - 1];
+    if (node.parent == parent && node.address == address) {
+      return table_[slot] - 1;
+    }
+    slot = (slot + 1) & mask;
+  }
+  uint32_t index = (uint32_t)nodes_.size();
+  Node node;
+  node.address = address;
+  node.parent = parent;
+  node.self_value = 0;
+  nodes_.push_back(node);
+  table_[slot] = index + 1;
+  // Keep load factor below one half, so probe sequences stay short.
+  if (nodes_.size() * 2 > table_.size()) {
+    table_grow();
+  }
+  return index;
+}
+
+void CallingContextTree::table_grow() {
+  table_.assign(table_.size() * 2, 0);
+  size_t mask = table_.size() - 1;
+  for (size_t i = 1; i < nodes_.size(); ++i) {
+    size_t slot = slot_hash(nodes_[i].parent, nodes_[i].address) & mask;
+    while (table_[slot] != 0) {
+      slot = (slot + 1) & mask;
+    }
+    table_[slot] = (uint32_t)i + 1;
+  }
+}
+
+string CallingContextTree::folded() const {
+  // Symbolize every unique address once.
+  map<void *, string> names;
+  StackTraceAddresses addresses;
+  for (size_t i = 1; i < nodes_.size(); ++i) {
+    if (names.insert(std::make_pair(nodes_[i].address, string())).second) {
+      addresses.push_back(nodes_[i].address);
+    }
+  }
+  Symbolize *symbolize = Symbolize::create();
+  symbolize->resolve(addresses);
+  for (size_t i = 0; i < addresses.size(); ++i) {
+    const Symbol& symbol = symbolize->at(i);
+    string name = symbol.function_name;
+    if (name.empty()) {
+      name = hex_cast(reinterpret_cast<uintptr_t>(addresses[i].address));
+    }
+    // Semicolon separates frames in the folded format.
+    for (size_t j = 0; j < name.size(); ++j) {
+      if (name[j] == ';') {
+        name[j] = ':';
+      }
+    }
+    names[addresses[i].address] = name;
+  }
+  delete symbolize;
+  // Different addresses within the same function give identical lines,
+  // which are merged.
+  map<string, uint64_t> stacks;
+  vector<const string *> frames;
+  for (size_t i = 1; i < nodes_.size(); ++i) {
+    if (nodes_[i].self_value == 0) {
+      continue;
+    }
+    frames.clear();
+    for (uint32_t index = (uint32_t)i;
+         index != ROOT;
+         index = nodes_[index].parent) {
+      frames.push_back(&names[nodes_[index].address]);
+    }
+    string stack;
+    for (size_t j = frames.size(); j > 0; --j) {
+      stack += *frames[j - 1];
+      if (j != 1) {
+        stack += ";";
+      }
+    }
+    stacks[stack] += nodes_[i].self_value;
+  }
+  std::stringstream ss;
+  for (map<string, uint64_t>::const_iterator it = stacks.begin();
+       it != stacks.end();
+       ++it) {
+    ss << it->first << " " << it->second << "\n";
+  }
+  return ss.str();
+}
+
+}  // namespace bt
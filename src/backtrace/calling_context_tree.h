@@ -0,0 +1,92 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef __CALLING_CONTEXT_TREE_H__
+#define __CALLING_CONTEXT_TREE_H__
+
+#include <stdint.h>
+
+#include "backtrace/backtrace_util.h"
+#include "backtrace/stacktrace.h"
+
+namespace bt {
+
+// Aggregates many stack traces into a tree of calling contexts.
+//
+// Every node corresponds to a frame address in the context of all its
+// callers, and accumulates value of the traces which ended in it (number of
+// samples, time spent waiting and so on). Only raw addresses are stored,
+// symbolization happens once per unique address when tree is exported.
+//
+// Nodes are kept in a single array and children are looked up in an open
+// addressing hash table keyed by parent node and address, so adding a trace
+// does not allocate memory unless new calling contexts are seen.
+class CallingContextTree {
+ public:
+  // Index of the root node, which has no address and no parent.
+  static const uint32_t ROOT = 0;
+  static const uint32_t NONE = ~(uint32_t)0;
+
+  struct Node {
+    void *address;
+    uint32_t parent;
+    // Value of the traces which ended in this node.
+    uint64_t self_value;
+  };
+
+  CallingContextTree();
+
+  // Add stack trace with innermost frame first, as captured by StackTrace.
+  // Returns index of the node which corresponds to the innermost frame.
+  uint32_t add(const StackTrace& stacktrace, uint64_t value = 1);
+  uint32_t add(void * const *addresses, size_t size, uint64_t value = 1);
+
+  // Merge all the traces of other tree into this one.
+  void merge(const CallingContextTree& other);
+
+  // Remove all the traces.
+  void clear();
+
+  size_t num_nodes() const { return nodes_.size(); }
+  const Node& node(uint32_t index) const { return nodes_[index]; }
+
+  // Sum of values of all the traces.
+  uint64_t total_value() const { return total_value_; }
+
+  // Symbolize all the nodes and format tree in the folded stacks format
+  // which is understood by flamegraph.pl: one line per calling context
+  // with frames separated by semicolons, outermost first, followed by the
+  // value.
+  string folded() const;
+
+ private:
+  uint32_t child_get(uint32_t parent, void *address);
+  void table_grow();
+  static size_t slot_hash(uint32_t parent, void *address);
+
+  vector<Node> nodes_;
+  // Index of node plus one, zero means the slot is empty.
+  vector<uint32_t> table_;
+  uint64_t total_value_;
+};
+
+}  // namespace bt
+
+#endif  // __CALLING_CONTEXT_TREE_H__
@@ -22,6 +22,8 @@
 
 #include "backtrace/demangle.h"
 
+#include "backtrace/stats.h"
+
 #ifdef __GNUC__
 #  include <cstdlib>
 #  include <cxxabi.h>
@@ -72,6 +74,7 @@ inline string demangle_impl(const string& function_name) {
 }  // namespace
 
 string demangle(const string& function_name) {
+  internal::stats_add(internal::STATS_DEMANGLE_CALLS);
   return demangle_impl(function_name);
 }
 
@@ -0,0 +1,872 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "backtrace/dwarf_frame.h"
+
+#ifdef BACKTRACE_HAS_DWARF_FRAME
+
+#include <algorithm>
+#include <elf.h>
+
+#include "backtrace/dwarf_reader.h"
+
+#define DW_EH_PE_absptr 0x00
+#define DW_EH_PE_uleb128 0x01
+#define DW_EH_PE_udata2 0x02
+#define DW_EH_PE_udata4 0x03
+#define DW_EH_PE_udata8 0x04
+#define DW_EH_PE_sleb128 0x09
+#define DW_EH_PE_sdata2 0x0a
+#define DW_EH_PE_sdata4 0x0b
+#define DW_EH_PE_sdata8 0x0c
+#define DW_EH_PE_pcrel 0x10
+#define DW_EH_PE_indirect 0x80
+#define DW_EH_PE_omit 0xff
+
+#define DW_CFA_advance_loc 0x40
+#define DW_CFA_offset 0x80
+#define DW_CFA_restore 0xc0
+#define DW_CFA_nop 0x00
+#define DW_CFA_set_loc 0x01
+#define DW_CFA_advance_loc1 0x02
+#define DW_CFA_advance_loc2 0x03
+#define DW_CFA_advance_loc4 0x04
+#define DW_CFA_offset_extended 0x05
+#define DW_CFA_restore_extended 0x06
+#define DW_CFA_undefined 0x07
+#define DW_CFA_same_value 0x08
+#define DW_CFA_register 0x09
+#define DW_CFA_remember_state 0x0a
+#define DW_CFA_restore_state 0x0b
+#define DW_CFA_def_cfa 0x0c
+#define DW_CFA_def_cfa_register 0x0d
+#define DW_CFA_def_cfa_offset 0x0e
+#define DW_CFA_def_cfa_expression 0x0f
+#define DW_CFA_expression 0x10
+#define DW_CFA_offset_extended_sf 0x11
+#define DW_CFA_def_cfa_sf 0x12
+#define DW_CFA_def_cfa_offset_sf 0x13
+#define DW_CFA_val_offset 0x14
+#define DW_CFA_val_offset_sf 0x15
+#define DW_CFA_val_expression 0x16
+#define DW_CFA_AARCH64_negate_ra_state 0x2d
+#define DW_CFA_GNU_args_size 0x2e
+#define DW_CFA_GNU_negative_offset_extended 0x2f
+
+#define DW_OP_addr 0x03
+#define DW_OP_deref 0x06
+#define DW_OP_const1u 0x08
+#define DW_OP_const1s 0x09
+#define DW_OP_const2u 0x0a
+#define DW_OP_const2s 0x0b
+#define DW_OP_const4u 0x0c
+#define DW_OP_const4s 0x0d
+#define DW_OP_const8u 0x0e
+#define DW_OP_const8s 0x0f
+#define DW_OP_constu 0x10
+#define DW_OP_consts 0x11
+#define DW_OP_dup 0x12
+#define DW_OP_drop 0x13
+#define DW_OP_over 0x14
+#define DW_OP_pick 0x15
+#define DW_OP_swap 0x16
+#define DW_OP_rot 0x17
+#define DW_OP_abs 0x19
+#define DW_OP_and 0x1a
+#define DW_OP_div 0x1b
+#define DW_OP_minus 0x1c
+#define DW_OP_mod 0x1d
+#define DW_OP_mul 0x1e
+#define DW_OP_neg 0x1f
+#define DW_OP_not 0x20
+#define DW_OP_or 0x21
+#define DW_OP_plus 0x22
+#define DW_OP_plus_uconst 0x23
+#define DW_OP_shl 0x24
+#define DW_OP_shr 0x25
+#define DW_OP_shra 0x26
+#define DW_OP_xor 0x27
+#define DW_OP_bra 0x28
+#define DW_OP_eq 0x29
+#define DW_OP_ge 0x2a
+#define DW_OP_gt 0x2b
+#define DW_OP_le 0x2c
+#define DW_OP_lt 0x2d
+#define DW_OP_ne 0x2e
+#define DW_OP_skip 0x2f
+#define DW_OP_lit0 0x30
+#define DW_OP_lit31 0x4f
+#define DW_OP_breg0 0x70
+#define DW_OP_breg31 0x8f
+#define DW_OP_bregx 0x92
+#define DW_OP_deref_size 0x94
+#define DW_OP_nop 0x96
+
+// Protection against expressions which loop forever.
+#define MAX_EXPRESSION_STEPS 1024
+
+namespace bt {
+namespace internal {
+
+namespace {
+
+enum {
+  SECTION_EH_FRAME = 0,
+  SECTION_DEBUG_FRAME = 1,
+};
+
+}  // namespace
+
+DwarfFrameTable::DwarfFrameTable(const ElfFile *elf)
+    : elf_(elf) {
+  const char *names[2] = {".eh_frame", ".debug_frame"};
+  for (uint8_t i = 0; i < 2; ++i) {
+    const ElfSection *elf_section = elf->section_by_name(names[i]);
+    // Separate debug files only have a placeholder of .eh_frame.
+    if (elf_section == NULL || elf_section->type == SHT_NOBITS) {
+      continue;
+    }
+    Section& section = sections_[i];
+    section.view = SectionView(elf, elf_section);
+    section.size = section.view.size();
+    section.data = section.view.data(0, section.size);
+    section.address = elf_section->address;
+    section.is_eh_frame = (i == SECTION_EH_FRAME);
+    if (section.data != NULL) {
+      read_entries(i);
+    }
+  }
+  std::sort(fdes_.begin(), fdes_.end());
+}
+
+void DwarfFrameTable::read_entries(uint8_t section_index) {
+  const Section& section = sections_[section_index];
+  // Entries usually share a handful of CIEs.
+  map<uint64_t, Cie> cies;
+  DwarfReader reader(section.data, section.size);
+  while (!reader.at_end() && !reader.has_error()) {
+    uint64_t offset = reader.position();
+    bool is_64bit;
+    uint64_t length = reader.initial_length(&is_64bit);
+    if (reader.has_error() || length > reader.remaining()) {
+      break;
+    }
+    if (length == 0) {
+      // Terminator of .eh_frame.
+      continue;
+    }
+    uint64_t end = reader.position() + length;
+    uint64_t id_position = reader.position();
+    uint64_t id = reader.offset(is_64bit);
+    bool is_cie = section.is_eh_frame
+                      ? id == 0
+                      : id == (is_64bit ? ~(uint64_t)0 : 0xffffffff);
+    if (!is_cie) {
+      uint64_t cie_offset = section.is_eh_frame ? id_position - id : id;
+      map<uint64_t, Cie>::iterator it = cies.find(cie_offset);
+      if (it == cies.end()) {
+        Cie cie;
+        if (!read_cie(section, cie_offset, &cie)) {
+          cie.fde_encoding = DW_EH_PE_omit;
+        }
+        it = cies.insert(std::make_pair(cie_offset, cie)).first;
+      }
+      uint64_t low, range;
+      if (it->second.fde_encoding != DW_EH_PE_omit &&
+          read_encoded(section, &reader, it->second.fde_encoding, &low) &&
+          read_encoded(section,
+                       &reader,
+                       it->second.fde_encoding & 0x0f,
+                       &range) &&
+          range != 0) {
+        Fde fde;
+        fde.low = low;
+        fde.high = low + range;
+        fde.offset = offset;
+        fde.section = section_index;
+        fdes_.push_back(fde);
+      }
+    }
+    reader.seek(end);
+  }
+}
+
+bool DwarfFrameTable::read_cie(const Section& section,
+                               uint64_t offset,
+                               Cie *cie) const {
+  DwarfReader reader(section.data, section.size);
+  reader.seek(offset);
+  bool is_64bit;
+  uint64_t length = reader.initial_length(&is_64bit);
+  if (reader.has_error() || length == 0 || length > reader.remaining()) {
+    return false;
+  }
+  uint64_t end = reader.position() + length;
+  uint64_t id = reader.offset(is_64bit);
+  if (section.is_eh_frame ? id != 0
+                          : id != (is_64bit ? ~(uint64_t)0 : 0xffffffff)) {
+    return false;
+  }
+  uint8_t version = reader.u8();
+  if (version != 1 && version != 3 && version != 4) {
+    return false;
+  }
+  const char *augmentation = reader.cstring();
+  if (augmentation == NULL) {
+    return false;
+  }
+  uint8_t address_size = elf_->is_64bit() ? 8 : 4;
+  if (version >= 4) {
+    address_size = reader.u8();
+    // Segment selector size.
+    reader.u8();
+  }
+  cie->code_alignment = reader.uleb128();
+  cie->data_alignment = reader.sleb128();
+  cie->return_register = (version == 1) ? reader.u8() : reader.uleb128();
+  cie->fde_encoding = (address_size == 4) ? DW_EH_PE_udata4
+                                          : DW_EH_PE_udata8;
+  cie->has_augmentation_data = false;
+  cie->is_signal_frame = false;
+  if (augmentation[0] == 'z') {
+    cie->has_augmentation_data = true;
+    uint64_t augmentation_size = reader.uleb128();
+    uint64_t augmentation_end = reader.position() + augmentation_size;
+    for (const char *p = augmentation + 1; *p != '\0'; ++p) {
+      if (*p == 'R') {
+        cie->fde_encoding = reader.u8();
+      } else if (*p == 'L') {
+        reader.u8();
+      } else if (*p == 'P') {
+        uint64_t personality;
+        if (!read_encoded(section, &reader, reader.u8(), &personality)) {
+          return false;
+        }
+      } else if (*p == 'S') {
+        cie->is_signal_frame = true;
+      } else if (*p != 'B') {
+        // Rest of the data is not understood, but it could be skipped.
+        break;
+      }
+    }
+    reader.seek(augmentation_end);
+  } else if (augmentation[0] != '\0') {
+    return false;
+  }
+  cie->instructions = reader.position();
+  cie->instructions_end = end;
+  return !reader.has_error() && reader.position() <= end;
+}
+
+bool DwarfFrameTable::read_encoded(const Section& section,
+                                   DwarfReader *reader,
+                                   uint8_t encoding,
+                                   uint64_t *value) const {
+  if (encoding == DW_EH_PE_omit) {
+    return false;
+  }
+  uint64_t field_address = section.address + reader->position();
+  switch (encoding & 0x0f) {
+    case DW_EH_PE_absptr:
+      *value = elf_->is_64bit() ? reader->u64() : reader->u32();
+      break;
+    case DW_EH_PE_uleb128:
+      *value = reader->uleb128();
+      break;
+    case DW_EH_PE_udata2:
+      *value = reader->u16();
+      break;
+    case DW_EH_PE_udata4:
+      *value = reader->u32();
+      break;
+    case DW_EH_PE_udata8:
+      *value = reader->u64();
+      break;
+    case DW_EH_PE_sleb128:
+      *value = (uint64_t)reader->sleb128();
+      break;
+    case DW_EH_PE_sdata2:
+      *value = (uint64_t)(int64_t)(int16_t)reader->u16();
+      break;
+    case DW_EH_PE_sdata4:
+      *value = (uint64_t)(int64_t)(int32_t)reader->u32();
+      break;
+    case DW_EH_PE_sdata8:
+      *value = reader->u64();
+      break;
+    default:
+      return false;
+  }
+  // Indirect pointers are only used for personality routines, which
+  // are skipped, so value itself does not matter.
+  switch (encoding & 0x70) {
+    case 0:
+      break;
+    case DW_EH_PE_pcrel:
+      *value += field_address;
+      break;
+    default:
+      if (!(encoding & DW_EH_PE_indirect)) {
+        return false;
+      }
+  }
+  return !reader->has_error();
+}
+
+bool DwarfFrameTable::run_program(const Section& section,
+                                  const Cie& cie,
+                                  uint64_t start,
+                                  uint64_t end,
+                                  uint64_t location,
+                                  uint64_t address,
+                                  const Row& initial,
+                                  Row *row) const {
+  DwarfReader reader(section.data, end);
+  reader.seek(start);
+  vector<Row> remembered;
+  while (!reader.at_end() && !reader.has_error()) {
+    uint8_t opcode = reader.u8();
+    uint64_t reg = opcode & 0x3f;
+    uint64_t delta = 0;
+    Rule rule;
+    rule.type = RULE_SAME;
+    rule.value = 0;
+    rule.expression = 0;
+    rule.expression_size = 0;
+    bool has_rule = false;
+    switch (opcode & 0xc0) {
+      case DW_CFA_advance_loc:
+        delta = reg;
+        break;
+      case DW_CFA_offset:
+        rule.type = RULE_OFFSET;
+        rule.value = (int64_t)reader.uleb128() * cie.data_alignment;
+        has_rule = true;
+        break;
+      case DW_CFA_restore:
+        if (reg < DWARF_NUM_REGISTERS) {
+          row->rules[reg] = initial.rules[reg];
+        }
+        break;
+      default:
+        switch (opcode) {
+          case DW_CFA_nop:
+          case DW_CFA_GNU_args_size:
+            if (opcode == DW_CFA_GNU_args_size) {
+              reader.uleb128();
+            }
+            break;
+          case DW_CFA_set_loc:
+            if (!read_encoded(section, &reader, cie.fde_encoding,
+                              &location)) {
+              return false;
+            }
+            if (location > address) {
+              return true;
+            }
+            break;
+          case DW_CFA_advance_loc1:
+            delta = reader.u8();
+            break;
+          case DW_CFA_advance_loc2:
+            delta = reader.u16();
+            break;
+          case DW_CFA_advance_loc4:
+            delta = reader.u32();
+            break;
+          case DW_CFA_offset_extended:
+            reg = reader.uleb128();
+            rule.type = RULE_OFFSET;
+            rule.value = (int64_t)reader.uleb128() * cie.data_alignment;
+            has_rule = true;
+            break;
+          case DW_CFA_offset_extended_sf:
+            reg = reader.uleb128();
+            rule.type = RULE_OFFSET;
+            rule.value = reader.sleb128() * cie.data_alignment;
+            has_rule = true;
+            break;
+          case DW_CFA_GNU_negative_offset_extended:
+            reg = reader.uleb128();
+            rule.type = RULE_OFFSET;
+            rule.value = -(int64_t)reader.uleb128() * cie.data_alignment;
+            has_rule = true;
+            break;
+          case DW_CFA_val_offset:
+            reg = reader.uleb128();
+            rule.type = RULE_VAL_OFFSET;
+            rule.value = (int64_t)reader.uleb128() * cie.data_alignment;
+            has_rule = true;
+            break;
+          case DW_CFA_val_offset_sf:
+            reg = reader.uleb128();
+            rule.type = RULE_VAL_OFFSET;
+            rule.value = reader.sleb128() * cie.data_alignment;
+            has_rule = true;
+            break;
+          case DW_CFA_restore_extended:
+            reg = reader.uleb128();
+            if (reg < DWARF_NUM_REGISTERS) {
+              row->rules[reg] = initial.rules[reg];
+            }
+            break;
+          case DW_CFA_undefined:
+            reg = reader.uleb128();
+            rule.type = RULE_UNDEFINED;
+            has_rule = true;
+            break;
+          case DW_CFA_same_value:
+            reg = reader.uleb128();
+            rule.type = RULE_SAME;
+            has_rule = true;
+            break;
+          case DW_CFA_register:
+            reg = reader.uleb128();
+            rule.type = RULE_REGISTER;
+            rule.value = (int64_t)reader.uleb128();
+            has_rule = true;
+            break;
+          case DW_CFA_expression:
+          case DW_CFA_val_expression:
+            reg = reader.uleb128();
+            rule.type = (opcode == DW_CFA_expression) ? RULE_EXPRESSION
+                                                      : RULE_VAL_EXPRESSION;
+            rule.expression_size = reader.uleb128();
+            rule.expression = reader.position();
+            reader.skip(rule.expression_size);
+            has_rule = true;
+            break;
+          case DW_CFA_remember_state:
+            remembered.push_back(*row);
+            break;
+          case DW_CFA_restore_state:
+            if (remembered.empty()) {
+              return false;
+            }
+            // CFA is restored as well, epilogues rely on that.
+            *row = remembered.back();
+            remembered.pop_back();
+            break;
+          case DW_CFA_def_cfa:
+            row->cfa_register = reader.uleb128();
+            row->cfa_offset = (int64_t)reader.uleb128();
+            row->cfa_is_expression = false;
+            break;
+          case DW_CFA_def_cfa_sf:
+            row->cfa_register = reader.uleb128();
+            row->cfa_offset = reader.sleb128() * cie.data_alignment;
+            row->cfa_is_expression = false;
+            break;
+          case DW_CFA_def_cfa_register:
+            row->cfa_register = reader.uleb128();
+            row->cfa_is_expression = false;
+            break;
+          case DW_CFA_def_cfa_offset:
+            row->cfa_offset = (int64_t)reader.uleb128();
+            break;
+          case DW_CFA_def_cfa_offset_sf:
+            row->cfa_offset = reader.sleb128() * cie.data_alignment;
+            break;
+          case DW_CFA_def_cfa_expression:
+            row->cfa_is_expression = true;
+            row->cfa_expression_size = reader.uleb128();
+            row->cfa_expression = reader.position();
+            reader.skip(row->cfa_expression_size);
+            break;
+#if defined(__aarch64__)
+          case DW_CFA_AARCH64_negate_ra_state:
+            row->return_address_signed = !row->return_address_signed;
+            break;
+#endif
+          default:
+            return false;
+        }
+    }
+    if (has_rule && reg < DWARF_NUM_REGISTERS) {
+      row->rules[reg] = rule;
+    }
+    if (delta != 0) {
+      location += delta * cie.code_alignment;
+      if (location > address) {
+        return true;
+      }
+    }
+  }
+  return !reader.has_error();
+}
+
+bool DwarfFrameTable::evaluate(const Section& section,
+                               uint64_t offset,
+                               uint64_t size,
+                               const DwarfRegisters& registers,
+                               const DwarfMemory& memory,
+                               const uint64_t *cfa,
+                               uint64_t *result) const {
+  if (offset > section.size || size > section.size - offset) {
+    return false;
+  }
+  DwarfReader reader(section.data + offset, size);
+  vector<uint64_t> stack;
+  if (cfa != NULL) {
+    stack.push_back(*cfa);
+  }
+  for (int step = 0; !reader.at_end(); ++step) {
+    if (step == MAX_EXPRESSION_STEPS || reader.has_error()) {
+      return false;
+    }
+    uint8_t opcode = reader.u8();
+    if (opcode >= DW_OP_lit0 && opcode <= DW_OP_lit31) {
+      stack.push_back(opcode - DW_OP_lit0);
+      continue;
+    }
+    if (opcode >= DW_OP_breg0 && opcode <= DW_OP_breg31) {
+      uint64_t value;
+      int64_t addend = reader.sleb128();
+      if (!registers.get(opcode - DW_OP_breg0, &value)) {
+        return false;
+      }
+      stack.push_back(value + addend);
+      continue;
+    }
+    // Operations which take operands from the stack.
+    size_t num_operands = 0;
+    switch (opcode) {
+      case DW_OP_deref:
+      case DW_OP_deref_size:
+      case DW_OP_dup:
+      case DW_OP_drop:
+      case DW_OP_abs:
+      case DW_OP_neg:
+      case DW_OP_not:
+      case DW_OP_plus_uconst:
+      case DW_OP_bra:
+        num_operands = 1;
+        break;
+      case DW_OP_over:
+      case DW_OP_swap:
+      case DW_OP_and:
+      case DW_OP_div:
+      case DW_OP_minus:
+      case DW_OP_mod:
+      case DW_OP_mul:
+      case DW_OP_or:
+      case DW_OP_plus:
+      case DW_OP_shl:
+      case DW_OP_shr:
+      case DW_OP_shra:
+      case DW_OP_xor:
+      case DW_OP_eq:
+      case DW_OP_ge:
+      case DW_OP_gt:
+      case DW_OP_le:
+      case DW_OP_lt:
+      case DW_OP_ne:
+        num_operands = 2;
+        break;
+      case DW_OP_rot:
+        num_operands = 3;
+        break;
+    }
+    if (stack.size() < num_operands) {
+      return false;
+    }
+    uint64_t a = 0, b = 0;
+    if (num_operands >= 2) {
+      a = stack[stack.size() - 2];
+      b = stack.back();
+    } else if (num_operands == 1) {
+      b = stack.back();
+    }
+    int64_t signed_a = (int64_t)a, signed_b = (int64_t)b;
+    bool is_binary = false;
+    uint64_t value = 0;
+    switch (opcode) {
+      case DW_OP_addr:
+        stack.push_back(elf_->is_64bit() ? reader.u64() : reader.u32());
+        break;
+      case DW_OP_deref:
+      case DW_OP_deref_size: {
+        int deref_size = (opcode == DW_OP_deref) ? 8 : reader.u8();
+        if (!memory.read_word(b, &value)) {
+          return false;
+        }
+        if (deref_size < 8) {
+          value &= ((uint64_t)1 << (8 * deref_size)) - 1;
+        }
+        stack.back() = value;
+        break;
+      }
+      case DW_OP_const1u: stack.push_back(reader.u8()); break;
+      case DW_OP_const1s: stack.push_back((int64_t)reader.s8()); break;
+      case DW_OP_const2u: stack.push_back(reader.u16()); break;
+      case DW_OP_const2s:
+        stack.push_back((int64_t)(int16_t)reader.u16());
+        break;
+      case DW_OP_const4u: stack.push_back(reader.u32()); break;
+      case DW_OP_const4s:
+        stack.push_back((int64_t)(int32_t)reader.u32());
+        break;
+      case DW_OP_const8u:
+      case DW_OP_const8s:
+        stack.push_back(reader.u64());
+        break;
+      case DW_OP_constu: stack.push_back(reader.uleb128()); break;
+      case DW_OP_consts: stack.push_back(reader.sleb128()); break;
+      case DW_OP_dup: stack.push_back(b); break;
+      case DW_OP_drop: stack.pop_back(); break;
+      case DW_OP_over: stack.push_back(a); break;
+      case DW_OP_pick: {
+        uint8_t index = reader.u8();
+        if (index >= stack.size()) {
+          return false;
+        }
+        stack.push_back(stack[stack.size() - 1 - index]);
+        break;
+      }
+      case DW_OP_swap:
+        stack[stack.size() - 2] = b;
+        stack.back() = a;
+        break;
+      case DW_OP_rot: {
+        // Top entry goes to the third position.
+        uint64_t c = stack[stack.size() - 3];
+        stack[stack.size() - 3] = b;
+        stack[stack.size() - 2] = c;
+        stack.back() = a;
+        break;
+      }
+      case DW_OP_abs:
+        stack.back() = (int64_t)b < 0 ? -b : b;
+        break;
+      case DW_OP_neg: stack.back() = -b; break;
+      case DW_OP_not: stack.back() = ~b; break;
+      case DW_OP_plus_uconst: stack.back() = b + reader.uleb128(); break;
+      case DW_OP_and: value = a & b; is_binary = true; break;
+      case DW_OP_div:
+        if (b == 0) {
+          return false;
+        }
+        value = (uint64_t)(signed_a / signed_b);
+        is_binary = true;
+        break;
+      case DW_OP_minus: value = a - b; is_binary = true; break;
+      case DW_OP_mod:
+        if (b == 0) {
+          return false;
+        }
+        value = a % b;
+        is_binary = true;
+        break;
+      case DW_OP_mul: value = a * b; is_binary = true; break;
+      case DW_OP_or: value = a | b; is_binary = true; break;
+      case DW_OP_plus: value = a + b; is_binary = true; break;
+      case DW_OP_shl: value = b < 64 ? a << b : 0; is_binary = true; break;
+      case DW_OP_shr: value = b < 64 ? a >> b : 0; is_binary = true; break;
+      case DW_OP_shra:
+        value = (uint64_t)((int64_t)a >> (b < 64 ? b : 63));
+        is_binary = true;
+        break;
+      case DW_OP_xor: value = a ^ b; is_binary = true; break;
+      case DW_OP_eq: value = (a == b); is_binary = true; break;
+      case DW_OP_ge: value = (signed_a >= signed_b); is_binary = true; break;
+      case DW_OP_gt: value = (signed_a > signed_b); is_binary = true; break;
+      case DW_OP_le: value = (signed_a <= signed_b); is_binary = true; break;
+      case DW_OP_lt: value = (signed_a < signed_b); is_binary = true; break;
+      case DW_OP_ne: value = (a != b); is_binary = true; break;
+      case DW_OP_skip:
+      case DW_OP_bra: {
+        int16_t skip = (int16_t)reader.u16();
+        if (opcode == DW_OP_bra) {
+          stack.pop_back();
+          if (b == 0) {
+            break;
+          }
+        }
+        reader.seek(reader.position() + skip);
+        break;
+      }
+      case DW_OP_bregx: {
+        uint64_t reg = reader.uleb128();
+        int64_t addend = reader.sleb128();
+        if (!registers.get(reg, &value)) {
+          return false;
+        }
+        stack.push_back(value + addend);
+        break;
+      }
+      case DW_OP_nop:
+        break;
+      default:
+        return false;
+    }
+    if (is_binary) {
+      stack.pop_back();
+      stack.back() = value;
+    }
+  }
+  if (stack.empty() || reader.has_error()) {
+    return false;
+  }
+  *result = stack.back();
+  return true;
+}
+
+bool DwarfFrameTable::unwind(uint64_t address,
+                             const DwarfMemory& memory,
+                             DwarfRegisters *registers,
+                             bool *is_signal_frame) const {
+  Fde key;
+  key.low = address;
+  vector<Fde>::const_iterator it =
+      std::upper_bound(fdes_.begin(), fdes_.end(), key);
+  if (it == fdes_.begin()) {
+    return false;
+  }
+  const Fde& fde = *(it - 1);
+  if (address >= fde.high) {
+    return false;
+  }
+  // Skip header of the entry up to its instructions.
+  const Section& section = sections_[fde.section];
+  DwarfReader reader(section.data, section.size);
+  reader.seek(fde.offset);
+  bool is_64bit;
+  uint64_t length = reader.initial_length(&is_64bit);
+  uint64_t end = reader.position() + length;
+  uint64_t id_position = reader.position();
+  uint64_t id = reader.offset(is_64bit);
+  Cie cie;
+  if (reader.has_error() || end > section.size ||
+      !read_cie(section,
+                section.is_eh_frame ? id_position - id : id,
+                &cie)) {
+    return false;
+  }
+  uint64_t low, range;
+  read_encoded(section, &reader, cie.fde_encoding, &low);
+  read_encoded(section, &reader, cie.fde_encoding & 0x0f, &range);
+  if (cie.has_augmentation_data) {
+    reader.skip(reader.uleb128());
+  }
+  if (reader.has_error() || reader.position() > end) {
+    return false;
+  }
+  // Rules of the CIE, then of the FDE up to the address.
+  Row initial;
+  initial.cfa_register = DWARF_REGISTER_SP;
+  initial.cfa_offset = 0;
+  initial.cfa_is_expression = false;
+  initial.cfa_expression = 0;
+  initial.cfa_expression_size = 0;
+  initial.return_address_signed = false;
+  for (int i = 0; i < DWARF_NUM_REGISTERS; ++i) {
+    initial.rules[i].type = RULE_SAME;
+    initial.rules[i].value = 0;
+    initial.rules[i].expression = 0;
+    initial.rules[i].expression_size = 0;
+  }
+  if (!run_program(section, cie, cie.instructions, cie.instructions_end,
+                   0, ~(uint64_t)0, initial, &initial)) {
+    return false;
+  }
+  Row row = initial;
+  if (!run_program(section, cie, reader.position(), end,
+                   fde.low, address, initial, &row)) {
+    return false;
+  }
+  // Canonical frame address, which is the stack pointer of the caller.
+  uint64_t cfa;
+  if (row.cfa_is_expression) {
+    if (!evaluate(section, row.cfa_expression, row.cfa_expression_size,
+                  *registers, memory, NULL, &cfa)) {
+      return false;
+    }
+  } else {
+    if (!registers->get(row.cfa_register, &cfa)) {
+      return false;
+    }
+    cfa += row.cfa_offset;
+  }
+  DwarfRegisters caller = *registers;
+  caller.set(DWARF_REGISTER_SP, cfa);
+  for (int i = 0; i < DWARF_NUM_REGISTERS; ++i) {
+    const Rule& rule = row.rules[i];
+    uint64_t value;
+    switch (rule.type) {
+      case RULE_SAME:
+        continue;
+      case RULE_UNDEFINED:
+        caller.clear(i);
+        continue;
+      case RULE_OFFSET:
+        if (!memory.read_word(cfa + rule.value, &value)) {
+          return false;
+        }
+        break;
+      case RULE_VAL_OFFSET:
+        value = cfa + rule.value;
+        break;
+      case RULE_REGISTER:
+        if (!registers->get((uint64_t)rule.value, &value)) {
+          caller.clear(i);
+          continue;
+        }
+        break;
+      case RULE_EXPRESSION:
+        if (!evaluate(section, rule.expression, rule.expression_size,
+                      *registers, memory, &cfa, &value) ||
+            !memory.read_word(value, &value)) {
+          return false;
+        }
+        break;
+      case RULE_VAL_EXPRESSION:
+        if (!evaluate(section, rule.expression, rule.expression_size,
+                      *registers, memory, &cfa, &value)) {
+          return false;
+        }
+        break;
+      default:
+        continue;
+    }
+    caller.set(i, value);
+  }
+  // Caller continues at the return address.
+  uint64_t return_address;
+  if (caller.get(cie.return_register, &return_address)) {
+#if defined(__aarch64__)
+    if (row.return_address_signed) {
+      // Strip pointer authentication code, user space addresses are
+      // below 2^48.
+      return_address &= ((uint64_t)1 << 48) - 1;
+    }
+#endif
+    caller.set(DWARF_REGISTER_PC, return_address);
+  } else {
+    caller.clear(DWARF_REGISTER_PC);
+  }
+  *registers = caller;
+  *is_signal_frame = cie.is_signal_frame;
+  return true;
+}
+
+}  // namespace internal
+}  // namespace bt
+
+#endif  // BACKTRACE_HAS_DWARF_FRAME
@@ -0,0 +1,249 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef __DWARF_FRAME_H__
+#define __DWARF_FRAME_H__
+
+#include "backtrace/backtrace_util.h"
+#include "backtrace/elf_file.h"
+#include "backtrace/section_cache.h"
+
+#if defined(BACKTRACE_HAS_ELF) && \
+    (defined(__x86_64__) || defined(__aarch64__))
+#  define BACKTRACE_HAS_DWARF_FRAME
+#endif
+
+#ifdef BACKTRACE_HAS_DWARF_FRAME
+
+#include <cstring>
+#include <stdint.h>
+
+// DWARF numbers of the registers which are tracked while unwinding.
+#if defined(__x86_64__)
+#  define DWARF_NUM_REGISTERS 17
+#  define DWARF_REGISTER_FP 6
+#  define DWARF_REGISTER_SP 7
+// Return address column, which is the instruction pointer.
+#  define DWARF_REGISTER_PC 16
+#elif defined(__aarch64__)
+#  define DWARF_NUM_REGISTERS 33
+#  define DWARF_REGISTER_FP 29
+#  define DWARF_REGISTER_LR 30
+#  define DWARF_REGISTER_SP 31
+// Not a DWARF register, slot of the program counter.
+#  define DWARF_REGISTER_PC 32
+#endif
+
+namespace bt {
+namespace internal {
+
+class DwarfReader;
+
+// Registers of a frame, indexed by their DWARF numbers.
+struct DwarfRegisters {
+  uint64_t values[DWARF_NUM_REGISTERS];
+  // Bit mask of the registers which values are known.
+  uint64_t known;
+
+  DwarfRegisters()
+  : known(0) {
+    memset(values, 0, sizeof(values));
+  }
+
+  bool get(uint64_t reg, uint64_t *value) const {
+    if (reg >= DWARF_NUM_REGISTERS || !(known & ((uint64_t)1 << reg))) {
+      return false;
+    }
+    *value = values[reg];
+    return true;
+  }
+
+  void set(uint64_t reg, uint64_t value) {
+    values[reg] = value;
+    known |= (uint64_t)1 << reg;
+  }
+
+  void clear(uint64_t reg) {
+    values[reg] = 0;
+    known &= ~((uint64_t)1 << reg);
+  }
+
+  bool has(uint64_t reg) const {
+    return (known & ((uint64_t)1 << reg)) != 0;
+  }
+
+  uint64_t pc() const { return values[DWARF_REGISTER_PC]; }
+  uint64_t sp() const { return values[DWARF_REGISTER_SP]; }
+  uint64_t fp() const { return values[DWARF_REGISTER_FP]; }
+};
+
+// Memory of the thread which is being unwound.
+class DwarfMemory {
+ public:
+  virtual ~DwarfMemory() {}
+
+  // Read a word at given address, returns false if it is not available.
+  virtual bool read_word(uint64_t address, uint64_t *value) const = 0;
+};
+
+// Call frame information of an object, read from .eh_frame and
+// .debug_frame sections.
+//
+// Only an index of the address ranges of frame descriptions is built
+// upfront. Rules of a frame are found by running the programs of its
+// description up to the requested address on every unwind step.
+class DwarfFrameTable {
+ public:
+  explicit DwarfFrameTable(const ElfFile *elf);
+
+  bool empty() const { return fdes_.empty(); }
+
+  // Replace registers with the ones of the caller, using the frame which
+  // contains given link-time address. For frames which made a call the
+  // address is to be inside of the call instruction, rather than the
+  // return address.
+  //
+  // Registers which are not mentioned by the rules keep their values.
+  // Program counter is unknown in the outermost frame. is_signal_frame
+  // is set when caller's program counter is the interrupted instruction
+  // rather than a return address.
+  //
+  // Returns false if there is no frame information for the address, or
+  // the rules refer to the registers or memory which are not known.
+  bool unwind(uint64_t address,
+              const DwarfMemory& memory,
+              DwarfRegisters *registers,
+              bool *is_signal_frame) const;
+
+  // Estimated heap memory used by the index.
+  size_t memory_usage() const {
+    return fdes_.capacity() * sizeof(Fde);
+  }
+
+ private:
+  struct Section {
+    SectionView view;
+    const unsigned char *data;
+    uint64_t size;
+    // Link-time address, which PC-relative pointers are relative to.
+    uint64_t address;
+    bool is_eh_frame;
+
+    Section()
+    : data(NULL),
+      size(0),
+      address(0),
+      is_eh_frame(false) {}
+  };
+
+  // Frame description entry.
+  struct Fde {
+    uint64_t low;
+    uint64_t high;
+    // Offset of the entry in its section.
+    uint64_t offset;
+    uint8_t section;
+
+    bool operator<(const Fde& other) const { return low < other.low; }
+  };
+
+  // Common information entry.
+  struct Cie {
+    uint64_t code_alignment;
+    int64_t data_alignment;
+    uint64_t return_register;
+    uint8_t fde_encoding;
+    bool has_augmentation_data;
+    bool is_signal_frame;
+    // Range of the initial instructions in the section.
+    uint64_t instructions;
+    uint64_t instructions_end;
+  };
+
+  enum RuleType {
+    RULE_SAME,
+    RULE_UNDEFINED,
+    RULE_OFFSET,
+    RULE_VAL_OFFSET,
+    RULE_REGISTER,
+    RULE_EXPRESSION,
+    RULE_VAL_EXPRESSION,
+  };
+
+  struct Rule {
+    uint8_t type;
+    // Offset from the CFA, or number of the register.
+    int64_t value;
+    // Range of the DWARF expression in the section.
+    uint64_t expression;
+    uint64_t expression_size;
+  };
+
+  struct Row {
+    uint64_t cfa_register;
+    int64_t cfa_offset;
+    bool cfa_is_expression;
+    uint64_t cfa_expression;
+    uint64_t cfa_expression_size;
+    // Return address is signed with a pointer authentication code.
+    bool return_address_signed;
+    Rule rules[DWARF_NUM_REGISTERS];
+  };
+
+  void read_entries(uint8_t section_index);
+  bool read_cie(const Section& section, uint64_t offset, Cie *cie) const;
+  bool read_encoded(const Section& section,
+                    DwarfReader *reader,
+                    uint8_t encoding,
+                    uint64_t *value) const;
+
+  // Run call frame instructions, stopping once location goes past the
+  // address. Initial row is used by DW_CFA_restore.
+  bool run_program(const Section& section,
+                   const Cie& cie,
+                   uint64_t start,
+                   uint64_t end,
+                   uint64_t location,
+                   uint64_t address,
+                   const Row& initial,
+                   Row *row) const;
+
+  // Evaluate DWARF expression, CFA is pushed to the stack first if it is
+  // not NULL.
+  bool evaluate(const Section& section,
+                uint64_t offset,
+                uint64_t size,
+                const DwarfRegisters& registers,
+                const DwarfMemory& memory,
+                const uint64_t *cfa,
+                uint64_t *result) const;
+
+  const ElfFile *elf_;
+  Section sections_[2];
+  // Sorted by their low address.
+  vector<Fde> fdes_;
+};
+
+}  // namespace internal
+}  // namespace bt
+
+#endif  // BACKTRACE_HAS_DWARF_FRAME
+
+#endif  // __DWARF_FRAME_H__
@@ -0,0 +1,1326 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "backtrace/dwarf_info.h"
+
+#ifdef BACKTRACE_HAS_ELF
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <endian.h>
+
+#include "backtrace/dwarf_reader.h"
+#include "backtrace/stats.h"
+
+#define DW_UT_compile 0x01
+#define DW_UT_type 0x02
+#define DW_UT_partial 0x03
+#define DW_UT_skeleton 0x04
+#define DW_UT_split_compile 0x05
+#define DW_UT_split_type 0x06
+
+#define DW_TAG_class_type 0x02
+#define DW_TAG_structure_type 0x13
+#define DW_TAG_union_type 0x17
+#define DW_TAG_subprogram 0x2e
+#define DW_TAG_namespace 0x39
+
+#define DW_AT_name 0x03
+#define DW_AT_stmt_list 0x10
+#define DW_AT_low_pc 0x11
+#define DW_AT_high_pc 0x12
+#define DW_AT_comp_dir 0x1b
+#define DW_AT_abstract_origin 0x31
+#define DW_AT_specification 0x47
+#define DW_AT_ranges 0x55
+#define DW_AT_linkage_name 0x6e
+#define DW_AT_str_offsets_base 0x72
+#define DW_AT_addr_base 0x73
+#define DW_AT_rnglists_base 0x74
+#define DW_AT_dwo_name 0x76
+#define DW_AT_MIPS_linkage_name 0x2007
+#define DW_AT_GNU_dwo_name 0x2130
+#define DW_AT_GNU_dwo_id 0x2131
+#define DW_AT_GNU_ranges_base 0x2132
+#define DW_AT_GNU_addr_base 0x2133
+
+#define DW_FORM_addr 0x01
+#define DW_FORM_block2 0x03
+#define DW_FORM_block4 0x04
+#define DW_FORM_data2 0x05
+#define DW_FORM_data4 0x06
+#define DW_FORM_data8 0x07
+#define DW_FORM_string 0x08
+#define DW_FORM_block 0x09
+#define DW_FORM_block1 0x0a
+#define DW_FORM_data1 0x0b
+#define DW_FORM_flag 0x0c
+#define DW_FORM_sdata 0x0d
+#define DW_FORM_strp 0x0e
+#define DW_FORM_udata 0x0f
+#define DW_FORM_ref_addr 0x10
+#define DW_FORM_ref1 0x11
+#define DW_FORM_ref2 0x12
+#define DW_FORM_ref4 0x13
+#define DW_FORM_ref8 0x14
+#define DW_FORM_ref_udata 0x15
+#define DW_FORM_indirect 0x16
+#define DW_FORM_sec_offset 0x17
+#define DW_FORM_exprloc 0x18
+#define DW_FORM_flag_present 0x19
+#define DW_FORM_strx 0x1a
+#define DW_FORM_addrx 0x1b
+#define DW_FORM_ref_sup4 0x1c
+#define DW_FORM_strp_sup 0x1d
+#define DW_FORM_data16 0x1e
+#define DW_FORM_line_strp 0x1f
+#define DW_FORM_ref_sig8 0x20
+#define DW_FORM_implicit_const 0x21
+#define DW_FORM_loclistx 0x22
+#define DW_FORM_rnglistx 0x23
+#define DW_FORM_ref_sup8 0x24
+#define DW_FORM_strx1 0x25
+#define DW_FORM_strx2 0x26
+#define DW_FORM_strx3 0x27
+#define DW_FORM_strx4 0x28
+#define DW_FORM_addrx1 0x29
+#define DW_FORM_addrx2 0x2a
+#define DW_FORM_addrx3 0x2b
+#define DW_FORM_addrx4 0x2c
+#define DW_FORM_GNU_addr_index 0x1f01
+#define DW_FORM_GNU_str_index 0x1f02
+#define DW_FORM_GNU_ref_alt 0x1f20
+#define DW_FORM_GNU_strp_alt 0x1f21
+
+#define DW_RLE_end_of_list 0x00
+#define DW_RLE_base_addressx 0x01
+#define DW_RLE_startx_endx 0x02
+#define DW_RLE_startx_length 0x03
+#define DW_RLE_offset_pair 0x04
+#define DW_RLE_base_address 0x05
+#define DW_RLE_start_end 0x06
+#define DW_RLE_start_length 0x07
+
+// Section identifiers of the .debug_cu_index columns.
+#define DW_SECT_INFO 1
+#define DW_SECT_ABBREV 3
+#define DW_SECT_STR_OFFSETS 6
+#define DW_SECT_RNGLISTS 8
+
+#define INVALID_UNIT ((uint32_t)-1)
+
+// Maximum length of DW_AT_specification and DW_AT_abstract_origin chain
+// which is followed to find the function name.
+#define MAX_REFERENCE_DEPTH 8
+
+namespace bt {
+namespace internal {
+
+namespace {
+
+// Names of a subprogram DIE, used to follow references between DIEs.
+struct SubprogramNames {
+  string linkage_name;
+  string name;
+  uint64_t reference;
+};
+
+bool is_address_index_form(uint64_t form) {
+  return form == DW_FORM_addrx || form == DW_FORM_addrx1 ||
+         form == DW_FORM_addrx2 || form == DW_FORM_addrx3 ||
+         form == DW_FORM_addrx4 || form == DW_FORM_GNU_addr_index;
+}
+
+// Get name qualified with the name of enclosing namespace or class.
+string qualified_name(const string& scope, const string& name) {
+  return scope.empty() ? name : scope + "::" + name;
+}
+
+bool is_string_index_form(uint64_t form) {
+  return form == DW_FORM_strx || form == DW_FORM_strx1 ||
+         form == DW_FORM_strx2 || form == DW_FORM_strx3 ||
+         form == DW_FORM_strx4 || form == DW_FORM_GNU_str_index;
+}
+
+// Get reader over the whole unit which starts at the given offset.
+DwarfReader unit_reader(const SectionView& info, uint64_t offset) {
+  uint64_t available = offset < info.size() ? info.size() - offset : 0;
+  uint64_t length_size = std::min(available, (uint64_t)12);
+  DwarfReader length_reader(info.data(offset, length_size), length_size);
+  bool is_64bit;
+  uint64_t unit_length = length_reader.initial_length(&is_64bit);
+  uint64_t size = length_reader.position() + unit_length;
+  if (length_reader.has_error() || unit_length > available ||
+      size > available) {
+    return DwarfReader(NULL, 0);
+  }
+  return DwarfReader(info.data(offset, size), size);
+}
+
+}  // namespace
+
+struct DwarfInfo::AttributeSpec {
+  uint64_t name;
+  uint64_t form;
+  int64_t implicit_const;
+};
+
+struct DwarfInfo::Abbrev {
+  uint64_t tag;
+  bool has_children;
+  vector<AttributeSpec> attributes;
+};
+
+// Raw value of an attribute, interpretation depends on the form.
+struct DwarfInfo::AttributeValue {
+  uint64_t form;
+  uint64_t value;
+  // Only for DW_FORM_string.
+  const char *str;
+
+  AttributeValue()
+  : form(0),
+    value(0),
+    str(NULL) {}
+};
+
+struct DwarfInfo::UnitContext {
+  // Sections the DIEs of the unit are read from.
+  const Sections *sections;
+  // Offset of the unit header within the info section.
+  uint64_t offset;
+  uint16_t version;
+  uint8_t unit_type;
+  bool is_64bit;
+  uint8_t address_size;
+  uint64_t abbrev_offset;
+  uint64_t dwo_id;
+  bool is_split;
+  uint64_t base_address;
+  uint64_t addr_base;
+  uint64_t str_offsets_base;
+  uint64_t rnglists_base;
+  uint64_t ranges_base;
+
+  UnitContext()
+  : sections(NULL),
+    offset(0),
+    version(0),
+    unit_type(0),
+    is_64bit(false),
+    address_size(0),
+    abbrev_offset(0),
+    dwo_id(0),
+    is_split(false),
+    base_address(0),
+    addr_base(0),
+    str_offsets_base(0),
+    rnglists_base(0),
+    ranges_base(0) {}
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// RangeTable.
+
+void DwarfInfo::RangeTable::add(uint64_t low, uint64_t high, uint32_t value) {
+  if (low >= high) {
+    return;
+  }
+  Range range;
+  range.low = low;
+  range.high = high;
+  range.value = value;
+  ranges_.push_back(range);
+}
+
+void DwarfInfo::RangeTable::build() {
+  std::stable_sort(ranges_.begin(), ranges_.end());
+  max_high_.resize(ranges_.size());
+  uint64_t max_high = 0;
+  for (size_t i = 0; i < ranges_.size(); ++i) {
+    max_high = std::max(max_high, ranges_[i].high);
+    max_high_[i] = max_high;
+  }
+}
+
+bool DwarfInfo::RangeTable::find(uint64_t address,
+                                 uint32_t *value,
+                                 uint64_t *low) const {
+  // Find first range which starts after the address.
+  size_t first = 0;
+  size_t count = ranges_.size();
+  while (count > 0) {
+    size_t step = count / 2;
+    if (ranges_[first + step].low <= address) {
+      first += step + 1;
+      count -= step + 1;
+    } else {
+      count = step;
+    }
+  }
+  // Go back for as long as there are ranges which could contain the
+  // address, looking for the innermost one.
+  bool found = false;
+  uint64_t best_size = 0;
+  for (size_t i = first; i > 0 && max_high_[i - 1] > address; --i) {
+    const Range& range = ranges_[i - 1];
+    if (address < range.high &&
+        (!found || range.high - range.low < best_size)) {
+      found = true;
+      best_size = range.high - range.low;
+      *value = range.value;
+      *low = range.low;
+    }
+  }
+  return found;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// DwarfInfo.
+
+void DwarfInfo::Sections::open(const ElfFile *elf, const char *suffix) {
+  const string s = suffix;
+  info = SectionView(elf, elf->section_by_name(".debug_info" + s));
+  abbrev = SectionView(elf, elf->section_by_name(".debug_abbrev" + s));
+  str = SectionView(elf, elf->section_by_name(".debug_str" + s));
+  str_offsets = SectionView(elf,
+                            elf->section_by_name(".debug_str_offsets" + s));
+  line_str = SectionView(elf, elf->section_by_name(".debug_line_str" + s));
+  addr = SectionView(elf, elf->section_by_name(".debug_addr" + s));
+  ranges = SectionView(elf, elf->section_by_name(".debug_ranges" + s));
+  rnglists = SectionView(elf, elf->section_by_name(".debug_rnglists" + s));
+}
+
+DwarfInfo::DwarfInfo(const ElfFile *elf)
+    : elf_(elf),
+      index_loaded_(false),
+      units_scanned_(false),
+      all_units_read_(true) {
+  sections_.open(elf, "");
+}
+
+DwarfInfo::~DwarfInfo() {
+  for (map<string, SplitFile *>::iterator it = split_files_.begin();
+       it != split_files_.end();
+       ++it) {
+    delete it->second;
+  }
+}
+
+size_t DwarfInfo::memory_usage() const {
+  // Rough estimate of a red-black tree node overhead.
+  const size_t map_node_size = 4 * sizeof(void *);
+  size_t memory_usage = units_.capacity() * sizeof(Unit) +
+                        unit_by_offset_.size() *
+                            (map_node_size + sizeof(uint64_t) +
+                             sizeof(uint32_t)) +
+                        unit_ranges_.memory_usage() +
+                        index_.memory_usage() +
+                        index_units_.capacity() * sizeof(uint64_t) +
+                        names_.capacity();
+  for (size_t i = 0; i < units_.size(); ++i) {
+    memory_usage += units_[i].dwo_name.capacity() +
+                    units_[i].comp_dir.capacity() +
+                    units_[i].functions.memory_usage();
+  }
+  for (map<string, SplitFile *>::const_iterator it = split_files_.begin();
+       it != split_files_.end();
+       ++it) {
+    memory_usage += map_node_size + sizeof(string) + it->first.capacity() +
+                    sizeof(SplitFile *);
+    if (it->second != NULL) {
+      memory_usage += sizeof(SplitFile);
+    }
+  }
+  return memory_usage;
+}
+
+bool DwarfInfo::find_function(uint64_t address,
+                              string *name,
+                              uint64_t *offset) {
+  Unit *unit = unit_find(address);
+  if (unit == NULL) {
+    return false;
+  }
+  if (!unit->functions_loaded) {
+    load_functions(unit);
+  }
+  uint32_t name_offset;
+  uint64_t low;
+  if (!unit->functions.find(address, &name_offset, &low)) {
+    return false;
+  }
+  *name = names_.c_str() + name_offset;
+  *offset = address - low;
+  return true;
+}
+
+bool DwarfInfo::find_line_program(uint64_t address, uint64_t *offset) {
+  Unit *unit = unit_find(address);
+  if (unit == NULL || unit->stmt_list == (uint64_t)-1) {
+    return false;
+  }
+  *offset = unit->stmt_list;
+  return true;
+}
+
+bool DwarfInfo::has_all_units() {
+  if (!units_scanned_) {
+    scan_units();
+  }
+  return all_units_read_ && !units_.empty();
+}
+
+DwarfInfo::Unit *DwarfInfo::unit_find(uint64_t address) {
+  if (!index_loaded_) {
+    load_index();
+  }
+  uint32_t index;
+  uint64_t low;
+  if (index_.find(address, &index, &low)) {
+    return unit_get(index_units_[index]);
+  }
+  // Not every unit is in the accelerator tables, assembly sources for
+  // example, so fall back to reading all the unit DIEs.
+  if (!units_scanned_) {
+    scan_units();
+  }
+  if (unit_ranges_.find(address, &index, &low)) {
+    return &units_[index];
+  }
+  return NULL;
+}
+
+DwarfInfo::Unit *DwarfInfo::unit_get(uint64_t offset) {
+  map<uint64_t, uint32_t>::iterator it = unit_by_offset_.find(offset);
+  if (it != unit_by_offset_.end()) {
+    return it->second != INVALID_UNIT ? &units_[it->second] : NULL;
+  }
+  Unit unit;
+  vector<std::pair<uint64_t, uint64_t> > ranges;
+  if (!read_unit(offset, &unit, &ranges)) {
+    unit_by_offset_[offset] = INVALID_UNIT;
+    return NULL;
+  }
+  unit_by_offset_[offset] = (uint32_t)units_.size();
+  units_.push_back(unit);
+  return &units_.back();
+}
+
+void DwarfInfo::load_index() {
+  index_loaded_ = true;
+  // Index of gdb is only there if somebody took care of generating it,
+  // so it is preferred over address ranges emitted by the compiler.
+  if (!read_gdb_index()) {
+    read_aranges();
+  }
+  index_.build();
+}
+
+bool DwarfInfo::read_gdb_index() {
+  const ElfSection *section = elf_->section_by_name(".gdb_index");
+  if (section == NULL) {
+    return false;
+  }
+  SectionView view(elf_, section);
+  DwarfReader reader(view.data(0, view.size()), view.size());
+  // Index is always little-endian.
+  uint32_t version = le32toh(reader.u32());
+  uint32_t cu_list_offset = le32toh(reader.u32());
+  uint32_t types_cu_list_offset = le32toh(reader.u32());
+  uint32_t address_area_offset = le32toh(reader.u32());
+  uint32_t symbol_table_offset = le32toh(reader.u32());
+  // Older versions had broken address area.
+  if (reader.has_error() || version < 7 || version > 9 ||
+      cu_list_offset > types_cu_list_offset ||
+      address_area_offset > symbol_table_offset) {
+    return false;
+  }
+  uint32_t num_units = (types_cu_list_offset - cu_list_offset) / 16;
+  uint32_t num_ranges = (symbol_table_offset - address_area_offset) / 20;
+  vector<uint64_t> unit_offsets(num_units);
+  reader.seek(cu_list_offset);
+  for (uint32_t i = 0; i < num_units; ++i) {
+    unit_offsets[i] = le64toh(reader.u64());
+    reader.u64();  // Unit length.
+  }
+  reader.seek(address_area_offset);
+  map<uint64_t, uint32_t> indices;
+  for (uint32_t i = 0; i < num_ranges && !reader.has_error(); ++i) {
+    uint64_t low = le64toh(reader.u64());
+    uint64_t high = le64toh(reader.u64());
+    uint32_t unit = le32toh(reader.u32());
+    // Units past the end of the list are type units.
+    if (unit < num_units && low != 0) {
+      index_add(low, high, unit_offsets[unit], &indices);
+    }
+  }
+  return !reader.has_error() && num_ranges != 0;
+}
+
+void DwarfInfo::read_aranges() {
+  SectionView view(elf_, elf_->section_by_name(".debug_aranges"));
+  if (!view.is_valid()) {
+    return;
+  }
+  DwarfReader reader(view.data(0, view.size()), view.size());
+  map<uint64_t, uint32_t> indices;
+  while (!reader.at_end() && !reader.has_error()) {
+    uint64_t set_offset = reader.position();
+    bool is_64bit;
+    uint64_t length = reader.initial_length(&is_64bit);
+    uint64_t end = reader.position() + length;
+    uint16_t version = reader.u16();
+    uint64_t unit_offset = reader.offset(is_64bit);
+    uint8_t address_size = reader.u8();
+    uint8_t segment_size = reader.u8();
+    if (reader.has_error() || end > view.size()) {
+      break;
+    }
+    if (version != 2 || segment_size != 0 ||
+        (address_size != 4 && address_size != 8)) {
+      reader.seek(end);
+      continue;
+    }
+    // Tuples are aligned to their size.
+    uint64_t tuple_size = 2 * address_size;
+    uint64_t header_size = reader.position() - set_offset;
+    reader.skip((tuple_size - header_size % tuple_size) % tuple_size);
+    while (reader.position() + tuple_size <= end) {
+      uint64_t address = reader.unsigned_value(address_size);
+      uint64_t size = reader.unsigned_value(address_size);
+      if (address == 0 && size == 0) {
+        break;
+      }
+      // Code removed by the linker is relocated to zero.
+      if (address != 0) {
+        index_add(address, address + size, unit_offset, &indices);
+      }
+    }
+    reader.seek(end);
+  }
+}
+
+void DwarfInfo::index_add(uint64_t low,
+                          uint64_t high,
+                          uint64_t unit_offset,
+                          map<uint64_t, uint32_t> *indices) {
+  map<uint64_t, uint32_t>::iterator it = indices->find(unit_offset);
+  if (it == indices->end()) {
+    it = indices->insert(std::make_pair(
+        unit_offset, (uint32_t)index_units_.size())).first;
+    index_units_.push_back(unit_offset);
+  }
+  index_.add(low, high, it->second);
+}
+
+bool DwarfInfo::read_abbrevs(const SectionView& section,
+                             uint64_t offset,
+                             uint64_t stop_code,
+                             AbbrevTable *abbrevs) {
+  if (offset >= section.size()) {
+    return false;
+  }
+  DwarfReader reader(section.data(offset, section.size() - offset),
+                     section.size() - offset);
+  while (!reader.at_end() && !reader.has_error()) {
+    uint64_t code = reader.uleb128();
+    if (code == 0) {
+      break;
+    }
+    Abbrev& abbrev = (*abbrevs)[code];
+    abbrev.tag = reader.uleb128();
+    abbrev.has_children = reader.u8() != 0;
+    for (;;) {
+      AttributeSpec spec;
+      spec.name = reader.uleb128();
+      spec.form = reader.uleb128();
+      spec.implicit_const = 0;
+      if (spec.form == DW_FORM_implicit_const) {
+        spec.implicit_const = reader.sleb128();
+      }
+      if ((spec.name == 0 && spec.form == 0) || reader.has_error()) {
+        break;
+      }
+      abbrev.attributes.push_back(spec);
+    }
+    if (code == stop_code) {
+      break;
+    }
+  }
+  return !reader.has_error();
+}
+
+bool DwarfInfo::read_unit_header(DwarfReader *reader, UnitContext *context) {
+  reader->initial_length(&context->is_64bit);
+  context->version = reader->u16();
+  if (context->version < 2 || context->version > 5) {
+    return false;
+  }
+  if (context->version >= 5) {
+    context->unit_type = reader->u8();
+    context->address_size = reader->u8();
+    context->abbrev_offset += reader->offset(context->is_64bit);
+    switch (context->unit_type) {
+      case DW_UT_skeleton:
+      case DW_UT_split_compile:
+        context->dwo_id = reader->u64();
+        break;
+      case DW_UT_type:
+      case DW_UT_split_type:
+        reader->u64();  // Type signature.
+        reader->offset(context->is_64bit);  // Type offset.
+        break;
+    }
+  } else {
+    context->unit_type = DW_UT_compile;
+    context->abbrev_offset += reader->offset(context->is_64bit);
+    context->address_size = reader->u8();
+  }
+  if (context->address_size != 4 && context->address_size != 8) {
+    return false;
+  }
+  return !reader->has_error();
+}
+
+bool DwarfInfo::read_value(DwarfReader *reader,
+                           const UnitContext& context,
+                           const AttributeSpec& spec,
+                           AttributeValue *value) {
+  value->form = spec.form;
+  value->str = NULL;
+  switch (spec.form) {
+    case DW_FORM_addr:
+      value->value = reader->unsigned_value(context.address_size);
+      break;
+    case DW_FORM_data1:
+    case DW_FORM_ref1:
+    case DW_FORM_flag:
+    case DW_FORM_strx1:
+    case DW_FORM_addrx1:
+      value->value = reader->u8();
+      break;
+    case DW_FORM_data2:
+    case DW_FORM_ref2:
+    case DW_FORM_strx2:
+    case DW_FORM_addrx2:
+      value->value = reader->u16();
+      break;
+    case DW_FORM_strx3:
+    case DW_FORM_addrx3:
+      value->value = reader->u24();
+      break;
+    case DW_FORM_data4:
+    case DW_FORM_ref4:
+    case DW_FORM_ref_sup4:
+    case DW_FORM_strx4:
+    case DW_FORM_addrx4:
+      value->value = reader->u32();
+      break;
+    case DW_FORM_data8:
+    case DW_FORM_ref8:
+    case DW_FORM_ref_sig8:
+    case DW_FORM_ref_sup8:
+      value->value = reader->u64();
+      break;
+    case DW_FORM_data16:
+      reader->skip(16);
+      break;
+    case DW_FORM_sdata:
+      value->value = (uint64_t)reader->sleb128();
+      break;
+    case DW_FORM_udata:
+    case DW_FORM_ref_udata:
+    case DW_FORM_strx:
+    case DW_FORM_addrx:
+    case DW_FORM_loclistx:
+    case DW_FORM_rnglistx:
+    case DW_FORM_GNU_addr_index:
+    case DW_FORM_GNU_str_index:
+      value->value = reader->uleb128();
+      break;
+    case DW_FORM_string:
+      value->str = reader->cstring();
+      break;
+    case DW_FORM_strp:
+    case DW_FORM_line_strp:
+    case DW_FORM_sec_offset:
+    case DW_FORM_strp_sup:
+    case DW_FORM_GNU_ref_alt:
+    case DW_FORM_GNU_strp_alt:
+      value->value = reader->offset(context.is_64bit);
+      break;
+    case DW_FORM_ref_addr:
+      // Was address sized in DWARF 2.
+      value->value = context.version == 2
+                         ? reader->unsigned_value(context.address_size)
+                         : reader->offset(context.is_64bit);
+      break;
+    case DW_FORM_flag_present:
+      value->value = 1;
+      break;
+    case DW_FORM_implicit_const:
+      value->value = (uint64_t)spec.implicit_const;
+      break;
+    case DW_FORM_block1:
+      reader->skip(reader->u8());
+      break;
+    case DW_FORM_block2:
+      reader->skip(reader->u16());
+      break;
+    case DW_FORM_block4:
+      reader->skip(reader->u32());
+      break;
+    case DW_FORM_block:
+    case DW_FORM_exprloc:
+      reader->skip(reader->uleb128());
+      break;
+    case DW_FORM_indirect: {
+      AttributeSpec indirect_spec = spec;
+      indirect_spec.form = reader->uleb128();
+      if (indirect_spec.form == DW_FORM_indirect) {
+        return false;
+      }
+      return read_value(reader, context, indirect_spec, value);
+    }
+    default:
+      // Size of unknown forms is not known, so the rest of the unit can
+      // not be decoded.
+      return false;
+  }
+  return !reader->has_error();
+}
+
+uint64_t DwarfInfo::value_address(const UnitContext& context,
+                                  const AttributeValue& value) {
+  if (!is_address_index_form(value.form)) {
+    return value.value;
+  }
+  // Address table is always in the main object, split units are using
+  // table of their skeleton.
+  uint64_t offset = context.addr_base + value.value * context.address_size;
+  DwarfReader reader(sections_.addr.data(offset, context.address_size),
+                     context.address_size);
+  return reader.unsigned_value(context.address_size);
+}
+
+string DwarfInfo::value_string(const UnitContext& context,
+                               const AttributeValue& value) {
+  switch (value.form) {
+    case DW_FORM_string:
+      return value.str != NULL ? value.str : "";
+    case DW_FORM_strp:
+      return context.sections->str.string_at(value.value);
+    case DW_FORM_line_strp:
+      return context.sections->line_str.string_at(value.value);
+  }
+  if (!is_string_index_form(value.form)) {
+    return "";
+  }
+  int offset_size = context.is_64bit ? 8 : 4;
+  uint64_t offset = context.str_offsets_base + value.value * offset_size;
+  DwarfReader reader(context.sections->str_offsets.data(offset, offset_size),
+                     offset_size);
+  uint64_t string_offset = reader.unsigned_value(offset_size);
+  if (reader.has_error()) {
+    return "";
+  }
+  return context.sections->str.string_at(string_offset);
+}
+
+void DwarfInfo::read_ranges(const UnitContext& context,
+                            const AttributeValue& value,
+                            vector<std::pair<uint64_t, uint64_t> > *result) {
+  uint64_t base_address = context.base_address;
+  if (context.version < 5) {
+    // Ranges of GNU split units are relative to the base of their skeleton
+    // and are stored in the main object.
+    uint64_t offset = value.value + (context.is_split ? context.ranges_base
+                                                      : 0);
+    const SectionView& ranges = sections_.ranges;
+    if (offset >= ranges.size()) {
+      return;
+    }
+    DwarfReader reader(ranges.data(offset, ranges.size() - offset),
+                       ranges.size() - offset);
+    uint64_t base_selection = context.address_size == 8
+                                  ? (uint64_t)-1
+                                  : (uint64_t)0xffffffff;
+    while (!reader.has_error()) {
+      uint64_t start = reader.unsigned_value(context.address_size);
+      uint64_t end = reader.unsigned_value(context.address_size);
+      if (reader.has_error() || (start == 0 && end == 0)) {
+        break;
+      }
+      if (start == base_selection) {
+        base_address = end;
+      } else {
+        result->push_back(std::make_pair(base_address + start,
+                                         base_address + end));
+      }
+    }
+    return;
+  }
+  const SectionView& rnglists = context.sections->rnglists;
+  uint64_t offset = value.value;
+  if (value.form == DW_FORM_rnglistx) {
+    int offset_size = context.is_64bit ? 8 : 4;
+    uint64_t index_offset = context.rnglists_base + offset * offset_size;
+    DwarfReader index_reader(rnglists.data(index_offset, offset_size),
+                             offset_size);
+    offset = context.rnglists_base + index_reader.unsigned_value(offset_size);
+    if (index_reader.has_error()) {
+      return;
+    }
+  }
+  if (offset >= rnglists.size()) {
+    return;
+  }
+  DwarfReader reader(rnglists.data(offset, rnglists.size() - offset),
+                     rnglists.size() - offset);
+  AttributeValue index;
+  index.form = DW_FORM_addrx;
+  while (!reader.has_error()) {
+    uint8_t kind = reader.u8();
+    uint64_t start = 0, end = 0;
+    switch (kind) {
+      case DW_RLE_end_of_list:
+        return;
+      case DW_RLE_base_addressx:
+        index.value = reader.uleb128();
+        base_address = value_address(context, index);
+        continue;
+      case DW_RLE_startx_endx:
+        index.value = reader.uleb128();
+        start = value_address(context, index);
+        index.value = reader.uleb128();
+        end = value_address(context, index);
+        break;
+      case DW_RLE_startx_length:
+        index.value = reader.uleb128();
+        start = value_address(context, index);
+        end = start + reader.uleb128();
+        break;
+      case DW_RLE_offset_pair:
+        start = base_address + reader.uleb128();
+        end = base_address + reader.uleb128();
+        break;
+      case DW_RLE_base_address:
+        base_address = reader.unsigned_value(context.address_size);
+        continue;
+      case DW_RLE_start_end:
+        start = reader.unsigned_value(context.address_size);
+        end = reader.unsigned_value(context.address_size);
+        break;
+      case DW_RLE_start_length:
+        start = reader.unsigned_value(context.address_size);
+        end = start + reader.uleb128();
+        break;
+      default:
+        return;
+    }
+    if (!reader.has_error()) {
+      result->push_back(std::make_pair(start, end));
+    }
+  }
+}
+
+bool DwarfInfo::read_unit(uint64_t offset,
+                          Unit *unit,
+                          vector<std::pair<uint64_t, uint64_t> > *ranges) {
+  DwarfReader reader = unit_reader(sections_.info, offset);
+  UnitContext context;
+  context.sections = &sections_;
+  context.offset = offset;
+  if (!read_unit_header(&reader, &context) ||
+      (context.unit_type != DW_UT_compile &&
+       context.unit_type != DW_UT_skeleton)) {
+    return false;
+  }
+  // Only the unit DIE is needed here, so avoid reading the whole
+  // abbreviations table.
+  uint64_t code = reader.uleb128();
+  AbbrevTable abbrevs;
+  if (code == 0 ||
+      !read_abbrevs(sections_.abbrev, context.abbrev_offset, code,
+                    &abbrevs) ||
+      abbrevs.find(code) == abbrevs.end()) {
+    return false;
+  }
+  // Attributes are collected first, since their interpretation depends
+  // on the bases which might come later.
+  unit->offset = context.offset;
+  unit->version = context.version;
+  unit->dwo_id = context.dwo_id;
+  AttributeValue low_pc, high_pc, ranges_value, dwo_name, comp_dir;
+  bool has_low_pc = false, has_high_pc = false, has_ranges = false;
+  const Abbrev& abbrev = abbrevs[code];
+  for (size_t i = 0; i < abbrev.attributes.size(); ++i) {
+    const AttributeSpec& spec = abbrev.attributes[i];
+    AttributeValue value;
+    if (!read_value(&reader, context, spec, &value)) {
+      return false;
+    }
+    switch (spec.name) {
+      case DW_AT_low_pc: low_pc = value; has_low_pc = true; break;
+      case DW_AT_high_pc: high_pc = value; has_high_pc = true; break;
+      case DW_AT_ranges: ranges_value = value; has_ranges = true; break;
+      case DW_AT_stmt_list: unit->stmt_list = value.value; break;
+      case DW_AT_dwo_name:
+      case DW_AT_GNU_dwo_name:
+        dwo_name = value;
+        break;
+      case DW_AT_comp_dir: comp_dir = value; break;
+      case DW_AT_GNU_dwo_id: unit->dwo_id = value.value; break;
+      case DW_AT_addr_base:
+      case DW_AT_GNU_addr_base:
+        unit->addr_base = value.value;
+        break;
+      case DW_AT_str_offsets_base: unit->str_offsets_base = value.value; break;
+      case DW_AT_rnglists_base: unit->rnglists_base = value.value; break;
+      case DW_AT_GNU_ranges_base: unit->ranges_base = value.value; break;
+    }
+  }
+  context.addr_base = unit->addr_base;
+  context.str_offsets_base = unit->str_offsets_base;
+  context.rnglists_base = unit->rnglists_base;
+  if (has_low_pc) {
+    unit->base_address = value_address(context, low_pc);
+    context.base_address = unit->base_address;
+  }
+  if (dwo_name.form != 0) {
+    unit->dwo_name = value_string(context, dwo_name);
+  }
+  if (comp_dir.form != 0) {
+    unit->comp_dir = value_string(context, comp_dir);
+  }
+  if (has_ranges) {
+    read_ranges(context, ranges_value, ranges);
+  } else if (has_low_pc && has_high_pc) {
+    uint64_t high = high_pc.form == DW_FORM_addr ||
+                    is_address_index_form(high_pc.form)
+                        ? value_address(context, high_pc)
+                        : unit->base_address + high_pc.value;
+    ranges->push_back(std::make_pair(unit->base_address, high));
+  }
+  return true;
+}
+
+void DwarfInfo::scan_units() {
+  units_scanned_ = true;
+  const SectionView& info = sections_.info;
+  uint64_t offset = 0;
+  vector<std::pair<uint64_t, uint64_t> > ranges;
+  while (offset < info.size()) {
+    DwarfReader reader = unit_reader(info, offset);
+    if (reader.has_error()) {
+      break;
+    }
+    uint64_t next_offset = offset + reader.remaining();
+    // Units which were found via the index are kept, but their ranges
+    // are still needed here.
+    Unit unit;
+    ranges.clear();
+    if (!read_unit(offset, &unit, &ranges)) {
+      all_units_read_ = false;
+    } else {
+      map<uint64_t, uint32_t>::iterator it = unit_by_offset_.find(offset);
+      if (it == unit_by_offset_.end()) {
+        it = unit_by_offset_.insert(std::make_pair(
+            offset, (uint32_t)units_.size())).first;
+        units_.push_back(unit);
+      }
+      for (size_t i = 0; i < ranges.size(); ++i) {
+        // Code removed by the linker is relocated to zero.
+        if (ranges[i].first != 0) {
+          unit_ranges_.add(ranges[i].first, ranges[i].second, it->second);
+        }
+      }
+    }
+    offset = next_offset;
+  }
+  unit_ranges_.build();
+}
+
+void DwarfInfo::load_functions(Unit *unit) {
+  unit->functions_loaded = true;
+  UnitContext context;
+  if (!unit->dwo_name.empty()) {
+    if (!split_unit_get(*unit, &context)) {
+      return;
+    }
+  } else {
+    DwarfReader reader = unit_reader(sections_.info, unit->offset);
+    context.sections = &sections_;
+    context.offset = unit->offset;
+    if (!read_unit_header(&reader, &context)) {
+      return;
+    }
+    context.str_offsets_base = unit->str_offsets_base;
+    context.rnglists_base = unit->rnglists_base;
+  }
+  context.base_address = unit->base_address;
+  context.addr_base = unit->addr_base;
+  context.ranges_base = unit->ranges_base;
+  read_functions(context, unit);
+  unit->functions.build();
+}
+
+void DwarfInfo::read_functions(const UnitContext& context, Unit *unit) {
+  AbbrevTable abbrevs;
+  if (!read_abbrevs(context.sections->abbrev, context.abbrev_offset, 0,
+                    &abbrevs)) {
+    return;
+  }
+  DwarfReader reader = unit_reader(context.sections->info, context.offset);
+  UnitContext header_context;
+  if (!read_unit_header(&reader, &header_context)) {
+    return;
+  }
+  // Names of all the subprograms, and code ranges of those which have
+  // code. Declarations might come after the definitions which are
+  // referencing them, so names are resolved once all DIEs are read.
+  map<uint64_t, SubprogramNames> subprograms;
+  vector<std::pair<uint64_t, std::pair<uint64_t, uint64_t> > > functions;
+  vector<std::pair<uint64_t, uint64_t> > ranges;
+  // Qualified names of the enclosing DIEs, linkage names are not always
+  // there, for example for functions in anonymous namespaces.
+  vector<string> scopes;
+  while (!reader.at_end() && !reader.has_error()) {
+    uint64_t die_offset = context.offset + reader.position();
+    uint64_t code = reader.uleb128();
+    if (code == 0) {
+      if (!scopes.empty()) {
+        scopes.pop_back();
+      }
+      continue;
+    }
+    AbbrevTable::const_iterator it = abbrevs.find(code);
+    if (it == abbrevs.end()) {
+      break;
+    }
+    const Abbrev& abbrev = it->second;
+    bool is_subprogram = abbrev.tag == DW_TAG_subprogram;
+    bool is_scope = abbrev.tag == DW_TAG_namespace ||
+                    abbrev.tag == DW_TAG_class_type ||
+                    abbrev.tag == DW_TAG_structure_type ||
+                    abbrev.tag == DW_TAG_union_type;
+    const string scope = scopes.empty() ? "" : scopes.back();
+    SubprogramNames names;
+    names.reference = 0;
+    AttributeValue low_pc, high_pc, ranges_value;
+    bool has_low_pc = false, has_high_pc = false, has_ranges = false;
+    bool ok = true;
+    for (size_t i = 0; i < abbrev.attributes.size() && ok; ++i) {
+      const AttributeSpec& spec = abbrev.attributes[i];
+      AttributeValue value;
+      ok = read_value(&reader, context, spec, &value);
+      if (!is_subprogram && !is_scope) {
+        continue;
+      }
+      switch (spec.name) {
+        case DW_AT_name:
+          names.name = value_string(context, value);
+          break;
+        case DW_AT_linkage_name:
+        case DW_AT_MIPS_linkage_name:
+          names.linkage_name = value_string(context, value);
+          break;
+        case DW_AT_specification:
+        case DW_AT_abstract_origin:
+          if (value.form == DW_FORM_ref_addr) {
+            names.reference = value.value;
+          } else if (value.form == DW_FORM_ref1 ||
+                     value.form == DW_FORM_ref2 ||
+                     value.form == DW_FORM_ref4 ||
+                     value.form == DW_FORM_ref8 ||
+                     value.form == DW_FORM_ref_udata) {
+            names.reference = context.offset + value.value;
+          }
+          break;
+        case DW_AT_low_pc: low_pc = value; has_low_pc = true; break;
+        case DW_AT_high_pc: high_pc = value; has_high_pc = true; break;
+        case DW_AT_ranges: ranges_value = value; has_ranges = true; break;
+      }
+    }
+    if (!ok) {
+      break;
+    }
+    if (abbrev.has_children) {
+      if (is_scope && !names.name.empty()) {
+        scopes.push_back(qualified_name(scope, names.name));
+      } else if (abbrev.tag == DW_TAG_namespace) {
+        scopes.push_back(qualified_name(scope, "(anonymous namespace)"));
+      } else {
+        scopes.push_back(scope);
+      }
+    }
+    if (!is_subprogram) {
+      continue;
+    }
+    if (!names.name.empty()) {
+      names.name = qualified_name(scope, names.name);
+    }
+    subprograms[die_offset] = names;
+    ranges.clear();
+    if (has_ranges) {
+      read_ranges(context, ranges_value, &ranges);
+    } else if (has_low_pc && has_high_pc) {
+      uint64_t low = value_address(context, low_pc);
+      uint64_t high = high_pc.form == DW_FORM_addr ||
+                      is_address_index_form(high_pc.form)
+                          ? value_address(context, high_pc)
+                          : low + high_pc.value;
+      ranges.push_back(std::make_pair(low, high));
+    }
+    for (size_t i = 0; i < ranges.size(); ++i) {
+      // Functions removed by the linker are relocated to zero.
+      if (ranges[i].first != 0) {
+        functions.push_back(std::make_pair(die_offset, ranges[i]));
+      }
+    }
+  }
+  // Linkage name is preferred, since once demangled it gives qualified
+  // name and arguments.
+  map<uint64_t, uint32_t> function_names;
+  for (size_t i = 0; i < functions.size(); ++i) {
+    uint64_t die_offset = functions[i].first;
+    map<uint64_t, uint32_t>::iterator name_it =
+        function_names.find(die_offset);
+    if (name_it == function_names.end()) {
+      string linkage_name, name;
+      uint64_t current = die_offset;
+      for (int depth = 0;
+           depth < MAX_REFERENCE_DEPTH && linkage_name.empty();
+           ++depth) {
+        map<uint64_t, SubprogramNames>::const_iterator it =
+            subprograms.find(current);
+        if (it == subprograms.end()) {
+          break;
+        }
+        linkage_name = it->second.linkage_name;
+        if (name.empty()) {
+          name = it->second.name;
+        }
+        current = it->second.reference;
+      }
+      if (linkage_name.empty() && name.empty()) {
+        continue;
+      }
+      name_it = function_names.insert(std::make_pair(
+          die_offset,
+          name_add(!linkage_name.empty() ? linkage_name : name))).first;
+    }
+    unit->functions.add(functions[i].second.first,
+                        functions[i].second.second,
+                        name_it->second);
+  }
+}
+
+bool DwarfInfo::split_unit_get(const Unit& unit, UnitContext *context) {
+  // Package next to the object takes precedence over separate files, same
+  // as debuggers do.
+  char *real_path = realpath(elf_->file_name().c_str(), NULL);
+  SplitFile *package = NULL;
+  if (real_path != NULL) {
+    package = split_file_get(string(real_path) + ".dwp");
+    free(real_path);
+  }
+  if (package != NULL && package->cu_index.is_valid()) {
+    return package_unit_get(package, unit, context);
+  }
+  vector<string> file_names;
+  if (unit.dwo_name[0] == '/') {
+    file_names.push_back(unit.dwo_name);
+  } else {
+    if (!unit.comp_dir.empty()) {
+      file_names.push_back(unit.comp_dir + "/" + unit.dwo_name);
+    }
+    // Build directory might be gone, so also look next to the object.
+    const string& object_name = elf_->file_name();
+    size_t slash = object_name.find_last_of('/');
+    file_names.push_back(slash != string::npos
+                             ? object_name.substr(0, slash + 1) +
+                                   unit.dwo_name
+                             : unit.dwo_name);
+  }
+  for (size_t i = 0; i < file_names.size(); ++i) {
+    SplitFile *file = split_file_get(file_names[i]);
+    if (file == NULL) {
+      continue;
+    }
+    // File might also have type units, look for the compilation one.
+    const SectionView& info = file->sections.info;
+    uint64_t offset = 0;
+    while (offset < info.size()) {
+      DwarfReader reader = unit_reader(info, offset);
+      if (reader.has_error()) {
+        break;
+      }
+      UnitContext split_context;
+      split_context.sections = &file->sections;
+      split_context.offset = offset;
+      offset += reader.remaining();
+      if (!read_unit_header(&reader, &split_context)) {
+        continue;
+      }
+      // Files of GNU split units only have one compilation unit and its
+      // identifier is in its DIE, which is not checked.
+      if (split_context.version >= 5 &&
+          (split_context.unit_type != DW_UT_split_compile ||
+           split_context.dwo_id != unit.dwo_id)) {
+        continue;
+      }
+      split_context.is_split = true;
+      if (split_context.version >= 5) {
+        // Offsets tables are preceded by a header.
+        split_context.str_offsets_base = split_context.is_64bit ? 16 : 8;
+        split_context.rnglists_base = split_context.is_64bit ? 20 : 12;
+      }
+      *context = split_context;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool DwarfInfo::package_unit_get(SplitFile *package,
+                                 const Unit& unit,
+                                 UnitContext *context) {
+  const SectionView& cu_index = package->cu_index;
+  DwarfReader reader(cu_index.data(0, cu_index.size()), cu_index.size());
+  uint16_t version = reader.u16();
+  if (version == 0) {
+    // Version 2 has 32 bit version field.
+    version = reader.u16();
+  } else {
+    reader.u16();  // Padding.
+  }
+  uint32_t num_columns = reader.u32();
+  uint32_t num_units = reader.u32();
+  uint32_t num_slots = reader.u32();
+  if (reader.has_error() || (version != 2 && version != 5) ||
+      num_slots == 0 || (num_slots & (num_slots - 1)) != 0 ||
+      num_columns > 64) {
+    return false;
+  }
+  // Hash table lookup of the unit row.
+  const uint64_t hash_offset = reader.position();
+  const uint64_t indices_offset = hash_offset + (uint64_t)num_slots * 8;
+  const uint64_t mask = num_slots - 1;
+  uint64_t slot = unit.dwo_id & mask;
+  const uint64_t step = ((unit.dwo_id >> 32) & mask) | 1;
+  uint32_t row = 0;
+  for (uint32_t i = 0; i < num_slots; ++i) {
+    reader.seek(hash_offset + slot * 8);
+    uint64_t signature = reader.u64();
+    reader.seek(indices_offset + slot * 4);
+    uint32_t index = reader.u32();
+    if (reader.has_error() || index == 0) {
+      break;
+    }
+    if (signature == unit.dwo_id) {
+      row = index;
+      break;
+    }
+    slot = (slot + step) & mask;
+  }
+  if (row == 0 || row > num_units) {
+    return false;
+  }
+  // Contribution offsets of the unit to all the sections.
+  const uint64_t columns_offset = indices_offset + (uint64_t)num_slots * 4;
+  const uint64_t row_offset =
+      columns_offset + (uint64_t)row * num_columns * 4;
+  UnitContext split_context;
+  split_context.sections = &package->sections;
+  split_context.is_split = true;
+  uint64_t info_offset = (uint64_t)-1;
+  for (uint32_t column = 0; column < num_columns; ++column) {
+    reader.seek(columns_offset + column * 4);
+    uint32_t section = reader.u32();
+    reader.seek(row_offset + column * 4);
+    uint64_t offset = reader.u32();
+    switch (section) {
+      case DW_SECT_INFO:
+        info_offset = offset;
+        break;
+      case DW_SECT_ABBREV:
+        split_context.abbrev_offset = offset;
+        break;
+      case DW_SECT_STR_OFFSETS:
+        split_context.str_offsets_base = offset;
+        break;
+      case DW_SECT_RNGLISTS:
+        if (version == 5) {
+          split_context.rnglists_base = offset;
+        }
+        break;
+    }
+  }
+  if (reader.has_error() || info_offset == (uint64_t)-1) {
+    return false;
+  }
+  split_context.offset = info_offset;
+  DwarfReader unit_data = unit_reader(package->sections.info, info_offset);
+  if (!read_unit_header(&unit_data, &split_context)) {
+    return false;
+  }
+  if (split_context.version >= 5) {
+    if (split_context.dwo_id != unit.dwo_id) {
+      return false;
+    }
+    split_context.str_offsets_base += split_context.is_64bit ? 16 : 8;
+    split_context.rnglists_base += split_context.is_64bit ? 20 : 12;
+  }
+  *context = split_context;
+  return true;
+}
+
+DwarfInfo::SplitFile *DwarfInfo::split_file_get(const string& file_name) {
+  map<string, SplitFile *>::iterator it = split_files_.find(file_name);
+  if (it != split_files_.end()) {
+    return it->second;
+  }
+  SplitFile *file = new SplitFile();
+  if (file->elf.open(file_name)) {
+    stats_add(STATS_OBJECTS_OPENED);
+    file->sections.open(&file->elf, ".dwo");
+    file->cu_index = SectionView(&file->elf,
+                                 file->elf.section_by_name(".debug_cu_index"));
+  } else {
+    delete file;
+    file = NULL;
+  }
+  split_files_[file_name] = file;
+  return file;
+}
+
+uint32_t DwarfInfo::name_add(const string& name) {
+  uint32_t offset = (uint32_t)names_.size();
+  names_.append(name.c_str(), name.size() + 1);
+  return offset;
+}
+
+}  // namespace internal
+}  // namespace bt
+
+#endif  // BACKTRACE_HAS_ELF
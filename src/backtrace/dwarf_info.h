@@ -0,0 +1,233 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef __DWARF_INFO_H__
+#define __DWARF_INFO_H__
+
+#include "backtrace/backtrace_util.h"
+#include "backtrace/elf_file.h"
+#include "backtrace/section_cache.h"
+
+#ifdef BACKTRACE_HAS_ELF
+
+#include <stdint.h>
+
+namespace bt {
+namespace internal {
+
+class DwarfReader;
+
+// Function names of an object, read from .debug_info section.
+//
+// Used for addresses which are not covered by the symbol table, which is
+// the case for stripped objects, and to find line number program of the
+// unit covering an address.
+//
+// Compilation units are found via .gdb_index or .debug_aranges when the
+// object has them, so only DIEs of the units covering looked up addresses
+// are ever read. Otherwise unit DIEs of all the units are read to find
+// their address ranges. Other DIEs of a unit are only decoded once an
+// address within the unit is looked up.
+//
+// Split DWARF is supported: for skeleton units the DIEs are read from the
+// .dwo file of the unit, or from the .dwp package next to the object which
+// is indexed via its .debug_cu_index table. Those files are only opened
+// once an address within the corresponding unit is looked up.
+class DwarfInfo {
+ public:
+  explicit DwarfInfo(const ElfFile *elf);
+  ~DwarfInfo();
+
+  // Find function which contains given link-time address. Name is mangled
+  // if the linkage name is known and offset is relative to the function
+  // entry point.
+  bool find_function(uint64_t address, string *name, uint64_t *offset);
+
+  // Find offset in .debug_line of the line number program of the unit
+  // which covers given link-time address.
+  bool find_line_program(uint64_t address, uint64_t *offset);
+
+  // Check whether address ranges of all the units are known, so there's
+  // no debug information for addresses which are not covered by any unit.
+  bool has_all_units();
+
+  // Estimated heap memory used by the decoded units and function names.
+  size_t memory_usage() const;
+
+ private:
+  // Debug sections of an object, or of a .dwo or .dwp file.
+  struct Sections {
+    SectionView info, abbrev, str, str_offsets, line_str, addr;
+    SectionView ranges, rnglists;
+
+    void open(const ElfFile *elf, const char *suffix);
+  };
+
+  // Opened .dwo or .dwp file.
+  struct SplitFile {
+    ElfFile elf;
+    Sections sections;
+    // Raw .debug_cu_index contents, only for packages.
+    SectionView cu_index;
+  };
+
+  // Functions, or units, sorted by their lowest address. Ranges might be
+  // nested, so every entry also knows the highest end address of all the
+  // entries up to it.
+  class RangeTable {
+   public:
+    void add(uint64_t low, uint64_t high, uint32_t value);
+    void build();
+    // Find value of the smallest range which contains given address.
+    bool find(uint64_t address, uint32_t *value, uint64_t *low) const;
+    size_t memory_usage() const {
+      return ranges_.capacity() * sizeof(Range) +
+             max_high_.capacity() * sizeof(uint64_t);
+    }
+
+   private:
+    struct Range {
+      uint64_t low;
+      uint64_t high;
+      uint32_t value;
+
+      bool operator<(const Range& other) const { return low < other.low; }
+    };
+    vector<Range> ranges_;
+    vector<uint64_t> max_high_;
+  };
+
+  struct Unit {
+    // Offset of the unit header in .debug_info.
+    uint64_t offset;
+    uint16_t version;
+    uint64_t dwo_id;
+    // Split DWARF file name, empty if unit is not a skeleton.
+    string dwo_name;
+    string comp_dir;
+    // Attributes of the unit DIE which are needed to decode DIEs of the
+    // unit, or of the split unit.
+    uint64_t base_address;
+    uint64_t addr_base;
+    uint64_t str_offsets_base;
+    uint64_t rnglists_base;
+    uint64_t ranges_base;
+    // Offset of the line number program in .debug_line.
+    uint64_t stmt_list;
+    bool functions_loaded;
+    RangeTable functions;
+
+    Unit()
+    : offset(0),
+      version(0),
+      dwo_id(0),
+      base_address(0),
+      addr_base(0),
+      str_offsets_base(0),
+      rnglists_base(0),
+      ranges_base(0),
+      stmt_list((uint64_t)-1),
+      functions_loaded(false) {}
+  };
+
+  struct AttributeSpec;
+  struct AttributeValue;
+  struct Abbrev;
+  typedef map<uint64_t, Abbrev> AbbrevTable;
+  // Where DIEs of a unit are and how to decode their attributes.
+  struct UnitContext;
+
+  // Find unit which covers given address.
+  Unit *unit_find(uint64_t address);
+  // Get unit with the header at the given offset, reading its DIE if it
+  // was not read yet.
+  Unit *unit_get(uint64_t offset);
+  bool read_unit(uint64_t offset,
+                 Unit *unit,
+                 vector<std::pair<uint64_t, uint64_t> > *ranges);
+  // Read unit DIEs of all the units to find their address ranges.
+  void scan_units();
+
+  // Build map of addresses to units from the accelerator tables.
+  void load_index();
+  bool read_gdb_index();
+  void read_aranges();
+  void index_add(uint64_t low,
+                 uint64_t high,
+                 uint64_t unit_offset,
+                 map<uint64_t, uint32_t> *indices);
+  // Decode all the DIEs of the unit and collect functions with code.
+  void load_functions(Unit *unit);
+  void read_functions(const UnitContext& context, Unit *unit);
+
+  // Find split unit of the given skeleton in a .dwp or .dwo file.
+  bool split_unit_get(const Unit& unit, UnitContext *context);
+  bool package_unit_get(SplitFile *package,
+                        const Unit& unit,
+                        UnitContext *context);
+  SplitFile *split_file_get(const string& file_name);
+
+  // Read abbreviations table at the given offset. If stop_code is not zero
+  // reading stops once abbreviation with this code is read.
+  static bool read_abbrevs(const SectionView& section,
+                           uint64_t offset,
+                           uint64_t stop_code,
+                           AbbrevTable *abbrevs);
+  static bool read_unit_header(DwarfReader *reader, UnitContext *context);
+  static bool read_value(DwarfReader *reader,
+                         const UnitContext& context,
+                         const AttributeSpec& spec,
+                         AttributeValue *value);
+  uint64_t value_address(const UnitContext& context,
+                         const AttributeValue& value);
+  string value_string(const UnitContext& context,
+                      const AttributeValue& value);
+  void read_ranges(const UnitContext& context,
+                   const AttributeValue& value,
+                   vector<std::pair<uint64_t, uint64_t> > *result);
+
+  uint32_t name_add(const string& name);
+
+  const ElfFile *elf_;
+  Sections sections_;
+  vector<Unit> units_;
+  map<uint64_t, uint32_t> unit_by_offset_;
+  // Units by their addresses from the accelerator tables, values are
+  // indices in the list of unit offsets.
+  bool index_loaded_;
+  RangeTable index_;
+  vector<uint64_t> index_units_;
+  // Units by their address ranges, read from the unit DIEs.
+  bool units_scanned_;
+  // False if some of the units could not be read.
+  bool all_units_read_;
+  RangeTable unit_ranges_;
+  // Opened split files by their name, NULL if file could not be opened.
+  map<string, SplitFile *> split_files_;
+  // Null-terminated names of the functions.
+  string names_;
+};
+
+}  // namespace internal
+}  // namespace bt
+
+#endif  // BACKTRACE_HAS_ELF
+
+#endif  // __DWARF_INFO_H__
@@ -0,0 +1,449 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "backtrace/dwarf_line.h"
+
+#ifdef BACKTRACE_HAS_ELF
+
+#include <algorithm>
+
+#include "backtrace/dwarf_info.h"
+#include "backtrace/dwarf_reader.h"
+
+// Forms which are used by DWARF 5 directory and file name tables.
+#define DW_FORM_block 0x09
+#define DW_FORM_data1 0x0b
+#define DW_FORM_data2 0x05
+#define DW_FORM_data4 0x06
+#define DW_FORM_data8 0x07
+#define DW_FORM_data16 0x1e
+#define DW_FORM_line_strp 0x1f
+#define DW_FORM_string 0x08
+#define DW_FORM_strp 0x0e
+#define DW_FORM_udata 0x0f
+
+#define DW_LNCT_path 0x1
+#define DW_LNCT_directory_index 0x2
+
+#define DW_LNS_copy 1
+#define DW_LNS_advance_pc 2
+#define DW_LNS_advance_line 3
+#define DW_LNS_set_file 4
+#define DW_LNS_const_add_pc 8
+#define DW_LNS_fixed_advance_pc 9
+
+#define DW_LNE_end_sequence 1
+#define DW_LNE_set_address 2
+#define DW_LNE_define_file 3
+
+#define INVALID_FILE ((uint32_t)-1)
+
+namespace bt {
+namespace internal {
+
+DwarfLineTable::DwarfLineTable(const ElfFile *elf, DwarfInfo *info)
+    : elf_(elf),
+      info_(info),
+      line_(elf, elf->section_by_name(".debug_line")),
+      line_str_(elf, elf->section_by_name(".debug_line_str")),
+      str_(elf, elf->section_by_name(".debug_str")),
+      next_offset_(0) {
+}
+
+size_t DwarfLineTable::memory_usage() const {
+  // Rough estimate of a red-black tree node overhead.
+  const size_t map_node_size = 4 * sizeof(void *);
+  size_t memory_usage = rows_.capacity() * sizeof(Row) +
+                        sequences_.capacity() * sizeof(Sequence) +
+                        files_.capacity() * sizeof(string) +
+                        sequence_by_high_.size() *
+                            (map_node_size + sizeof(uint64_t) +
+                             sizeof(size_t)) +
+                        decoded_programs_.size() *
+                            (map_node_size + sizeof(uint64_t));
+  for (size_t i = 0; i < files_.size(); ++i) {
+    // File name is stored both in the list and as the index key.
+    memory_usage += 2 * files_[i].capacity() + map_node_size +
+                    sizeof(string) + sizeof(uint32_t);
+  }
+  return memory_usage;
+}
+
+bool DwarfLineTable::find(uint64_t address,
+                          string *file_name,
+                          int *line_number) {
+  if (find_in_sequences(address, file_name, line_number)) {
+    return true;
+  }
+  uint64_t program_offset;
+  if (info_ != NULL && info_->find_line_program(address, &program_offset)) {
+    if (program_offset >= next_offset_ &&
+        decoded_programs_.count(program_offset) == 0) {
+      uint64_t next_offset;
+      decode_program(program_offset, &next_offset);
+      decoded_programs_.insert(program_offset);
+    }
+    return find_in_sequences(address, file_name, line_number);
+  }
+  if (info_ != NULL && info_->has_all_units()) {
+    // Code which was compiled without debug information, no need to go
+    // over all the programs.
+    return false;
+  }
+  for (;;) {
+    if (find_in_sequences(address, file_name, line_number)) {
+      return true;
+    }
+    if (next_offset_ >= line_.size()) {
+      return false;
+    }
+    uint64_t next_offset;
+    if (!decode_program(next_offset_, &next_offset)) {
+      // There's no way to get to the next program if this one is
+      // corrupted, so consider the whole section done.
+      next_offset_ = line_.size();
+      return false;
+    }
+    next_offset_ = next_offset;
+  }
+}
+
+bool DwarfLineTable::decode_program(uint64_t offset, uint64_t *next_offset) {
+  // Read unit length first, so we know how much data to ask for.
+  uint64_t available = line_.size() - offset;
+  DwarfReader length_reader(line_.data(offset, std::min(available,
+                                                        (uint64_t)12)),
+                            std::min(available, (uint64_t)12));
+  bool is_64bit;
+  uint64_t unit_length = length_reader.initial_length(&is_64bit);
+  uint64_t header_size = length_reader.position();
+  if (length_reader.has_error() ||
+      unit_length > available - header_size) {
+    return false;
+  }
+  *next_offset = offset + header_size + unit_length;
+  if (decoded_programs_.count(offset) != 0) {
+    return true;
+  }
+  DwarfReader reader(line_.data(offset, header_size + unit_length),
+                     header_size + unit_length);
+  reader.seek(header_size);
+  uint16_t version = reader.u16();
+  if (version < 2 || version > 5) {
+    // Unknown version, skip the unit.
+    return true;
+  }
+  if (version >= 5) {
+    reader.u8();  // Address size.
+    reader.u8();  // Segment selector size.
+  }
+  uint64_t header_length = reader.offset(is_64bit);
+  uint64_t program_start = reader.position() + header_length;
+  uint8_t minimum_instruction_length = reader.u8();
+  if (version >= 4) {
+    reader.u8();  // Maximum operations per instruction.
+  }
+  reader.u8();  // Default is_stmt.
+  int8_t line_base = reader.s8();
+  uint8_t line_range = reader.u8();
+  uint8_t opcode_base = reader.u8();
+  vector<uint8_t> standard_opcode_lengths;
+  for (int i = 1; i < opcode_base; ++i) {
+    standard_opcode_lengths.push_back(reader.u8());
+  }
+  if (reader.has_error() || line_range == 0) {
+    return true;
+  }
+
+  // Directory and file name tables, file names are converted to global
+  // indices right away.
+  vector<string> directories;
+  vector<uint32_t> files;
+  if (version < 5) {
+    // Directory 0 is the compilation directory, file 0 is invalid.
+    directories.push_back("");
+    files.push_back(INVALID_FILE);
+    for (;;) {
+      const char *directory = reader.cstring();
+      if (directory == NULL || directory[0] == '\0') {
+        break;
+      }
+      directories.push_back(directory);
+    }
+    for (;;) {
+      const char *name = reader.cstring();
+      if (name == NULL || name[0] == '\0') {
+        break;
+      }
+      uint64_t directory_index = reader.uleb128();
+      reader.uleb128();  // Modification time.
+      reader.uleb128();  // File size.
+      files.push_back(file_index(directory_index < directories.size()
+                                     ? directories[directory_index]
+                                     : "",
+                                 name));
+    }
+  } else {
+    for (int table = 0; table < 2; ++table) {
+      vector<uint64_t> format;
+      uint8_t format_count = reader.u8();
+      for (int i = 0; i < format_count; ++i) {
+        format.push_back(reader.uleb128());  // Content type.
+        format.push_back(reader.uleb128());  // Form.
+      }
+      uint64_t count = reader.uleb128();
+      for (uint64_t i = 0; i < count && !reader.has_error(); ++i) {
+        string path;
+        uint64_t directory_index = 0;
+        if (!read_entry_format(&reader, is_64bit, format,
+                               &path, &directory_index)) {
+          return true;
+        }
+        if (table == 0) {
+          directories.push_back(path);
+        } else {
+          files.push_back(file_index(directory_index < directories.size()
+                                         ? directories[directory_index]
+                                         : "",
+                                     path));
+        }
+      }
+    }
+  }
+  if (reader.has_error()) {
+    return true;
+  }
+
+  // Run the line number program.
+  reader.seek(program_start);
+  uint64_t address = 0;
+  uint64_t file = 1;
+  int64_t line = 1;
+  size_t sequence_first_row = rows_.size();
+  while (!reader.at_end() && !reader.has_error()) {
+    uint8_t opcode = reader.u8();
+    bool emit_row = false;
+    if (opcode >= opcode_base) {
+      uint8_t adjusted_opcode = opcode - opcode_base;
+      address += (adjusted_opcode / line_range) * minimum_instruction_length;
+      line += line_base + adjusted_opcode % line_range;
+      emit_row = true;
+    } else if (opcode == 0) {
+      uint64_t length = reader.uleb128();
+      uint64_t end = reader.position() + length;
+      if (length == 0) {
+        continue;
+      }
+      uint8_t extended_opcode = reader.u8();
+      switch (extended_opcode) {
+        case DW_LNE_end_sequence: {
+          size_t num_rows = rows_.size() - sequence_first_row;
+          // Sequences at zero address are functions removed by the
+          // linker, they are only confusing the lookup.
+          if (num_rows != 0 &&
+              rows_[sequence_first_row].address != 0 &&
+              rows_[sequence_first_row].address < address) {
+            Sequence sequence;
+            sequence.low = rows_[sequence_first_row].address;
+            sequence.high = address;
+            sequence.first_row = sequence_first_row;
+            sequence.num_rows = num_rows;
+            sequences_.push_back(sequence);
+            sequence_by_high_.insert(
+                std::make_pair(sequence.high, sequences_.size() - 1));
+          } else {
+            rows_.resize(sequence_first_row);
+          }
+          sequence_first_row = rows_.size();
+          address = 0;
+          file = 1;
+          line = 1;
+          break;
+        }
+        case DW_LNE_set_address:
+          address = reader.unsigned_value((int)length - 1);
+          break;
+        case DW_LNE_define_file: {
+          const char *name = reader.cstring();
+          uint64_t directory_index = reader.uleb128();
+          if (name != NULL) {
+            files.push_back(file_index(directory_index < directories.size()
+                                           ? directories[directory_index]
+                                           : "",
+                                       name));
+          }
+          break;
+        }
+      }
+      reader.seek(end);
+    } else {
+      switch (opcode) {
+        case DW_LNS_copy:
+          emit_row = true;
+          break;
+        case DW_LNS_advance_pc:
+          address += reader.uleb128() * minimum_instruction_length;
+          break;
+        case DW_LNS_advance_line:
+          line += reader.sleb128();
+          break;
+        case DW_LNS_set_file:
+          file = reader.uleb128();
+          break;
+        case DW_LNS_const_add_pc:
+          address += ((255 - opcode_base) / line_range) *
+                     minimum_instruction_length;
+          break;
+        case DW_LNS_fixed_advance_pc:
+          address += reader.u16();
+          break;
+        default:
+          // Skip operands of the opcodes which do not affect the rows.
+          for (int i = 0; i < standard_opcode_lengths[opcode - 1]; ++i) {
+            reader.uleb128();
+          }
+          break;
+      }
+    }
+    if (emit_row) {
+      Row row;
+      row.address = address;
+      row.file = file < files.size() ? files[file] : INVALID_FILE;
+      row.line = (int32_t)line;
+      rows_.push_back(row);
+    }
+  }
+  // Drop rows of unterminated sequence.
+  rows_.resize(sequence_first_row);
+  return true;
+}
+
+bool DwarfLineTable::read_entry_format(DwarfReader *reader,
+                                       bool is_64bit,
+                                       const vector<uint64_t>& format,
+                                       string *path,
+                                       uint64_t *directory_index) {
+  for (size_t i = 0; i < format.size(); i += 2) {
+    uint64_t content_type = format[i];
+    uint64_t form = format[i + 1];
+    string string_value;
+    uint64_t value = 0;
+    switch (form) {
+      case DW_FORM_string: {
+        const char *str = reader->cstring();
+        string_value = str != NULL ? str : "";
+        break;
+      }
+      case DW_FORM_line_strp:
+        string_value = line_str_.string_at(reader->offset(is_64bit));
+        break;
+      case DW_FORM_strp:
+        string_value = str_.string_at(reader->offset(is_64bit));
+        break;
+      case DW_FORM_udata:
+        value = reader->uleb128();
+        break;
+      case DW_FORM_data1:
+        value = reader->u8();
+        break;
+      case DW_FORM_data2:
+        value = reader->u16();
+        break;
+      case DW_FORM_data4:
+        value = reader->u32();
+        break;
+      case DW_FORM_data8:
+        value = reader->u64();
+        break;
+      case DW_FORM_data16:
+        reader->skip(16);
+        break;
+      case DW_FORM_block:
+        reader->skip(reader->uleb128());
+        break;
+      default:
+        // Forms which depend on the compilation unit are not supported.
+        return false;
+    }
+    if (content_type == DW_LNCT_path) {
+      *path = string_value;
+    } else if (content_type == DW_LNCT_directory_index) {
+      *directory_index = value;
+    }
+  }
+  return !reader->has_error();
+}
+
+uint32_t DwarfLineTable::file_index(const string& directory,
+                                    const string& name) {
+  string path = name;
+  if (!directory.empty() && (name.empty() || name[0] != '/')) {
+    path = directory + "/" + name;
+  }
+  map<string, uint32_t>::iterator it = file_indices_.find(path);
+  if (it != file_indices_.end()) {
+    return it->second;
+  }
+  uint32_t index = (uint32_t)files_.size();
+  files_.push_back(path);
+  file_indices_[path] = index;
+  return index;
+}
+
+bool DwarfLineTable::find_in_sequences(uint64_t address,
+                                       string *file_name,
+                                       int *line_number) const {
+  map<uint64_t, size_t>::const_iterator it =
+      sequence_by_high_.upper_bound(address);
+  if (it == sequence_by_high_.end()) {
+    return false;
+  }
+  const Sequence& sequence = sequences_[it->second];
+  if (address < sequence.low) {
+    return false;
+  }
+  // Find last row with address less or equal to the requested one.
+  size_t first = sequence.first_row;
+  size_t count = sequence.num_rows;
+  while (count > 0) {
+    size_t step = count / 2;
+    if (rows_[first + step].address <= address) {
+      first += step + 1;
+      count -= step + 1;
+    } else {
+      count = step;
+    }
+  }
+  if (first == sequence.first_row) {
+    return false;
+  }
+  const Row& row = rows_[first - 1];
+  if (row.file == INVALID_FILE) {
+    return false;
+  }
+  *file_name = files_[row.file];
+  *line_number = row.line;
+  return true;
+}
+
+}  // namespace internal
+}  // namespace bt
+
+#endif  // BACKTRACE_HAS_ELF
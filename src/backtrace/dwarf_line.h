@@ -0,0 +1,111 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef __DWARF_LINE_H__
+#define __DWARF_LINE_H__
+
+#include "backtrace/backtrace_util.h"
+#include "backtrace/elf_file.h"
+#include "backtrace/section_cache.h"
+
+#ifdef BACKTRACE_HAS_ELF
+
+#include <set>
+
+namespace bt {
+namespace internal {
+
+class DwarfInfo;
+class DwarfReader;
+
+// Source line information of an object, read from .debug_line section.
+//
+// Line programs are decoded lazily. When the unit covering requested
+// address is known from the debug information only its program is
+// decoded. Otherwise lookup decodes programs in order until the one
+// covering the address is found, so only the beginning of a (possibly
+// compressed) section is touched for the early addresses. Decoded rows
+// are kept, so subsequent lookups are a binary search.
+class DwarfLineTable {
+ public:
+  // Info is used to find the program of the unit, it might be NULL.
+  DwarfLineTable(const ElfFile *elf, DwarfInfo *info);
+
+  // Find source file name and line number of the given link-time address.
+  bool find(uint64_t address, string *file_name, int *line_number);
+
+  // Estimated heap memory used by the decoded rows and file names.
+  size_t memory_usage() const;
+
+ private:
+  struct Row {
+    uint64_t address;
+    uint32_t file;
+    int32_t line;
+  };
+
+  // Continuous range of addresses which rows are sorted by address.
+  struct Sequence {
+    uint64_t low;
+    uint64_t high;
+    size_t first_row;
+    size_t num_rows;
+  };
+
+  // Decode line program which starts at the given section offset,
+  // offset of the next program is returned in next_offset.
+  bool decode_program(uint64_t offset, uint64_t *next_offset);
+
+  // Read an entry of DWARF 5 directory or file name table.
+  bool read_entry_format(DwarfReader *reader,
+                         bool is_64bit,
+                         const vector<uint64_t>& format,
+                         string *path,
+                         uint64_t *directory_index);
+
+  // Get global index of a file with given directory and name.
+  uint32_t file_index(const string& directory, const string& name);
+
+  bool find_in_sequences(uint64_t address,
+                         string *file_name,
+                         int *line_number) const;
+
+  const ElfFile *elf_;
+  DwarfInfo *info_;
+  SectionView line_, line_str_, str_;
+  // Offset of the first program which was not decoded yet.
+  uint64_t next_offset_;
+  // Programs past the next offset which were decoded out of order.
+  std::set<uint64_t> decoded_programs_;
+
+  vector<string> files_;
+  map<string, uint32_t> file_indices_;
+  vector<Row> rows_;
+  vector<Sequence> sequences_;
+  // Index of sequences by their high address.
+  map<uint64_t, size_t> sequence_by_high_;
+};
+
+}  // namespace internal
+}  // namespace bt
+
+#endif  // BACKTRACE_HAS_ELF
+
+#endif  // __DWARF_LINE_H__
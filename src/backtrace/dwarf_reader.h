@@ -0,0 +1,201 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef __DWARF_READER_H__
+#define __DWARF_READER_H__
+
+#include "backtrace/backtrace_util.h"
+
+#include <cstring>
+#include <stdint.h>
+
+namespace bt {
+namespace internal {
+
+// Bounds checked cursor over a DWARF data in native byte order.
+//
+// Once reading past the end is attempted reader goes into an error state
+// and all further reads are returning zeros.
+class DwarfReader {
+ public:
+  DwarfReader()
+  : data_(NULL),
+    size_(0),
+    position_(0),
+    error_(false) {}
+
+  DwarfReader(const unsigned char *data, uint64_t size)
+  : data_(data),
+    size_(data != NULL ? size : 0),
+    position_(0),
+    error_(data == NULL) {}
+
+  bool has_error() const { return error_; }
+  bool at_end() const { return position_ >= size_; }
+  uint64_t position() const { return position_; }
+  uint64_t remaining() const { return error_ ? 0 : size_ - position_; }
+  const unsigned char *current() const { return data_ + position_; }
+
+  void seek(uint64_t position) {
+    if (position > size_) {
+      error_ = true;
+    } else {
+      position_ = position;
+    }
+  }
+
+  void skip(uint64_t size) {
+    if (!check(size)) {
+      return;
+    }
+    position_ += size;
+  }
+
+  uint8_t u8() { return read<uint8_t>(); }
+  uint16_t u16() { return read<uint16_t>(); }
+  uint32_t u32() { return read<uint32_t>(); }
+  uint64_t u64() { return read<uint64_t>(); }
+  int8_t s8() { return read<int8_t>(); }
+
+  // Read 24 bit unsigned value, used by DW_FORM_strx3 and DW_FORM_addrx3.
+  uint32_t u24() {
+    if (!check(3)) {
+      return 0;
+    }
+    const unsigned char *p = data_ + position_;
+    position_ += 3;
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    return p[0] | (p[1] << 8) | ((uint32_t)p[2] << 16);
+#else
+    return ((uint32_t)p[0] << 16) | (p[1] << 8) | p[2];
+#endif
+  }
+
+  // Read unsigned value of a given size in bytes.
+  uint64_t unsigned_value(int size) {
+    switch (size) {
+      case 1: return u8();
+      case 2: return u16();
+      case 4: return u32();
+      case 8: return u64();
+    }
+    error_ = true;
+    return 0;
+  }
+
+  uint64_t uleb128() {
+    uint64_t result = 0;
+    int shift = 0;
+    while (check(1)) {
+      uint8_t byte = data_[position_++];
+      if (shift < 64) {
+        result |= (uint64_t)(byte & 0x7f) << shift;
+      }
+      shift += 7;
+      if ((byte & 0x80) == 0) {
+        break;
+      }
+    }
+    return result;
+  }
+
+  int64_t sleb128() {
+    int64_t result = 0;
+    int shift = 0;
+    uint8_t byte = 0;
+    while (check(1)) {
+      byte = data_[position_++];
+      if (shift < 64) {
+        result |= (int64_t)(byte & 0x7f) << shift;
+      }
+      shift += 7;
+      if ((byte & 0x80) == 0) {
+        break;
+      }
+    }
+    if (shift < 64 && (byte & 0x40)) {
+      result |= -((int64_t)1 << shift);
+    }
+    return result;
+  }
+
+  // Read null-terminated string, returns NULL if there's no terminator
+  // within the data.
+  const char *cstring() {
+    if (error_) {
+      return NULL;
+    }
+    const unsigned char *start = data_ + position_;
+    const void *end = memchr(start, 0, size_ - position_);
+    if (end == NULL) {
+      error_ = true;
+      return NULL;
+    }
+    position_ += (const unsigned char *)end - start + 1;
+    return reinterpret_cast<const char *>(start);
+  }
+
+  // Read initial length of a unit, sets is_64bit according to the DWARF
+  // format used by the unit.
+  uint64_t initial_length(bool *is_64bit) {
+    uint64_t length = u32();
+    *is_64bit = false;
+    if (length == 0xffffffff) {
+      length = u64();
+      *is_64bit = true;
+    }
+    return length;
+  }
+
+  // Read section offset, which size depends on DWARF format.
+  uint64_t offset(bool is_64bit) {
+    return is_64bit ? u64() : u32();
+  }
+
+ private:
+  bool check(uint64_t size) {
+    if (error_ || size > size_ - position_) {
+      error_ = true;
+      return false;
+    }
+    return true;
+  }
+
+  template<typename T>
+  T read() {
+    if (!check(sizeof(T))) {
+      return 0;
+    }
+    T value;
+    memcpy(&value, data_ + position_, sizeof(T));
+    position_ += sizeof(T);
+    return value;
+  }
+
+  const unsigned char *data_;
+  uint64_t size_;
+  uint64_t position_;
+  bool error_;
+};
+
+}  // namespace internal
+}  // namespace bt
+
+#endif  // __DWARF_READER_H__
@@ -0,0 +1,296 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "backtrace/elf_file.h"
+
+#ifdef BACKTRACE_HAS_ELF
+
+#include <elf.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef SHF_COMPRESSED
+#  define SHF_COMPRESSED (1 << 11)
+#endif
+#ifndef ELFCOMPRESS_ZLIB
+#  define ELFCOMPRESS_ZLIB 1
+#endif
+#ifndef ELFCOMPRESS_ZSTD
+#  define ELFCOMPRESS_ZSTD 2
+#endif
+
+// Header of legacy .zdebug_* sections: "ZLIB" followed by big endian
+// 64 bit uncompressed size.
+#define ZDEBUG_HEADER_SIZE 12
+
+namespace bt {
+namespace internal {
+
+namespace {
+
+bool is_zdebug_section(const ElfSection& section) {
+  return section.name.compare(0, 8, ".zdebug_") == 0;
+}
+
+}  // namespace
+
+ElfFile::ElfFile()
+    : data_(NULL),
+      size_(0),
+      is_64bit_(false),
+      load_address_(0) {
+}
+
+ElfFile::ElfFile(const string& file_name)
+    : data_(NULL),
+      size_(0),
+      is_64bit_(false),
+      load_address_(0) {
+  open(file_name);
+}
+
+ElfFile::~ElfFile() {
+  close();
+}
+
+bool ElfFile::open(const string& file_name) {
+  close();
+  int fd = ::open(file_name.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)EI_NIDENT) {
+    ::close(fd);
+    return false;
+  }
+  void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+  file_name_ = file_name;
+  data_ = reinterpret_cast<const unsigned char *>(data);
+  size_ = st.st_size;
+  id_.device = st.st_dev;
+  id_.inode = st.st_ino;
+  id_.size = st.st_size;
+  id_.mtime = st.st_mtime;
+  // Only native byte order is supported, symbolizer never deals with
+  // objects of other architectures anyway.
+  bool ok = memcmp(data_, ELFMAG, SELFMAG) == 0;
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  ok = ok && data_[EI_DATA] == ELFDATA2LSB;
+#else
+  ok = ok && data_[EI_DATA] == ELFDATA2MSB;
+#endif
+  if (ok) {
+    if (data_[EI_CLASS] == ELFCLASS64) {
+      is_64bit_ = true;
+      ok = parse_headers<Elf64_Ehdr, Elf64_Shdr, Elf64_Phdr>();
+    } else if (data_[EI_CLASS] == ELFCLASS32) {
+      is_64bit_ = false;
+      ok = parse_headers<Elf32_Ehdr, Elf32_Shdr, Elf32_Phdr>();
+    } else {
+      ok = false;
+    }
+  }
+  if (!ok) {
+    close();
+  }
+  return ok;
+}
+
+void ElfFile::close() {
+  if (data_ != NULL) {
+    munmap(const_cast<unsigned char *>(data_), size_);
+  }
+  file_name_ = "";
+  id_ = ElfFileId();
+  data_ = NULL;
+  size_ = 0;
+  load_address_ = 0;
+  sections_.clear();
+}
+
+template<typename Ehdr, typename Shdr, typename Phdr>
+bool ElfFile::parse_headers() {
+  if (!in_bounds(0, sizeof(Ehdr))) {
+    return false;
+  }
+  const Ehdr *ehdr = reinterpret_cast<const Ehdr *>(data_);
+  // Program headers, only used to find out load address.
+  if (ehdr->e_phoff != 0 && ehdr->e_phentsize == sizeof(Phdr) &&
+      in_bounds(ehdr->e_phoff, (uint64_t)ehdr->e_phnum * sizeof(Phdr))) {
+    const Phdr *phdr = reinterpret_cast<const Phdr *>(data_ + ehdr->e_phoff);
+    bool has_load = false;
+    for (int i = 0; i < ehdr->e_phnum; ++i) {
+      if (phdr[i].p_type != PT_LOAD) {
+        continue;
+      }
+      uint64_t address = phdr[i].p_vaddr;
+      if (phdr[i].p_align > 1) {
+        address &= ~((uint64_t)phdr[i].p_align - 1);
+      }
+      if (!has_load || address < load_address_) {
+        load_address_ = address;
+        has_load = true;
+      }
+    }
+  }
+  // Section headers.
+  if (ehdr->e_shoff == 0 || ehdr->e_shentsize != sizeof(Shdr)) {
+    return true;
+  }
+  if (!in_bounds(ehdr->e_shoff, sizeof(Shdr))) {
+    return false;
+  }
+  const Shdr *shdr = reinterpret_cast<const Shdr *>(data_ + ehdr->e_shoff);
+  // Extended numbering is stored in the first section header.
+  uint64_t num_sections = ehdr->e_shnum;
+  if (num_sections == 0) {
+    num_sections = shdr[0].sh_size;
+  }
+  uint64_t string_index = ehdr->e_shstrndx;
+  if (string_index == SHN_XINDEX) {
+    string_index = shdr[0].sh_link;
+  }
+  if (!in_bounds(ehdr->e_shoff, num_sections * sizeof(Shdr)) ||
+      string_index >= num_sections) {
+    return false;
+  }
+  const Shdr& strings = shdr[string_index];
+  if (!in_bounds(strings.sh_offset, strings.sh_size)) {
+    return false;
+  }
+  const char *names = reinterpret_cast<const char *>(data_ + strings.sh_offset);
+  sections_.resize(num_sections);
+  for (size_t i = 0; i < num_sections; ++i) {
+    ElfSection& section = sections_[i];
+    section.type = shdr[i].sh_type;
+    section.flags = shdr[i].sh_flags;
+    section.address = shdr[i].sh_addr;
+    section.offset = shdr[i].sh_offset;
+    section.size = shdr[i].sh_size;
+    section.link = shdr[i].sh_link;
+    section.info = shdr[i].sh_info;
+    section.entry_size = shdr[i].sh_entsize;
+    if (shdr[i].sh_name < strings.sh_size) {
+      const char *name = names + shdr[i].sh_name;
+      section.name.assign(name, strnlen(name, strings.sh_size -
+                                               shdr[i].sh_name));
+    }
+    // Sections without contents in the file are treated as empty, this
+    // way nobody will try to read past the file end.
+    if (section.type == SHT_NOBITS ||
+        !in_bounds(section.offset, section.size)) {
+      section.offset = 0;
+      section.size = 0;
+    }
+  }
+  return true;
+}
+
+const ElfSection *ElfFile::section_by_name(const string& name) const {
+  for (size_t i = 0; i < sections_.size(); ++i) {
+    if (sections_[i].name == name) {
+      return &sections_[i];
+    }
+  }
+  if (name.compare(0, 7, ".debug_") == 0) {
+    string zdebug_name = ".z" + name.substr(1);
+    for (size_t i = 0; i < sections_.size(); ++i) {
+      if (sections_[i].name == zdebug_name) {
+        return &sections_[i];
+      }
+    }
+  }
+  return NULL;
+}
+
+size_t ElfFile::compression_header_size(const ElfSection& section) const {
+  if (section.flags & SHF_COMPRESSED) {
+    return is_64bit_ ? sizeof(Elf64_Chdr) : sizeof(Elf32_Chdr);
+  }
+  if (is_zdebug_section(section)) {
+    return ZDEBUG_HEADER_SIZE;
+  }
+  return 0;
+}
+
+ElfFile::Compression ElfFile::compression(const ElfSection& section) const {
+  size_t header_size = compression_header_size(section);
+  if (header_size == 0) {
+    return COMPRESSION_NONE;
+  }
+  if (section.size < header_size) {
+    return COMPRESSION_UNKNOWN;
+  }
+  const unsigned char *header = data_ + section.offset;
+  if (is_zdebug_section(section) && !(section.flags & SHF_COMPRESSED)) {
+    return memcmp(header, "ZLIB", 4) == 0 ? COMPRESSION_ZLIB
+                                          : COMPRESSION_UNKNOWN;
+  }
+  uint32_t type = is_64bit_
+      ? reinterpret_cast<const Elf64_Chdr *>(header)->ch_type
+      : reinterpret_cast<const Elf32_Chdr *>(header)->ch_type;
+  switch (type) {
+    case ELFCOMPRESS_ZLIB: return COMPRESSION_ZLIB;
+    case ELFCOMPRESS_ZSTD: return COMPRESSION_ZSTD;
+  }
+  return COMPRESSION_UNKNOWN;
+}
+
+uint64_t ElfFile::uncompressed_size(const ElfSection& section) const {
+  size_t header_size = compression_header_size(section);
+  if (header_size == 0) {
+    return section.size;
+  }
+  if (section.size < header_size) {
+    return 0;
+  }
+  const unsigned char *header = data_ + section.offset;
+  if (is_zdebug_section(section) && !(section.flags & SHF_COMPRESSED)) {
+    uint64_t size = 0;
+    for (int i = 4; i < ZDEBUG_HEADER_SIZE; ++i) {
+      size = (size << 8) | header[i];
+    }
+    return size;
+  }
+  return is_64bit_ ? reinterpret_cast<const Elf64_Chdr *>(header)->ch_size
+                   : reinterpret_cast<const Elf32_Chdr *>(header)->ch_size;
+}
+
+const unsigned char *ElfFile::raw_data(const ElfSection& section) const {
+  return data_ + section.offset + compression_header_size(section);
+}
+
+uint64_t ElfFile::raw_size(const ElfSection& section) const {
+  size_t header_size = compression_header_size(section);
+  return section.size > header_size ? section.size - header_size : 0;
+}
+
+}  // namespace internal
+}  // namespace bt
+
+#endif  // BACKTRACE_HAS_ELF
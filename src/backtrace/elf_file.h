@@ -0,0 +1,163 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef __ELF_FILE_H__
+#define __ELF_FILE_H__
+
+#include "backtrace/backtrace_util.h"
+
+#ifdef BACKTRACE_HAS_ELF
+
+#include <stdint.h>
+
+namespace bt {
+namespace internal {
+
+// Identifier of a file on disk, used to share data between different
+// ElfFile instances which are opened for the same object.
+struct ElfFileId {
+  uint64_t device;
+  uint64_t inode;
+  uint64_t size;
+  int64_t mtime;
+
+  ElfFileId()
+  : device(0),
+    inode(0),
+    size(0),
+    mtime(0) {}
+
+  bool operator<(const ElfFileId& other) const {
+    if (device != other.device) return device < other.device;
+    if (inode != other.inode) return inode < other.inode;
+    if (size != other.size) return size < other.size;
+    return mtime < other.mtime;
+  }
+};
+
+// Section of an ELF object, in a word size independent form.
+struct ElfSection {
+  string name;
+  uint32_t type;
+  uint64_t flags;
+  uint64_t address;
+  uint64_t offset;
+  uint64_t size;
+  uint32_t link;
+  uint32_t info;
+  uint64_t entry_size;
+
+  ElfSection()
+  : type(0),
+    flags(0),
+    address(0),
+    offset(0),
+    size(0),
+    link(0),
+    info(0),
+    entry_size(0) {}
+};
+
+// Memory mapped read-only ELF object.
+//
+// Only headers are parsed when object is opened, section contents is to
+// be accessed via SectionView which takes care of compressed sections.
+class ElfFile {
+ public:
+  // Compression of section contents.
+  enum Compression {
+    COMPRESSION_NONE,
+    COMPRESSION_ZLIB,
+    COMPRESSION_ZSTD,
+    COMPRESSION_UNKNOWN,
+  };
+
+  ElfFile();
+  explicit ElfFile(const string& file_name);
+  ~ElfFile();
+
+  // Open object with a given file name, return false if file is not
+  // readable or is not a supported ELF object.
+  bool open(const string& file_name);
+  void close();
+
+  bool is_open() const { return data_ != NULL; }
+  const string& file_name() const { return file_name_; }
+  const ElfFileId& id() const { return id_; }
+  bool is_64bit() const { return is_64bit_; }
+
+  // Access sections of the object.
+  size_t num_sections() const { return sections_.size(); }
+  const ElfSection& section(size_t index) const {
+    assert(index < sections_.size());
+    return sections_[index];
+  }
+
+  // Find section by its name, NULL is returned if there's no such section.
+  //
+  // Legacy .zdebug_* sections are found when asking for .debug_*.
+  const ElfSection *section_by_name(const string& name) const;
+
+  // Get compression used by the section contents.
+  Compression compression(const ElfSection& section) const;
+
+  // Get size of the section contents after decompression.
+  uint64_t uncompressed_size(const ElfSection& section) const;
+
+  // Get bytes of the section as they are stored in the file, this skips
+  // compression header for compressed sections.
+  const unsigned char *raw_data(const ElfSection& section) const;
+  uint64_t raw_size(const ElfSection& section) const;
+
+  // Lowest virtual address of the loadable segments, page aligned.
+  // Used to convert run-time address to a link-time one.
+  uint64_t load_address() const { return load_address_; }
+
+ private:
+  // ElfFile is not copyable.
+  ElfFile(const ElfFile& other);
+  ElfFile& operator=(const ElfFile& other);
+
+  template<typename Ehdr, typename Shdr, typename Phdr>
+  bool parse_headers();
+
+  // Size of compression header of the section, 0 if section is not
+  // compressed.
+  size_t compression_header_size(const ElfSection& section) const;
+
+  bool in_bounds(uint64_t offset, uint64_t size) const {
+    return offset <= size_ && size <= size_ - offset;
+  }
+
+  string file_name_;
+  ElfFileId id_;
+  const unsigned char *data_;
+  size_t size_;
+  bool is_64bit_;
+  uint64_t load_address_;
+  vector<ElfSection> sections_;
+};
+
+}  // namespace internal
+}  // namespace bt
+
+#endif  // BACKTRACE_HAS_ELF
+
+#endif  // __ELF_FILE_H__
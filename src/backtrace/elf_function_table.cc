@@ -0,0 +1,170 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "backtrace/elf_function_table.h"
+
+#ifdef BACKTRACE_HAS_ELF
+
+#include <algorithm>
+#include <cstring>
+#include <elf.h>
+
+namespace bt {
+namespace internal {
+
+namespace {
+
+// Symbol table which is preferred when both have the same function.
+enum {
+  STRING_TABLE_SYMTAB = 0,
+  STRING_TABLE_DYNSYM = 1,
+};
+
+}  // namespace
+
+ElfFunctionTable::ElfFunctionTable(const ElfFile *elf)
+    : elf_(elf) {
+  for (size_t i = 0; i < elf->num_sections(); ++i) {
+    const ElfSection& section = elf->section(i);
+    uint8_t string_table_index;
+    if (section.type == SHT_SYMTAB) {
+      string_table_index = STRING_TABLE_SYMTAB;
+    } else if (section.type == SHT_DYNSYM) {
+      string_table_index = STRING_TABLE_DYNSYM;
+    } else {
+      continue;
+    }
+    if (section.link >= elf->num_sections()) {
+      continue;
+    }
+    string_tables_[string_table_index] =
+        SectionView(elf, &elf->section(section.link));
+    if (elf->is_64bit()) {
+      read_symbols<Elf64_Sym>(section, string_table_index);
+    } else {
+      read_symbols<Elf32_Sym>(section, string_table_index);
+    }
+  }
+  // Keep single, best, function for every address.
+  std::sort(functions_.begin(), functions_.end());
+  size_t num_unique = 0;
+  for (size_t i = 0; i < functions_.size(); ++i) {
+    if (num_unique == 0 ||
+        functions_[num_unique - 1].address != functions_[i].address) {
+      functions_[num_unique++] = functions_[i];
+    }
+  }
+  functions_.resize(num_unique);
+  // Slot 0 is unused, children of node k are 2k and 2k + 1.
+  eytzinger_addresses_.resize(functions_.size() + 1);
+  eytzinger_indices_.resize(functions_.size() + 1);
+  build_eytzinger(0, 1);
+}
+
+template<typename Sym>
+void ElfFunctionTable::read_symbols(const ElfSection& section,
+                                    uint8_t string_table_index) {
+  SectionView view(elf_, &section);
+  size_t num_symbols = view.size() / sizeof(Sym);
+  const unsigned char *data = view.data(0, num_symbols * sizeof(Sym));
+  if (data == NULL) {
+    return;
+  }
+  for (size_t i = 0; i < num_symbols; ++i) {
+    Sym symbol;
+    memcpy(&symbol, data + i * sizeof(Sym), sizeof(Sym));
+    int type = ELF64_ST_TYPE(symbol.st_info);
+    if ((type != STT_FUNC && type != STT_GNU_IFUNC) ||
+        symbol.st_shndx == SHN_UNDEF ||
+        symbol.st_value == 0) {
+      continue;
+    }
+    int binding = ELF64_ST_BIND(symbol.st_info);
+    Function function;
+    function.address = symbol.st_value;
+    function.size = symbol.st_size;
+    function.name_offset = symbol.st_name;
+    function.string_table = string_table_index;
+    // Prefer symbols with known size, then global ones, then the ones from
+    // the full symbol table.
+    function.rank = (symbol.st_size == 0 ? 8 : 0) +
+                    (binding == STB_GLOBAL ? 0 :
+                     binding == STB_WEAK ? 2 : 4) +
+                    string_table_index;
+    functions_.push_back(function);
+  }
+}
+
+size_t ElfFunctionTable::build_eytzinger(size_t sorted_index, size_t node) {
+  if (node < eytzinger_addresses_.size()) {
+    sorted_index = build_eytzinger(sorted_index, 2 * node);
+    eytzinger_addresses_[node] = functions_[sorted_index].address;
+    eytzinger_indices_[node] = (uint32_t)sorted_index;
+    ++sorted_index;
+    sorted_index = build_eytzinger(sorted_index, 2 * node + 1);
+  }
+  return sorted_index;
+}
+
+bool ElfFunctionTable::find(uint64_t address,
+                            const char **name,
+                            uint64_t *offset) const {
+  const size_t num_functions = functions_.size();
+  if (num_functions == 0) {
+    return false;
+  }
+  // Descend to the leaf, going right while node's address is not above
+  // the requested one. Branch-free loop body.
+  const uint64_t *addresses = &eytzinger_addresses_[0];
+  size_t node = 1;
+  while (node <= num_functions) {
+    node = 2 * node + (addresses[node] <= address);
+  }
+  // Undo the right turns and the last left one, which gives the first
+  // function starting above the address.
+  node >>= __builtin_ffsl(~node);
+  size_t upper_index = (node == 0) ? num_functions
+                                   : eytzinger_indices_[node];
+  if (upper_index == 0) {
+    return false;
+  }
+  const Function& function = functions_[upper_index - 1];
+  if (function.size != 0 && address - function.address >= function.size) {
+    // Address is in padding between functions or in code without symbols.
+    return false;
+  }
+  const SectionView& strings = string_tables_[function.string_table];
+  if (function.name_offset >= strings.size()) {
+    return false;
+  }
+  const char *function_name = reinterpret_cast<const char *>(
+      strings.data(function.name_offset, 1));
+  if (function_name == NULL) {
+    return false;
+  }
+  *name = function_name;
+  *offset = address - function.address;
+  return true;
+}
+
+}  // namespace internal
+}  // namespace bt
+
+#endif  // BACKTRACE_HAS_ELF
@@ -0,0 +1,95 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef __ELF_FUNCTION_TABLE_H__
+#define __ELF_FUNCTION_TABLE_H__
+
+#include "backtrace/backtrace_util.h"
+#include "backtrace/elf_file.h"
+#include "backtrace/section_cache.h"
+
+#ifdef BACKTRACE_HAS_ELF
+
+#include <stdint.h>
+
+namespace bt {
+namespace internal {
+
+// Table of function start addresses of an ELF object, built from .symtab
+// and .dynsym.
+//
+// Start addresses are laid out in Eytzinger (breadth-first) order, so the
+// top levels of the search share a few cache lines and lookup does not
+// jump across the whole array like a regular binary search. Names are not
+// copied, they are referenced in the string tables of the object.
+class ElfFunctionTable {
+ public:
+  explicit ElfFunctionTable(const ElfFile *elf);
+
+  // Find function which contains given link-time address. Name is mangled
+  // and offset is relative to the function start.
+  bool find(uint64_t address, const char **name, uint64_t *offset) const;
+
+  size_t size() const { return functions_.size(); }
+
+  // Estimated heap memory used by the table.
+  size_t memory_usage() const {
+    return functions_.capacity() * sizeof(Function) +
+           eytzinger_addresses_.capacity() * sizeof(uint64_t) +
+           eytzinger_indices_.capacity() * sizeof(uint32_t);
+  }
+
+ private:
+  struct Function {
+    uint64_t address;
+    uint64_t size;
+    uint32_t name_offset;
+    // Index of the string table the name is in.
+    uint8_t string_table;
+    // Lower is better, used to pick one of the aliases.
+    uint8_t rank;
+
+    bool operator<(const Function& other) const {
+      if (address != other.address) return address < other.address;
+      return rank < other.rank;
+    }
+  };
+
+  template<typename Sym>
+  void read_symbols(const ElfSection& section, uint8_t string_table_index);
+  size_t build_eytzinger(size_t sorted_index, size_t node);
+
+  const ElfFile *elf_;
+  // String tables of .symtab and .dynsym.
+  SectionView string_tables_[2];
+  // Functions sorted by their start address.
+  vector<Function> functions_;
+  // Start addresses in Eytzinger order, one-based, and index of the
+  // corresponding function in the sorted array.
+  vector<uint64_t> eytzinger_addresses_;
+  vector<uint32_t> eytzinger_indices_;
+};
+
+}  // namespace internal
+}  // namespace bt
+
+#endif  // BACKTRACE_HAS_ELF
+
+#endif  // __ELF_FUNCTION_TABLE_H__
@@ -0,0 +1,566 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "backtrace/flight_recorder.h"
+
+#ifdef BACKTRACE_HAS_FLIGHT_RECORDER
+
+#include <algorithm>
+#include <elf.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sstream>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "backtrace/symbolize.h"
+
+// "BTFR" in a little endian file.
+#define RECORDER_MAGIC 0x52465442
+#define RECORDER_VERSION 1
+
+#if defined(__x86_64__)
+#  define RECORDER_MACHINE EM_X86_64
+#elif defined(__aarch64__)
+#  define RECORDER_MACHINE EM_AARCH64
+#endif
+
+#define MAX_MODULES 512
+#define MODULE_PATH_SIZE 512
+#define BUILD_ID_MAX_SIZE 64
+
+namespace bt {
+namespace internal {
+
+namespace {
+
+// Recorder memory is laid out exactly as the file: header, module table
+// and rings of all the threads, each of them followed by its events.
+struct FileHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t machine;
+  uint32_t depth;
+  uint32_t tag_size;
+  uint32_t events_per_ring;
+  uint32_t num_rings;
+  volatile uint32_t num_modules;
+  uint64_t pid;
+  // Difference between wall clock and monotonic time.
+  int64_t realtime_offset_ns;
+};
+
+struct FileModule {
+  uint64_t start;
+  uint64_t end;
+  uint64_t file_offset;
+  uint64_t load_bias;
+  uint32_t path_size;
+  uint32_t build_id_size;
+  char path[MODULE_PATH_SIZE];
+  char build_id[BUILD_ID_MAX_SIZE];
+};
+
+enum RingState {
+  RING_FREE = 0,
+  RING_ACTIVE = 1,
+  RING_EXITED = 2,
+};
+
+struct FileRing {
+  volatile uint32_t state;
+  uint32_t reserved;
+  uint64_t tid;
+  char name[16];
+  // Index of the next event to be written.
+  volatile uint64_t next;
+};
+
+struct FileEvent {
+  // Sequence lock of the event: odd while the event is being written,
+  // 2 * index + 2 once event with the given index is complete.
+  volatile uint64_t seq;
+  uint64_t timestamp_ns;
+  uint32_t depth;
+  char tag[BACKTRACE_FLIGHT_RECORDER_TAG_SIZE];
+  uint64_t frames[BACKTRACE_FLIGHT_RECORDER_DEPTH];
+};
+
+// Per-thread state, which makes recording lock free after the first event.
+struct ThreadState {
+  FileRing *ring;
+  FileEvent *events;
+  uint64_t mask;
+  uintptr_t stack_low;
+  uintptr_t stack_high;
+  bool failed;
+};
+
+__thread ThreadState thread_state __attribute__((tls_model("initial-exec")));
+
+// Serializes opening of the recorder and assignment of the rings.
+Mutex recorder_mutex;
+char *volatile recorder_base = NULL;
+pthread_key_t ring_key;
+
+bool module_less(const Module& a, const Module& b) {
+  return a.start < b.start;
+}
+
+size_t modules_offset() {
+  return sizeof(FileHeader);
+}
+
+size_t rings_offset() {
+  return modules_offset() + MAX_MODULES * sizeof(FileModule);
+}
+
+size_t ring_size(size_t events_per_ring) {
+  return sizeof(FileRing) + events_per_ring * sizeof(FileEvent);
+}
+
+FileRing *ring_get(const char *base, size_t index) {
+  const FileHeader *header = reinterpret_cast<const FileHeader *>(base);
+  return reinterpret_cast<FileRing *>(const_cast<char *>(
+      base + rings_offset() + index * ring_size(header->events_per_ring)));
+}
+
+FileEvent *ring_events(FileRing *ring) {
+  return reinterpret_cast<FileEvent *>(ring + 1);
+}
+
+uint64_t time_realtime_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Must be called with recorder mutex held.
+void modules_store(char *base) {
+  FileHeader *header = reinterpret_cast<FileHeader *>(base);
+  FileModule *file_modules =
+      reinterpret_cast<FileModule *>(base + modules_offset());
+  vector<Module> modules;
+  module_table_load(&modules);
+  size_t num_modules = std::min(modules.size(), (size_t)MAX_MODULES);
+  // Readers of a crashed process' file only trust the published count.
+  header->num_modules = 0;
+  __sync_synchronize();
+  for (size_t i = 0; i < num_modules; ++i) {
+    const Module& module = modules[i];
+    FileModule& file_module = file_modules[i];
+    file_module.start = module.start;
+    file_module.end = module.end;
+    file_module.file_offset = module.file_offset;
+    file_module.load_bias = module.load_bias;
+    file_module.path_size = (uint32_t)std::min(module.path.size(),
+                                               (size_t)MODULE_PATH_SIZE);
+    memcpy(file_module.path, module.path.data(), file_module.path_size);
+    file_module.build_id_size = (uint32_t)std::min(
+        module.build_id.size(), (size_t)BUILD_ID_MAX_SIZE);
+    memcpy(file_module.build_id,
+           module.build_id.data(),
+           file_module.build_id_size);
+  }
+  __sync_synchronize();
+  header->num_modules = (uint32_t)num_modules;
+}
+
+void ring_release(void *ring_v) {
+  FileRing *ring = reinterpret_cast<FileRing *>(ring_v);
+  ring->state = RING_EXITED;
+  // Thread is going away, do not let late destructors take a new ring.
+  thread_state.ring = NULL;
+  thread_state.failed = true;
+}
+
+bool thread_state_init(ThreadState *state) {
+  state->failed = true;
+  if (recorder_base == NULL) {
+    flight_recorder_open(NULL,
+                         BACKTRACE_FLIGHT_RECORDER_EVENTS,
+                         BACKTRACE_FLIGHT_RECORDER_THREADS);
+  }
+  MutexLock lock(&recorder_mutex);
+  char *base = recorder_base;
+  if (base == NULL) {
+    return false;
+  }
+  const FileHeader *header = reinterpret_cast<const FileHeader *>(base);
+  // Prefer rings which were never used, so events of exited threads are
+  // kept for as long as possible.
+  FileRing *ring = NULL, *exited_ring = NULL;
+  for (size_t i = 0; i < header->num_rings && ring == NULL; ++i) {
+    FileRing *candidate = ring_get(base, i);
+    if (candidate->state == RING_FREE) {
+      ring = candidate;
+    } else if (candidate->state == RING_EXITED && exited_ring == NULL) {
+      exited_ring = candidate;
+    }
+  }
+  if (ring == NULL) {
+    ring = exited_ring;
+  }
+  if (ring == NULL) {
+    return false;
+  }
+  FileEvent *events = ring_events(ring);
+  for (size_t i = 0; i < header->events_per_ring; ++i) {
+    events[i].seq = 0;
+  }
+  ring->next = 0;
+  ring->tid = (uint64_t)syscall(SYS_gettid);
+  memset(ring->name, 0, sizeof(ring->name));
+  prctl(PR_GET_NAME, ring->name, 0, 0, 0);
+  ring->state = RING_ACTIVE;
+  state->stack_low = state->stack_high = 0;
+  pthread_attr_t attr;
+  if (pthread_getattr_np(pthread_self(), &attr) == 0) {
+    void *stack_address;
+    size_t stack_size;
+    if (pthread_attr_getstack(&attr, &stack_address, &stack_size) == 0) {
+      state->stack_low = reinterpret_cast<uintptr_t>(stack_address);
+      state->stack_high = state->stack_low + stack_size;
+    }
+    pthread_attr_destroy(&attr);
+  }
+  pthread_setspecific(ring_key, ring);
+  // New threads often come along with newly loaded objects.
+  modules_store(base);
+  state->events = events;
+  state->mask = header->events_per_ring - 1;
+  state->ring = ring;
+  state->failed = false;
+  return true;
+}
+
+// Follow frame pointers starting from the given frame, every frame must be
+// within the thread's stack and above the previous one.
+inline int frames_walk(uintptr_t fp,
+                       uintptr_t stack_low,
+                       uintptr_t stack_high,
+                       uint64_t *frames) {
+  int depth = 0;
+  while (depth < BACKTRACE_FLIGHT_RECORDER_DEPTH) {
+    if (fp < stack_low ||
+        fp + 2 * sizeof(uintptr_t) > stack_high ||
+        (fp & (sizeof(uintptr_t) - 1)) != 0) {
+      break;
+    }
+    const uintptr_t *frame = reinterpret_cast<const uintptr_t *>(fp);
+    if (frame[1] == 0) {
+      break;
+    }
+    frames[depth++] = frame[1];
+    if (frame[0] <= fp) {
+      break;
+    }
+    fp = frame[0];
+  }
+  return depth;
+}
+
+bool recording_parse(const char *data,
+                     size_t size,
+                     FlightRecording *recording) {
+  *recording = FlightRecording();
+  if (size < rings_offset()) {
+    return false;
+  }
+  const FileHeader *header = reinterpret_cast<const FileHeader *>(data);
+  if (header->magic != RECORDER_MAGIC ||
+      header->version != RECORDER_VERSION ||
+      header->machine != RECORDER_MACHINE ||
+      header->depth != BACKTRACE_FLIGHT_RECORDER_DEPTH ||
+      header->tag_size != BACKTRACE_FLIGHT_RECORDER_TAG_SIZE ||
+      header->events_per_ring == 0 ||
+      (header->events_per_ring & (header->events_per_ring - 1)) != 0 ||
+      header->num_modules > MAX_MODULES ||
+      (size - rings_offset()) / ring_size(header->events_per_ring) <
+          header->num_rings) {
+    return false;
+  }
+  recording->pid = (int)header->pid;
+  const FileModule *file_modules =
+      reinterpret_cast<const FileModule *>(data + modules_offset());
+  for (size_t i = 0; i < header->num_modules; ++i) {
+    const FileModule& file_module = file_modules[i];
+    Module module;
+    module.start = (uintptr_t)file_module.start;
+    module.end = (uintptr_t)file_module.end;
+    module.file_offset = file_module.file_offset;
+    module.load_bias = (uintptr_t)file_module.load_bias;
+    module.path.assign(file_module.path,
+                       std::min(file_module.path_size,
+                                (uint32_t)MODULE_PATH_SIZE));
+    module.build_id.assign(file_module.build_id,
+                           std::min(file_module.build_id_size,
+                                    (uint32_t)BUILD_ID_MAX_SIZE));
+    recording->modules.push_back(module);
+  }
+  uint64_t events_per_ring = header->events_per_ring;
+  for (size_t i = 0; i < header->num_rings; ++i) {
+    FileRing *ring = ring_get(data, i);
+    if (ring->state == RING_FREE) {
+      continue;
+    }
+    FlightThread thread;
+    thread.tid = (long)ring->tid;
+    thread.name.assign(ring->name, strnlen(ring->name, sizeof(ring->name)));
+    thread.exited = (ring->state == RING_EXITED);
+    const FileEvent *events = ring_events(ring);
+    uint64_t next = ring->next;
+    uint64_t first = next > events_per_ring ? next - events_per_ring : 0;
+    for (uint64_t index = first; index < next; ++index) {
+      const FileEvent& event = events[index & (events_per_ring - 1)];
+      uint64_t seq = event.seq;
+      __sync_synchronize();
+      // Event is being written, or it was already overwritten by a newer
+      // one, which is the case for torn events of a crashed process too.
+      if (seq != 2 * index + 2) {
+        continue;
+      }
+      FlightEvent flight_event;
+      flight_event.timestamp_ns =
+          event.timestamp_ns + header->realtime_offset_ns;
+      flight_event.tag.assign(event.tag, strnlen(event.tag,
+                                                 sizeof(event.tag)));
+      uint32_t depth = std::min(event.depth,
+                                (uint32_t)BACKTRACE_FLIGHT_RECORDER_DEPTH);
+      for (uint32_t j = 0; j < depth; ++j) {
+        flight_event.stacktrace.push_back(
+            reinterpret_cast<void *>((uintptr_t)event.frames[j]));
+      }
+      __sync_synchronize();
+      if (event.seq != seq) {
+        continue;
+      }
+      thread.events.push_back(flight_event);
+    }
+    recording->threads.push_back(thread);
+  }
+  return true;
+}
+
+}  // namespace
+
+bool flight_recorder_open(const char *filename,
+                          size_t events_per_thread,
+                          size_t max_threads) {
+  MutexLock lock(&recorder_mutex);
+  if (recorder_base != NULL || events_per_thread == 0 || max_threads == 0) {
+    return false;
+  }
+  // Power of two, so position in the ring is a mask of the index.
+  size_t events_per_ring = 1;
+  while (events_per_ring < events_per_thread) {
+    events_per_ring *= 2;
+  }
+  size_t size = rings_offset() + max_threads * ring_size(events_per_ring);
+  void *data;
+  if (filename == NULL) {
+    data = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  } else {
+    int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1) {
+      return false;
+    }
+    if (ftruncate(fd, size) != 0) {
+      close(fd);
+      return false;
+    }
+    // Shared mapping, so the kernel writes pages back even if the process
+    // crashes.
+    data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+  }
+  if (data == MAP_FAILED) {
+    return false;
+  }
+  if (pthread_key_create(&ring_key, ring_release) != 0) {
+    munmap(data, size);
+    return false;
+  }
+  char *base = reinterpret_cast<char *>(data);
+  FileHeader *header = reinterpret_cast<FileHeader *>(base);
+  header->version = RECORDER_VERSION;
+  header->machine = RECORDER_MACHINE;
+  header->depth = BACKTRACE_FLIGHT_RECORDER_DEPTH;
+  header->tag_size = BACKTRACE_FLIGHT_RECORDER_TAG_SIZE;
+  header->events_per_ring = (uint32_t)events_per_ring;
+  header->num_rings = (uint32_t)max_threads;
+  header->pid = (uint64_t)getpid();
+  header->realtime_offset_ns =
+      (int64_t)(time_realtime_ns() - time_monotonic_ns());
+  modules_store(base);
+  __sync_synchronize();
+  header->magic = RECORDER_MAGIC;
+  recorder_base = base;
+  return true;
+}
+
+__attribute__((noinline))
+void flight_recorder_record(const char *tag, void *frame) {
+  ThreadState& state = thread_state;
+  if (state.ring == NULL) {
+    if (state.failed || !thread_state_init(&state)) {
+      return;
+    }
+  }
+  // Atomic increment, so events recorded from signal handlers which
+  // interrupted this function go to a slot of their own.
+  uint64_t index = __sync_fetch_and_add(&state.ring->next, 1);
+  FileEvent *event = &state.events[index & state.mask];
+  event->seq = 2 * index + 1;
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  event->timestamp_ns = time_monotonic_ns();
+  size_t length = 0;
+  if (tag != NULL) {
+    while (length < sizeof(event->tag) - 1 && tag[length] != '\0') {
+      event->tag[length] = tag[length];
+      ++length;
+    }
+  }
+  event->tag[length] = '\0';
+  // Frame of this function holds the return address into the caller.
+  if (frame == NULL) {
+    frame = __builtin_frame_address(0);
+  }
+  event->depth = frames_walk(
+      reinterpret_cast<uintptr_t>(frame),
+      state.stack_low,
+      state.stack_high,
+      event->frames);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  event->seq = 2 * index + 2;
+}
+
+void flight_recorder_update_modules() {
+  MutexLock lock(&recorder_mutex);
+  if (recorder_base != NULL) {
+    modules_store(recorder_base);
+  }
+}
+
+bool flight_recorder_snapshot(FlightRecording *recording) {
+  char *base = recorder_base;
+  if (base == NULL) {
+    return false;
+  }
+  const FileHeader *header = reinterpret_cast<const FileHeader *>(base);
+  size_t size = rings_offset() +
+                header->num_rings * ring_size(header->events_per_ring);
+  if (!recording_parse(base, size, recording)) {
+    return false;
+  }
+  // Objects are still loaded, so the current table is the most accurate.
+  module_table_load(&recording->modules);
+  return true;
+}
+
+bool flight_recorder_read(const string& filename,
+                          FlightRecording *recording) {
+  FILE *file = fopen(filename.c_str(), "rb");
+  if (file == NULL) {
+    return false;
+  }
+  string data;
+  char buffer[65536];
+  size_t size;
+  while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    data.append(buffer, size);
+  }
+  fclose(file);
+  if (!recording_parse(data.data(), data.size(), recording)) {
+    return false;
+  }
+  std::sort(recording->modules.begin(),
+            recording->modules.end(),
+            module_less);
+  module_table_locate_objects(&recording->modules);
+  return true;
+}
+
+string flight_recorder_format(const FlightRecording& recording,
+                              size_t last_events) {
+  // Symbolize every unique address once.
+  map<void *, Symbol> symbols;
+  StackTraceAddresses unique_addresses;
+  for (size_t i = 0; i < recording.threads.size(); ++i) {
+    const vector<FlightEvent>& events = recording.threads[i].events;
+    size_t first = events.size() > last_events
+                       ? events.size() - last_events : 0;
+    for (size_t j = first; j < events.size(); ++j) {
+      const StackTrace& stacktrace = events[j].stacktrace;
+      for (size_t k = 0; k < stacktrace.size(); ++k) {
+        void *address = stacktrace[k].address;
+        if (symbols.insert(std::make_pair(address, Symbol())).second) {
+          unique_addresses.push_back(address);
+        }
+      }
+    }
+  }
+  Symbolize *symbolize = symbolize_create_elf_modules(recording.modules);
+  symbolize->resolve(unique_addresses);
+  for (size_t i = 0; i < unique_addresses.size(); ++i) {
+    symbols[unique_addresses[i].address] = symbolize->at(i);
+  }
+  delete symbolize;
+  std::stringstream ss;
+  for (size_t i = 0; i < recording.threads.size(); ++i) {
+    const FlightThread& thread = recording.threads[i];
+    ss << "Thread " << thread.tid;
+    if (!thread.name.empty()) {
+      ss << " (" << thread.name << ")";
+    }
+    if (thread.exited) {
+      ss << " exited";
+    }
+    ss << ":\n";
+    size_t first = thread.events.size() > last_events
+                       ? thread.events.size() - last_events : 0;
+    for (size_t j = first; j < thread.events.size(); ++j) {
+      const FlightEvent& event = thread.events[j];
+      char timestamp[64];
+      snprintf(timestamp, sizeof(timestamp), "%llu.%06llu",
+               (unsigned long long)(event.timestamp_ns / 1000000000ULL),
+               (unsigned long long)(event.timestamp_ns % 1000000000ULL /
+                                    1000));
+      ss << "    [" << timestamp << "] " << event.tag << "\n";
+      vector<Symbol> event_symbols(event.stacktrace.size());
+      for (size_t k = 0; k < event.stacktrace.size(); ++k) {
+        event_symbols[k] = symbols[event.stacktrace[k].address];
+      }
+      ss << symbolize_format(event_symbols);
+    }
+  }
+  return ss.str();
+}
+
+}  // namespace internal
+}  // namespace bt
+
+#endif  // BACKTRACE_HAS_FLIGHT_RECORDER
@@ -0,0 +1,135 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef __FLIGHT_RECORDER_H__
+#define __FLIGHT_RECORDER_H__
+
+#include <stdint.h>
+
+#include "backtrace/backtrace_util.h"
+#include "backtrace/module_table.h"
+#include "backtrace/stacktrace.h"
+
+// Stacks are captured by following frame pointers, which is the only way
+// to stay within the latency budget of a recording.
+#if defined(__linux__) && defined(__GNUC__) && defined(BACKTRACE_HAS_ELF) && \
+    (defined(__x86_64__) || defined(__aarch64__))
+#  define BACKTRACE_HAS_FLIGHT_RECORDER
+#endif
+
+#ifdef BACKTRACE_HAS_FLIGHT_RECORDER
+
+// Maximum number of frames stored with every event.
+#ifndef BACKTRACE_FLIGHT_RECORDER_DEPTH
+#  define BACKTRACE_FLIGHT_RECORDER_DEPTH 16
+#endif
+
+// Maximum length of an event tag, longer tags are truncated.
+#ifndef BACKTRACE_FLIGHT_RECORDER_TAG_SIZE
+#  define BACKTRACE_FLIGHT_RECORDER_TAG_SIZE 32
+#endif
+
+// Defaults used when recording starts without explicit open.
+#ifndef BACKTRACE_FLIGHT_RECORDER_EVENTS
+#  define BACKTRACE_FLIGHT_RECORDER_EVENTS 256
+#endif
+#ifndef BACKTRACE_FLIGHT_RECORDER_THREADS
+#  define BACKTRACE_FLIGHT_RECORDER_THREADS 64
+#endif
+
+namespace bt {
+namespace internal {
+
+struct FlightEvent {
+  // Wall clock time of the event.
+  uint64_t timestamp_ns;
+  string tag;
+  StackTraceAddresses stacktrace;
+
+  FlightEvent()
+  : timestamp_ns(0) {}
+};
+
+struct FlightThread {
+  long tid;
+  string name;
+  // True if thread exited, its ring is kept until it is reused.
+  bool exited;
+  // Oldest event first.
+  vector<FlightEvent> events;
+
+  FlightThread()
+  : tid(0),
+    exited(false) {}
+};
+
+struct FlightRecording {
+  int pid;
+  vector<Module> modules;
+  vector<FlightThread> threads;
+
+  FlightRecording()
+  : pid(0) {}
+};
+
+// Allocate rings of the recorder, either in memory if filename is NULL, or
+// in a file which is mapped into memory, so its contents survives a crash
+// of the process. Every thread gets its own ring on its first event, once
+// all of them are taken, threads which exited are reused. Returns false if
+// recorder is already open.
+bool flight_recorder_open(const char *filename,
+                          size_t events_per_thread,
+                          size_t max_threads);
+
+// Record an event with the stack of the caller into the calling thread's
+// ring, opening recorder in memory with default sizes if needed. Stack
+// starts at the caller of the function which owns the given frame, which
+// is this function itself if frame is NULL.
+//
+// Only frame pointers are followed, so code is to be compiled with
+// -fno-omit-frame-pointer for the stacks to be complete. Frame pointers
+// are validated against bounds of the thread's stack, so recording is
+// safe either way. Takes no locks after the thread's first event and is
+// async-signal-safe from then on.
+void flight_recorder_record(const char *tag, void *frame = NULL);
+
+// Store current module table in the recorder, so stacks from a file could
+// be symbolized after objects were loaded with dlopen(). Table is also
+// stored when recorder is opened and when a new thread starts recording.
+void flight_recorder_update_modules();
+
+// Copy events out of the recorder of this process.
+bool flight_recorder_snapshot(FlightRecording *recording);
+
+// Read events from a recorder file, possibly of a process which crashed.
+// Objects are looked up on disk by their build IDs, same as for minidumps.
+bool flight_recorder_read(const string& filename, FlightRecording *recording);
+
+// Symbolize and format up to last_events most recent events of every
+// thread, oldest first.
+string flight_recorder_format(const FlightRecording& recording,
+                              size_t last_events);
+
+}  // namespace internal
+}  // namespace bt
+
+#endif  // BACKTRACE_HAS_FLIGHT_RECORDER
+
+#endif  // __FLIGHT_RECORDER_H__
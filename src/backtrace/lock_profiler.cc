@@ -0,0 +1,255 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "backtrace/lock_profiler.h"
+
+#ifdef BACKTRACE_HAS_LOCK_PROFILER
+
+#include <cerrno>
+#include <cstdlib>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "backtrace/backtrace.h"
+
+// Frames of the profiler itself, which are not interesting. Interposed
+// lock function is kept as the innermost frame, so waits on mutexes and
+// rwlocks are told apart.
+#define PROFILER_FRAMES 2
+
+namespace bt {
+
+namespace {
+
+typedef int (*MutexFunction)(pthread_mutex_t *);
+typedef int (*RWLockFunction)(pthread_rwlock_t *);
+
+struct RealFunctions {
+  MutexFunction mutex_lock;
+  MutexFunction mutex_trylock;
+  RWLockFunction rwlock_rdlock;
+  RWLockFunction rwlock_tryrdlock;
+  RWLockFunction rwlock_wrlock;
+  RWLockFunction rwlock_trywrlock;
+};
+
+// Resolved by a constructor or by the first interposed call, whichever
+// comes first. dlsym() might allocate memory, and allocators take locks,
+// so interposed calls made meanwhile fall back to spinning on trylock.
+RealFunctions real;
+volatile bool real_resolved = false;
+volatile bool real_resolving = false;
+
+volatile bool profiler_enabled = false;
+volatile uint64_t profiler_threshold_ns = 0;
+volatile uint32_t profiler_sample_period = 0;
+volatile uint32_t num_contended = 0;
+
+// Protects the tree. Spin lock is used since mutexes are interposed.
+volatile int tree_lock = 0;
+CallingContextTree *tree = NULL;
+
+// Set while profiler does its own work, so locks taken by the unwinder or
+// memory allocator are not recorded recursively.
+__thread bool in_profiler = false;
+
+template<typename T>
+T real_function_get(const char *name) {
+  void *function = dlsym(RTLD_NEXT, name);
+  if (function == NULL) {
+    abort();
+  }
+  return reinterpret_cast<T>(function);
+}
+
+// Returns without resolving anything if the functions are being resolved
+// by this or another thread already.
+void real_functions_resolve() {
+  if (real_resolved ||
+      !__sync_bool_compare_and_swap(&real_resolving, false, true)) {
+    return;
+  }
+  in_profiler = true;
+  real.mutex_lock = real_function_get<MutexFunction>("pthread_mutex_lock");
+  real.mutex_trylock =
+      real_function_get<MutexFunction>("pthread_mutex_trylock");
+  real.rwlock_rdlock =
+      real_function_get<RWLockFunction>("pthread_rwlock_rdlock");
+  real.rwlock_tryrdlock =
+      real_function_get<RWLockFunction>("pthread_rwlock_tryrdlock");
+  real.rwlock_wrlock =
+      real_function_get<RWLockFunction>("pthread_rwlock_wrlock");
+  real.rwlock_trywrlock =
+      real_function_get<RWLockFunction>("pthread_rwlock_trywrlock");
+  __sync_synchronize();
+  real_resolved = true;
+  in_profiler = false;
+}
+
+__attribute__((constructor)) void real_functions_init() {
+  real_functions_resolve();
+}
+
+// Lock without the real lock function. Trylock functions are not
+// interposed, so they are safe to call before anything is resolved.
+template<typename T>
+int trylock_spin(T *lock, int (*trylock_function)(T *)) {
+  int result;
+  while ((result = trylock_function(lock)) == EBUSY) {
+    sched_yield();
+  }
+  return result;
+}
+
+void tree_lock_acquire() {
+  while (__sync_lock_test_and_set(&tree_lock, 1)) {
+    while (tree_lock) {
+    }
+  }
+}
+
+void tree_lock_release() {
+  __sync_lock_release(&tree_lock);
+}
+
+bool is_sampled(uint64_t wait_ns) {
+  uint32_t counter = __sync_add_and_fetch(&num_contended, 1);
+  if (wait_ns >= profiler_threshold_ns) {
+    return true;
+  }
+  uint32_t sample_period = profiler_sample_period;
+  return sample_period != 0 && counter % sample_period == 0;
+}
+
+__attribute__((noinline)) void record_wait(uint64_t wait_ns) {
+  in_profiler = true;
+  void *frames[BACKTRACE_MAX_DEPTH + PROFILER_FRAMES];
+  int depth = backtrace(frames, BACKTRACE_MAX_DEPTH + PROFILER_FRAMES);
+  // Skip this function and profiled_lock().
+  if (depth > PROFILER_FRAMES) {
+    tree_lock_acquire();
+    if (tree == NULL) {
+      tree = new CallingContextTree();
+    }
+    tree->add(frames + PROFILER_FRAMES, depth - PROFILER_FRAMES, wait_ns);
+    tree_lock_release();
+  }
+  in_profiler = false;
+}
+
+// Shared implementation of all the interposed lock functions.
+template<typename T>
+__attribute__((noinline)) int profiled_lock(T *lock,
+                  int (*lock_function)(T *),
+                  int (*trylock_function)(T *)) {
+  if (!profiler_enabled || in_profiler) {
+    return lock_function(lock);
+  }
+  // Uncontended acquisitions are not interesting. Anything but EBUSY means
+  // trylock either took the lock or failed on its own (robust or error
+  // checking mutexes), in both cases its result is final.
+  int trylock_result = trylock_function(lock);
+  if (trylock_result != EBUSY) {
+    return trylock_result;
+  }
+  uint64_t start_time = internal::time_monotonic_ns();
+  int result = lock_function(lock);
+  uint64_t wait_ns = internal::time_monotonic_ns() - start_time;
+  if (is_sampled(wait_ns)) {
+    record_wait(wait_ns);
+  }
+  return result;
+}
+
+}  // namespace
+
+void lock_profiler_start(uint64_t threshold_ns, uint32_t sample_period) {
+  real_functions_resolve();
+  profiler_threshold_ns = threshold_ns;
+  profiler_sample_period = sample_period;
+  __sync_synchronize();
+  profiler_enabled = true;
+}
+
+void lock_profiler_stop() {
+  profiler_enabled = false;
+}
+
+void lock_profiler_get(CallingContextTree *result) {
+  in_profiler = true;
+  tree_lock_acquire();
+  if (tree != NULL) {
+    result->merge(*tree);
+  }
+  tree_lock_release();
+  in_profiler = false;
+}
+
+void lock_profiler_reset() {
+  in_profiler = true;
+  tree_lock_acquire();
+  if (tree != NULL) {
+    tree->clear();
+  }
+  tree_lock_release();
+  in_profiler = false;
+}
+
+}  // namespace bt
+
+extern "C" int pthread_mutex_lock(pthread_mutex_t *mutex) {
+  if (!bt::real_resolved) {
+    bt::real_functions_resolve();
+    if (!bt::real_resolved) {
+      return bt::trylock_spin(mutex, pthread_mutex_trylock);
+    }
+  }
+  return bt::profiled_lock(mutex,
+                           bt::real.mutex_lock,
+                           bt::real.mutex_trylock);
+}
+
+extern "C" int pthread_rwlock_rdlock(pthread_rwlock_t *rwlock) {
+  if (!bt::real_resolved) {
+    bt::real_functions_resolve();
+    if (!bt::real_resolved) {
+      return bt::trylock_spin(rwlock, pthread_rwlock_tryrdlock);
+    }
+  }
+  return bt::profiled_lock(rwlock,
+                           bt::real.rwlock_rdlock,
+                           bt::real.rwlock_tryrdlock);
+}
+
+extern "C" int pthread_rwlock_wrlock(pthread_rwlock_t *rwlock) {
+  if (!bt::real_resolved) {
+    bt::real_functions_resolve();
+    if (!bt::real_resolved) {
+      return bt::trylock_spin(rwlock, pthread_rwlock_trywrlock);
+    }
+  }
+  return bt::profiled_lock(rwlock,
+                           bt::real.rwlock_wrlock,
+                           bt::real.rwlock_trywrlock);
+}
+
+#endif  // BACKTRACE_HAS_LOCK_PROFILER
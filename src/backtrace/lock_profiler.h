@@ -0,0 +1,66 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef __LOCK_PROFILER_H__
+#define __LOCK_PROFILER_H__
+
+#include <stdint.h>
+
+#include "backtrace/backtrace_util.h"
+#include "backtrace/calling_context_tree.h"
+
+#if defined(WITH_LOCK_PROFILER) && defined(BACKTRACE_HAS_EXECINFO) && \
+    defined(__GNUC__)
+#  define BACKTRACE_HAS_LOCK_PROFILER
+#endif
+
+#ifdef BACKTRACE_HAS_LOCK_PROFILER
+
+namespace bt {
+
+// Profiler of time spent waiting for pthread mutexes and rwlocks.
+//
+// When the library is built with lock profiler support, lock functions are
+// interposed. Uncontended acquisitions only cost a trylock. Contended ones
+// are timed, and if the wait exceeds the threshold or the acquisition is
+// picked by sampling, stack of the waiter is captured and the wait time is
+// accumulated in a calling-context tree, in nanoseconds.
+//
+// Profiler is disabled until started.
+
+// Start profiling. Waits longer than threshold are always recorded, and
+// every sample_period-th contended acquisition is recorded regardless of
+// its wait time, zero disables sampling.
+void lock_profiler_start(uint64_t threshold_ns, uint32_t sample_period);
+
+// Stop recording new waits, collected data is kept.
+void lock_profiler_stop();
+
+// Merge all the collected waits into the given tree.
+void lock_profiler_get(CallingContextTree *tree);
+
+// Forget all the collected waits.
+void lock_profiler_reset();
+
+}  // namespace bt
+
+#endif  // BACKTRACE_HAS_LOCK_PROFILER
+
+#endif  // __LOCK_PROFILER_H__
@@ -0,0 +1,768 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "backtrace/minidump.h"
+
+#ifdef BACKTRACE_HAS_MINIDUMP
+
+#include <algorithm>
+#include <climits>
+#include <elf.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <link.h>
+#include <signal.h>
+#include <sstream>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include "backtrace/symbolize.h"
+
+// "BTMD" in a little endian file.
+#define MINIDUMP_MAGIC 0x444d5442
+#define MINIDUMP_VERSION 2
+
+#if defined(__x86_64__)
+#  define MINIDUMP_MACHINE EM_X86_64
+#elif defined(__aarch64__)
+#  define MINIDUMP_MACHINE EM_AARCH64
+#endif
+
+#define BUILD_ID_MAX_SIZE 64
+#define NOTES_MAX_SIZE 1024
+
+namespace bt {
+namespace internal {
+
+namespace {
+
+// File is a sequence of records, each of them is prefixed with its type
+// and size of the payload. Unknown records are skipped by the reader.
+enum RecordType {
+  RECORD_HEADER = 1,
+  RECORD_MODULE = 2,
+  RECORD_THREAD = 3,
+  RECORD_END = 4,
+};
+
+struct RecordHeader {
+  uint32_t type;
+  uint32_t size;
+};
+
+struct HeaderRecord {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t machine;
+  uint32_t signal;
+  uint64_t pid;
+  uint64_t crashed_tid;
+};
+
+// Followed by path and build ID bytes.
+struct ModuleRecord {
+  uint64_t start;
+  uint64_t end;
+  uint64_t file_offset;
+  uint64_t load_bias;
+  uint32_t path_size;
+  uint32_t build_id_size;
+};
+
+enum ThreadFlags {
+  THREAD_CAPTURED = 1,
+};
+
+// Followed by stack bytes, which start at the stack pointer.
+struct ThreadRecord {
+  uint64_t tid;
+  // Indexed by DWARF register numbers.
+  uint64_t registers[DWARF_NUM_REGISTERS];
+  uint64_t known_registers;
+  uint32_t flags;
+  uint32_t stack_size;
+  char name[16];
+};
+
+// Slot filled in by the signal handler of every other thread.
+struct ThreadSlot {
+  volatile int done;
+  DwarfRegisters registers;
+  char name[17];
+};
+
+const int crash_signals[] = {SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT};
+#define NUM_CRASH_SIGNALS (sizeof(crash_signals) / sizeof(*crash_signals))
+
+// Everything used while writing the dump is allocated statically, heap
+// might be corrupted by the time of a crash.
+char dump_filename[PATH_MAX];
+struct sigaction previous_actions[NUM_CRASH_SIGNALS];
+size_t page_size = 0;
+volatile int writer_active = 0;
+// Set once a crash was dumped, dumps of later crashes would overwrite it.
+volatile int crash_dumped = 0;
+uint32_t dump_generation = 0;
+// Generation of the dump in progress, handlers of other threads wait until
+// it is released.
+volatile uint32_t active_generation = 0;
+volatile uint32_t released_generation = 0;
+long thread_tids[BACKTRACE_MINIDUMP_MAX_THREADS];
+ThreadSlot thread_slots[BACKTRACE_MINIDUMP_MAX_THREADS];
+size_t num_threads = 0;
+char stack_buffer[BACKTRACE_MINIDUMP_STACK_SIZE];
+struct iovec stack_iovecs[BACKTRACE_MINIDUMP_STACK_SIZE / 4096 + 2];
+char io_buffer[4096];
+char line_buffer[PATH_MAX + 256];
+
+bool module_less(const Module& a, const Module& b) {
+  return a.start < b.start;
+}
+
+int stop_signal_get() {
+  return SIGRTMIN + BACKTRACE_MINIDUMP_SIGNAL;
+}
+
+uint64_t time_ms() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void sleep_ms(int ms) {
+  struct timespec ts = {0, ms * 1000000};
+  nanosleep(&ts, NULL);
+}
+
+bool write_all(int fd, const void *data, size_t size) {
+  const char *p = reinterpret_cast<const char *>(data);
+  while (size > 0) {
+    ssize_t written = write(fd, p, size);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    p += written;
+    size -= (size_t)written;
+  }
+  return true;
+}
+
+bool record_write(int fd, uint32_t type, uint32_t size) {
+  RecordHeader header;
+  header.type = type;
+  header.size = size;
+  return write_all(fd, &header, sizeof(header));
+}
+
+// Copy memory of the own process, without crashing on unmapped pages.
+// Ranges are split by pages, so copy stops at the first unmapped one.
+size_t memory_copy(uintptr_t address, size_t size, void *buffer) {
+  size_t num_iovecs = 0;
+  uintptr_t end = address + size;
+  while (address < end &&
+         num_iovecs < sizeof(stack_iovecs) / sizeof(*stack_iovecs)) {
+    uintptr_t page_end = (address + page_size) & ~(uintptr_t)(page_size - 1);
+    stack_iovecs[num_iovecs].iov_base = reinterpret_cast<void *>(address);
+    stack_iovecs[num_iovecs].iov_len = (page_end < end ? page_end : end) -
+                                       address;
+    address += stack_iovecs[num_iovecs].iov_len;
+    ++num_iovecs;
+  }
+  struct iovec local;
+  local.iov_base = buffer;
+  local.iov_len = size;
+  ssize_t copied = process_vm_readv(getpid(), &local, 1,
+                                    stack_iovecs, num_iovecs, 0);
+  return copied > 0 ? (size_t)copied : 0;
+}
+
+// All the general purpose registers are stored, call frame information
+// might refer to any of them.
+void registers_from_ucontext(void *ucontext_v, ThreadSlot *slot) {
+  ucontext_t *ucontext = reinterpret_cast<ucontext_t *>(ucontext_v);
+  DwarfRegisters& registers = slot->registers;
+#if defined(__x86_64__)
+  // In the order of DWARF register numbers.
+  static const int gregs[DWARF_NUM_REGISTERS] = {
+    REG_RAX, REG_RDX, REG_RCX, REG_RBX,
+    REG_RSI, REG_RDI, REG_RBP, REG_RSP,
+    REG_R8, REG_R9, REG_R10, REG_R11,
+    REG_R12, REG_R13, REG_R14, REG_R15,
+    REG_RIP,
+  };
+  for (int i = 0; i < DWARF_NUM_REGISTERS; ++i) {
+    registers.set(i, (uint64_t)ucontext->uc_mcontext.gregs[gregs[i]]);
+  }
+#elif defined(__aarch64__)
+  for (int i = 0; i < 31; ++i) {
+    registers.set(i, ucontext->uc_mcontext.regs[i]);
+  }
+  registers.set(DWARF_REGISTER_SP, ucontext->uc_mcontext.sp);
+  registers.set(DWARF_REGISTER_PC, ucontext->uc_mcontext.pc);
+#endif
+}
+
+void stop_signal_handler(int /*signum*/, siginfo_t *info, void *ucontext) {
+  int saved_errno = errno;
+  uint64_t value = (uint64_t)(uintptr_t)info->si_value.sival_ptr;
+  uint32_t generation = (uint32_t)(value >> 32);
+  uint32_t index = (uint32_t)value;
+  if (info->si_code == SI_QUEUE && info->si_pid == getpid() &&
+      generation == active_generation && index < num_threads) {
+    ThreadSlot& slot = thread_slots[index];
+    registers_from_ucontext(ucontext, &slot);
+    prctl(PR_GET_NAME, slot.name, 0, 0, 0);
+    __sync_synchronize();
+    slot.done = 1;
+    // Keep the stack intact until it is written.
+    uint64_t deadline = time_ms() + 2 * BACKTRACE_MINIDUMP_TIMEOUT_MS;
+    while (released_generation != generation && time_ms() < deadline) {
+      sleep_ms(1);
+    }
+  }
+  errno = saved_errno;
+}
+
+// Minimal getdents64() entry, glibc does not expose it.
+struct LinuxDirent64 {
+  uint64_t d_ino;
+  int64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[1];
+};
+
+void threads_enumerate() {
+  num_threads = 0;
+  int fd = open("/proc/self/task", O_RDONLY | O_DIRECTORY);
+  if (fd == -1) {
+    return;
+  }
+  for (;;) {
+    long size = syscall(SYS_getdents64, fd, io_buffer, sizeof(io_buffer));
+    if (size <= 0) {
+      break;
+    }
+    for (long offset = 0; offset < size;) {
+      const LinuxDirent64 *entry =
+          reinterpret_cast<const LinuxDirent64 *>(io_buffer + offset);
+      offset += entry->d_reclen;
+      if (entry->d_name[0] < '0' || entry->d_name[0] > '9' ||
+          num_threads == BACKTRACE_MINIDUMP_MAX_THREADS) {
+        continue;
+      }
+      long tid = 0;
+      for (const char *p = entry->d_name; *p >= '0' && *p <= '9'; ++p) {
+        tid = tid * 10 + (*p - '0');
+      }
+      thread_tids[num_threads++] = tid;
+    }
+  }
+  close(fd);
+}
+
+// Fill in load bias and build ID of an object from its headers, which
+// are mapped at the base address.
+bool object_info_read(uintptr_t base,
+                      uint64_t *load_bias,
+                      char *build_id,
+                      uint32_t *build_id_size) {
+  ElfW(Ehdr) ehdr;
+  if (memory_copy(base, sizeof(ehdr), &ehdr) != sizeof(ehdr) ||
+      memcmp(ehdr.e_ident, ELFMAG, SELFMAG) != 0 ||
+      ehdr.e_phentsize != sizeof(ElfW(Phdr))) {
+    return false;
+  }
+  ElfW(Phdr) phdrs[64];
+  size_t num_phdrs = ehdr.e_phnum < 64 ? ehdr.e_phnum : 64;
+  size_t phdrs_size = num_phdrs * sizeof(ElfW(Phdr));
+  if (memory_copy(base + ehdr.e_phoff, phdrs_size, phdrs) != phdrs_size) {
+    return false;
+  }
+  bool has_load = false;
+  uint64_t load_address = 0;
+  for (size_t i = 0; i < num_phdrs; ++i) {
+    if (phdrs[i].p_type == PT_LOAD &&
+        (!has_load || phdrs[i].p_vaddr < load_address)) {
+      load_address = phdrs[i].p_vaddr & ~(uint64_t)(page_size - 1);
+      has_load = true;
+    }
+  }
+  if (!has_load) {
+    return false;
+  }
+  *load_bias = base - load_address;
+  *build_id_size = 0;
+  for (size_t i = 0; i < num_phdrs && *build_id_size == 0; ++i) {
+    if (phdrs[i].p_type != PT_NOTE) {
+      continue;
+    }
+    char notes[NOTES_MAX_SIZE];
+    size_t size = phdrs[i].p_memsz < sizeof(notes) ? phdrs[i].p_memsz
+                                                   : sizeof(notes);
+    size = memory_copy(*load_bias + phdrs[i].p_vaddr, size, notes);
+    size_t offset = 0;
+    while (offset + sizeof(ElfW(Nhdr)) <= size) {
+      ElfW(Nhdr) note;
+      memcpy(&note, notes + offset, sizeof(note));
+      size_t desc_offset = offset + sizeof(note) +
+                           ((note.n_namesz + 3) & ~3U);
+      size_t next_offset = desc_offset + ((note.n_descsz + 3) & ~3U);
+      if (next_offset > size) {
+        break;
+      }
+      if (note.n_type == NT_GNU_BUILD_ID &&
+          note.n_descsz <= BUILD_ID_MAX_SIZE) {
+        memcpy(build_id, notes + desc_offset, note.n_descsz);
+        *build_id_size = note.n_descsz;
+        break;
+      }
+      offset = next_offset;
+    }
+  }
+  return true;
+}
+
+uint64_t parse_hex(const char **p) {
+  uint64_t value = 0;
+  for (;; ++*p) {
+    char c = **p;
+    if (c >= '0' && c <= '9') {
+      value = value * 16 + (c - '0');
+    } else if (c >= 'a' && c <= 'f') {
+      value = value * 16 + (c - 'a' + 10);
+    } else {
+      return value;
+    }
+  }
+}
+
+void skip_field(const char **p) {
+  while (**p != ' ' && **p != '\0') ++*p;
+  while (**p == ' ') ++*p;
+}
+
+// Handle a single line of /proc/self/maps, executable mappings of files
+// are written as modules.
+void maps_line_process(int fd,
+                       const char *line,
+                       char *base_path,
+                       uintptr_t *base_start) {
+  const char *p = line;
+  uint64_t start = parse_hex(&p);
+  ++p;
+  uint64_t end = parse_hex(&p);
+  ++p;
+  bool executable = p[2] == 'x';
+  skip_field(&p);
+  uint64_t offset = parse_hex(&p);
+  skip_field(&p);
+  skip_field(&p);
+  skip_field(&p);
+  if (*p != '/') {
+    return;
+  }
+  size_t path_size = strlen(p);
+  if (offset == 0) {
+    memcpy(base_path, p, path_size + 1);
+    *base_start = start;
+  }
+  if (!executable) {
+    return;
+  }
+  ModuleRecord module;
+  module.start = start;
+  module.end = end;
+  module.file_offset = offset;
+  module.path_size = (uint32_t)path_size;
+  module.build_id_size = 0;
+  char build_id[BUILD_ID_MAX_SIZE];
+  if (strcmp(base_path, p) != 0 ||
+      !object_info_read(*base_start,
+                        &module.load_bias,
+                        build_id,
+                        &module.build_id_size)) {
+    // Best guess, assuming segments are mapped at their offsets.
+    module.load_bias = start - offset;
+  }
+  record_write(fd, RECORD_MODULE,
+               sizeof(module) + module.path_size + module.build_id_size);
+  write_all(fd, &module, sizeof(module));
+  write_all(fd, p, module.path_size);
+  write_all(fd, build_id, module.build_id_size);
+}
+
+void modules_write(int fd) {
+  int maps_fd = open("/proc/self/maps", O_RDONLY);
+  if (maps_fd == -1) {
+    return;
+  }
+  static char base_path[PATH_MAX + 256];
+  base_path[0] = '\0';
+  uintptr_t base_start = 0;
+  size_t line_size = 0;
+  for (;;) {
+    ssize_t size = read(maps_fd, io_buffer, sizeof(io_buffer));
+    if (size < 0 && errno == EINTR) {
+      continue;
+    }
+    if (size <= 0) {
+      break;
+    }
+    for (ssize_t i = 0; i < size; ++i) {
+      if (io_buffer[i] != '\n') {
+        if (line_size < sizeof(line_buffer) - 1) {
+          line_buffer[line_size++] = io_buffer[i];
+        }
+        continue;
+      }
+      line_buffer[line_size] = '\0';
+      maps_line_process(fd, line_buffer, base_path, &base_start);
+      line_size = 0;
+    }
+  }
+  close(maps_fd);
+}
+
+void thread_write(int fd, long tid, const ThreadSlot& slot) {
+  ThreadRecord thread;
+  memset(&thread, 0, sizeof(thread));
+  thread.tid = tid;
+  memcpy(thread.name, slot.name, sizeof(thread.name));
+  if (slot.done) {
+    thread.flags = THREAD_CAPTURED;
+    memcpy(thread.registers,
+           slot.registers.values,
+           sizeof(thread.registers));
+    thread.known_registers = slot.registers.known;
+    thread.stack_size = (uint32_t)memory_copy(slot.registers.sp(),
+                                              sizeof(stack_buffer),
+                                              stack_buffer);
+  }
+  record_write(fd, RECORD_THREAD, sizeof(thread) + thread.stack_size);
+  write_all(fd, &thread, sizeof(thread));
+  write_all(fd, stack_buffer, thread.stack_size);
+}
+
+bool dump_write(int fd, int signum, void *ucontext);
+
+void crash_signal_handler(int signum, siginfo_t * /*info*/, void *ucontext) {
+  // Writer is taken before the file is opened, so a thread which crashes
+  // meanwhile does not truncate the dump which is being written. Such a
+  // thread waits for the dump to be finished rather than terminating the
+  // process, it gets stopped and dumped like any other thread meanwhile.
+  uint64_t deadline = time_ms() + 2 * BACKTRACE_MINIDUMP_TIMEOUT_MS;
+  bool is_writer = false;
+  while (!(is_writer = (__sync_lock_test_and_set(&writer_active, 1) == 0)) &&
+         time_ms() < deadline) {
+    sleep_ms(1);
+  }
+  if (is_writer) {
+    if (!crash_dumped) {
+      int fd = open(dump_filename, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+      if (fd != -1) {
+        dump_write(fd, signum, ucontext);
+        close(fd);
+      }
+      crash_dumped = 1;
+    }
+    __sync_lock_release(&writer_active);
+  }
+  // Let the previous handler or the default action deal with the signal,
+  // it is delivered once this handler returns.
+  for (size_t i = 0; i < NUM_CRASH_SIGNALS; ++i) {
+    if (crash_signals[i] == signum) {
+      sigaction(signum, &previous_actions[i], NULL);
+    }
+  }
+  raise(signum);
+}
+
+}  // namespace
+
+bool minidump_install(const char *filename) {
+  if (strlen(filename) >= sizeof(dump_filename)) {
+    return false;
+  }
+  strcpy(dump_filename, filename);
+  page_size = (size_t)sysconf(_SC_PAGESIZE);
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_sigaction = stop_signal_handler;
+  action.sa_flags = SA_SIGINFO | SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  if (sigaction(stop_signal_get(), &action, NULL) != 0) {
+    return false;
+  }
+  // Stack overflow of the calling thread is only handled with an
+  // alternate signal stack.
+  stack_t current_stack;
+  if (sigaltstack(NULL, &current_stack) == 0 &&
+      (current_stack.ss_flags & SS_DISABLE)) {
+    stack_t stack;
+    stack.ss_size = 64 * 1024;
+    stack.ss_sp = malloc(stack.ss_size);
+    stack.ss_flags = 0;
+    if (stack.ss_sp != NULL) {
+      sigaltstack(&stack, NULL);
+    }
+  }
+  action.sa_sigaction = crash_signal_handler;
+  action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+  for (size_t i = 0; i < NUM_CRASH_SIGNALS; ++i) {
+    if (sigaction(crash_signals[i], &action, &previous_actions[i]) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+namespace {
+
+// Writer is to be taken by the caller.
+bool dump_write(int fd, int signum, void *ucontext) {
+  if (page_size == 0) {
+    page_size = (size_t)sysconf(_SC_PAGESIZE);
+  }
+  long self_tid = syscall(SYS_gettid);
+  HeaderRecord header;
+  header.magic = MINIDUMP_MAGIC;
+  header.version = MINIDUMP_VERSION;
+  header.machine = MINIDUMP_MACHINE;
+  header.signal = (uint32_t)signum;
+  header.pid = (uint64_t)getpid();
+  header.crashed_tid = (uint64_t)self_tid;
+  bool result = record_write(fd, RECORD_HEADER, sizeof(header)) &&
+                write_all(fd, &header, sizeof(header));
+  if (result) {
+    modules_write(fd);
+  }
+  // Registers of the calling thread.
+  ThreadSlot self_slot = ThreadSlot();
+  if (ucontext != NULL) {
+    registers_from_ucontext(ucontext, &self_slot);
+  } else {
+    // Dump starts from this function, which is unwound just like any
+    // other frame.
+    ucontext_t context;
+    getcontext(&context);
+    registers_from_ucontext(&context, &self_slot);
+  }
+  prctl(PR_GET_NAME, self_slot.name, 0, 0, 0);
+  self_slot.done = 1;
+  // Stop all other threads in their signal handlers.
+  uint32_t generation = ++dump_generation;
+  threads_enumerate();
+  for (size_t i = 0; i < num_threads; ++i) {
+    thread_slots[i] = ThreadSlot();
+  }
+  __sync_synchronize();
+  active_generation = generation;
+  pid_t pid = getpid();
+  size_t num_signalled = 0;
+  for (size_t i = 0; i < num_threads && result; ++i) {
+    if (thread_tids[i] == self_tid) {
+      continue;
+    }
+    siginfo_t info;
+    memset(&info, 0, sizeof(info));
+    info.si_signo = stop_signal_get();
+    info.si_code = SI_QUEUE;
+    info.si_pid = pid;
+    info.si_uid = getuid();
+    info.si_value.sival_ptr = (void *)(uintptr_t)(
+        ((uint64_t)generation << 32) | i);
+    if (syscall(SYS_rt_tgsigqueueinfo,
+                pid, thread_tids[i], info.si_signo, &info) == 0) {
+      ++num_signalled;
+    }
+  }
+  uint64_t deadline = time_ms() + BACKTRACE_MINIDUMP_TIMEOUT_MS;
+  for (;;) {
+    size_t num_done = 0;
+    for (size_t i = 0; i < num_threads; ++i) {
+      num_done += thread_slots[i].done;
+    }
+    if (num_done >= num_signalled || time_ms() >= deadline) {
+      break;
+    }
+    sleep_ms(1);
+  }
+  if (result) {
+    thread_write(fd, self_tid, self_slot);
+    for (size_t i = 0; i < num_threads; ++i) {
+      if (thread_tids[i] != self_tid) {
+        thread_write(fd, thread_tids[i], thread_slots[i]);
+      }
+    }
+    result = record_write(fd, RECORD_END, 0);
+  }
+  active_generation = 0;
+  released_generation = generation;
+  return result;
+}
+
+}  // namespace
+
+bool minidump_write(int fd, int signum, void *ucontext) {
+  // Only one thread writes a dump at a time.
+  if (__sync_lock_test_and_set(&writer_active, 1) != 0) {
+    return false;
+  }
+  bool result = dump_write(fd, signum, ucontext);
+  __sync_lock_release(&writer_active);
+  return result;
+}
+
+bool minidump_read(const string& filename, Minidump *dump) {
+  FILE *file = fopen(filename.c_str(), "rb");
+  if (file == NULL) {
+    return false;
+  }
+  string data;
+  char buffer[65536];
+  size_t size;
+  while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    data.append(buffer, size);
+  }
+  fclose(file);
+  *dump = Minidump();
+  bool has_header = false, has_end = false;
+  size_t offset = 0;
+  while (offset + sizeof(RecordHeader) <= data.size() && !has_end) {
+    RecordHeader record;
+    memcpy(&record, &data[offset], sizeof(record));
+    offset += sizeof(record);
+    if (record.size > data.size() - offset) {
+      break;
+    }
+    const char *payload = &data[offset];
+    offset += record.size;
+    if (record.type == RECORD_HEADER && record.size >= sizeof(HeaderRecord)) {
+      HeaderRecord header;
+      memcpy(&header, payload, sizeof(header));
+      if (header.magic != MINIDUMP_MAGIC ||
+          header.version != MINIDUMP_VERSION ||
+          header.machine != MINIDUMP_MACHINE) {
+        return false;
+      }
+      dump->pid = (int)header.pid;
+      dump->signal = (int)header.signal;
+      dump->crashed_tid = (long)header.crashed_tid;
+      has_header = true;
+    } else if (!has_header) {
+      return false;
+    } else if (record.type == RECORD_MODULE &&
+               record.size >= sizeof(ModuleRecord)) {
+      ModuleRecord record_module;
+      memcpy(&record_module, payload, sizeof(record_module));
+      if (sizeof(record_module) + (uint64_t)record_module.path_size +
+              record_module.build_id_size > record.size) {
+        continue;
+      }
+      Module module;
+      module.start = record_module.start;
+      module.end = record_module.end;
+      module.file_offset = record_module.file_offset;
+      module.load_bias = record_module.load_bias;
+      module.path.assign(payload + sizeof(record_module),
+                         record_module.path_size);
+      module.build_id.assign(
+          payload + sizeof(record_module) + record_module.path_size,
+          record_module.build_id_size);
+      dump->modules.push_back(module);
+    } else if (record.type == RECORD_THREAD &&
+               record.size >= sizeof(ThreadRecord)) {
+      ThreadRecord record_thread;
+      memcpy(&record_thread, payload, sizeof(record_thread));
+      if (sizeof(record_thread) + (uint64_t)record_thread.stack_size >
+              record.size) {
+        continue;
+      }
+      MinidumpThread thread;
+      thread.tid = (long)record_thread.tid;
+      thread.name.assign(record_thread.name,
+                         strnlen(record_thread.name,
+                                 sizeof(record_thread.name)));
+      thread.captured = (record_thread.flags & THREAD_CAPTURED) != 0;
+      for (int i = 0; i < DWARF_NUM_REGISTERS; ++i) {
+        if (record_thread.known_registers & ((uint64_t)1 << i)) {
+          thread.registers.set(i, record_thread.registers[i]);
+        }
+      }
+      thread.stack.start = (uintptr_t)thread.registers.sp();
+      thread.stack.data.assign(payload + sizeof(record_thread),
+                               payload + sizeof(record_thread) +
+                                   record_thread.stack_size);
+      dump->threads.push_back(thread);
+    } else if (record.type == RECORD_END) {
+      has_end = true;
+    }
+  }
+  if (!has_header) {
+    return false;
+  }
+  std::sort(dump->modules.begin(), dump->modules.end(), module_less);
+  module_table_locate_objects(&dump->modules);
+  return true;
+}
+
+string minidump_format(const Minidump& dump) {
+  Symbolize *symbolize = symbolize_create_elf_modules(dump.modules);
+  RemoteUnwinder unwinder(dump.modules);
+  std::stringstream ss;
+  StackTraceAddresses stacktrace;
+  for (size_t i = 0; i < dump.threads.size(); ++i) {
+    const MinidumpThread& thread = dump.threads[i];
+    ss << "Thread " << thread.tid;
+    if (!thread.name.empty()) {
+      ss << " (" << thread.name << ")";
+    }
+    if (thread.tid == dump.crashed_tid && dump.signal != 0) {
+      ss << " received signal " << dump.signal;
+    }
+    if (!thread.captured) {
+      ss << ":\n        (did not respond)\n";
+      continue;
+    }
+    ss << ":\n";
+    unwinder.unwind(thread.registers, thread.stack, &stacktrace);
+    symbolize->resolve(stacktrace);
+    ss << symbolize_format(*symbolize);
+  }
+  delete symbolize;
+  return ss.str();
+}
+
+}  // namespace internal
+}  // namespace bt
+
+#endif  // BACKTRACE_HAS_MINIDUMP
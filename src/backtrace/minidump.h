@@ -0,0 +1,118 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef __MINIDUMP_H__
+#define __MINIDUMP_H__
+
+#include "backtrace/backtrace_util.h"
+#include "backtrace/module_table.h"
+#include "backtrace/remote_backtrace.h"
+
+#ifdef BACKTRACE_HAS_REMOTE_BACKTRACE
+#  define BACKTRACE_HAS_MINIDUMP
+#endif
+
+#ifdef BACKTRACE_HAS_MINIDUMP
+
+// Number of bytes of every thread's stack stored in the dump, starting
+// from its stack pointer.
+#ifndef BACKTRACE_MINIDUMP_STACK_SIZE
+#  define BACKTRACE_MINIDUMP_STACK_SIZE (64 * 1024)
+#endif
+
+// Maximum number of threads stored in the dump.
+#ifndef BACKTRACE_MINIDUMP_MAX_THREADS
+#  define BACKTRACE_MINIDUMP_MAX_THREADS 1024
+#endif
+
+// Real-time signal used to collect registers of other threads, relative
+// to SIGRTMIN.
+#ifndef BACKTRACE_MINIDUMP_SIGNAL
+#  define BACKTRACE_MINIDUMP_SIGNAL 5
+#endif
+
+// Time to wait for other threads to report their registers.
+#ifndef BACKTRACE_MINIDUMP_TIMEOUT_MS
+#  define BACKTRACE_MINIDUMP_TIMEOUT_MS 1000
+#endif
+
+namespace bt {
+namespace internal {
+
+// Thread stored in a minidump.
+struct MinidumpThread {
+  long tid;
+  string name;
+  // False if thread did not report its registers in time.
+  bool captured;
+  DwarfRegisters registers;
+  RemoteStack stack;
+
+  MinidumpThread()
+  : tid(0),
+    captured(false) {}
+};
+
+// Contents of a minidump, as read back from a file.
+struct Minidump {
+  int pid;
+  int signal;
+  long crashed_tid;
+  vector<Module> modules;
+  vector<MinidumpThread> threads;
+
+  Minidump()
+  : pid(0),
+    signal(0),
+    crashed_tid(0) {}
+};
+
+// Install handlers of fatal signals which write a minidump to the given
+// file and then pass the signal on to the previously installed handler.
+bool minidump_install(const char *filename);
+
+// Write a minidump of the process to the file descriptor. Only
+// async-signal-safe calls are used, so it is to be called from a signal
+// handler, ucontext is the one passed to the handler. If ucontext is NULL
+// calling thread is dumped from the caller of this function.
+//
+// Dump contains registers and top of the stack of every thread, and
+// executable mappings with their build IDs, which is enough to unwind and
+// symbolize the stacks later on. Other threads are stopped in a signal
+// handler until dump is written.
+bool minidump_write(int fd, int signum, void *ucontext);
+
+// Read minidump from a file.
+//
+// Objects are looked up on disk by their paths, and objects with a
+// different build ID are replaced with separate debug files from
+// /usr/lib/debug/.build-id if available, otherwise they are not symbolized.
+bool minidump_read(const string& filename, Minidump *dump);
+
+// Unwind and symbolize all threads of the dump and format them as a
+// human-readable text.
+string minidump_format(const Minidump& dump);
+
+}  // namespace internal
+}  // namespace bt
+
+#endif  // BACKTRACE_HAS_MINIDUMP
+
+#endif  // __MINIDUMP_H__
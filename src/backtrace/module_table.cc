@@ -0,0 +1,311 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "backtrace/module_table.h"
+
+#include <algorithm>
+
+#ifdef BACKTRACE_HAS_ELF
+#  include <climits>
+#  include <cstddef>
+#  include <cstdio>
+#  include <cstdlib>
+#  include <cstring>
+#  include <elf.h>
+#  include <link.h>
+
+#  include "backtrace/elf_file.h"
+#endif
+
+namespace bt {
+namespace internal {
+
+namespace {
+
+bool module_less(const Module& a, const Module& b) {
+  return a.start < b.start;
+}
+
+#ifdef BACKTRACE_HAS_ELF
+
+size_t note_align(size_t size) {
+  return (size + 3) & ~(size_t)3;
+}
+
+// Look for the GNU build ID among the notes of a loaded segment.
+string build_id_from_notes(const char *data, size_t size) {
+  size_t offset = 0;
+  while (offset + sizeof(ElfW(Nhdr)) <= size) {
+    const ElfW(Nhdr) *note =
+        reinterpret_cast<const ElfW(Nhdr) *>(data + offset);
+    size_t name_offset = offset + sizeof(ElfW(Nhdr));
+    size_t desc_offset = name_offset + note_align(note->n_namesz);
+    size_t next_offset = desc_offset + note_align(note->n_descsz);
+    if (next_offset > size) {
+      break;
+    }
+    if (note->n_type == NT_GNU_BUILD_ID &&
+        note->n_namesz == 4 &&
+        memcmp(data + name_offset, "GNU", 4) == 0) {
+      return string(data + desc_offset, note->n_descsz);
+    }
+    offset = next_offset;
+  }
+  return "";
+}
+
+int collect_module_cb(struct dl_phdr_info *info,
+                      size_t /*size*/,
+                      void *modules_v) {
+  vector<Module> *modules = reinterpret_cast<vector<Module> *>(modules_v);
+  string path;
+  if (info->dlpi_name == NULL || info->dlpi_name[0] == '\0') {
+    // Main executable has no name in the list of loaded objects.
+    char real_path[PATH_MAX];
+    if (realpath("/proc/self/exe", real_path) != NULL) {
+      path = real_path;
+    }
+  } else {
+    path = info->dlpi_name;
+  }
+  string build_id;
+  for (int i = 0; i < info->dlpi_phnum; ++i) {
+    const ElfW(Phdr)& phdr = info->dlpi_phdr[i];
+    if (phdr.p_type == PT_NOTE && build_id.empty()) {
+      build_id = build_id_from_notes(
+          reinterpret_cast<const char *>(info->dlpi_addr + phdr.p_vaddr),
+          phdr.p_memsz);
+    }
+  }
+  for (int i = 0; i < info->dlpi_phnum; ++i) {
+    const ElfW(Phdr)& phdr = info->dlpi_phdr[i];
+    if (phdr.p_type != PT_LOAD || (phdr.p_flags & PF_X) == 0) {
+      continue;
+    }
+    Module module;
+    module.path = path;
+    module.start = info->dlpi_addr + phdr.p_vaddr;
+    module.end = module.start + phdr.p_memsz;
+    module.file_offset = phdr.p_offset;
+    module.load_bias = info->dlpi_addr;
+    module.build_id = build_id;
+    modules->push_back(module);
+  }
+  return 0;
+}
+
+#ifdef __GLIBC__
+// Get numbers of objects loaded and unloaded since the process started.
+int load_counters_cb(struct dl_phdr_info *info,
+                     size_t size,
+                     void *counters_v) {
+  uint64_t *counters = reinterpret_cast<uint64_t *>(counters_v);
+  // Counters were only added later to the structure.
+  if (size >= offsetof(struct dl_phdr_info, dlpi_subs) +
+              sizeof(info->dlpi_subs)) {
+    counters[0] = info->dlpi_adds;
+    counters[1] = info->dlpi_subs;
+  }
+  // Counters are the same for all the objects, so stop after the first one.
+  return 1;
+}
+#endif
+
+// Read build ID of an object which is not loaded into this process.
+string build_id_from_file(const ElfFile& elf) {
+  const ElfSection *section = elf.section_by_name(".note.gnu.build-id");
+  if (section == NULL || elf.compression(*section) !=
+                             ElfFile::COMPRESSION_NONE) {
+    return "";
+  }
+  return build_id_from_notes(
+      reinterpret_cast<const char *>(elf.raw_data(*section)),
+      elf.raw_size(*section));
+}
+
+#endif  // BACKTRACE_HAS_ELF
+
+}  // namespace
+
+bool module_table_load(vector<Module> *modules) {
+  modules->clear();
+#ifdef BACKTRACE_HAS_ELF
+  dl_iterate_phdr(collect_module_cb, modules);
+  std::sort(modules->begin(), modules->end(), module_less);
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool module_table_load(int pid, vector<Module> *modules) {
+  modules->clear();
+#ifdef BACKTRACE_HAS_ELF
+  char maps_path[64];
+  snprintf(maps_path, sizeof(maps_path), "/proc/%d/maps", pid);
+  FILE *maps = fopen(maps_path, "r");
+  if (maps == NULL) {
+    return false;
+  }
+  // Start address of the mapping at offset zero, per object.
+  map<string, uintptr_t> bases;
+  char line[PATH_MAX + 128];
+  while (fgets(line, sizeof(line), maps) != NULL) {
+    unsigned long start, end, offset;
+    char permissions[8];
+    int path_offset = 0;
+    if (sscanf(line, "%lx-%lx %7s %lx %*s %*s %n",
+               &start, &end, permissions, &offset, &path_offset) < 4 ||
+        path_offset == 0 || line[path_offset] != '/') {
+      // Anonymous mappings, stacks and such.
+      continue;
+    }
+    string path = line + path_offset;
+    if (!path.empty() && path[path.size() - 1] == '\n') {
+      path.resize(path.size() - 1);
+    }
+    if (offset == 0 && bases.find(path) == bases.end()) {
+      bases[path] = start;
+    }
+    if (permissions[2] != 'x') {
+      continue;
+    }
+    Module module;
+    module.path = path;
+    module.start = start;
+    module.end = end;
+    module.file_offset = offset;
+    modules->push_back(module);
+  }
+  fclose(maps);
+  // Open every object once to find its link-time address.
+  map<string, std::pair<uintptr_t, string> > objects;
+  for (size_t i = 0; i < modules->size(); ++i) {
+    Module& module = (*modules)[i];
+    if (objects.find(module.path) == objects.end()) {
+      std::pair<uintptr_t, string>& object = objects[module.path];
+      ElfFile elf(module.path);
+      map<string, uintptr_t>::const_iterator base = bases.find(module.path);
+      if (elf.is_open() && base != bases.end()) {
+        object.first = base->second - elf.load_address();
+        object.second = build_id_from_file(elf);
+      } else {
+        // Best guess, assuming segments are mapped at their offsets.
+        object.first = module.start - module.file_offset;
+      }
+    }
+    module.load_bias = objects[module.path].first;
+    module.build_id = objects[module.path].second;
+  }
+  std::sort(modules->begin(), modules->end(), module_less);
+  return true;
+#else
+  (void) pid;  // Ignored.
+  return false;
+#endif
+}
+
+uint64_t module_table_generation() {
+  uint64_t counters[2] = {0, 0};
+#if defined(BACKTRACE_HAS_ELF) && defined(__GLIBC__)
+  dl_iterate_phdr(load_counters_cb, counters);
+#endif
+  return counters[0] + counters[1];
+}
+
+uint64_t module_table_unloads() {
+  uint64_t counters[2] = {0, 0};
+#if defined(BACKTRACE_HAS_ELF) && defined(__GLIBC__)
+  dl_iterate_phdr(load_counters_cb, counters);
+#endif
+  return counters[1];
+}
+
+const Module *module_table_find(const vector<Module>& modules,
+                                uintptr_t address) {
+  Module key;
+  key.start = address;
+  // First module which starts after the address, candidate is the one
+  // before it.
+  vector<Module>::const_iterator it = std::upper_bound(modules.begin(),
+                                                       modules.end(),
+                                                       key,
+                                                       module_less);
+  if (it == modules.begin()) {
+    return NULL;
+  }
+  --it;
+  if (address >= it->end) {
+    return NULL;
+  }
+  return &*it;
+}
+
+string build_id_read(const string& path) {
+#ifdef BACKTRACE_HAS_ELF
+  ElfFile elf(path);
+  if (elf.is_open()) {
+    return build_id_from_file(elf);
+  }
+#else
+  (void) path;  // Ignored.
+#endif
+  return "";
+}
+
+void module_table_locate_objects(vector<Module> *modules) {
+  // Make sure symbols are only taken from the very same objects.
+  map<string, string> object_paths;
+  for (size_t i = 0; i < modules->size(); ++i) {
+    Module& module = (*modules)[i];
+    if (module.build_id.empty()) {
+      continue;
+    }
+    map<string, string>::iterator it = object_paths.find(module.path);
+    if (it == object_paths.end()) {
+      string path = module.path;
+      if (build_id_read(path) != module.build_id) {
+        string build_id = build_id_hex(module.build_id);
+        path = "/usr/lib/debug/.build-id/" + build_id.substr(0, 2) + "/" +
+               build_id.substr(2) + ".debug";
+        if (build_id_read(path) != module.build_id) {
+          path.clear();
+        }
+      }
+      it = object_paths.insert(std::make_pair(module.path, path)).first;
+    }
+    module.path = it->second;
+  }
+}
+
+string build_id_hex(const string& build_id) {
+  static const char digits[] = "0123456789abcdef";
+  string result;
+  result.reserve(build_id.size() * 2);
+  for (size_t i = 0; i < build_id.size(); ++i) {
+    unsigned char byte = (unsigned char)build_id[i];
+    result += digits[byte >> 4];
+    result += digits[byte & 0xf];
+  }
+  return result;
+}
+
+}  // namespace internal
+}  // namespace bt
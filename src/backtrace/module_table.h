@@ -0,0 +1,91 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef __MODULE_TABLE_H__
+#define __MODULE_TABLE_H__
+
+#include <stdint.h>
+
+#include "backtrace/backtrace_util.h"
+
+namespace bt {
+namespace internal {
+
+// Executable segment of an object which is loaded into the process.
+struct Module {
+  // Path of the object file, main executable is resolved to a real path.
+  string path;
+  // Run-time address range of the segment, end is exclusive.
+  uintptr_t start;
+  uintptr_t end;
+  // Offset of the segment in the object file.
+  uint64_t file_offset;
+  // Difference between run-time and link-time addresses.
+  uintptr_t load_bias;
+  // Raw bytes of the GNU build ID note, empty if object has none.
+  string build_id;
+
+  Module()
+  : start(0),
+    end(0),
+    file_offset(0),
+    load_bias(0) {}
+};
+
+// Collect executable segments of all the objects loaded into the process,
+// sorted by their start address. Returns false if the platform does not
+// provide a way to enumerate loaded objects.
+bool module_table_load(vector<Module> *modules);
+
+// Same as above, but for another process, using its /proc/<pid>/maps.
+// Load bias is found by matching the first mapping of every object against
+// its ELF headers, so objects are expected to be present on disk.
+bool module_table_load(int pid, vector<Module> *modules);
+
+// Counter which changes every time an object is loaded into the process or
+// unloaded from it, cheap enough to check before every table lookup.
+// Returns zero if the platform does not provide one.
+uint64_t module_table_generation();
+
+// Same as above, but only changes when an object is unloaded.
+uint64_t module_table_unloads();
+
+// Find module which contains given address in a sorted table.
+const Module *module_table_find(const vector<Module>& modules,
+                                uintptr_t address);
+
+// Read build ID of an object file on disk, empty if it has none or file
+// is not a readable ELF object.
+string build_id_read(const string& path);
+
+// Point modules of another process or of a past run of the program to
+// the objects on disk which have the same build ID: either the objects
+// at their original paths, or separate debug files found in
+// /usr/lib/debug/.build-id. Path of a module is cleared if neither
+// matches, so it is not symbolized with unrelated symbols.
+void module_table_locate_objects(vector<Module> *modules);
+
+// Build ID as a lower case hexadecimal string.
+string build_id_hex(const string& build_id);
+
+}  // namespace internal
+}  // namespace bt
+
+#endif  // __MODULE_TABLE_H__
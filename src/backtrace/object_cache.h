@@ -0,0 +1,119 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef __OBJECT_CACHE_H__
+#define __OBJECT_CACHE_H__
+
+#include <list>
+
+#include "backtrace/backtrace_util.h"
+#include "backtrace/stats.h"
+#include "backtrace/symbolize.h"
+
+namespace bt {
+namespace internal {
+
+// Per-object symbol data of a symbolizer, with least recently used objects
+// evicted once their estimated memory usage goes above the budget.
+//
+// Objects are created as new T(name) on demand, and report their memory
+// usage via memory_usage(). Usage is re-evaluated every time object is
+// used, since symbol data is typically loaded lazily.
+template<typename T>
+class ObjectCache {
+ public:
+  ObjectCache() : memory_usage_(0) {}
+
+  ~ObjectCache() {
+    clear();
+  }
+
+  // Get object with the given name, loading it if needed. Returned object
+  // stays valid until the next call.
+  T& get(const string& name) {
+    // Most recently used object might have loaded more data meanwhile.
+    if (!lru_.empty()) {
+      update_memory_usage(&lru_.front());
+    }
+    typename IndexMap::iterator it = index_.find(name);
+    if (it != index_.end()) {
+      lru_.splice(lru_.begin(), lru_, it->second);
+      stats_add(STATS_CACHE_HITS);
+    } else {
+      Entry entry;
+      entry.object = new T(name);
+      entry.memory_usage = 0;
+      lru_.push_front(entry);
+      index_[name] = lru_.begin();
+      lru_.front().name = name;
+      update_memory_usage(&lru_.front());
+      stats_add(STATS_CACHE_MISSES);
+    }
+    // Object which is about to be used is never evicted.
+    while (memory_usage_ > object_cache_budget && lru_.size() > 1) {
+      evict(--lru_.end());
+      stats_add(STATS_CACHE_EVICTIONS);
+    }
+    return *lru_.front().object;
+  }
+
+  void clear() {
+    while (!lru_.empty()) {
+      evict(lru_.begin());
+    }
+  }
+
+  size_t size() const { return lru_.size(); }
+  size_t memory_usage() const { return memory_usage_; }
+
+ private:
+  struct Entry {
+    string name;
+    T *object;
+    size_t memory_usage;
+  };
+  typedef std::list<Entry> EntryList;
+  typedef map<string, typename EntryList::iterator> IndexMap;
+
+  void update_memory_usage(Entry *entry) {
+    size_t memory_usage = entry->object->memory_usage();
+    memory_usage_ += memory_usage - entry->memory_usage;
+    stats_add(STATS_SYMBOL_MEMORY,
+              (int64_t)memory_usage - (int64_t)entry->memory_usage);
+    entry->memory_usage = memory_usage;
+  }
+
+  void evict(typename EntryList::iterator it) {
+    memory_usage_ -= it->memory_usage;
+    stats_add(STATS_SYMBOL_MEMORY, -(int64_t)it->memory_usage);
+    delete it->object;
+    index_.erase(it->name);
+    lru_.erase(it);
+  }
+
+  EntryList lru_;
+  IndexMap index_;
+  size_t memory_usage_;
+};
+
+}  // namespace internal
+}  // namespace bt
+
+#endif  // __OBJECT_CACHE_H__
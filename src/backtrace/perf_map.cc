@@ -0,0 +1,237 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "backtrace/perf_map.h"
+
+#ifdef BACKTRACE_HAS_PERF_MAP
+
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace bt {
+namespace internal {
+
+namespace {
+
+// Parse hexadecimal number with an optional 0x prefix, skipping leading
+// spaces.
+bool parse_hex(const char **data, const char *end, uint64_t *value) {
+  const char *p = *data;
+  while (p < end && *p == ' ') {
+    ++p;
+  }
+  if (end - p >= 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+    p += 2;
+  }
+  const char *digits = p;
+  *value = 0;
+  while (p < end) {
+    int digit;
+    if (*p >= '0' && *p <= '9') {
+      digit = *p - '0';
+    } else if (*p >= 'a' && *p <= 'f') {
+      digit = *p - 'a' + 10;
+    } else if (*p >= 'A' && *p <= 'F') {
+      digit = *p - 'A' + 10;
+    } else {
+      break;
+    }
+    *value = (*value << 4) | digit;
+    ++p;
+  }
+  *data = p;
+  return p != digits;
+}
+
+// Map of this process, shared by all the symbolizers.
+Mutex perf_map_mutex;
+PerfMap *perf_map = NULL;
+int perf_map_pid = 0;
+
+// Symbolize implementation which only knows about JIT functions.
+class SymbolizePerfMap : public Symbolize {
+ public:
+  explicit SymbolizePerfMap(StackTrace *stacktrace)
+  : Symbolize(stacktrace) {
+    if (stacktrace_ != NULL) {
+      resolve(*stacktrace_);
+    }
+  }
+
+  void resolve(const StackTrace& stacktrace) {
+    symbols_.clear();
+    symbols_.resize(stacktrace.size());
+    MutexLock lock(&perf_map_mutex);
+    int pid = getpid();
+    if (perf_map == NULL || perf_map_pid != pid) {
+      // Child process after fork() has a map of its own.
+      delete perf_map;
+      perf_map = new PerfMap(pid);
+      perf_map_pid = pid;
+    }
+    // JIT might have reused memory of older code, so map is brought up to
+    // date first, which is a stat() call if nothing was appended.
+    if (!perf_map->update()) {
+      return;
+    }
+    for (size_t i = 0; i < stacktrace.size(); ++i) {
+      uintptr_t address =
+          reinterpret_cast<uintptr_t>(stacktrace[i].address) - 1;
+      perf_map->lookup(address, &symbols_[i]);
+    }
+  }
+};
+
+}  // namespace
+
+PerfMap::PerfMap(int pid)
+    : file_offset_(0) {
+  char path[64];
+  snprintf(path, sizeof(path), "/tmp/perf-%d.map", pid);
+  path_ = path;
+}
+
+bool PerfMap::update() {
+  struct stat st;
+  if (stat(path_.c_str(), &st) != 0) {
+    return false;
+  }
+  if ((uint64_t)st.st_size == file_offset_) {
+    return true;
+  }
+  FILE *file = fopen(path_.c_str(), "r");
+  if (file == NULL) {
+    return false;
+  }
+  if ((uint64_t)st.st_size < file_offset_) {
+    // File was replaced, start over.
+    file_offset_ = 0;
+    partial_line_.clear();
+    entries_.clear();
+    names_.clear();
+  }
+  if (fseeko(file, (off_t)file_offset_, SEEK_SET) != 0) {
+    fclose(file);
+    return true;
+  }
+  char buffer[65536];
+  size_t size;
+  while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    file_offset_ += size;
+    const char *data = buffer, *end = buffer + size;
+    while (data < end) {
+      const char *newline = reinterpret_cast<const char *>(
+          memchr(data, '\n', end - data));
+      if (newline == NULL) {
+        partial_line_.append(data, end - data);
+        break;
+      }
+      if (partial_line_.empty()) {
+        parse_line(data, newline - data);
+      } else {
+        partial_line_.append(data, newline - data);
+        parse_line(partial_line_.data(), partial_line_.size());
+        partial_line_.clear();
+      }
+      data = newline + 1;
+    }
+  }
+  fclose(file);
+  return true;
+}
+
+bool PerfMap::lookup(uintptr_t address, Symbol *symbol) const {
+  map<uintptr_t, Entry>::const_iterator it = entries_.upper_bound(address);
+  if (it == entries_.begin()) {
+    return false;
+  }
+  --it;
+  if (address >= it->second.end) {
+    return false;
+  }
+  symbol->object_name = path_;
+  symbol->function_name = names_.c_str() + it->second.name_offset;
+  symbol->function_offset = address - it->second.function_start;
+  if (symbol->address == Symbol::ADDRESS_NONE) {
+    symbol->address = address;
+  }
+  return true;
+}
+
+void PerfMap::insert(uintptr_t start, uintptr_t end, size_t name_offset) {
+  map<uintptr_t, Entry>::iterator it = entries_.lower_bound(start);
+  // Cut the tail of an older entry which starts before the new one.
+  if (it != entries_.begin()) {
+    map<uintptr_t, Entry>::iterator previous = it;
+    --previous;
+    if (previous->second.end > start) {
+      if (previous->second.end > end) {
+        Entry tail = previous->second;
+        entries_[end] = tail;
+      }
+      previous->second.end = start;
+    }
+  }
+  // Drop older entries which start within the new one, keeping the part
+  // which goes beyond it.
+  while (it != entries_.end() && it->first < end) {
+    Entry entry = it->second;
+    entries_.erase(it++);
+    if (entry.end > end) {
+      entries_[end] = entry;
+      break;
+    }
+  }
+  Entry entry;
+  entry.end = end;
+  entry.function_start = start;
+  entry.name_offset = name_offset;
+  entries_[start] = entry;
+}
+
+void PerfMap::parse_line(const char *line, size_t length) {
+  const char *data = line, *end = line + length;
+  uint64_t start, size;
+  if (!parse_hex(&data, end, &start) ||
+      !parse_hex(&data, end, &size) ||
+      size == 0 ||
+      data == end || *data != ' ') {
+    return;
+  }
+  ++data;
+  if (end > data && end[-1] == '\r') {
+    --end;
+  }
+  size_t name_offset = names_.size();
+  names_.append(data, end - data);
+  names_.push_back('\0');
+  insert((uintptr_t)start, (uintptr_t)(start + size), name_offset);
+}
+
+Symbolize *symbolize_create_perf_map(StackTrace *stacktrace) {
+  return new SymbolizePerfMap(stacktrace);
+}
+
+}  // namespace internal
+}  // namespace bt
+
+#endif  // BACKTRACE_HAS_PERF_MAP
@@ -0,0 +1,89 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef __PERF_MAP_H__
+#define __PERF_MAP_H__
+
+#include <stdint.h>
+
+#include "backtrace/backtrace_util.h"
+#include "backtrace/symbolize.h"
+
+#if defined(__linux__)
+#  define BACKTRACE_HAS_PERF_MAP
+#endif
+
+#ifdef BACKTRACE_HAS_PERF_MAP
+
+namespace bt {
+namespace internal {
+
+// Symbols of JIT-compiled code, as written by the JIT into
+// /tmp/perf-<pid>.map, one "<start> <size> <name>" line per function.
+//
+// File is only ever appended to, so it is read incrementally. Newer
+// entries replace overlapping parts of older ones, as the JIT reuses code
+// memory, which keeps the index a set of disjoint intervals with
+// logarithmic lookups.
+class PerfMap {
+ public:
+  explicit PerfMap(int pid);
+
+  // Read lines which were appended since the previous update. Returns
+  // false if there's no map file.
+  bool update();
+
+  // Returns false if address does not belong to any known JIT function.
+  bool lookup(uintptr_t address, Symbol *symbol) const;
+
+  size_t size() const { return entries_.size(); }
+
+ private:
+  struct Entry {
+    uintptr_t end;
+    // Start of the whole function, which differs from the start of the
+    // interval if head of the function was replaced by newer code.
+    uintptr_t function_start;
+    // Offset of the zero-terminated name in the names pool.
+    size_t name_offset;
+  };
+
+  void insert(uintptr_t start, uintptr_t end, size_t name_offset);
+  void parse_line(const char *line, size_t length);
+
+  string path_;
+  // Number of bytes of the file which were consumed so far.
+  uint64_t file_offset_;
+  // Incomplete last line, which is still being written.
+  string partial_line_;
+  map<uintptr_t, Entry> entries_;
+  string names_;
+};
+
+// Resolve addresses using perf map file of this process, addresses which
+// are not JIT functions are left unresolved.
+Symbolize *symbolize_create_perf_map(StackTrace *stacktrace = NULL);
+
+}  // namespace internal
+}  // namespace bt
+
+#endif  // BACKTRACE_HAS_PERF_MAP
+
+#endif  // __PERF_MAP_H__
@@ -0,0 +1,330 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "backtrace/pprof.h"
+
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <stdint.h>
+
+#ifdef BACKTRACE_HAS_ZLIB
+#  include <zlib.h>
+#endif
+
+#include "backtrace/module_table.h"
+#include "backtrace/symbolize.h"
+
+namespace bt {
+
+namespace {
+
+// Field numbers of the profile.proto messages.
+enum {
+  PROFILE_SAMPLE_TYPE = 1,
+  PROFILE_SAMPLE = 2,
+  PROFILE_MAPPING = 3,
+  PROFILE_LOCATION = 4,
+  PROFILE_FUNCTION = 5,
+  PROFILE_STRING_TABLE = 6,
+  PROFILE_TIME_NANOS = 9,
+
+  VALUE_TYPE_TYPE = 1,
+  VALUE_TYPE_UNIT = 2,
+
+  SAMPLE_LOCATION_ID = 1,
+  SAMPLE_VALUE = 2,
+
+  MAPPING_ID = 1,
+  MAPPING_MEMORY_START = 2,
+  MAPPING_MEMORY_LIMIT = 3,
+  MAPPING_FILE_OFFSET = 4,
+  MAPPING_FILENAME = 5,
+  MAPPING_BUILD_ID = 6,
+  MAPPING_HAS_FUNCTIONS = 7,
+  MAPPING_HAS_FILENAMES = 8,
+  MAPPING_HAS_LINE_NUMBERS = 9,
+
+  LOCATION_ID = 1,
+  LOCATION_MAPPING_ID = 2,
+  LOCATION_ADDRESS = 3,
+  LOCATION_LINE = 4,
+
+  LINE_FUNCTION_ID = 1,
+  LINE_LINE = 2,
+
+  FUNCTION_ID = 1,
+  FUNCTION_NAME = 2,
+  FUNCTION_SYSTEM_NAME = 3,
+  FUNCTION_FILENAME = 4,
+};
+
+// Minimal protocol buffers encoder, only wire types used by the profile
+// are supported.
+class ProtoWriter {
+ public:
+  void varint(int field, uint64_t value) {
+    tag(field, 0);
+    raw_varint(value);
+  }
+
+  // Only emitted when non-zero, which is the default value.
+  void optional_varint(int field, uint64_t value) {
+    if (value != 0) {
+      varint(field, value);
+    }
+  }
+
+  void bytes(int field, const string& value) {
+    tag(field, 2);
+    raw_varint(value.size());
+    data_ += value;
+  }
+
+  void message(int field, const ProtoWriter& message) {
+    bytes(field, message.data_);
+  }
+
+  void packed_varints(int field, const vector<uint64_t>& values) {
+    ProtoWriter packed;
+    for (size_t i = 0; i < values.size(); ++i) {
+      packed.raw_varint(values[i]);
+    }
+    bytes(field, packed.data_);
+  }
+
+  const string& data() const { return data_; }
+
+ private:
+  void tag(int field, int wire_type) {
+    raw_varint(((uint64_t)field << 3) | wire_type);
+  }
+
+  void raw_varint(uint64_t value) {
+    while (value >= 0x80) {
+      data_ += (char)((value & 0x7f) | 0x80);
+      value >>= 7;
+    }
+    data_ += (char)value;
+  }
+
+  string data_;
+};
+
+// Deduplicated string table, index 0 is always an empty string.
+class StringTable {
+ public:
+  StringTable() {
+    index("");
+  }
+
+  uint64_t index(const string& str) {
+    map<string, uint64_t>::iterator it = indices_.find(str);
+    if (it != indices_.end()) {
+      return it->second;
+    }
+    uint64_t index = strings_.size();
+    indices_[str] = index;
+    strings_.push_back(str);
+    return index;
+  }
+
+  void write(ProtoWriter *profile) const {
+    for (size_t i = 0; i < strings_.size(); ++i) {
+      profile->bytes(PROFILE_STRING_TABLE, strings_[i]);
+    }
+  }
+
+ private:
+  map<string, uint64_t> indices_;
+  vector<string> strings_;
+};
+
+#ifdef BACKTRACE_HAS_ZLIB
+bool gzip_compress(const string& input, string *output) {
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  // Window bits of 15 + 16 makes zlib write gzip header and trailer.
+  if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                   15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+    return false;
+  }
+  output->resize(deflateBound(&stream, input.size()));
+  stream.next_in = (Bytef *)input.data();
+  stream.avail_in = (uInt)input.size();
+  stream.next_out = (Bytef *)&(*output)[0];
+  stream.avail_out = (uInt)output->size();
+  int result = deflate(&stream, Z_FINISH);
+  output->resize(stream.total_out);
+  deflateEnd(&stream);
+  return result == Z_STREAM_END;
+}
+#endif
+
+}  // namespace
+
+string pprof_export(const CallingContextTree& tree,
+                    const string& sample_type,
+                    const string& sample_unit) {
+  ProtoWriter profile;
+  StringTable strings;
+  {
+    ProtoWriter value_type;
+    value_type.varint(VALUE_TYPE_TYPE, strings.index(sample_type));
+    value_type.varint(VALUE_TYPE_UNIT, strings.index(sample_unit));
+    profile.message(PROFILE_SAMPLE_TYPE, value_type);
+  }
+  // Mappings of all the loaded objects, ids are one-based. They are
+  // written once locations tell which of them got symbolized.
+  vector<internal::Module> modules;
+  internal::module_table_load(&modules);
+  vector<bool> has_functions(modules.size(), false);
+  vector<bool> has_filenames(modules.size(), false);
+  vector<bool> has_line_numbers(modules.size(), false);
+  // Location for every unique address, ids are one-based.
+  map<void *, uint64_t> location_ids;
+  StackTraceAddresses addresses;
+  for (size_t i = 1; i < tree.num_nodes(); ++i) {
+    void *address = tree.node((uint32_t)i).address;
+    if (location_ids.insert(std::make_pair(address,
+                                           addresses.size() + 1)).second) {
+      addresses.push_back(address);
+    }
+  }
+  Symbolize *symbolize = Symbolize::create();
+  symbolize->resolve(addresses);
+  map<std::pair<string, string>, uint64_t> function_ids;
+  for (size_t i = 0; i < addresses.size(); ++i) {
+    uintptr_t address = reinterpret_cast<uintptr_t>(addresses[i].address);
+    const Symbol& symbol = symbolize->at(i);
+    ProtoWriter location;
+    location.varint(LOCATION_ID, i + 1);
+    const internal::Module *module =
+        internal::module_table_find(modules, address);
+    if (module != NULL) {
+      size_t index = module - &modules[0];
+      location.varint(LOCATION_MAPPING_ID, index + 1);
+      if (symbol.function_name != "") {
+        has_functions[index] = true;
+      }
+      if (symbol.file_name != "") {
+        has_filenames[index] = true;
+      }
+      if (symbol.line_number != Symbol::LINE_NONE) {
+        has_line_numbers[index] = true;
+      }
+    }
+    location.varint(LOCATION_ADDRESS, address);
+    if (symbol.function_name != "") {
+      std::pair<string, string> key(symbol.function_name, symbol.file_name);
+      map<std::pair<string, string>, uint64_t>::iterator it =
+          function_ids.find(key);
+      uint64_t function_id;
+      if (it == function_ids.end()) {
+        function_id = function_ids.size() + 1;
+        function_ids[key] = function_id;
+        ProtoWriter function;
+        function.varint(FUNCTION_ID, function_id);
+        function.varint(FUNCTION_NAME, strings.index(symbol.function_name));
+        function.varint(FUNCTION_SYSTEM_NAME,
+                        strings.index(symbol.function_name));
+        function.optional_varint(FUNCTION_FILENAME,
+                                 strings.index(symbol.file_name));
+        profile.message(PROFILE_FUNCTION, function);
+      } else {
+        function_id = it->second;
+      }
+      ProtoWriter line;
+      line.varint(LINE_FUNCTION_ID, function_id);
+      if (symbol.line_number != Symbol::LINE_NONE) {
+        line.optional_varint(LINE_LINE, symbol.line_number);
+      }
+      location.message(LOCATION_LINE, line);
+    }
+    profile.message(PROFILE_LOCATION, location);
+  }
+  delete symbolize;
+  for (size_t i = 0; i < modules.size(); ++i) {
+    const internal::Module& module = modules[i];
+    ProtoWriter mapping;
+    mapping.varint(MAPPING_ID, i + 1);
+    mapping.varint(MAPPING_MEMORY_START, module.start);
+    mapping.varint(MAPPING_MEMORY_LIMIT, module.end);
+    mapping.optional_varint(MAPPING_FILE_OFFSET, module.file_offset);
+    mapping.optional_varint(MAPPING_FILENAME, strings.index(module.path));
+    mapping.optional_varint(
+        MAPPING_BUILD_ID,
+        strings.index(internal::build_id_hex(module.build_id)));
+    // pprof symbolizes mappings without these flags on its own.
+    mapping.optional_varint(MAPPING_HAS_FUNCTIONS, has_functions[i]);
+    mapping.optional_varint(MAPPING_HAS_FILENAMES, has_filenames[i]);
+    mapping.optional_varint(MAPPING_HAS_LINE_NUMBERS, has_line_numbers[i]);
+    profile.message(PROFILE_MAPPING, mapping);
+  }
+  // Sample for every calling context with a value, innermost location goes
+  // first.
+  vector<uint64_t> location_path;
+  vector<uint64_t> values(1);
+  for (size_t i = 1; i < tree.num_nodes(); ++i) {
+    const CallingContextTree::Node& node = tree.node((uint32_t)i);
+    if (node.self_value == 0) {
+      continue;
+    }
+    location_path.clear();
+    for (uint32_t index = (uint32_t)i;
+         index != CallingContextTree::ROOT;
+         index = tree.node(index).parent) {
+      location_path.push_back(location_ids[tree.node(index).address]);
+    }
+    values[0] = node.self_value;
+    ProtoWriter sample;
+    sample.packed_varints(SAMPLE_LOCATION_ID, location_path);
+    sample.packed_varints(SAMPLE_VALUE, values);
+    profile.message(PROFILE_SAMPLE, sample);
+  }
+  profile.varint(PROFILE_TIME_NANOS, (uint64_t)time(NULL) * 1000000000);
+  strings.write(&profile);
+#ifdef BACKTRACE_HAS_ZLIB
+  string compressed;
+  if (gzip_compress(profile.data(), &compressed)) {
+    return compressed;
+  }
+#endif
+  // pprof also accepts uncompressed profiles.
+  return profile.data();
+}
+
+bool pprof_write(const CallingContextTree& tree,
+                 const string& filename,
+                 const string& sample_type,
+                 const string& sample_unit) {
+  string data = pprof_export(tree, sample_type, sample_unit);
+  FILE *file = fopen(filename.c_str(), "wb");
+  if (file == NULL) {
+    return false;
+  }
+  bool ok = (fwrite(data.data(), 1, data.size(), file) == data.size());
+  if (fclose(file) != 0) {
+    ok = false;
+  }
+  return ok;
+}
+
+}  // namespace bt
@@ -0,0 +1,49 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef __PPROF_H__
+#define __PPROF_H__
+
+#include "backtrace/backtrace_util.h"
+#include "backtrace/calling_context_tree.h"
+
+namespace bt {
+
+// Serialize tree into the profile.proto format understood by pprof.
+//
+// Every calling context with non-zero value becomes a sample. Mappings are
+// taken from the objects currently loaded into the process, so profile is
+// to be exported by the process which captured the traces. Locations are
+// symbolized, so the profile is readable without access to the binaries.
+//
+// Profile is gzip-compressed when compiled with zlib support.
+string pprof_export(const CallingContextTree& tree,
+                    const string& sample_type = "samples",
+                    const string& sample_unit = "count");
+
+// Export tree and write it to a file. Returns false on I/O error.
+bool pprof_write(const CallingContextTree& tree,
+                 const string& filename,
+                 const string& sample_type = "samples",
+                 const string& sample_unit = "count");
+
+}  // namespace bt
+
+#endif  // __PPROF_H__
@@ -0,0 +1,192 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "backtrace/relative_stacktrace.h"
+
+#include "backtrace/module_table.h"
+
+namespace bt {
+
+const uint32_t RelativeFrame::MODULE_NONE;
+
+namespace {
+
+// Process-wide table of loaded modules. Executable segments are looked up
+// in a sorted table, while indices of objects only ever grow, so frames
+// which were converted earlier stay valid after the table is reloaded.
+internal::Mutex registry_mutex;
+bool registry_loaded = false;
+uint64_t registry_generation = 0;
+vector<internal::Module> registry_segments;
+// Index of the module for every segment.
+vector<uint32_t> registry_segment_modules;
+vector<RelativeModule> registry_modules;
+map<std::pair<string, uintptr_t>, uint32_t> registry_indices;
+
+void registry_reload(uint64_t generation) {
+  registry_loaded = true;
+  registry_generation = generation;
+  internal::module_table_load(&registry_segments);
+  registry_segment_modules.resize(registry_segments.size());
+  for (size_t i = 0; i < registry_segments.size(); ++i) {
+    const internal::Module& segment = registry_segments[i];
+    std::pair<string, uintptr_t> key(segment.path, segment.load_bias);
+    map<std::pair<string, uintptr_t>, uint32_t>::const_iterator it =
+        registry_indices.find(key);
+    if (it != registry_indices.end()) {
+      registry_segment_modules[i] = it->second;
+      continue;
+    }
+    uint32_t index = (uint32_t)registry_modules.size();
+    RelativeModule module;
+    module.path = segment.path;
+    module.build_id = segment.build_id;
+    module.load_bias = segment.load_bias;
+    registry_modules.push_back(module);
+    registry_indices[key] = index;
+    registry_segment_modules[i] = index;
+  }
+}
+
+// Must be called with registry mutex held. Table is checked for loads and
+// unloads only once per trace, and only if some address is missing from
+// it: checking walks all the loaded objects.
+const internal::Module *registry_find(uintptr_t address, bool *checked) {
+  const internal::Module *segment =
+      internal::module_table_find(registry_segments, address);
+  if (segment == NULL && !*checked) {
+    *checked = true;
+    // Counters are not available everywhere, so an object might have been
+    // loaded unnoticed.
+    uint64_t generation = internal::module_table_generation();
+    if (generation == 0 || generation != registry_generation) {
+      registry_reload(generation);
+      segment = internal::module_table_find(registry_segments, address);
+    }
+  }
+  return segment;
+}
+
+// Must be called with registry mutex held.
+void *registry_absolute(const RelativeFrame& frame) {
+  uintptr_t address = (uintptr_t)frame.offset;
+  if (frame.module < registry_modules.size()) {
+    address += registry_modules[frame.module].load_bias;
+  }
+  return reinterpret_cast<void *>(address);
+}
+
+}  // namespace
+
+string RelativeModule::id() const {
+  if (build_id.empty()) {
+    return path;
+  }
+  return internal::build_id_hex(build_id);
+}
+
+RelativeStackTrace::RelativeStackTrace(const StackTrace& stacktrace) {
+  assign(stacktrace);
+}
+
+void RelativeStackTrace::assign(const StackTrace& stacktrace) {
+  frames_.resize(stacktrace.size());
+  internal::MutexLock lock(&registry_mutex);
+  bool checked = false;
+  if (!registry_loaded) {
+    registry_reload(internal::module_table_generation());
+    checked = true;
+  }
+  for (size_t i = 0; i < stacktrace.size(); ++i) {
+    uintptr_t address = reinterpret_cast<uintptr_t>(stacktrace[i].address);
+    RelativeFrame& frame = frames_[i];
+    const internal::Module *segment = registry_find(address, &checked);
+    if (segment == NULL) {
+      frame.module = RelativeFrame::MODULE_NONE;
+      frame.offset = address;
+      continue;
+    }
+    frame.module = registry_segment_modules[segment - &registry_segments[0]];
+    frame.offset = address - segment->load_bias;
+  }
+}
+
+StackTraceAddresses RelativeStackTrace::to_absolute() const {
+  StackTraceAddresses addresses;
+  internal::MutexLock lock(&registry_mutex);
+  for (size_t i = 0; i < frames_.size(); ++i) {
+    addresses.push_back(registry_absolute(frames_[i]));
+  }
+  return addresses;
+}
+
+string RelativeStackTrace::key() const {
+  string key;
+  for (size_t i = 0; i < frames_.size(); ++i) {
+    const RelativeFrame& frame = frames_[i];
+    if (i != 0) {
+      key += ";";
+    }
+    if (frame.module != RelativeFrame::MODULE_NONE) {
+      key += relative_module_get(frame.module).id();
+      key += "+";
+    }
+    key += hex_cast(frame.offset);
+  }
+  return key;
+}
+
+RelativeModule relative_module_get(uint32_t module) {
+  internal::MutexLock lock(&registry_mutex);
+  if (module >= registry_modules.size()) {
+    return RelativeModule();
+  }
+  return registry_modules[module];
+}
+
+void relative_symbolize(const vector<RelativeFrame>& frames,
+                        vector<Symbol> *symbols) {
+  // Frames are the same for all the traces of a binary, so every unique
+  // one is resolved once.
+  map<RelativeFrame, size_t> indices;
+  vector<RelativeFrame> unique_frames;
+  for (size_t i = 0; i < frames.size(); ++i) {
+    if (indices.insert(std::make_pair(frames[i],
+                                      unique_frames.size())).second) {
+      unique_frames.push_back(frames[i]);
+    }
+  }
+  StackTraceAddresses addresses;
+  {
+    internal::MutexLock lock(&registry_mutex);
+    for (size_t i = 0; i < unique_frames.size(); ++i) {
+      addresses.push_back(registry_absolute(unique_frames[i]));
+    }
+  }
+  Symbolize *symbolize = Symbolize::create();
+  symbolize->resolve(addresses);
+  symbols->resize(frames.size());
+  for (size_t i = 0; i < frames.size(); ++i) {
+    (*symbols)[i] = symbolize->at(indices[frames[i]]);
+  }
+  delete symbolize;
+}
+
+}  // namespace bt
@@ -0,0 +1,126 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef __RELATIVE_STACKTRACE_H__
+#define __RELATIVE_STACKTRACE_H__
+
+#include <stdint.h>
+
+#include "backtrace/backtrace_util.h"
+#include "backtrace/stacktrace.h"
+#include "backtrace/symbolize.h"
+
+namespace bt {
+
+// Object which frames of relative stack traces refer to.
+struct RelativeModule {
+  string path;
+  // Raw bytes of the GNU build ID, empty if object has none.
+  string build_id;
+  // Difference between run-time and link-time addresses in this process.
+  uintptr_t load_bias;
+
+  RelativeModule()
+  : load_bias(0) {}
+
+  // Identifier which is the same for all the processes running the very
+  // same object: hexadecimal build ID, or path if there's no build ID.
+  string id() const;
+};
+
+// Frame in a position-independent form, which does not change when the
+// same objects get loaded at different addresses. Module is an index in
+// the table of this process, so frames are only comparable within the
+// process, see RelativeStackTrace::key() for a form which is not.
+struct RelativeFrame {
+  static const uint32_t MODULE_NONE = 0xffffffff;
+
+  // Index of the module, see relative_module_get(). Indices are assigned
+  // once per process and are never reused.
+  uint32_t module;
+  // Link-time address within the module, or an absolute address if
+  // address does not belong to any known module.
+  uint64_t offset;
+
+  RelativeFrame()
+  : module(MODULE_NONE),
+    offset(0) {}
+
+  bool operator==(const RelativeFrame& other) const {
+    return module == other.module && offset == other.offset;
+  }
+
+  bool operator<(const RelativeFrame& other) const {
+    if (module != other.module) return module < other.module;
+    return offset < other.offset;
+  }
+};
+
+// Stack trace which stores frames relative to the objects they belong to,
+// so traces could be aggregated in this process and stored, with key()
+// being comparable between processes.
+//
+// Conversion looks addresses up in a process-wide module table which is
+// only reloaded once an address is not found in it, same as the symbol
+// cache only checks for unloads when something is missing.
+class RelativeStackTrace {
+ public:
+  RelativeStackTrace() {}
+  explicit RelativeStackTrace(const StackTrace& stacktrace);
+
+  void assign(const StackTrace& stacktrace);
+
+  size_t size() const { return frames_.size(); }
+  const RelativeFrame& operator[](size_t index) const {
+    assert(index < size());
+    return frames_[index];
+  }
+  const vector<RelativeFrame>& frames() const { return frames_; }
+
+  // Absolute addresses in this process, as long as modules are loaded.
+  StackTraceAddresses to_absolute() const;
+
+  // Text form of the trace, one "<module id>+0x<offset>" per frame
+  // separated by semicolons, which is the same in every process.
+  string key() const;
+
+  bool operator==(const RelativeStackTrace& other) const {
+    return frames_ == other.frames_;
+  }
+
+  bool operator<(const RelativeStackTrace& other) const {
+    return frames_ < other.frames_;
+  }
+
+ private:
+  vector<RelativeFrame> frames_;
+};
+
+// Get module by its index, index is to come from a RelativeFrame.
+RelativeModule relative_module_get(uint32_t module);
+
+// Symbolize frames, every unique frame is only resolved once. Symbol
+// addresses are absolute addresses in this process.
+void relative_symbolize(const vector<RelativeFrame>& frames,
+                        vector<Symbol> *symbols);
+
+}  // namespace bt
+
+#endif  // __RELATIVE_STACKTRACE_H__
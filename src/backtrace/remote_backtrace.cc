@@ -0,0 +1,370 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "backtrace/remote_backtrace.h"
+
+#ifdef BACKTRACE_HAS_REMOTE_BACKTRACE
+
+#include <dirent.h>
+#include <elf.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sstream>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ptrace.h>
+#include <sys/uio.h>
+#include <sys/user.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "backtrace/backtrace.h"
+#include "backtrace/symbolize.h"
+
+namespace bt {
+namespace internal {
+
+namespace {
+
+bool registers_get(long tid, DwarfRegisters *registers) {
+  struct user_regs_struct regs;
+  struct iovec iov;
+  iov.iov_base = &regs;
+  iov.iov_len = sizeof(regs);
+  if (ptrace(PTRACE_GETREGSET, tid, (void *)NT_PRSTATUS, &iov) != 0) {
+    return false;
+  }
+  if (iov.iov_len != sizeof(regs)) {
+    // Process of a different word size.
+    return false;
+  }
+  *registers = DwarfRegisters();
+#if defined(__x86_64__)
+  // In the order of DWARF register numbers.
+  const unsigned long long values[DWARF_NUM_REGISTERS] = {
+    regs.rax, regs.rdx, regs.rcx, regs.rbx,
+    regs.rsi, regs.rdi, regs.rbp, regs.rsp,
+    regs.r8, regs.r9, regs.r10, regs.r11,
+    regs.r12, regs.r13, regs.r14, regs.r15,
+    regs.rip,
+  };
+  for (int i = 0; i < DWARF_NUM_REGISTERS; ++i) {
+    registers->set(i, values[i]);
+  }
+#elif defined(__aarch64__)
+  for (int i = 0; i < 31; ++i) {
+    registers->set(i, regs.regs[i]);
+  }
+  registers->set(DWARF_REGISTER_SP, regs.sp);
+  registers->set(DWARF_REGISTER_PC, regs.pc);
+#endif
+  return true;
+}
+
+// Copy stack from the stack pointer up in a single system call. Remote
+// ranges are split by pages, so the copy stops at the end of the stack
+// mapping rather than failing as a whole.
+void stack_copy(int pid, uintptr_t sp, RemoteStack *stack) {
+  const size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+  stack->start = sp;
+  stack->data.resize(BACKTRACE_REMOTE_STACK_SIZE);
+  vector<struct iovec> remote;
+  uintptr_t address = sp;
+  uintptr_t end = sp + BACKTRACE_REMOTE_STACK_SIZE;
+  while (address < end) {
+    uintptr_t page_end = (address + page_size) & ~(uintptr_t)(page_size - 1);
+    struct iovec iov;
+    iov.iov_base = reinterpret_cast<void *>(address);
+    iov.iov_len = (page_end < end ? page_end : end) - address;
+    remote.push_back(iov);
+    address += iov.iov_len;
+  }
+  struct iovec local;
+  local.iov_base = &stack->data[0];
+  local.iov_len = stack->data.size();
+  ssize_t size = process_vm_readv(pid, &local, 1,
+                                  &remote[0], remote.size(), 0);
+  stack->data.resize(size > 0 ? (size_t)size : 0);
+}
+
+string thread_name_get(int pid, long tid) {
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/%d/task/%ld/comm", pid, tid);
+  int fd = open(path, O_RDONLY);
+  if (fd == -1) {
+    return "";
+  }
+  char name[64];
+  ssize_t length = read(fd, name, sizeof(name) - 1);
+  close(fd);
+  if (length < 0) {
+    return "";
+  }
+  name[length] = '\0';
+  if (length > 0 && name[length - 1] == '\n') {
+    name[length - 1] = '\0';
+  }
+  return name;
+}
+
+// Stop a single thread, grab its registers and stack and let it go.
+bool thread_capture(int pid,
+                    long tid,
+                    DwarfRegisters *registers,
+                    RemoteStack *stack) {
+  if (ptrace(PTRACE_SEIZE, tid, NULL, NULL) != 0) {
+    return false;
+  }
+  if (ptrace(PTRACE_INTERRUPT, tid, NULL, NULL) != 0) {
+    ptrace(PTRACE_DETACH, tid, NULL, NULL);
+    return false;
+  }
+  int status;
+  long signal = 0;
+  for (;;) {
+    if (waitpid(tid, &status, __WALL) == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    if (!WIFSTOPPED(status)) {
+      // Thread exited meanwhile.
+      return false;
+    }
+    if ((status >> 16) != PTRACE_EVENT_STOP) {
+      // Signal is to be delivered once thread is detached.
+      signal = WSTOPSIG(status);
+    }
+    break;
+  }
+  bool result = registers_get(tid, registers);
+  if (result) {
+    stack_copy(pid, registers->sp(), stack);
+  }
+  ptrace(PTRACE_DETACH, tid, NULL, (void *)signal);
+  return result;
+}
+
+}  // namespace
+
+bool RemoteStack::read_word(uint64_t address, uint64_t *value) const {
+  if (address < start || address - start > data.size() ||
+      data.size() - (address - start) < sizeof(uint64_t)) {
+    return false;
+  }
+  memcpy(value, &data[address - start], sizeof(uint64_t));
+  return true;
+}
+
+RemoteUnwinder::RemoteUnwinder(const vector<Module>& modules)
+    : modules_(modules) {
+}
+
+RemoteUnwinder::~RemoteUnwinder() {
+  for (map<string, Object *>::iterator it = objects_.begin();
+       it != objects_.end();
+       ++it) {
+    if (it->second != NULL) {
+      delete it->second->table;
+      delete it->second;
+    }
+  }
+}
+
+const DwarfFrameTable *RemoteUnwinder::table_get(const Module& module) {
+  if (module.path.empty()) {
+    // Object was not found on disk.
+    return NULL;
+  }
+  map<string, Object *>::iterator it = objects_.find(module.path);
+  if (it == objects_.end()) {
+    Object *object = new Object();
+    object->table = NULL;
+    if (object->elf.open(module.path)) {
+      object->table = new DwarfFrameTable(&object->elf);
+    } else {
+      delete object;
+      object = NULL;
+    }
+    it = objects_.insert(std::make_pair(module.path, object)).first;
+  }
+  return it->second != NULL ? it->second->table : NULL;
+}
+
+bool RemoteUnwinder::fallback_step(const DwarfRegisters& frame,
+                                   const RemoteStack& stack,
+                                   bool is_top,
+                                   bool in_module,
+                                   DwarfRegisters *caller) const {
+  if (is_top && !in_module) {
+    // Call through an invalid pointer did not get to set up a frame.
+#if defined(__x86_64__)
+    uint64_t return_address;
+    if (!stack.read_word(frame.sp(), &return_address)) {
+      return false;
+    }
+    caller->set(DWARF_REGISTER_PC, return_address);
+    caller->set(DWARF_REGISTER_SP, frame.sp() + sizeof(uint64_t));
+#elif defined(__aarch64__)
+    uint64_t return_address;
+    if (!frame.get(DWARF_REGISTER_LR, &return_address)) {
+      return false;
+    }
+    caller->set(DWARF_REGISTER_PC, return_address);
+#endif
+    return true;
+  }
+  // Both on x86-64 and AArch64 frame pointer points to the saved caller's
+  // frame pointer, which is followed by the return address. Frame pointer
+  // register might be used as a general purpose one, caller checks that
+  // the chain only points to code.
+  uint64_t fp, next_fp, return_address;
+  if (!frame.get(DWARF_REGISTER_FP, &fp) ||
+      !stack.read_word(fp, &next_fp) ||
+      !stack.read_word(fp + sizeof(uint64_t), &return_address)) {
+    return false;
+  }
+  caller->set(DWARF_REGISTER_FP, next_fp);
+  caller->set(DWARF_REGISTER_SP, fp + 2 * sizeof(uint64_t));
+  caller->set(DWARF_REGISTER_PC, return_address);
+  return true;
+}
+
+void RemoteUnwinder::unwind(const DwarfRegisters& registers,
+                            const RemoteStack& stack,
+                            StackTraceAddresses *stacktrace) {
+  stacktrace->clear();
+  DwarfRegisters frame = registers;
+  // Program counter of the top frame and of the frames interrupted by a
+  // signal is the instruction itself rather than a return address.
+  bool is_exact = true;
+  while (stacktrace->size() < BACKTRACE_MAX_DEPTH) {
+    uint64_t pc = frame.pc();
+    // Resolving subtracts one from every address, which is only meant for
+    // return addresses.
+    stacktrace->push_back(reinterpret_cast<void *>(is_exact ? pc + 1 : pc));
+    // Return address might be past the end of a function which does not
+    // return, so the call instruction is looked up instead.
+    uint64_t address = is_exact ? pc : pc - 1;
+    const Module *module = module_table_find(modules_, address);
+    const DwarfFrameTable *table = (module != NULL) ? table_get(*module)
+                                                    : NULL;
+    DwarfRegisters caller = frame;
+    bool is_signal_frame = false;
+    if (table == NULL ||
+        !table->unwind(address - module->load_bias,
+                       stack,
+                       &caller,
+                       &is_signal_frame)) {
+      caller = frame;
+      if (!fallback_step(frame, stack, stacktrace->size() == 1,
+                         module != NULL, &caller)) {
+        break;
+      }
+    }
+    // Return address is undefined in the outermost frame.
+    if (!caller.has(DWARF_REGISTER_PC) || !caller.has(DWARF_REGISTER_SP)) {
+      break;
+    }
+    // Stack grows down, so callers' frames are at higher addresses.
+    if (caller.sp() < frame.sp() ||
+        (caller.sp() == frame.sp() && caller.pc() == frame.pc())) {
+      break;
+    }
+    is_exact = is_signal_frame;
+    uint64_t next_address = is_exact ? caller.pc() : caller.pc() - 1;
+    if (caller.pc() == 0 ||
+        module_table_find(modules_, next_address) == NULL) {
+      break;
+    }
+    frame = caller;
+  }
+}
+
+bool remote_backtrace_capture(int pid,
+                              vector<Module> *modules,
+                              vector<RemoteThreadStackTrace> *threads) {
+  threads->clear();
+  if (pid == getpid()) {
+    // Threads of the own process can not be traced.
+    return false;
+  }
+  if (!module_table_load(pid, modules)) {
+    return false;
+  }
+  char task_path[64];
+  snprintf(task_path, sizeof(task_path), "/proc/%d/task", pid);
+  DIR *dir = opendir(task_path);
+  if (dir == NULL) {
+    return false;
+  }
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL) {
+    if (entry->d_name[0] != '.') {
+      RemoteThreadStackTrace thread;
+      thread.tid = atol(entry->d_name);
+      threads->push_back(thread);
+    }
+  }
+  closedir(dir);
+  RemoteUnwinder unwinder(*modules);
+  DwarfRegisters registers;
+  RemoteStack stack;
+  for (size_t i = 0; i < threads->size(); ++i) {
+    RemoteThreadStackTrace& thread = (*threads)[i];
+    thread.name = thread_name_get(pid, thread.tid);
+    if (thread_capture(pid, thread.tid, &registers, &stack)) {
+      unwinder.unwind(registers, stack, &thread.stacktrace);
+      thread.captured = true;
+    }
+  }
+  return true;
+}
+
+string remote_backtrace_format(const vector<Module>& modules,
+                               const vector<RemoteThreadStackTrace>& threads) {
+  Symbolize *symbolize = symbolize_create_elf_modules(modules);
+  std::stringstream ss;
+  for (size_t i = 0; i < threads.size(); ++i) {
+    const RemoteThreadStackTrace& thread = threads[i];
+    ss << "Thread " << thread.tid;
+    if (!thread.name.empty()) {
+      ss << " (" << thread.name << ")";
+    }
+    if (!thread.captured) {
+      ss << ":\n        (could not be captured)\n";
+      continue;
+    }
+    ss << ":\n";
+    symbolize->resolve(thread.stacktrace);
+    ss << symbolize_format(*symbolize);
+  }
+  delete symbolize;
+  return ss.str();
+}
+
+}  // namespace internal
+}  // namespace bt
+
+#endif  // BACKTRACE_HAS_REMOTE_BACKTRACE
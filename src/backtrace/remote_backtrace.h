@@ -0,0 +1,143 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef __REMOTE_BACKTRACE_H__
+#define __REMOTE_BACKTRACE_H__
+
+#include <stdint.h>
+
+#include "backtrace/backtrace_util.h"
+#include "backtrace/dwarf_frame.h"
+#include "backtrace/elf_file.h"
+#include "backtrace/module_table.h"
+#include "backtrace/stacktrace.h"
+
+#if defined(__linux__) && defined(BACKTRACE_HAS_DWARF_FRAME)
+#  define BACKTRACE_HAS_REMOTE_BACKTRACE
+#endif
+
+#ifdef BACKTRACE_HAS_REMOTE_BACKTRACE
+
+// Number of bytes of every thread's stack copied for unwinding, starting
+// from its stack pointer.
+#ifndef BACKTRACE_REMOTE_STACK_SIZE
+#  define BACKTRACE_REMOTE_STACK_SIZE (256 * 1024)
+#endif
+
+namespace bt {
+namespace internal {
+
+// Copy of the top of a thread's stack.
+struct RemoteStack : public DwarfMemory {
+  uintptr_t start;
+  vector<char> data;
+
+  RemoteStack()
+  : start(0) {}
+
+  // Read a word at given address of the original stack, returns false if
+  // it is outside of the copy.
+  bool read_word(uint64_t address, uint64_t *value) const;
+};
+
+// Unwinder of the stack copies of another process, or of a past run of
+// this one.
+//
+// Frames are unwound using call frame information of the modules: from
+// .eh_frame, which every loaded object has unless it was explicitly
+// stripped, or from .debug_frame. Frames of code without it are unwound
+// by following frame pointers. Top frame outside of any module is taken
+// to be a call through an invalid pointer, so its return address is the
+// word at the stack pointer, or the link register on AArch64.
+//
+// Objects are opened on the first frame which needs them and are kept
+// for the lifetime of the unwinder. Walk stops once return address does
+// not belong to any of the modules.
+class RemoteUnwinder {
+ public:
+  explicit RemoteUnwinder(const vector<Module>& modules);
+  ~RemoteUnwinder();
+
+  void unwind(const DwarfRegisters& registers,
+              const RemoteStack& stack,
+              StackTraceAddresses *stacktrace);
+
+ private:
+  struct Object {
+    ElfFile elf;
+    DwarfFrameTable *table;
+  };
+
+  // RemoteUnwinder is not copyable.
+  RemoteUnwinder(const RemoteUnwinder& other);
+  RemoteUnwinder& operator=(const RemoteUnwinder& other);
+
+  // Get frame table of the module, NULL if object could not be opened.
+  const DwarfFrameTable *table_get(const Module& module);
+
+  // Unwind frame which has no call frame information.
+  bool fallback_step(const DwarfRegisters& frame,
+                     const RemoteStack& stack,
+                     bool is_top,
+                     bool in_module,
+                     DwarfRegisters *caller) const;
+
+  vector<Module> modules_;
+  map<string, Object *> objects_;
+};
+
+// Stack trace of a single thread of another process.
+struct RemoteThreadStackTrace {
+  long tid;
+  string name;
+  // False if thread could not be attached to or has exited meanwhile.
+  bool captured;
+  // Addresses in the address space of the traced process.
+  StackTraceAddresses stacktrace;
+
+  RemoteThreadStackTrace()
+  : tid(0),
+    captured(false) {}
+};
+
+// Capture stack traces of all threads of another process.
+//
+// Threads are stopped one at a time with PTRACE_SEIZE and PTRACE_INTERRUPT,
+// just long enough to read registers and copy top of the stack with a
+// single process_vm_readv() call. Unwinding happens after the thread is
+// detached, see RemoteUnwinder.
+//
+// Loaded objects of the process are stored in the modules, so the traces
+// could be symbolized later on.
+bool remote_backtrace_capture(int pid,
+                              vector<Module> *modules,
+                              vector<RemoteThreadStackTrace> *threads);
+
+// Symbolize traces using objects of the traced process and format them as
+// a human-readable text.
+string remote_backtrace_format(const vector<Module>& modules,
+                               const vector<RemoteThreadStackTrace>& threads);
+
+}  // namespace internal
+}  // namespace bt
+
+#endif  // BACKTRACE_HAS_REMOTE_BACKTRACE
+
+#endif  // __REMOTE_BACKTRACE_H__
@@ -0,0 +1,516 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "backtrace/sampler.h"
+
+#ifdef BACKTRACE_HAS_SAMPLER
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <execinfo.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+// Maximum number of frames in a sample.
+#define MAX_SAMPLE_DEPTH 64
+
+// Interval at which samples of the process-wide profile are drained.
+#define PROFILE_DRAIN_INTERVAL_NS 100000000ULL
+
+// Number of data pages of every perf event ring buffer, must be a power of
+// two.
+#define NUM_PERF_DATA_PAGES 8
+
+// Number of slots in the ring of the signal backend.
+#define NUM_SIGNAL_SLOTS 1024
+
+// Frames of the signal handler and signal trampoline.
+#define HANDLER_FRAMES 2
+
+namespace bt {
+
+struct Sampler::PerfEvent {
+  int fd;
+  char *buffer;
+  size_t buffer_size;
+};
+
+struct Sampler::SignalSlot {
+  enum State {
+    FREE,
+    WRITING,
+    READY,
+  };
+  volatile int state;
+  int depth;
+  void *frames[MAX_SAMPLE_DEPTH + HANDLER_FRAMES];
+};
+
+namespace {
+
+// Sampler which currently owns SIGPROF.
+Sampler *volatile signal_sampler = NULL;
+// Number of signal handlers which might be accessing the sampler.
+volatile int num_active_handlers = 0;
+
+vector<long> thread_ids_get() {
+  vector<long> tids;
+  DIR *dir = opendir("/proc/self/task");
+  if (dir == NULL) {
+    return tids;
+  }
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL) {
+    if (entry->d_name[0] != '.') {
+      tids.push_back(atol(entry->d_name));
+    }
+  }
+  closedir(dir);
+  return tids;
+}
+
+}  // namespace
+
+Sampler::Sampler(int frequency)
+    : frequency_(frequency),
+      backend_(BACKEND_NONE),
+      num_lost_(0),
+      page_size_(sysconf(_SC_PAGESIZE)),
+      signal_slots_(NULL),
+      signal_action_saved_(false),
+      signal_write_position_(0),
+      signal_num_lost_(0) {
+}
+
+Sampler::~Sampler() {
+  stop();
+}
+
+bool Sampler::start(bool allow_perf_events) {
+  if (backend_ != BACKEND_NONE) {
+    return true;
+  }
+  if (allow_perf_events && perf_events_start()) {
+    backend_ = BACKEND_PERF_EVENTS;
+    return true;
+  }
+  if (signal_start()) {
+    backend_ = BACKEND_SIGNAL;
+    return true;
+  }
+  return false;
+}
+
+void Sampler::stop() {
+  switch (backend_) {
+    case BACKEND_PERF_EVENTS:
+      perf_events_stop();
+      break;
+    case BACKEND_SIGNAL:
+      signal_stop();
+      break;
+    case BACKEND_NONE:
+      break;
+  }
+  backend_ = BACKEND_NONE;
+}
+
+size_t Sampler::read(vector<StackTraceAddresses> *samples) {
+  switch (backend_) {
+    case BACKEND_PERF_EVENTS:
+      return perf_events_read(samples);
+    case BACKEND_SIGNAL:
+      return signal_read(samples);
+    case BACKEND_NONE:
+      break;
+  }
+  return 0;
+}
+
+size_t Sampler::read(CallingContextTree *tree) {
+  vector<StackTraceAddresses> samples;
+  size_t num_samples = read(&samples);
+  for (size_t i = 0; i < samples.size(); ++i) {
+    tree->add(samples[i]);
+  }
+  return num_samples;
+}
+
+uint64_t Sampler::num_lost() const {
+  return num_lost_ + signal_num_lost_;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Perf events backend.
+
+bool Sampler::perf_events_start() {
+  vector<long> tids = thread_ids_get();
+  for (size_t i = 0; i < tids.size(); ++i) {
+    if (!perf_event_open(tids[i])) {
+      // Threads might exit meanwhile, but failing to open event for the
+      // calling thread means perf events are not permitted.
+      if (tids[i] == syscall(SYS_gettid) || errno == EACCES ||
+          errno == EPERM || errno == ENOSYS || errno == ENOENT) {
+        perf_events_stop();
+        return false;
+      }
+    }
+  }
+  return !perf_events_.empty();
+}
+
+bool Sampler::perf_event_open(long tid) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_SOFTWARE;
+  attr.config = PERF_COUNT_SW_TASK_CLOCK;
+  attr.sample_freq = frequency_;
+  attr.freq = 1;
+  attr.sample_type = PERF_SAMPLE_TID | PERF_SAMPLE_CALLCHAIN;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.exclude_callchain_kernel = 1;
+  attr.sample_max_stack = MAX_SAMPLE_DEPTH;
+  int fd = (int)syscall(SYS_perf_event_open, &attr, tid, -1, -1,
+                        PERF_FLAG_FD_CLOEXEC);
+  if (fd == -1) {
+    return false;
+  }
+  size_t buffer_size = (NUM_PERF_DATA_PAGES + 1) * page_size_;
+  void *buffer = mmap(NULL, buffer_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED, fd, 0);
+  if (buffer == MAP_FAILED) {
+    int saved_errno = errno;
+    close(fd);
+    errno = saved_errno;
+    return false;
+  }
+  PerfEvent *event = new PerfEvent();
+  event->fd = fd;
+  event->buffer = reinterpret_cast<char *>(buffer);
+  event->buffer_size = buffer_size;
+  perf_events_[tid] = event;
+  ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+  return true;
+}
+
+void Sampler::perf_events_update() {
+  // Open events for threads which were created since the last read, and
+  // close events of threads which are gone.
+  vector<long> tids = thread_ids_get();
+  map<long, bool> alive;
+  for (size_t i = 0; i < tids.size(); ++i) {
+    alive[tids[i]] = true;
+    if (perf_events_.find(tids[i]) == perf_events_.end()) {
+      perf_event_open(tids[i]);
+    }
+  }
+  map<long, PerfEvent *>::iterator it = perf_events_.begin();
+  while (it != perf_events_.end()) {
+    if (alive.find(it->first) == alive.end()) {
+      PerfEvent *event = it->second;
+      munmap(event->buffer, event->buffer_size);
+      close(event->fd);
+      delete event;
+      perf_events_.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void Sampler::perf_events_stop() {
+  for (map<long, PerfEvent *>::iterator it = perf_events_.begin();
+       it != perf_events_.end();
+       ++it) {
+    PerfEvent *event = it->second;
+    munmap(event->buffer, event->buffer_size);
+    close(event->fd);
+    delete event;
+  }
+  perf_events_.clear();
+}
+
+size_t Sampler::perf_events_read(vector<StackTraceAddresses> *samples) {
+  size_t num_samples = samples->size();
+  // Drain all the buffers before closing events of exited threads, so their
+  // last samples are not lost.
+  for (map<long, PerfEvent *>::iterator it = perf_events_.begin();
+       it != perf_events_.end();
+       ++it) {
+    perf_event_drain(it->second, samples);
+  }
+  perf_events_update();
+  return samples->size() - num_samples;
+}
+
+void Sampler::perf_event_drain(PerfEvent *event,
+                               vector<StackTraceAddresses> *samples) {
+  struct perf_event_mmap_page *meta =
+      reinterpret_cast<struct perf_event_mmap_page *>(event->buffer);
+  const char *data = event->buffer + page_size_;
+  const uint64_t data_size = NUM_PERF_DATA_PAGES * page_size_;
+  uint64_t head = __atomic_load_n(&meta->data_head, __ATOMIC_ACQUIRE);
+  uint64_t tail = meta->data_tail;
+  while (tail < head) {
+    // Records might wrap around the end of the buffer, so they are copied
+    // into a contiguous buffer first.
+    struct perf_event_header header;
+    for (size_t i = 0; i < sizeof(header); ++i) {
+      reinterpret_cast<char *>(&header)[i] = data[(tail + i) % data_size];
+    }
+    if (header.size < sizeof(header) || tail + header.size > head) {
+      break;
+    }
+    record_buffer_.resize(header.size);
+    for (size_t i = 0; i < header.size; ++i) {
+      record_buffer_[i] = data[(tail + i) % data_size];
+    }
+    const char *record = &record_buffer_[0] + sizeof(header);
+    if (header.type == PERF_RECORD_SAMPLE) {
+      // Layout for PERF_SAMPLE_TID | PERF_SAMPLE_CALLCHAIN:
+      // u32 pid, tid; u64 nr; u64 ips[nr].
+      uint64_t nr;
+      memcpy(&nr, record + 8, sizeof(nr));
+      if (sizeof(header) + 16 + nr * 8 <= header.size) {
+        StackTraceAddresses stacktrace;
+        for (uint64_t i = 0; i < nr; ++i) {
+          uint64_t ip;
+          memcpy(&ip, record + 16 + i * 8, sizeof(ip));
+          // Skip context markers, such as PERF_CONTEXT_USER.
+          if (ip >= (uint64_t)PERF_CONTEXT_MAX) {
+            continue;
+          }
+          stacktrace.push_back(reinterpret_cast<void *>(ip));
+        }
+        samples->push_back(stacktrace);
+      }
+    } else if (header.type == PERF_RECORD_LOST) {
+      // u64 id, lost.
+      uint64_t lost;
+      memcpy(&lost, record + 8, sizeof(lost));
+      num_lost_ += lost;
+    }
+    tail += header.size;
+  }
+  __atomic_store_n(&meta->data_tail, tail, __ATOMIC_RELEASE);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Signal backend.
+
+bool Sampler::signal_start() {
+  if (!__sync_bool_compare_and_swap(&signal_sampler,
+                                    (Sampler *)NULL,
+                                    this)) {
+    return false;
+  }
+  // Make sure unwinder is loaded, so backtrace() does not allocate memory
+  // from within signal handler.
+  void *dummy[1];
+  backtrace(dummy, 1);
+  signal_slots_ = new SignalSlot[NUM_SIGNAL_SLOTS];
+  for (size_t i = 0; i < NUM_SIGNAL_SLOTS; ++i) {
+    signal_slots_[i].state = SignalSlot::FREE;
+  }
+  __sync_synchronize();
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_sigaction = signal_handler;
+  action.sa_flags = SA_SIGINFO | SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  if (sigaction(SIGPROF, &action, &signal_old_action_) != 0) {
+    signal_stop();
+    return false;
+  }
+  signal_action_saved_ = true;
+  struct itimerval timer;
+  timer.it_interval.tv_sec = 0;
+  timer.it_interval.tv_usec = 1000000 / (frequency_ > 0 ? frequency_ : 1);
+  timer.it_value = timer.it_interval;
+  if (setitimer(ITIMER_PROF, &timer, NULL) != 0) {
+    signal_stop();
+    return false;
+  }
+  return true;
+}
+
+void Sampler::signal_stop() {
+  struct itimerval timer;
+  memset(&timer, 0, sizeof(timer));
+  setitimer(ITIMER_PROF, &timer, NULL);
+  if (signal_action_saved_) {
+    // Pending signals are ignored rather than killing the process if
+    // nobody handled them before.
+    if (!(signal_old_action_.sa_flags & SA_SIGINFO) &&
+        signal_old_action_.sa_handler == SIG_DFL) {
+      signal(SIGPROF, SIG_IGN);
+    } else {
+      sigaction(SIGPROF, &signal_old_action_, NULL);
+    }
+    signal_action_saved_ = false;
+  }
+  // Make sure no handler is touching the slots before they are freed,
+  // late handlers will see there's no sampler.
+  signal_sampler = NULL;
+  __sync_synchronize();
+  while (num_active_handlers != 0) {
+    sched_yield();
+  }
+  delete [] signal_slots_;
+  signal_slots_ = NULL;
+}
+
+size_t Sampler::signal_read(vector<StackTraceAddresses> *samples) {
+  size_t num_samples = 0;
+  for (size_t i = 0; i < NUM_SIGNAL_SLOTS; ++i) {
+    SignalSlot& slot = signal_slots_[i];
+    if (slot.state != SignalSlot::READY) {
+      continue;
+    }
+    __sync_synchronize();
+    if (slot.depth > HANDLER_FRAMES) {
+      samples->push_back(StackTraceAddresses(slot.frames + HANDLER_FRAMES,
+                                             slot.depth - HANDLER_FRAMES));
+      ++num_samples;
+    }
+    __sync_synchronize();
+    slot.state = SignalSlot::FREE;
+  }
+  return num_samples;
+}
+
+void Sampler::signal_handler(int /*signum*/,
+                             siginfo_t * /*info*/,
+                             void * /*ucontext*/) {
+  int saved_errno = errno;
+  __sync_fetch_and_add(&num_active_handlers, 1);
+  Sampler *sampler = signal_sampler;
+  if (sampler != NULL) {
+    uint32_t position =
+        __sync_fetch_and_add(&sampler->signal_write_position_, 1);
+    SignalSlot& slot = sampler->signal_slots_[position % NUM_SIGNAL_SLOTS];
+    if (__sync_bool_compare_and_swap(&slot.state,
+                                     SignalSlot::FREE,
+                                     SignalSlot::WRITING)) {
+      slot.depth = backtrace(slot.frames, MAX_SAMPLE_DEPTH + HANDLER_FRAMES);
+      __sync_synchronize();
+      slot.state = SignalSlot::READY;
+    } else {
+      __sync_fetch_and_add(&sampler->signal_num_lost_, 1);
+    }
+  }
+  __sync_fetch_and_sub(&num_active_handlers, 1);
+  errno = saved_errno;
+}
+
+namespace {
+
+// Serializes starting and stopping of the profile.
+internal::Mutex profile_control_mutex;
+// Protects all the state below.
+internal::Mutex profile_mutex;
+internal::ConditionVariable profile_cond;
+Sampler *profile_sampler = NULL;
+internal::Thread *profile_thread = NULL;
+bool profile_stopping = false;
+// Never destroyed, so the profile could be read at exit.
+CallingContextTree *profile_tree = NULL;
+
+void profile_drain(void * /*arg*/) {
+  internal::MutexLock lock(&profile_mutex);
+  while (!profile_stopping) {
+    profile_cond.wait_for(&profile_mutex, PROFILE_DRAIN_INTERVAL_NS);
+    profile_sampler->read(profile_tree);
+  }
+}
+
+}  // namespace
+
+bool sampler_profile_start(int frequency) {
+  internal::MutexLock control_lock(&profile_control_mutex);
+  {
+    internal::MutexLock lock(&profile_mutex);
+    if (profile_sampler != NULL) {
+      return false;
+    }
+    Sampler *sampler = new Sampler(frequency);
+    if (!sampler->start()) {
+      delete sampler;
+      return false;
+    }
+    if (profile_tree == NULL) {
+      profile_tree = new CallingContextTree();
+    }
+    profile_sampler = sampler;
+    profile_stopping = false;
+  }
+  profile_thread = new internal::Thread(profile_drain, NULL);
+  if (!profile_thread->start()) {
+    delete profile_thread;
+    profile_thread = NULL;
+    internal::MutexLock lock(&profile_mutex);
+    delete profile_sampler;
+    profile_sampler = NULL;
+    return false;
+  }
+  return true;
+}
+
+void sampler_profile_stop() {
+  internal::MutexLock control_lock(&profile_control_mutex);
+  {
+    internal::MutexLock lock(&profile_mutex);
+    if (profile_sampler == NULL) {
+      return;
+    }
+    profile_stopping = true;
+    profile_cond.notify_all();
+  }
+  profile_thread->join();
+  delete profile_thread;
+  profile_thread = NULL;
+  internal::MutexLock lock(&profile_mutex);
+  // Samples which were taken since the last drain.
+  profile_sampler->read(profile_tree);
+  delete profile_sampler;
+  profile_sampler = NULL;
+}
+
+void sampler_profile_get(CallingContextTree *tree) {
+  internal::MutexLock lock(&profile_mutex);
+  if (profile_sampler != NULL) {
+    profile_sampler->read(profile_tree);
+  }
+  if (profile_tree != NULL) {
+    tree->merge(*profile_tree);
+  }
+}
+
+}  // namespace bt
+
+#endif  // BACKTRACE_HAS_SAMPLER
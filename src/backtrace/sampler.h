@@ -0,0 +1,135 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef __SAMPLER_H__
+#define __SAMPLER_H__
+
+#include <signal.h>
+#include <stdint.h>
+
+#include "backtrace/backtrace_util.h"
+#include "backtrace/calling_context_tree.h"
+#include "backtrace/stacktrace.h"
+
+#if defined(__linux__) && defined(BACKTRACE_HAS_EXECINFO)
+#  define BACKTRACE_HAS_SAMPLER
+#endif
+
+#ifdef BACKTRACE_HAS_SAMPLER
+
+namespace bt {
+
+// Periodically samples stacks of all threads of the process.
+//
+// Preferred backend is perf events: a task-clock event with callchain
+// sampling is opened for every thread, so stacks are captured by the kernel
+// and the process only drains the ring buffers. Kernel follows frame
+// pointers, so code built without them gives truncated stacks.
+//
+// If perf events are not permitted (see perf_event_paranoid), sampler falls
+// back to a SIGPROF interval timer whose handler unwinds with backtrace()
+// into a preallocated ring of slots.
+//
+// Samples are to be read periodically, samples which do not fit into the
+// buffers are dropped and counted as lost.
+class Sampler {
+ public:
+  enum Backend {
+    BACKEND_NONE,
+    BACKEND_PERF_EVENTS,
+    BACKEND_SIGNAL,
+  };
+
+  // Frequency of sampling in samples per second of CPU time.
+  explicit Sampler(int frequency = 99);
+  ~Sampler();
+
+  // Start sampling, returns false if neither of backends is available or
+  // another sampler already uses the signal backend.
+  bool start(bool allow_perf_events = true);
+  void stop();
+
+  Backend backend() const { return backend_; }
+
+  // Append samples collected since the previous call, innermost frame
+  // first. Returns number of appended samples.
+  size_t read(vector<StackTraceAddresses> *samples);
+
+  // Add samples collected since the previous call to the tree, with value
+  // of one per sample.
+  size_t read(CallingContextTree *tree);
+
+  // Number of samples which were dropped because buffers were full.
+  uint64_t num_lost() const;
+
+ private:
+  struct PerfEvent;
+  struct SignalSlot;
+
+  bool perf_events_start();
+  void perf_events_update();
+  void perf_events_stop();
+  size_t perf_events_read(vector<StackTraceAddresses> *samples);
+  bool perf_event_open(long tid);
+  void perf_event_drain(PerfEvent *event,
+                        vector<StackTraceAddresses> *samples);
+
+  bool signal_start();
+  void signal_stop();
+  size_t signal_read(vector<StackTraceAddresses> *samples);
+  static void signal_handler(int signum, siginfo_t *info, void *ucontext);
+
+  int frequency_;
+  Backend backend_;
+  uint64_t num_lost_;
+
+  // Perf events backend.
+  map<long, PerfEvent *> perf_events_;
+  size_t page_size_;
+  vector<char> record_buffer_;
+
+  // Signal backend.
+  SignalSlot *signal_slots_;
+  // Action of SIGPROF before the sampler took it over.
+  struct sigaction signal_old_action_;
+  bool signal_action_saved_;
+  volatile uint32_t signal_write_position_;
+  volatile int signal_num_lost_;
+};
+
+// Process-wide profile, which is sampled into a calling-context tree with
+// value of one per sample. Samples are drained by a thread of its own,
+// often enough for the buffers not to overflow.
+
+// Start profiling, returns false if sampler is not available or profile
+// is being sampled already.
+bool sampler_profile_start(int frequency);
+
+// Stop sampling, collected samples are kept.
+void sampler_profile_stop();
+
+// Merge all the collected samples into the given tree.
+void sampler_profile_get(CallingContextTree *tree);
+
+}  // namespace bt
+
+#endif  // BACKTRACE_HAS_SAMPLER
+
+#endif  // __SAMPLER_H__
@@ -0,0 +1,429 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "backtrace/section_cache.h"
+
+#ifdef BACKTRACE_HAS_ELF
+
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef BACKTRACE_HAS_ZLIB
+#  include <zlib.h>
+#endif
+#ifdef BACKTRACE_HAS_ZSTD
+#  include <zstd.h>
+#endif
+
+// Default maximum size of decompressed data kept in the cache.
+#define DEFAULT_CAPACITY (64 * 1024 * 1024)
+
+// Number of bytes decompressed at a time.
+#define CHUNK_SIZE (256 * 1024)
+
+namespace bt {
+namespace internal {
+
+struct SectionCache::Entry {
+  Key key;
+  ElfFile::Compression compression;
+  // Buffer for the whole uncompressed section. Pages are only touched
+  // when data gets decompressed into them.
+  unsigned char *buffer;
+  uint64_t total_size;
+  // Number of bytes which were decompressed so far.
+  uint64_t decompressed;
+  // Number of compressed bytes consumed so far.
+  uint64_t consumed;
+  // Decompressor state, alive until the whole section is decompressed.
+  void *stream;
+  bool failed;
+  int refcount;
+  uint64_t last_use;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// SectionView.
+
+SectionView::SectionView()
+    : elf_(NULL),
+      section_(NULL),
+      entry_(NULL),
+      size_(0) {
+}
+
+SectionView::SectionView(const ElfFile *elf, const ElfSection *section)
+    : elf_(elf),
+      section_(section),
+      entry_(NULL),
+      size_(0) {
+  if (elf_ == NULL || section_ == NULL) {
+    return;
+  }
+  switch (elf_->compression(*section_)) {
+    case ElfFile::COMPRESSION_NONE:
+      size_ = section_->size;
+      break;
+    case ElfFile::COMPRESSION_ZLIB:
+    case ElfFile::COMPRESSION_ZSTD:
+      entry_ = SectionCache::instance().acquire(*elf_, *section_);
+      if (entry_ != NULL) {
+        size_ = elf_->uncompressed_size(*section_);
+      }
+      break;
+    case ElfFile::COMPRESSION_UNKNOWN:
+      break;
+  }
+}
+
+SectionView::SectionView(const SectionView& other)
+    : elf_(other.elf_),
+      section_(other.section_),
+      entry_(other.entry_),
+      size_(other.size_) {
+  if (entry_ != NULL) {
+    SectionCache::instance().acquire(
+        reinterpret_cast<SectionCache::Entry *>(entry_));
+  }
+}
+
+SectionView::~SectionView() {
+  reset();
+}
+
+SectionView& SectionView::operator=(const SectionView& other) {
+  if (this != &other) {
+    if (other.entry_ != NULL) {
+      SectionCache::instance().acquire(
+          reinterpret_cast<SectionCache::Entry *>(other.entry_));
+    }
+    reset();
+    elf_ = other.elf_;
+    section_ = other.section_;
+    entry_ = other.entry_;
+    size_ = other.size_;
+  }
+  return *this;
+}
+
+void SectionView::reset() {
+  if (entry_ != NULL) {
+    SectionCache::instance().release(
+        reinterpret_cast<SectionCache::Entry *>(entry_));
+  }
+  elf_ = NULL;
+  section_ = NULL;
+  entry_ = NULL;
+  size_ = 0;
+}
+
+const unsigned char *SectionView::data(uint64_t offset, uint64_t size) const {
+  if (offset > size_ || size > size_ - offset) {
+    return NULL;
+  }
+  if (entry_ == NULL) {
+    return elf_->raw_data(*section_) + offset;
+  }
+  const unsigned char *buffer = SectionCache::instance().data(
+      reinterpret_cast<SectionCache::Entry *>(entry_),
+      *elf_, *section_,
+      offset + size);
+  return buffer != NULL ? buffer + offset : NULL;
+}
+
+string SectionView::string_at(uint64_t offset) const {
+  if (offset >= size_) {
+    return "";
+  }
+  // Strings are short, so avoid asking for more data than needed, which
+  // matters for compressed sections.
+  uint64_t size = 64;
+  for (;;) {
+    if (size > size_ - offset) {
+      size = size_ - offset;
+    }
+    const char *str = reinterpret_cast<const char *>(data(offset, size));
+    if (str == NULL) {
+      return "";
+    }
+    const void *end = memchr(str, 0, size);
+    if (end != NULL) {
+      return string(str, (const char *)end - str);
+    }
+    if (offset + size == size_) {
+      return "";
+    }
+    size *= 2;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// SectionCache.
+
+SectionCache& SectionCache::instance() {
+  // Never destroyed, so the cache is usable from destructors of other
+  // static objects.
+  static SectionCache *cache = new SectionCache();
+  return *cache;
+}
+
+SectionCache::SectionCache()
+    : capacity_(DEFAULT_CAPACITY),
+      size_(0),
+      clock_(0) {
+}
+
+SectionCache::~SectionCache() {
+  for (EntryMap::iterator it = entries_.begin();
+       it != entries_.end();
+       ++it) {
+    free_entry(it->second);
+  }
+}
+
+void SectionCache::set_capacity(size_t capacity) {
+  MutexLock lock(&mutex_);
+  capacity_ = capacity;
+  evict();
+}
+
+void SectionCache::clear() {
+  MutexLock lock(&mutex_);
+  EntryMap::iterator it = entries_.begin();
+  while (it != entries_.end()) {
+    if (it->second->refcount == 0) {
+      free_entry(it->second);
+      entries_.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+}
+
+SectionCache::Entry *SectionCache::acquire(const ElfFile& elf,
+                                           const ElfSection& section) {
+  MutexLock lock(&mutex_);
+  Key key;
+  key.file_id = elf.id();
+  key.section_offset = section.offset;
+  EntryMap::iterator it = entries_.find(key);
+  if (it != entries_.end()) {
+    Entry *entry = it->second;
+    ++entry->refcount;
+    entry->last_use = ++clock_;
+    return entry;
+  }
+  uint64_t total_size = elf.uncompressed_size(section);
+  if (total_size == 0 || total_size != (size_t)total_size) {
+    return NULL;
+  }
+  unsigned char *buffer =
+      reinterpret_cast<unsigned char *>(malloc(total_size));
+  if (buffer == NULL) {
+    return NULL;
+  }
+  Entry *entry = new Entry();
+  entry->key = key;
+  entry->compression = elf.compression(section);
+  entry->buffer = buffer;
+  entry->total_size = total_size;
+  entry->decompressed = 0;
+  entry->consumed = 0;
+  entry->stream = NULL;
+  entry->failed = false;
+  entry->refcount = 1;
+  entry->last_use = ++clock_;
+  entries_[key] = entry;
+  return entry;
+}
+
+void SectionCache::acquire(Entry *entry) {
+  MutexLock lock(&mutex_);
+  ++entry->refcount;
+}
+
+void SectionCache::release(Entry *entry) {
+  MutexLock lock(&mutex_);
+  assert(entry->refcount > 0);
+  --entry->refcount;
+  evict();
+}
+
+const unsigned char *SectionCache::data(Entry *entry,
+                                        const ElfFile& elf,
+                                        const ElfSection& section,
+                                        uint64_t end) {
+  MutexLock lock(&mutex_);
+  entry->last_use = ++clock_;
+  while (entry->decompressed < end) {
+    if (entry->failed) {
+      return NULL;
+    }
+    uint64_t decompressed = entry->decompressed;
+    bool ok = decompress_chunk(entry, elf, section);
+    size_ += entry->decompressed - decompressed;
+    if (!ok) {
+      entry->failed = true;
+      return NULL;
+    }
+  }
+  evict();
+  return entry->buffer;
+}
+
+bool SectionCache::decompress_chunk(Entry *entry,
+                                    const ElfFile& elf,
+                                    const ElfSection& section) {
+  const unsigned char *input = elf.raw_data(section);
+  uint64_t input_size = elf.raw_size(section);
+  uint64_t chunk_size = entry->total_size - entry->decompressed;
+  if (chunk_size > CHUNK_SIZE) {
+    chunk_size = CHUNK_SIZE;
+  }
+  switch (entry->compression) {
+#ifdef BACKTRACE_HAS_ZLIB
+    case ElfFile::COMPRESSION_ZLIB: {
+      z_stream *stream = reinterpret_cast<z_stream *>(entry->stream);
+      if (stream == NULL) {
+        stream = new z_stream();
+        memset(stream, 0, sizeof(*stream));
+        if (inflateInit(stream) != Z_OK) {
+          delete stream;
+          return false;
+        }
+        entry->stream = stream;
+      }
+      // Input pointer is re-set every time, since the mapping belongs to
+      // the ElfFile and could be different from the previous call.
+      uint64_t available = input_size - entry->consumed;
+      stream->next_in = const_cast<Bytef *>(input + entry->consumed);
+      stream->avail_in = (uInt)(available > UINT_MAX ? UINT_MAX : available);
+      stream->next_out = entry->buffer + entry->decompressed;
+      stream->avail_out = (uInt)chunk_size;
+      uInt avail_in = stream->avail_in;
+      int result = inflate(stream, Z_SYNC_FLUSH);
+      entry->consumed += avail_in - stream->avail_in;
+      entry->decompressed += chunk_size - stream->avail_out;
+      if (result == Z_STREAM_END ||
+          entry->decompressed == entry->total_size) {
+        inflateEnd(stream);
+        delete stream;
+        entry->stream = NULL;
+        return entry->decompressed == entry->total_size;
+      }
+      return result == Z_OK;
+    }
+#endif
+#ifdef BACKTRACE_HAS_ZSTD
+    case ElfFile::COMPRESSION_ZSTD: {
+      ZSTD_DStream *stream = reinterpret_cast<ZSTD_DStream *>(entry->stream);
+      if (stream == NULL) {
+        stream = ZSTD_createDStream();
+        if (stream == NULL) {
+          return false;
+        }
+        ZSTD_initDStream(stream);
+        entry->stream = stream;
+      }
+      ZSTD_inBuffer in = {input, (size_t)input_size, (size_t)entry->consumed};
+      ZSTD_outBuffer out = {entry->buffer,
+                            (size_t)(entry->decompressed + chunk_size),
+                            (size_t)entry->decompressed};
+      size_t result = 0;
+      // Decompressor might consume frame header without producing any
+      // output, so keep going until there is some progress.
+      while (out.pos == entry->decompressed && in.pos < in.size) {
+        result = ZSTD_decompressStream(stream, &out, &in);
+        if (ZSTD_isError(result)) {
+          return false;
+        }
+      }
+      bool progress = out.pos != entry->decompressed;
+      entry->consumed = in.pos;
+      entry->decompressed = out.pos;
+      if (result == 0 || entry->decompressed == entry->total_size) {
+        ZSTD_freeDStream(stream);
+        entry->stream = NULL;
+        return entry->decompressed == entry->total_size;
+      }
+      return progress;
+    }
+#endif
+    default:
+      (void) input;
+      (void) input_size;
+      (void) chunk_size;
+      return false;
+  }
+}
+
+void SectionCache::free_entry(Entry *entry) {
+  if (entry->stream != NULL) {
+    switch (entry->compression) {
+#ifdef BACKTRACE_HAS_ZLIB
+      case ElfFile::COMPRESSION_ZLIB: {
+        z_stream *stream = reinterpret_cast<z_stream *>(entry->stream);
+        inflateEnd(stream);
+        delete stream;
+        break;
+      }
+#endif
+#ifdef BACKTRACE_HAS_ZSTD
+      case ElfFile::COMPRESSION_ZSTD:
+        ZSTD_freeDStream(reinterpret_cast<ZSTD_DStream *>(entry->stream));
+        break;
+#endif
+      default:
+        break;
+    }
+  }
+  size_ -= entry->decompressed;
+  free(entry->buffer);
+  delete entry;
+}
+
+void SectionCache::evict() {
+  while (size_ > capacity_) {
+    EntryMap::iterator victim = entries_.end();
+    for (EntryMap::iterator it = entries_.begin();
+         it != entries_.end();
+         ++it) {
+      if (it->second->refcount != 0) {
+        continue;
+      }
+      if (victim == entries_.end() ||
+          it->second->last_use < victim->second->last_use) {
+        victim = it;
+      }
+    }
+    if (victim == entries_.end()) {
+      // Everything is in use, nothing to be evicted.
+      return;
+    }
+    free_entry(victim->second);
+    entries_.erase(victim);
+  }
+}
+
+}  // namespace internal
+}  // namespace bt
+
+#endif  // BACKTRACE_HAS_ELF
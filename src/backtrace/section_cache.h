@@ -0,0 +1,145 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef __SECTION_CACHE_H__
+#define __SECTION_CACHE_H__
+
+#include "backtrace/backtrace_util.h"
+#include "backtrace/elf_file.h"
+
+#ifdef BACKTRACE_HAS_ELF
+
+namespace bt {
+namespace internal {
+
+class SectionCache;
+
+// Contents of an ELF section.
+//
+// Uncompressed sections are accessed directly from the file mapping.
+// Compressed ones are decompressed lazily, in chunks, only up to the
+// offset which was actually requested. Decompressed data lives in the
+// SectionCache, so it is shared by all the lookups and symbolizers which
+// are dealing with the same object. Data stays pinned in the cache for as
+// long as there are views referencing it.
+class SectionView {
+ public:
+  SectionView();
+  SectionView(const ElfFile *elf, const ElfSection *section);
+  SectionView(const SectionView& other);
+  ~SectionView();
+
+  SectionView& operator=(const SectionView& other);
+
+  // Check whether view points to a section which contents can be read.
+  bool is_valid() const { return size_ != 0; }
+
+  // Size of the section contents, after decompression.
+  uint64_t size() const { return size_; }
+
+  // Get pointer to at least size bytes of the section contents starting
+  // at the given offset. Returns NULL if the range is outside of the
+  // section or if decompression has failed.
+  //
+  // Pointer stays valid for as long as the view exists.
+  const unsigned char *data(uint64_t offset, uint64_t size) const;
+
+  // Read null-terminated string at the given offset, empty string is
+  // returned if there's no terminator within the section.
+  string string_at(uint64_t offset) const;
+
+ private:
+  friend class SectionCache;
+
+  void reset();
+
+  const ElfFile *elf_;
+  const ElfSection *section_;
+  // Cache entry with the decompressed data, NULL for sections which are
+  // stored uncompressed.
+  void *entry_;
+  uint64_t size_;
+};
+
+// Bounded cache of decompressed sections, shared across the process.
+//
+// When total size of decompressed data goes above the capacity least
+// recently used sections which are not referenced by any view are freed.
+class SectionCache {
+ public:
+  static SectionCache& instance();
+
+  // Set maximum number of bytes of decompressed data to be kept around.
+  void set_capacity(size_t capacity);
+  size_t capacity() const { return capacity_; }
+
+  // Number of bytes of decompressed data currently in the cache.
+  size_t size() const { return size_; }
+
+  // Free all the sections which are not currently in use.
+  void clear();
+
+ private:
+  friend class SectionView;
+
+  struct Entry;
+  struct Key {
+    ElfFileId file_id;
+    uint64_t section_offset;
+
+    bool operator<(const Key& other) const {
+      if (section_offset != other.section_offset) {
+        return section_offset < other.section_offset;
+      }
+      return file_id < other.file_id;
+    }
+  };
+  typedef map<Key, Entry*> EntryMap;
+
+  SectionCache();
+  ~SectionCache();
+
+  Entry *acquire(const ElfFile& elf, const ElfSection& section);
+  void acquire(Entry *entry);
+  void release(Entry *entry);
+  const unsigned char *data(Entry *entry,
+                            const ElfFile& elf,
+                            const ElfSection& section,
+                            uint64_t end);
+
+  // Decompress next chunk of the entry, return false on error.
+  bool decompress_chunk(Entry *entry, const ElfFile& elf,
+                        const ElfSection& section);
+  void free_entry(Entry *entry);
+  void evict();
+
+  Mutex mutex_;
+  EntryMap entries_;
+  size_t capacity_;
+  size_t size_;
+  uint64_t clock_;
+};
+
+}  // namespace internal
+}  // namespace bt
+
+#endif  // BACKTRACE_HAS_ELF
+
+#endif  // __SECTION_CACHE_H__
@@ -28,7 +28,9 @@
 
 namespace bt {
 
-StackTrace *StackTrace::create() {
+namespace {
+
+StackTrace *stacktrace_create_native() {
 #if defined(BACKTRACE_HAS_STACK_WALK)
   return internal::stacktrace_create_stack_walk();
 #elif defined(BACKTRACE_HAS_CAPTURE_STACK_BACKTRACE)
@@ -40,6 +42,16 @@ StackTrace *StackTrace::create() {
 #endif
 }
 
+}  // namespace
+
+StackTrace *StackTrace::create() {
+#ifdef BACKTRACE_HAS_SHADOW_STACK
+  return internal::stacktrace_create_shadow_stack(stacktrace_create_native());
+#else
+  return stacktrace_create_native();
+#endif
+}
+
 void *StackTrace::current_addr_get(void *context) {
 #ifdef BACKTRACE_HAS_UCONTEXT
   ucontext_t *ucontext = reinterpret_cast<ucontext_t *>(context);
@@ -56,4 +68,20 @@ void *StackTrace::current_addr_get(void *context) {
   return NULL;
 }
 
+namespace internal {
+
+uint64_t stacktrace_hash(const StackTrace& stacktrace) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < stacktrace.size(); ++i) {
+    uintptr_t address = reinterpret_cast<uintptr_t>(stacktrace[i].address);
+    for (size_t j = 0; j < sizeof(address); ++j) {
+      hash ^= (address >> (j * 8)) & 0xff;
+      hash *= 1099511628211ULL;
+    }
+  }
+  return hash;
+}
+
+}  // namespace internal
+
 }  // namespace bt
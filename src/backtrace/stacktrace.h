@@ -23,6 +23,8 @@
 #ifndef __STACKTRACE_H__
 #define __STACKTRACE_H__
 
+#include <stdint.h>
+
 #include "backtrace/backtrace_util.h"
 
 namespace bt {
@@ -74,8 +76,49 @@ class StackTrace {
   virtual TraceEntry operator[](size_t index) const = 0;
 };
 
+// Stack trace which addresses were gathered elsewhere, for example by a
+// signal handler or received from another process.
+class StackTraceAddresses : public StackTrace {
+ public:
+  StackTraceAddresses() : StackTrace() {}
+
+  StackTraceAddresses(void * const *addresses, size_t size)
+  : StackTrace(),
+    addresses_(addresses, addresses + size) {}
+
+  // Addresses are never loaded by this trace, only number of known
+  // entries is returned.
+  size_t load(void * /*addr*/, size_t /*depth*/) {
+    return addresses_.size();
+  }
+
+  size_t size() const {
+    return addresses_.size();
+  }
+
+  TraceEntry operator[](size_t index) const {
+    assert(index < size());
+    TraceEntry entry(addresses_[index]);
+    return entry;
+  }
+
+  void push_back(void *address) {
+    addresses_.push_back(address);
+  }
+
+  void clear() {
+    addresses_.clear();
+  }
+
+ private:
+  vector<void*> addresses_;
+};
+
 namespace internal {
 
+// FNV-1a hash of all the addresses of the trace.
+uint64_t stacktrace_hash(const StackTrace& stacktrace);
+
 StackTrace *stacktrace_create_stub();
 
 #ifdef BACKTRACE_HAS_CAPTURE_STACK_BACKTRACE
@@ -90,6 +133,20 @@ StackTrace *stacktrace_create_stack_walk();
 StackTrace *stacktrace_create_execinfo();
 #endif
 
+#ifdef BACKTRACE_HAS_SHADOW_STACK
+// Maximum number of frames kept by the shadow stack of every thread, must
+// be a power of two. Only the innermost ones are kept for deeper stacks.
+#  ifndef BACKTRACE_SHADOW_STACK_DEPTH
+#    define BACKTRACE_SHADOW_STACK_DEPTH 256
+#  endif
+// Threads which did not enter any instrumented function are captured with
+// the fallback, which is owned by the returned trace.
+StackTrace *stacktrace_create_shadow_stack(StackTrace *fallback);
+
+// True if the calling thread is inside of an instrumented function.
+bool shadow_stack_is_active();
+#endif
+
 }  // namespace internal
 
 }  // namespace bt
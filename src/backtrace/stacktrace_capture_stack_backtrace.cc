@@ -27,6 +27,8 @@
 #include <windows.h>
 #include <limits.h>
 
+#include "backtrace/stats.h"
+
 namespace bt {
 namespace internal {
 
@@ -38,6 +40,7 @@ class StackTraceCaptureStackBacktrace : public StackTrace {
   StackTraceCaptureStackBacktrace() : StackTrace() {}
 
   size_t load(void * /*addr*/, size_t depth) {
+    StatsTimer timer(STATS_CAPTURE_CAPTURE_STACK_BACKTRACE);
     backtrace_buffer_.resize(depth);
     DWORD num_frames = CaptureStackBackTrace(0,
                                              (DWORD)depth,
@@ -26,6 +26,8 @@
 
 #include <execinfo.h>
 
+#include "backtrace/stats.h"
+
 namespace bt {
 namespace internal {
 
@@ -37,6 +39,7 @@ class StackTraceExecinfo : public StackTrace {
   StackTraceExecinfo() : StackTrace() {}
 
   size_t load(void * /*addr*/, size_t depth) {
+    StatsTimer timer(STATS_CAPTURE_EXECINFO);
     backtrace_buffer_.resize(depth);
     size_t num_addr = backtrace(&backtrace_buffer_[0], depth);
     backtrace_buffer_.resize(num_addr);
@@ -0,0 +1,162 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "backtrace/stacktrace.h"
+
+#ifdef BACKTRACE_HAS_SHADOW_STACK
+
+#include <cstring>
+
+#include "backtrace/stats.h"
+
+#define SHADOW_STACK_MASK (BACKTRACE_SHADOW_STACK_DEPTH - 1)
+
+namespace bt {
+namespace internal {
+
+namespace {
+
+// Per-thread ring of the instrumented calls, innermost call is at
+// (depth - 1) & SHADOW_STACK_MASK. Depth keeps counting above the ring
+// size, so enter and exit stay balanced for deep stacks.
+struct ShadowStack {
+  size_t depth;
+  void *functions[BACKTRACE_SHADOW_STACK_DEPTH];
+  void *call_sites[BACKTRACE_SHADOW_STACK_DEPTH];
+};
+
+// Initial-exec model avoids __tls_get_addr() call on every function entry.
+__thread ShadowStack shadow_stack __attribute__((tls_model("initial-exec")));
+
+// Stack trace implementation which copies the shadow stack maintained by
+// -finstrument-functions hooks. Every instrumented function is reported
+// once: the innermost one by its entry address and the rest by the call
+// sites of their callees. Calls through non-instrumented code, including
+// this library, are not visible. Threads which are not inside of any
+// instrumented function, for example because the program was built
+// without -finstrument-functions, are captured with the fallback.
+class StackTraceShadowStack : public StackTrace {
+ public:
+  explicit StackTraceShadowStack(StackTrace *fallback)
+      : StackTrace(),
+        fallback_(fallback),
+        use_fallback_(false),
+        size_(0) {}
+
+  ~StackTraceShadowStack() {
+    delete fallback_;
+  }
+
+  size_t load(void *addr, size_t depth) {
+    const ShadowStack& stack = shadow_stack;
+    size_ = 0;
+    use_fallback_ = (stack.depth == 0);
+    if (use_fallback_) {
+      return fallback_->load(addr, depth);
+    }
+    StatsTimer timer(STATS_CAPTURE_SHADOW_STACK);
+    if (depth == 0) {
+      return 0;
+    }
+    size_t num_call_sites = stack.depth;
+    if (num_call_sites > BACKTRACE_SHADOW_STACK_DEPTH) {
+      num_call_sites = BACKTRACE_SHADOW_STACK_DEPTH;
+    }
+    if (num_call_sites > depth - 1) {
+      num_call_sites = depth - 1;
+    }
+    // Copy innermost call sites in the order they are stored, which takes
+    // two copies when they wrap around the end of the ring.
+    size_t first = (stack.depth - num_call_sites) & SHADOW_STACK_MASK;
+    size_t num_tail = BACKTRACE_SHADOW_STACK_DEPTH - first;
+    if (num_tail >= num_call_sites) {
+      memcpy(frames_, &stack.call_sites[first],
+             num_call_sites * sizeof(void *));
+    } else {
+      memcpy(frames_, &stack.call_sites[first], num_tail * sizeof(void *));
+      memcpy(frames_ + num_tail, &stack.call_sites[0],
+             (num_call_sites - num_tail) * sizeof(void *));
+    }
+    // Symbolizers treat addresses as return addresses and look up the
+    // byte before them.
+    void *function = stack.functions[(stack.depth - 1) & SHADOW_STACK_MASK];
+    frames_[num_call_sites] = reinterpret_cast<char *>(function) + 1;
+    size_ = num_call_sites + 1;
+    return size_;
+  }
+
+  size_t size() const {
+    return use_fallback_ ? fallback_->size() : size_;
+  }
+
+  TraceEntry operator[](size_t index) const {
+    if (use_fallback_) {
+      return (*fallback_)[index];
+    }
+    assert(index < size());
+    // Frames are stored outermost first.
+    TraceEntry entry(frames_[size_ - 1 - index]);
+    return entry;
+  }
+
+ private:
+  StackTrace *fallback_;
+  bool use_fallback_;
+  void *frames_[BACKTRACE_SHADOW_STACK_DEPTH + 1];
+  size_t size_;
+};
+
+}  // namespace
+
+StackTrace *stacktrace_create_shadow_stack(StackTrace *fallback) {
+  return new StackTraceShadowStack(fallback);
+}
+
+bool shadow_stack_is_active() {
+  return shadow_stack.depth != 0;
+}
+
+}  // namespace internal
+}  // namespace bt
+
+extern "C" {
+
+__attribute__((no_instrument_function))
+void __cyg_profile_func_enter(void *function, void *call_site) {
+  bt::internal::ShadowStack& stack = bt::internal::shadow_stack;
+  size_t index = stack.depth & SHADOW_STACK_MASK;
+  stack.functions[index] = function;
+  stack.call_sites[index] = call_site;
+  ++stack.depth;
+}
+
+__attribute__((no_instrument_function))
+void __cyg_profile_func_exit(void * /*function*/, void * /*call_site*/) {
+  bt::internal::ShadowStack& stack = bt::internal::shadow_stack;
+  // Functions which were entered before the library was loaded are
+  // exited without being seen.
+  if (stack.depth != 0) {
+    --stack.depth;
+  }
+}
+
+}  // extern "C"
+
+#endif  // BACKTRACE_HAS_SHADOW_STACK
@@ -27,6 +27,8 @@
 #include <windows.h>
 #include <imagehlp.h>
 
+#include "backtrace/stats.h"
+
 namespace bt {
 namespace internal {
 
@@ -38,6 +40,7 @@ class StackTraceStackWalk : public StackTrace {
   StackTraceStackWalk() : StackTrace() {}
 
   size_t load(void * /*addr*/, size_t depth) {
+    StatsTimer timer(STATS_CAPTURE_STACK_WALK);
     init_symbol_handler();
     // Some initialization.
     HANDLE process = GetCurrentProcess();
@@ -0,0 +1,206 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "backtrace/stats.h"
+
+namespace bt {
+namespace internal {
+
+namespace {
+
+volatile int64_t counters[STATS_NUM_COUNTERS];
+volatile int64_t histograms[STATS_NUM_HISTOGRAMS][STATS_NUM_BUCKETS + 2];
+
+const char *counter_names[STATS_NUM_COUNTERS] = {
+  "objects_opened",
+  "cache_hits",
+  "cache_misses",
+  "cache_evictions",
+  "demangle_calls",
+  "symbol_memory_bytes",
+  "symbol_cache_hits",
+  "symbol_cache_misses",
+  "symbol_cache_entries",
+};
+
+const char *histogram_names[STATS_NUM_HISTOGRAMS] = {
+  "capture_execinfo",
+  "capture_capture_stack_backtrace",
+  "capture_stack_walk",
+  "capture_shadow_stack",
+  "symbolize",
+};
+
+// Index of count and sum within histogram array.
+enum {
+  HISTOGRAM_COUNT = STATS_NUM_BUCKETS,
+  HISTOGRAM_SUM = STATS_NUM_BUCKETS + 1,
+};
+
+inline void atomic_add(volatile int64_t *value, int64_t delta) {
+#if defined(_MSC_VER)
+  InterlockedExchangeAdd64(reinterpret_cast<volatile LONG64 *>(value),
+                           delta);
+#else
+  __sync_fetch_and_add(value, delta);
+#endif
+}
+
+inline int64_t atomic_load(volatile int64_t *value) {
+#if defined(_MSC_VER)
+  return InterlockedCompareExchange64(
+      reinterpret_cast<volatile LONG64 *>(value), 0, 0);
+#else
+  return __sync_fetch_and_add(value, 0);
+#endif
+}
+
+inline void atomic_store(volatile int64_t *value, int64_t new_value) {
+#if defined(_MSC_VER)
+  InterlockedExchange64(reinterpret_cast<volatile LONG64 *>(value),
+                        new_value);
+#else
+  __sync_lock_test_and_set(value, new_value);
+#endif
+}
+
+int bucket_index(uint64_t latency_ns) {
+  int index = 0;
+  while (index < STATS_NUM_BUCKETS - 1 && latency_ns >= (1ULL << index)) {
+    ++index;
+  }
+  return index;
+}
+
+// Approximate percentile, as an upper bound of the bucket it falls into.
+uint64_t histogram_percentile(const StatsHistogramData& data,
+                              double percentile) {
+  if (data.count == 0) {
+    return 0;
+  }
+  uint64_t rank = (uint64_t)(data.count * percentile);
+  uint64_t seen = 0;
+  for (int i = 0; i < STATS_NUM_BUCKETS; ++i) {
+    seen += data.buckets[i];
+    if (seen > rank) {
+      return 1ULL << i;
+    }
+  }
+  return 1ULL << (STATS_NUM_BUCKETS - 1);
+}
+
+}  // namespace
+
+void stats_add(StatsCounter counter, int64_t delta) {
+  atomic_add(&counters[counter], delta);
+}
+
+void stats_record(StatsHistogram histogram, uint64_t latency_ns) {
+  atomic_add(&histograms[histogram][bucket_index(latency_ns)], 1);
+  atomic_add(&histograms[histogram][HISTOGRAM_COUNT], 1);
+  atomic_add(&histograms[histogram][HISTOGRAM_SUM], (int64_t)latency_ns);
+}
+
+uint64_t stats_get(StatsCounter counter) {
+  return (uint64_t)atomic_load(&counters[counter]);
+}
+
+void stats_get(StatsHistogram histogram, StatsHistogramData *data) {
+  for (int i = 0; i < STATS_NUM_BUCKETS; ++i) {
+    data->buckets[i] = (uint64_t)atomic_load(&histograms[histogram][i]);
+  }
+  data->count = (uint64_t)atomic_load(&histograms[histogram][HISTOGRAM_COUNT]);
+  data->sum_ns = (uint64_t)atomic_load(&histograms[histogram][HISTOGRAM_SUM]);
+}
+
+const char *stats_name(StatsCounter counter) {
+  return counter_names[counter];
+}
+
+const char *stats_name(StatsHistogram histogram) {
+  return histogram_names[histogram];
+}
+
+void stats_reset() {
+  for (int i = 0; i < STATS_NUM_COUNTERS; ++i) {
+    if (i != STATS_SYMBOL_MEMORY && i != STATS_SYMBOL_CACHE_ENTRIES) {
+      atomic_store(&counters[i], 0);
+    }
+  }
+  for (int i = 0; i < STATS_NUM_HISTOGRAMS; ++i) {
+    for (int j = 0; j < STATS_NUM_BUCKETS + 2; ++j) {
+      atomic_store(&histograms[i][j], 0);
+    }
+  }
+}
+
+string stats_format_text() {
+  std::stringstream ss;
+  for (int i = 0; i < STATS_NUM_COUNTERS; ++i) {
+    StatsCounter counter = (StatsCounter)i;
+    ss << stats_name(counter) << ": " << stats_get(counter) << "\n";
+  }
+  for (int i = 0; i < STATS_NUM_HISTOGRAMS; ++i) {
+    StatsHistogram histogram = (StatsHistogram)i;
+    StatsHistogramData data;
+    stats_get(histogram, &data);
+    ss << stats_name(histogram) << ": count " << data.count;
+    if (data.count != 0) {
+      ss << ", mean " << data.sum_ns / data.count << " ns"
+         << ", p50 < " << histogram_percentile(data, 0.5) << " ns"
+         << ", p99 < " << histogram_percentile(data, 0.99) << " ns";
+    }
+    ss << "\n";
+  }
+  return ss.str();
+}
+
+string stats_format_json() {
+  std::stringstream ss;
+  ss << "{";
+  for (int i = 0; i < STATS_NUM_COUNTERS; ++i) {
+    StatsCounter counter = (StatsCounter)i;
+    ss << (i == 0 ? "" : ", ")
+       << "\"" << stats_name(counter) << "\": " << stats_get(counter);
+  }
+  for (int i = 0; i < STATS_NUM_HISTOGRAMS; ++i) {
+    StatsHistogram histogram = (StatsHistogram)i;
+    StatsHistogramData data;
+    stats_get(histogram, &data);
+    ss << ", \"" << stats_name(histogram) << "\": {"
+       << "\"count\": " << data.count
+       << ", \"sum_ns\": " << data.sum_ns
+       << ", \"buckets\": [";
+    // Trailing empty buckets are omitted.
+    int num_buckets = STATS_NUM_BUCKETS;
+    while (num_buckets > 0 && data.buckets[num_buckets - 1] == 0) {
+      --num_buckets;
+    }
+    for (int j = 0; j < num_buckets; ++j) {
+      ss << (j == 0 ? "" : ", ") << data.buckets[j];
+    }
+    ss << "]}";
+  }
+  ss << "}\n";
+  return ss.str();
+}
+
+}  // namespace internal
+}  // namespace bt
@@ -0,0 +1,111 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <stdint.h>
+
+#include "backtrace/backtrace_util.h"
+
+// Number of latency histogram buckets, bucket i counts latencies below
+// 2^i nanoseconds, the last one counts everything above.
+#define STATS_NUM_BUCKETS 32
+
+namespace bt {
+namespace internal {
+
+// Counters of the library's own activity, updated with atomic additions
+// only, so they are cheap enough to be always on.
+enum StatsCounter {
+  // Objects opened by the symbolizers to read their symbols.
+  STATS_OBJECTS_OPENED,
+  // Lookups of per-object symbol data.
+  STATS_CACHE_HITS,
+  STATS_CACHE_MISSES,
+  STATS_CACHE_EVICTIONS,
+  STATS_DEMANGLE_CALLS,
+  // Estimated bytes of symbol data currently held, this one is a gauge.
+  STATS_SYMBOL_MEMORY,
+  // Lookups of the process-wide address to symbol cache.
+  STATS_SYMBOL_CACHE_HITS,
+  STATS_SYMBOL_CACHE_MISSES,
+  // Addresses currently held by the cache, this one is a gauge.
+  STATS_SYMBOL_CACHE_ENTRIES,
+
+  STATS_NUM_COUNTERS,
+};
+
+enum StatsHistogram {
+  // Stack trace capture latency, per backend.
+  STATS_CAPTURE_EXECINFO,
+  STATS_CAPTURE_CAPTURE_STACK_BACKTRACE,
+  STATS_CAPTURE_STACK_WALK,
+  STATS_CAPTURE_SHADOW_STACK,
+  // Latency of symbolizing a whole stack trace in-process, including the
+  // lookups of the symbol cache.
+  STATS_SYMBOLIZE,
+
+  STATS_NUM_HISTOGRAMS,
+};
+
+struct StatsHistogramData {
+  uint64_t count;
+  uint64_t sum_ns;
+  uint64_t buckets[STATS_NUM_BUCKETS];
+};
+
+void stats_add(StatsCounter counter, int64_t delta = 1);
+void stats_record(StatsHistogram histogram, uint64_t latency_ns);
+
+uint64_t stats_get(StatsCounter counter);
+void stats_get(StatsHistogram histogram, StatsHistogramData *data);
+
+// Name of the statistics, as used in the text and JSON output.
+const char *stats_name(StatsCounter counter);
+const char *stats_name(StatsHistogram histogram);
+
+// Reset all the counters and histograms, except of gauges.
+void stats_reset();
+
+// Dump all the statistics as a human-readable text or as a JSON object.
+string stats_format_text();
+string stats_format_json();
+
+// Record latency of a scope into a histogram.
+class StatsTimer {
+ public:
+  explicit StatsTimer(StatsHistogram histogram)
+  : histogram_(histogram),
+    start_ns_(time_monotonic_ns()) {}
+
+  ~StatsTimer() {
+    stats_record(histogram_, time_monotonic_ns() - start_ns_);
+  }
+
+ private:
+  StatsHistogram histogram_;
+  uint64_t start_ns_;
+};
+
+}  // namespace internal
+}  // namespace bt
+
+#endif  // __STATS_H__
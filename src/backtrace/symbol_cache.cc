@@ -0,0 +1,457 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+
+#include "backtrace/symbol_cache.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if !defined(_MSC_VER)
+#  include <sched.h>
+#endif
+
+#include "backtrace/module_table.h"
+#include "backtrace/stats.h"
+
+// Arena is allocated in chunks of this size.
+#define ARENA_CHUNK_SIZE (64 * 1024)
+// Average bytes of strings allowed per cached address, the table is
+// rebuilt without the strings of evicted entries once they are used up.
+#define ARENA_BYTES_PER_ENTRY 512
+
+// Address of a slot whose entry got evicted, probing goes on past it.
+#define SLOT_EVICTED reinterpret_cast<void *>(1)
+
+namespace bt {
+namespace internal {
+
+namespace {
+
+// Resolved symbol with all its strings, stored in the arena.
+struct CachedSymbol {
+  // Address the symbol belongs to, checked by lookups since the slot
+  // might be reused for another address while they read it.
+  void *key;
+  size_t address;
+  size_t function_offset;
+  int line_number;
+  const char *object_name;
+  const char *file_name;
+  const char *function_name;
+};
+
+struct Slot {
+  // NULL for an empty slot, SLOT_EVICTED once its entry is evicted.
+  void *volatile address;
+  // Might be replaced with a newer symbol for the same address.
+  CachedSymbol *volatile symbol;
+  // Set by lookups, cleared as the clock hand passes over the slot.
+  volatile bool referenced;
+};
+
+struct Table {
+  Slot *slots;
+  size_t mask;
+  size_t num_entries;
+  size_t num_evicted;
+  size_t max_entries;
+  // Next slot to be considered for eviction.
+  size_t hand;
+  // Number of unloads at the time the table was created.
+  uint64_t generation;
+  vector<char *> chunks;
+  size_t chunk_used;
+  size_t arena_size;
+  size_t arena_limit;
+};
+
+// Serializes insertions and resizes, lookups do not take it.
+Mutex cache_mutex;
+volatile size_t cache_size = BACKTRACE_SYMBOL_CACHE_SIZE;
+// Created on the first insertion.
+Table *volatile cache_table = NULL;
+// Number of unloads, refreshed by lookups which miss.
+volatile uint64_t cache_generation = 0;
+// Number of clears, see symbol_cache_settings().
+volatile uint64_t cache_settings = 0;
+// Lookups in progress, counted apart for even and odd epochs. Replacing
+// the table starts a new epoch, and the old table is freed once lookups
+// of the previous one are done.
+volatile long cache_readers[2] = {0, 0};
+volatile long cache_epoch = 0;
+
+inline void memory_barrier() {
+#if defined(_MSC_VER)
+  MemoryBarrier();
+#else
+  __sync_synchronize();
+#endif
+}
+
+// Also a full memory barrier.
+inline void counter_add(volatile long *counter, long delta) {
+#if defined(_MSC_VER)
+  InterlockedExchangeAdd(counter, delta);
+#else
+  __sync_fetch_and_add(counter, delta);
+#endif
+}
+
+inline long counter_get(volatile long *counter) {
+#if defined(_MSC_VER)
+  return InterlockedCompareExchange(counter, 0, 0);
+#else
+  return __sync_fetch_and_add(counter, 0);
+#endif
+}
+
+inline void thread_yield() {
+#if defined(_MSC_VER)
+  SwitchToThread();
+#else
+  sched_yield();
+#endif
+}
+
+long readers_enter() {
+  for (;;) {
+    long epoch = cache_epoch;
+    counter_add(&cache_readers[epoch & 1], 1);
+    // Table might have been replaced before the counter got incremented,
+    // in which case it could already be gone.
+    if (cache_epoch == epoch) {
+      return epoch;
+    }
+    counter_add(&cache_readers[epoch & 1], -1);
+  }
+}
+
+void readers_leave(long epoch) {
+  counter_add(&cache_readers[epoch & 1], -1);
+}
+
+size_t slot_hash(void *address) {
+  uint64_t key = reinterpret_cast<uintptr_t>(address);
+  // Mixing step of the MurmurHash3 finalizer.
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdULL;
+  key ^= key >> 33;
+  return (size_t)key;
+}
+
+Table *table_create(size_t size, uint64_t generation) {
+  Table *table = new Table();
+  // Keep load factor below one half, so probe sequences stay short and
+  // there's always an empty slot to stop at.
+  size_t num_slots = 16;
+  while (num_slots < size * 2) {
+    num_slots *= 2;
+  }
+  table->slots = new Slot[num_slots];
+  memset(table->slots, 0, sizeof(Slot) * num_slots);
+  table->mask = num_slots - 1;
+  table->num_entries = 0;
+  table->num_evicted = 0;
+  table->max_entries = size;
+  table->hand = 0;
+  table->generation = generation;
+  table->chunk_used = ARENA_CHUNK_SIZE;
+  table->arena_size = 0;
+  table->arena_limit = std::max((size_t)ARENA_CHUNK_SIZE,
+                                size * ARENA_BYTES_PER_ENTRY);
+  return table;
+}
+
+void table_destroy(Table *table) {
+  for (size_t i = 0; i < table->chunks.size(); ++i) {
+    delete [] table->chunks[i];
+  }
+  delete [] table->slots;
+  delete table;
+}
+
+// Make the table visible to lookups, previous one is freed as soon as
+// no lookup might be using it. Cache mutex is to be held.
+void table_replace(Table *table) {
+  Table *old_table = cache_table;
+  memory_barrier();
+  cache_table = table;
+  if (old_table == NULL) {
+    return;
+  }
+  stats_add(STATS_SYMBOL_CACHE_ENTRIES, -(int64_t)old_table->num_entries);
+  long epoch = cache_epoch;
+  cache_epoch = epoch + 1;
+  memory_barrier();
+  // Lookups are short and never block, lookups which start from now on
+  // are counted for the new epoch and only see the new table.
+  while (counter_get(&cache_readers[epoch & 1]) != 0) {
+    thread_yield();
+  }
+  table_destroy(old_table);
+}
+
+// Returns NULL once the arena reached its limit.
+char *arena_alloc(Table *table, size_t size) {
+  size = (size + 7) & ~(size_t)7;
+  if (size > ARENA_CHUNK_SIZE) {
+    return NULL;
+  }
+  if (table->chunk_used + size > ARENA_CHUNK_SIZE) {
+    if (table->arena_size + ARENA_CHUNK_SIZE > table->arena_limit) {
+      return NULL;
+    }
+    table->chunks.push_back(new char[ARENA_CHUNK_SIZE]);
+    table->chunk_used = 0;
+    table->arena_size += ARENA_CHUNK_SIZE;
+  }
+  char *data = table->chunks.back() + table->chunk_used;
+  table->chunk_used += size;
+  return data;
+}
+
+const char *arena_string(char **data, const string& str) {
+  char *result = *data;
+  memcpy(result, str.c_str(), str.size() + 1);
+  *data += str.size() + 1;
+  return result;
+}
+
+bool table_lookup(Table *table, void *address, Symbol *symbol) {
+  size_t slot = slot_hash(address) & table->mask;
+  for (;;) {
+    void *slot_address = table->slots[slot].address;
+    if (slot_address == address) {
+      break;
+    }
+    if (slot_address == NULL) {
+      return false;
+    }
+    slot = (slot + 1) & table->mask;
+  }
+  // Symbol is published after its contents is written, and reading its
+  // fields depends on the pointer, so no barrier is needed here.
+  const CachedSymbol *cached = table->slots[slot].symbol;
+  if (cached == NULL || cached->key != address) {
+    return false;
+  }
+  if (!table->slots[slot].referenced) {
+    table->slots[slot].referenced = true;
+  }
+  symbol->object_name = cached->object_name;
+  symbol->address = cached->address;
+  symbol->file_name = cached->file_name;
+  symbol->line_number = cached->line_number;
+  symbol->function_name = cached->function_name;
+  symbol->function_offset = cached->function_offset;
+  return true;
+}
+
+// Evict the first entry which was not looked up since the clock hand
+// passed it the last time.
+void table_evict(Table *table) {
+  for (;;) {
+    Slot& slot = table->slots[table->hand];
+    table->hand = (table->hand + 1) & table->mask;
+    if (slot.address == NULL || slot.address == SLOT_EVICTED) {
+      continue;
+    }
+    if (slot.referenced) {
+      slot.referenced = false;
+      continue;
+    }
+    slot.address = SLOT_EVICTED;
+    --table->num_entries;
+    ++table->num_evicted;
+    stats_add(STATS_SYMBOL_CACHE_ENTRIES, -1);
+    return;
+  }
+}
+
+// Returns false if the table has to be rebuilt to make room for the
+// symbol.
+bool table_insert(Table *table, void *address, const Symbol& symbol) {
+  size_t slot = slot_hash(address) & table->mask;
+  size_t evicted_slot = table->mask + 1;
+  while (table->slots[slot].address != NULL &&
+         table->slots[slot].address != address) {
+    if (table->slots[slot].address == SLOT_EVICTED &&
+        evicted_slot > table->mask) {
+      evicted_slot = slot;
+    }
+    slot = (slot + 1) & table->mask;
+  }
+  bool is_new = (table->slots[slot].address == NULL);
+  if (is_new && evicted_slot <= table->mask) {
+    slot = evicted_slot;
+  } else if (is_new &&
+             (table->num_entries + table->num_evicted + 1) * 4 >
+             (table->mask + 1) * 3) {
+    // Evicted slots never end a probe sequence, so too many of them
+    // make lookups slow.
+    return false;
+  }
+  char *data = arena_alloc(table,
+                           sizeof(CachedSymbol) +
+                           symbol.object_name.size() + 1 +
+                           symbol.file_name.size() + 1 +
+                           symbol.function_name.size() + 1);
+  if (data == NULL) {
+    return false;
+  }
+  CachedSymbol *cached = reinterpret_cast<CachedSymbol *>(data);
+  data += sizeof(CachedSymbol);
+  cached->key = address;
+  cached->address = symbol.address;
+  cached->function_offset = symbol.function_offset;
+  cached->line_number = symbol.line_number;
+  cached->object_name = arena_string(&data, symbol.object_name);
+  cached->file_name = arena_string(&data, symbol.file_name);
+  cached->function_name = arena_string(&data, symbol.function_name);
+  if (is_new && table->num_entries >= table->max_entries) {
+    table_evict(table);
+  }
+  memory_barrier();
+  table->slots[slot].symbol = cached;
+  if (is_new) {
+    if (table->slots[slot].address == SLOT_EVICTED) {
+      --table->num_evicted;
+    }
+    table->slots[slot].referenced = false;
+    memory_barrier();
+    table->slots[slot].address = address;
+    ++table->num_entries;
+    stats_add(STATS_SYMBOL_CACHE_ENTRIES);
+  }
+  return true;
+}
+
+// New table with entries which were not evicted, without the arena
+// space taken by the evicted ones.
+Table *table_rebuild(const Table *old_table) {
+  Table *table = table_create(old_table->max_entries,
+                              old_table->generation);
+  for (size_t i = 0; i <= old_table->mask; ++i) {
+    const Slot& slot = old_table->slots[i];
+    if (slot.address == NULL || slot.address == SLOT_EVICTED) {
+      continue;
+    }
+    const CachedSymbol *cached = slot.symbol;
+    Symbol symbol;
+    symbol.object_name = cached->object_name;
+    symbol.address = cached->address;
+    symbol.file_name = cached->file_name;
+    symbol.line_number = cached->line_number;
+    symbol.function_name = cached->function_name;
+    symbol.function_offset = cached->function_offset;
+    table_insert(table, slot.address, symbol);
+  }
+  return table;
+}
+
+}  // namespace
+
+void symbol_cache_lookup(const StackTrace& stacktrace,
+                         vector<Symbol> *symbols,
+                         vector<size_t> *missed) {
+  size_t num_missed = missed->size();
+  long epoch = readers_enter();
+  Table *table = cache_table;
+  if (table != NULL && table->generation != cache_generation) {
+    // Entries might belong to objects which are gone.
+    table = NULL;
+  }
+  for (size_t i = 0; i < stacktrace.size(); ++i) {
+    void *address = stacktrace[i].address;
+    if (table == NULL || address == NULL ||
+        !table_lookup(table, address, &(*symbols)[i])) {
+      missed->push_back(i);
+    }
+  }
+  readers_leave(epoch);
+  if (missed->size() != num_missed) {
+    // Frames are about to be resolved anyway, so it is the time to pick
+    // up unloads of objects. Walking the list of objects on every lookup
+    // would cost more than the lookup itself.
+    uint64_t generation = module_table_unloads();
+    if (generation != cache_generation) {
+      cache_generation = generation;
+      missed->resize(num_missed);
+      for (size_t i = 0; i < stacktrace.size(); ++i) {
+        missed->push_back(i);
+      }
+    }
+  }
+  // Counted per trace rather than per address, to keep lookups from
+  // contending on the counters.
+  size_t num_hits = stacktrace.size() - (missed->size() - num_missed);
+  stats_add(STATS_SYMBOL_CACHE_HITS, num_hits);
+  stats_add(STATS_SYMBOL_CACHE_MISSES, stacktrace.size() - num_hits);
+}
+
+void symbol_cache_insert(void *address,
+                         const Symbol& symbol,
+                         uint64_t settings) {
+  if (address == NULL || address == SLOT_EVICTED) {
+    return;
+  }
+  MutexLock lock(&cache_mutex);
+  if (cache_size == 0 || settings != cache_settings) {
+    return;
+  }
+  Table *table = cache_table;
+  if (table == NULL || table->generation != cache_generation) {
+    // Start over after an unload, rather than keep entries which might
+    // be wrong.
+    table = table_create(cache_size, cache_generation);
+    table_replace(table);
+  }
+  if (!table_insert(table, address, symbol)) {
+    table = table_rebuild(table);
+    table_insert(table, address, symbol);
+    table_replace(table);
+  }
+}
+
+void symbol_cache_set_size(size_t size) {
+  MutexLock lock(&cache_mutex);
+  cache_size = size;
+  table_replace(NULL);
+}
+
+size_t symbol_cache_size() {
+  // Only used to skip the cache, so a stale value does not matter.
+  return cache_size;
+}
+
+void symbol_cache_clear() {
+  MutexLock lock(&cache_mutex);
+  ++cache_settings;
+  table_replace(NULL);
+}
+
+uint64_t symbol_cache_settings() {
+  MutexLock lock(&cache_mutex);
+  return cache_settings;
+}
+
+}  // namespace internal
+}  // namespace bt
@@ -0,0 +1,72 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef __SYMBOL_CACHE_H__
+#define __SYMBOL_CACHE_H__
+
+#include "backtrace/backtrace_util.h"
+#include "backtrace/symbolize.h"
+
+// Default number of addresses kept in the process-wide symbol cache.
+#ifndef BACKTRACE_SYMBOL_CACHE_SIZE
+#  define BACKTRACE_SYMBOL_CACHE_SIZE 4096
+#endif
+
+namespace bt {
+namespace internal {
+
+// Process-wide cache of resolved symbols, keyed by return address.
+//
+// Entries live in an open-addressing table with linear probing, their
+// strings are copied into an append-only arena. Lookups take no locks, a
+// warm one is a single hash probe; insertions are serialized. Once the
+// cache is full, entries are evicted with the clock algorithm, and the
+// table is rebuilt when its arena runs out or when an object gets
+// unloaded. Replaced tables are freed after concurrent lookups drain.
+
+// Look up symbols of all the frames, indices of frames which are not in
+// the cache are appended to missed. Unloads of objects are only checked
+// for when something is missing.
+void symbol_cache_lookup(const StackTrace& stacktrace,
+                         vector<Symbol> *symbols,
+                         vector<size_t> *missed);
+
+// Remember symbol of an address, might evict another one. Symbol is
+// dropped if it was resolved with settings older than the current ones.
+void symbol_cache_insert(void *address,
+                         const Symbol& symbol,
+                         uint64_t settings);
+
+// Maximum number of cached addresses, zero disables the cache. Changing
+// it drops all the entries.
+void symbol_cache_set_size(size_t size);
+size_t symbol_cache_size();
+
+// Drop all the entries once symbolizer backends or detail change, since
+// they were resolved with the previous ones.
+void symbol_cache_clear();
+// Number of times the cache was cleared. Symbolizers take it before
+// reading the settings, and only use the cache while it's unchanged.
+uint64_t symbol_cache_settings();
+
+}  // namespace internal
+}  // namespace bt
+
+#endif  // __SYMBOL_CACHE_H__
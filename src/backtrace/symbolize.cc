@@ -22,18 +22,133 @@
 
 #include "backtrace/symbolize.h"
 
+#include <iomanip>
+#include <sstream>
+
+#include "backtrace/perf_map.h"
+#include "backtrace/stats.h"
+#include "backtrace/symbol_cache.h"
+
 namespace bt {
 
+namespace internal {
+
+volatile size_t object_cache_budget = 256 * 1024 * 1024;
+
+namespace {
+
+// Plain data, so it's usable from constructors of static objects.
+Mutex backends_mutex;
+SymbolizeBackend backend_order[SYMBOLIZE_NUM_BACKENDS];
+// Negative until the order is configured, all the available backends are
+// used in the order of their cost then.
+int num_backends = -1;
+SymbolizeDetail backend_detail = SYMBOLIZE_DETAIL_LINE;
+
+const char *backend_names[SYMBOLIZE_NUM_BACKENDS] = {
+  "execinfo",
+  "elf",
+  "bfd",
+  "sym_from_addr",
+  "perf_map",
+};
+
+}  // namespace
+
+}  // namespace internal
+
 Symbolize *Symbolize::create(StackTrace *stacktrace) {
-#if defined(BACKTRACE_HAS_BFD)
-  return internal::symbolize_create_bfd(stacktrace);
-#elif defined(BACKTRACE_HAS_EXECINFO)
-  return internal::symbolize_create_execinfo(stacktrace);
-#elif defined(BACKTRACE_HAS_SYM_FROM_ADDR)
-  return internal::symbolize_create_sym_from_addr(stacktrace);
-#else
-  return internal::symbolize_create_stub(stacktrace);
+  // Taken first, so symbols resolved with settings which get changed
+  // meanwhile don't end up in the cache.
+  uint64_t settings = internal::symbol_cache_settings();
+  return internal::symbolize_create_cascade(backends(),
+                                            detail(),
+                                            settings,
+                                            stacktrace);
+}
+
+bool Symbolize::set_backends(const vector<SymbolizeBackend>& backends) {
+  if (backends.size() > SYMBOLIZE_NUM_BACKENDS) {
+    return false;
+  }
+  for (size_t i = 0; i < backends.size(); ++i) {
+    if (!backend_available(backends[i])) {
+      return false;
+    }
+  }
+  {
+    internal::MutexLock lock(&internal::backends_mutex);
+    for (size_t i = 0; i < backends.size(); ++i) {
+      internal::backend_order[i] = backends[i];
+    }
+    internal::num_backends = (int)backends.size();
+  }
+  internal::symbol_cache_clear();
+  return true;
+}
+
+vector<SymbolizeBackend> Symbolize::backends() {
+  internal::MutexLock lock(&internal::backends_mutex);
+  vector<SymbolizeBackend> backends;
+  if (internal::num_backends < 0) {
+    // Backends are declared in the order of their cost.
+    for (int i = 0; i < SYMBOLIZE_NUM_BACKENDS; ++i) {
+      if (backend_available((SymbolizeBackend)i)) {
+        backends.push_back((SymbolizeBackend)i);
+      }
+    }
+  } else {
+    backends.assign(internal::backend_order,
+                    internal::backend_order + internal::num_backends);
+  }
+  return backends;
+}
+
+bool Symbolize::backend_available(SymbolizeBackend backend) {
+  switch (backend) {
+#ifdef BACKTRACE_HAS_EXECINFO
+    case SYMBOLIZE_EXECINFO:
+      return true;
 #endif
+#ifdef BACKTRACE_HAS_ELF
+    case SYMBOLIZE_ELF:
+      return true;
+#endif
+#ifdef BACKTRACE_HAS_BFD
+    case SYMBOLIZE_BFD:
+      return true;
+#endif
+#ifdef BACKTRACE_HAS_SYM_FROM_ADDR
+    case SYMBOLIZE_SYM_FROM_ADDR:
+      return true;
+#endif
+#ifdef BACKTRACE_HAS_PERF_MAP
+    case SYMBOLIZE_PERF_MAP:
+      return true;
+#endif
+    default:
+      return false;
+  }
+}
+
+const char *Symbolize::backend_name(SymbolizeBackend backend) {
+  if (backend < 0 || backend >= SYMBOLIZE_NUM_BACKENDS) {
+    return "";
+  }
+  return internal::backend_names[backend];
+}
+
+void Symbolize::set_detail(SymbolizeDetail detail) {
+  {
+    internal::MutexLock lock(&internal::backends_mutex);
+    internal::backend_detail = detail;
+  }
+  internal::symbol_cache_clear();
+}
+
+SymbolizeDetail Symbolize::detail() {
+  internal::MutexLock lock(&internal::backends_mutex);
+  return internal::backend_detail;
 }
 
 Symbolize::~Symbolize() {
@@ -42,4 +157,88 @@ Symbolize::~Symbolize() {
   }
 }
 
+void Symbolize::set_memory_budget(size_t budget) {
+  internal::object_cache_budget = budget;
+}
+
+size_t Symbolize::memory_budget() {
+  return internal::object_cache_budget;
+}
+
+void Symbolize::set_symbol_cache_size(size_t size) {
+  internal::symbol_cache_set_size(size);
+}
+
+size_t Symbolize::symbol_cache_size() {
+  return internal::symbol_cache_size();
+}
+
+SymbolizeCacheStats Symbolize::cache_stats() {
+  SymbolizeCacheStats stats;
+  stats.hits = internal::stats_get(internal::STATS_CACHE_HITS);
+  stats.misses = internal::stats_get(internal::STATS_CACHE_MISSES);
+  stats.evictions = internal::stats_get(internal::STATS_CACHE_EVICTIONS);
+  stats.memory_usage = internal::stats_get(internal::STATS_SYMBOL_MEMORY);
+  return stats;
+}
+
+namespace internal {
+
+string symbolize_format(const vector<Symbol>& symbols) {
+  std::stringstream ss;
+  for (size_t i = 0; i < symbols.size(); ++i) {
+    const Symbol& symbol = symbols[i];
+    // Frame index.
+    ss << std::right << std::setw(8) << i;
+    // TODO(sergey): Show object name in some nice format,
+    // which doesn't screw alignment up.
+    // Frame address.
+    ss << "  " << std::right << std::setw(16)
+       << ((symbol.address != Symbol::ADDRESS_NONE)
+                   ? hex_cast(symbol.address)
+                   : "(nil)");
+    // Function name, or object and offset within it for the frames which
+    // were not symbolized in time or have no symbol.
+    string function_name = "(unknown)";
+    if (symbol.function_name.size() > 0) {
+      function_name = symbol.function_name;
+    } else if (symbol.object_offset != Symbol::OFFSET_NONE) {
+      function_name = symbol.object_name + "+" +
+                      hex_cast(symbol.object_offset);
+    } else if (symbol.object_name.size() > 0) {
+      // Function offset is the one within object then.
+      function_name = symbol.object_name;
+    }
+    ss << "    " << function_name;
+    // Source file or function offset.
+    if (symbol.file_name.size() == 0) {
+      if (symbol.function_offset != Symbol::OFFSET_NONE) {
+        ss << "+" << hex_cast(symbol.function_offset);
+      }
+    } else {
+      const int N = 8;
+      size_t pad = ((size_t)((function_name.size() + N - 1) / N)) * N
+                   - function_name.size();
+      ss << std::setfill(' ') << std::setw(pad) << ""
+         << " " << symbol.file_name;
+      if (symbol.line_number != Symbol::LINE_NONE) {
+         ss << ":" << symbol.line_number;
+      }
+    }
+    ss << "\n";
+  }
+  return ss.str();
+}
+
+string symbolize_format(Symbolize& symbolize) {
+  vector<Symbol> symbols;
+  symbols.reserve(symbolize.size());
+  for (size_t i = 0; i < symbolize.size(); ++i) {
+    symbols.push_back(symbolize.at(i));
+  }
+  return symbolize_format(symbols);
+}
+
+}  // namespace internal
+
 }  // namespace bt
@@ -52,6 +52,9 @@ struct Symbol {
   int line_number;
   string function_name;
   size_t function_offset;
+  // Link-time address within the object, only known for frames which were
+  // not symbolized in time, see Symbolize::resolve_until().
+  size_t object_offset;
 
   Symbol()
   : object_name(""),
@@ -59,7 +62,8 @@ struct Symbol {
     file_name(""),
     line_number(LINE_NONE),
     function_name(),
-    function_offset(OFFSET_NONE) {}
+    function_offset(OFFSET_NONE),
+    object_offset(OFFSET_NONE) {}
 
   Symbol(const string& object_name,
          size_t address,
@@ -72,14 +76,86 @@ struct Symbol {
     file_name(file_name),
     line_number(line_number),
     function_name(function_name),
-    function_offset(function_offset) {}
+    function_offset(function_offset),
+    object_offset(OFFSET_NONE) {}
+};
+
+// Counters of the per-object symbol data caches of all symbolizers.
+struct SymbolizeCacheStats {
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+  // Estimated number of bytes used by the symbol data.
+  uint64_t memory_usage;
+
+  SymbolizeCacheStats()
+  : hits(0),
+    misses(0),
+    evictions(0),
+    memory_usage(0) {}
+};
+
+// Symbolizer implementations, which are run by the symbolizer created by
+// Symbolize::create() in a configurable order.
+enum SymbolizeBackend {
+  // Names of exported symbols from dladdr().
+  SYMBOLIZE_EXECINFO,
+  // Symbol tables and DWARF line tables read directly from ELF files.
+  SYMBOLIZE_ELF,
+  // Everything libbfd knows, including inlined functions.
+  SYMBOLIZE_BFD,
+  // Windows debug help library.
+  SYMBOLIZE_SYM_FROM_ADDR,
+  // JIT functions from /tmp/perf-<pid>.map.
+  SYMBOLIZE_PERF_MAP,
+
+  SYMBOLIZE_NUM_BACKENDS,
+};
+
+// Information which is required for a frame to be considered resolved.
+enum SymbolizeDetail {
+  SYMBOLIZE_DETAIL_FUNCTION,
+  SYMBOLIZE_DETAIL_LINE,
 };
 
 class Symbolize {
  public:
-  // Create an actual symbolizer implementation.
+  // Create a symbolizer which runs the configured backends one after
+  // another, every next one only gets the frames which previous ones did
+  // not resolve to the configured detail.
   static Symbolize *create(StackTrace *stacktrace = NULL);
 
+  // Set order of the backends. Backends which are able to provide the
+  // configured detail run first, in the given order, the rest of them are
+  // only used as fallbacks for the frames which are still unresolved.
+  // Returns false and keeps the current order if any of the backends is
+  // not available in this build.
+  static bool set_backends(const vector<SymbolizeBackend>& backends);
+  static vector<SymbolizeBackend> backends();
+  static bool backend_available(SymbolizeBackend backend);
+
+  // Name of the backend as used by backtrace_symbolize_set_backends().
+  static const char *backend_name(SymbolizeBackend backend);
+
+  static void set_detail(SymbolizeDetail detail);
+  static SymbolizeDetail detail();
+
+  // Set maximum memory which every symbolizer might use for symbol data
+  // of the loaded objects. Least recently used objects are unloaded when
+  // going above it, and are loaded again on demand.
+  static void set_memory_budget(size_t budget);
+  static size_t memory_budget();
+
+  // Get counters of the symbol data caches.
+  static SymbolizeCacheStats cache_stats();
+
+  // Set number of addresses kept in the process-wide cache of resolved
+  // symbols, which is shared by all the symbolizers. Zero disables the
+  // cache. Entries are dropped, and memory of the previous cache is
+  // released once lookups in progress are done.
+  static void set_symbol_cache_size(size_t size);
+  static size_t symbol_cache_size();
+
   // Default constructor.
   Symbolize()
   : stacktrace_(NULL) {}
@@ -106,6 +182,19 @@ class Symbolize {
 
   virtual void resolve(const StackTrace& stacktrace) = 0;
 
+  // Same as above, but stop once time_monotonic_ns() reaches the deadline,
+  // zero means there's no deadline. Frames are resolved from the top of
+  // the stack, a frame which is being resolved when the deadline passes is
+  // finished. Frames which were not reached only get their object name
+  // and object offset, if the address belongs to a loaded object.
+  //
+  // Returns number of frames which were not reached.
+  virtual size_t resolve_until(const StackTrace& stacktrace,
+                               uint64_t /*deadline_ns*/) {
+    resolve(stacktrace);
+    return 0;
+  }
+
  protected:
   StackTrace *stacktrace_;
   vector<Symbol> symbols_;
@@ -113,6 +202,13 @@ class Symbolize {
 
 namespace internal {
 
+// Budget shared by the per-object caches of all symbolizers.
+extern volatile size_t object_cache_budget;
+
+// Format symbols into a human-readable multi-line text, one frame per line.
+string symbolize_format(const vector<Symbol>& symbols);
+string symbolize_format(Symbolize& symbolize);
+
 Symbolize *symbolize_create_stub(StackTrace *stacktrace = NULL);
 
 #ifdef BACKTRACE_HAS_EXECINFO
@@ -123,10 +219,32 @@ Symbolize *symbolize_create_execinfo(StackTrace *stacktrace = NULL);
 Symbolize *symbolize_create_bfd(StackTrace *stacktrace = NULL);
 #endif
 
+#ifdef BACKTRACE_HAS_ELF
+Symbolize *symbolize_create_elf(StackTrace *stacktrace = NULL);
+
+// Symbolizer of addresses of another process, which are mapped to objects
+// using given module table rather than dladdr().
+struct Module;
+Symbolize *symbolize_create_elf_modules(const vector<Module>& modules,
+                                        StackTrace *stacktrace = NULL);
+#endif
+
 #ifdef BACKTRACE_HAS_SYM_FROM_ADDR
 Symbolize *symbolize_create_sym_from_addr(StackTrace *stacktrace = NULL);
 #endif
 
+// Create a symbolizer of a single backend, which must be available.
+Symbolize *symbolize_create_backend(SymbolizeBackend backend,
+                                    StackTrace *stacktrace = NULL);
+
+// Run the backends in order, see Symbolize::create().
+// Settings are the symbol_cache_settings() taken before the backends and
+// detail were read.
+Symbolize *symbolize_create_cascade(const vector<SymbolizeBackend>& backends,
+                                    SymbolizeDetail detail,
+                                    uint64_t settings,
+                                    StackTrace *stacktrace = NULL);
+
 }  // namespace internal
 
 }  // namespace bt
@@ -31,6 +31,10 @@
 #include <unistd.h>
 
 #include "backtrace/demangle.h"
+#include "backtrace/elf_file.h"
+#include "backtrace/elf_function_table.h"
+#include "backtrace/object_cache.h"
+#include "backtrace/stats.h"
 
 #define GNU_DEBUGLINK ".gnu_debuglink"
 
@@ -46,7 +50,12 @@ class BfdSymbols {
         symtab_(NULL),
         dynamic_symtab_(NULL),
         text_(NULL),
-        debug_link_(NULL) {
+        debug_link_(NULL),
+        memory_usage_(sizeof(*this))
+#ifdef BACKTRACE_HAS_ELF
+        , function_table_(NULL)
+#endif
+  {
     init(self_object_name_get());
   }
 
@@ -55,11 +64,19 @@ class BfdSymbols {
         symtab_(NULL),
         dynamic_symtab_(NULL),
         text_(NULL),
-        debug_link_(NULL) {
+        debug_link_(NULL),
+        memory_usage_(sizeof(*this))
+#ifdef BACKTRACE_HAS_ELF
+        , function_table_(NULL)
+#endif
+  {
     init(object_name);
   }
 
   ~BfdSymbols() {
+#ifdef BACKTRACE_HAS_ELF
+    delete function_table_;
+#endif
     if (symtab_ != NULL) {
       free(symtab_);
     }
@@ -71,6 +88,16 @@ class BfdSymbols {
     }
   }
 
+  // Estimated memory used by symbol tables and debug sections.
+  size_t memory_usage() const {
+#ifdef BACKTRACE_HAS_ELF
+    if (function_table_ != NULL) {
+      return memory_usage_ + function_table_->memory_usage();
+    }
+#endif
+    return memory_usage_;
+  }
+
   // Resolve given address into a symbol description.
   bool resolve(void *address,
                void *base_address,
@@ -92,11 +119,39 @@ class BfdSymbols {
       if (info.function_name != NULL) {
         symbol->function_name = demangle(info.function_name);
       }
+      resolve_function(address, base_address, symbol);
       return true;
     }
     return false;
   }
 
+  // BFD only reports name of the function, offset within it is found
+  // using the symbol table. Name is also filled in if BFD did not find it.
+  void resolve_function(void *address,
+                        void *base_address,
+                        Symbol *symbol) {
+#ifdef BACKTRACE_HAS_ELF
+    if (function_table_ == NULL) {
+      return;
+    }
+    uint64_t load_bias = (uint64_t)base_address - elf_.load_address();
+    const char *function_name;
+    uint64_t function_offset;
+    if (function_table_->find((uint64_t)address - load_bias,
+                              &function_name,
+                              &function_offset)) {
+      if (symbol->function_name.empty()) {
+        symbol->function_name = demangle(function_name);
+      }
+      symbol->function_offset = function_offset;
+    }
+#else
+    (void) address;  // Ignored.
+    (void) base_address;  // Ignored.
+    (void) symbol;  // Ignored.
+#endif
+  }
+
  protected:
   // Used by symbol_find_info().
   struct SymbolInfo {
@@ -129,6 +184,7 @@ class BfdSymbols {
     if (bfd_ == NULL) {
         return false;
     }
+    stats_add(STATS_OBJECTS_OPENED);
     // Sanity checks on the binary, to make sure all information
     // is available and symbolizer can be used.
     if (!bfd_check_format(bfd_, bfd_object)) {
@@ -150,13 +206,34 @@ class BfdSymbols {
       symtab_count = bfd_canonicalize_symtab(bfd_, symtab_);
     }
     if (dynamic_symtab_size > 0) {
-      dynamic_symtab_ = reinterpret_cast<asymbol **>(malloc(symtab_size));
-      symtab_count = bfd_canonicalize_symtab(bfd_, dynamic_symtab_);
+      dynamic_symtab_ =
+          reinterpret_cast<asymbol **>(malloc(dynamic_symtab_size));
+      symtab_count = bfd_canonicalize_dynamic_symtab(bfd_, dynamic_symtab_);
+    }
+    memory_usage_ += (symtab_size > 0 ? symtab_size : 0) +
+                     (dynamic_symtab_size > 0 ? dynamic_symtab_size : 0);
+    // BFD keeps DWARF sections in memory once it looked up lines, count
+    // them upfront.
+    const char *debug_sections[] = {".debug_info", ".debug_line",
+                                    ".debug_str", ".debug_abbrev",
+                                    ".debug_ranges"};
+    for (size_t i = 0;
+         i < sizeof(debug_sections) / sizeof(*debug_sections);
+         ++i) {
+      asection *section = bfd_get_section_by_name(bfd_, debug_sections[i]);
+      if (section != NULL) {
+        memory_usage_ += bfd_get_section_size(section);
+      }
     }
     (void) symtab_count;  // Currently ignored.
     // Gather .text section.
     text_ = bfd_get_section_by_name(bfd_, ".text");
     debug_link_ = bfd_get_section_by_name(bfd_, GNU_DEBUGLINK);
+#ifdef BACKTRACE_HAS_ELF
+    if (elf_.open(object_name)) {
+      function_table_ = new ElfFunctionTable(&elf_);
+    }
+#endif
     return true;
   }
 
@@ -251,6 +328,11 @@ class BfdSymbols {
   asymbol **symtab_;
   asymbol **dynamic_symtab_;
   asection *text_, *debug_link_;
+  size_t memory_usage_;
+#ifdef BACKTRACE_HAS_ELF
+  ElfFile elf_;
+  ElfFunctionTable *function_table_;
+#endif
 };
 
 // Sybolize implementation using BFD library.
@@ -266,15 +348,8 @@ class SymbolizeBfd : public Symbolize {
     }
   }
 
-  ~SymbolizeBfd() {
-    for (BfdObjectMap::iterator it = bfd_object_map_.begin();
-        it != bfd_object_map_.end();
-        ++it) {
-      delete it->second;
-    }
-  }
-
   void resolve(const StackTrace& stacktrace) {
+    symbols_.clear();
     symbols_.resize(stacktrace.size());
     for (size_t i = 0; i < stacktrace.size(); ++i) {
       unsigned char *address =
@@ -284,19 +359,6 @@ class SymbolizeBfd : public Symbolize {
   }
 
  private:
-  typedef map<string, BfdSymbols*> BfdObjectMap;
-
-  BfdSymbols& load_object(const string& object_name) {
-    using std::pair;
-    BfdObjectMap::iterator it = bfd_object_map_.find(object_name);
-    if (it != bfd_object_map_.end()) {
-      return *it->second;
-    }
-    BfdSymbols *bfd_symbols = new BfdSymbols(object_name);
-    bfd_object_map_.insert(pair<string, BfdSymbols*>(object_name, bfd_symbols));
-    return *bfd_symbols;
-  }
-
   // Perform all the magic to resolve information about particular address.
   bool resolve(void *address, Symbol *symbol) {
     Dl_info symbol_info;
@@ -307,7 +369,7 @@ class SymbolizeBfd : public Symbolize {
       return false;
     }
 
-    BfdSymbols& bfd_symbols = load_object(symbol_info.dli_fname);
+    BfdSymbols& bfd_symbols = bfd_objects_.get(symbol_info.dli_fname);
     if (symbol_info.dli_sname != NULL) {
       symbol->object_name = symbol_info.dli_sname;
     }
@@ -318,12 +380,14 @@ class SymbolizeBfd : public Symbolize {
       symbol->address = (size_t)address;
       if (symbol_info.dli_sname != NULL) {
         symbol->function_name = demangle(symbol_info.dli_sname);
+        symbol->function_offset = (size_t)address -
+                                  (size_t)symbol_info.dli_saddr;
       }
     }
     return true;
   }
 
-  BfdObjectMap bfd_object_map_;
+  ObjectCache<BfdSymbols> bfd_objects_;
 };
 
 }  // namespace
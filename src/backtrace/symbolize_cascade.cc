@@ -0,0 +1,314 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "backtrace/symbolize.h"
+
+#include "backtrace/perf_map.h"
+#include "backtrace/relative_stacktrace.h"
+#include "backtrace/stats.h"
+#include "backtrace/symbol_cache.h"
+
+namespace bt {
+namespace internal {
+
+namespace {
+
+// Detail of a resolved symbol, comparable with SymbolizeDetail by adding
+// one to the latter.
+enum SymbolLevel {
+  LEVEL_NONE = 0,
+  LEVEL_FUNCTION = 1,
+  LEVEL_LINE = 2,
+};
+
+int symbol_level(const Symbol& symbol) {
+  if (!symbol.file_name.empty() && symbol.line_number != Symbol::LINE_NONE) {
+    return LEVEL_LINE;
+  }
+  if (!symbol.function_name.empty()) {
+    return LEVEL_FUNCTION;
+  }
+  return LEVEL_NONE;
+}
+
+// Best detail the backend is able to provide.
+int backend_level(SymbolizeBackend backend) {
+  switch (backend) {
+    case SYMBOLIZE_EXECINFO:
+    case SYMBOLIZE_PERF_MAP:
+      return LEVEL_FUNCTION;
+    default:
+      return LEVEL_LINE;
+  }
+}
+
+// Take the more detailed symbol, with blanks filled in from the other one.
+void symbol_merge(const Symbol& other, Symbol *symbol) {
+  Symbol result = other;
+  const Symbol *better = &other, *worse = symbol;
+  if (symbol_level(other) <= symbol_level(*symbol)) {
+    result = *symbol;
+    better = symbol;
+    worse = &other;
+  }
+  // Without a function, offset is the one within the object, which is
+  // only taken if there's no better one.
+  if (better->function_name.empty() &&
+      (!worse->function_name.empty() ||
+       better->function_offset == Symbol::OFFSET_NONE)) {
+    result.function_name = worse->function_name;
+    result.function_offset = worse->function_offset;
+  }
+  if (better->object_name.empty()) {
+    result.object_name = worse->object_name;
+  }
+  if (better->address == Symbol::ADDRESS_NONE) {
+    result.address = worse->address;
+  }
+  *symbol = result;
+}
+
+class SymbolizeCascade : public Symbolize {
+ public:
+  SymbolizeCascade(const vector<SymbolizeBackend>& backends,
+                   SymbolizeDetail detail,
+                   uint64_t settings,
+                   StackTrace *stacktrace)
+  : Symbolize(stacktrace),
+    level_(detail + 1),
+    settings_(settings),
+    has_perf_map_(false) {
+    // Backends which might satisfy the requested detail go first, others
+    // are fallbacks for whatever is left unresolved.
+    for (size_t i = 0; i < backends.size(); ++i) {
+      if (backend_level(backends[i]) >= level_) {
+        backends_.push_back(backends[i]);
+      }
+    }
+    for (size_t i = 0; i < backends.size(); ++i) {
+      if (backend_level(backends[i]) < level_) {
+        backends_.push_back(backends[i]);
+      }
+      if (backends[i] == SYMBOLIZE_PERF_MAP) {
+        has_perf_map_ = true;
+      }
+    }
+    symbolizers_.resize(backends_.size(), NULL);
+    if (stacktrace_ != NULL) {
+      resolve(*stacktrace_);
+    }
+  }
+
+  ~SymbolizeCascade() {
+    for (size_t i = 0; i < symbolizers_.size(); ++i) {
+      delete symbolizers_[i];
+    }
+  }
+
+  void resolve(const StackTrace& stacktrace) {
+    resolve_until(stacktrace, 0);
+  }
+
+  size_t resolve_until(const StackTrace& stacktrace, uint64_t deadline_ns) {
+    // Timed here rather than in the backends, which might all get a go at
+    // the same trace.
+    StatsTimer timer(STATS_SYMBOLIZE);
+    symbols_.clear();
+    symbols_.resize(stacktrace.size());
+    levels_.assign(stacktrace.size(), LEVEL_NONE);
+    resolved_by_.assign(stacktrace.size(), backends_.size());
+    vector<size_t> pending;
+    // Symbolizers created before settings changed bypass the cache.
+    bool use_cache = (symbol_cache_size() != 0 &&
+                      settings_ == symbol_cache_settings());
+    if (use_cache) {
+      symbol_cache_lookup(stacktrace, &symbols_, &pending);
+    } else {
+      for (size_t i = 0; i < stacktrace.size(); ++i) {
+        pending.push_back(i);
+      }
+    }
+    const vector<size_t> missed = pending;
+    size_t num_resolved = missed.size();
+    if (deadline_ns == 0) {
+      backends_run(stacktrace, &pending);
+    } else {
+      // Frame by frame, so the deadline is checked between them. Objects
+      // are still only loaded once, by the first frame which needs them.
+      for (size_t i = 0; i < missed.size(); ++i) {
+        if (time_monotonic_ns() >= deadline_ns) {
+          num_resolved = i;
+          break;
+        }
+        pending.assign(1, missed[i]);
+        backends_run(stacktrace, &pending);
+      }
+      skipped_fill(stacktrace, missed, num_resolved);
+    }
+    if (!use_cache) {
+      return missed.size() - num_resolved;
+    }
+    // Frames which were skipped are not known to be unresolvable.
+    for (size_t i = 0; i < num_resolved; ++i) {
+      size_t index = missed[i];
+      // JIT code memory gets reused, and addresses outside of any object
+      // might turn out to be JIT functions later on.
+      bool is_jit = resolved_by_[index] < backends_.size() &&
+                    backends_[resolved_by_[index]] == SYMBOLIZE_PERF_MAP;
+      bool maybe_jit = has_perf_map_ && levels_[index] == LEVEL_NONE &&
+                       symbols_[index].object_name.empty();
+      if (is_jit || maybe_jit) {
+        continue;
+      }
+      symbol_cache_insert(stacktrace[index].address, symbols_[index],
+                          settings_);
+    }
+    return missed.size() - num_resolved;
+  }
+
+ private:
+  // Run backends on the pending frames, frames which got resolved to the
+  // configured detail are removed from the list.
+  void backends_run(const StackTrace& stacktrace, vector<size_t> *pending) {
+    for (size_t i = 0; i < backends_.size() && !pending->empty(); ++i) {
+      // Only frames which this backend could improve.
+      addresses_.clear();
+      indices_.clear();
+      for (size_t j = 0; j < pending->size(); ++j) {
+        size_t index = (*pending)[j];
+        if (levels_[index] < backend_level(backends_[i])) {
+          addresses_.push_back(stacktrace[index].address);
+          indices_.push_back(index);
+        }
+      }
+      if (indices_.empty()) {
+        continue;
+      }
+      Symbolize *symbolize = symbolizer_get(i);
+      symbolize->resolve(addresses_);
+      for (size_t j = 0; j < indices_.size(); ++j) {
+        size_t index = indices_[j];
+        int level = symbol_level(symbolize->at(j));
+        symbol_merge(symbolize->at(j), &symbols_[index]);
+        if (level > levels_[index]) {
+          levels_[index] = level;
+          resolved_by_[index] = i;
+        }
+      }
+      size_t num_pending = 0;
+      for (size_t j = 0; j < pending->size(); ++j) {
+        if (levels_[(*pending)[j]] < level_) {
+          (*pending)[num_pending++] = (*pending)[j];
+        }
+      }
+      pending->resize(num_pending);
+    }
+  }
+
+  // Fill in object and offset within it for the frames which were not
+  // reached before the deadline, which is enough to symbolize them
+  // offline. Module table is cached, so this is cheap.
+  void skipped_fill(const StackTrace& stacktrace,
+                    const vector<size_t>& missed,
+                    size_t num_resolved) {
+    if (num_resolved == missed.size()) {
+      return;
+    }
+    // Call sites rather than return addresses, same as the backends do.
+    StackTraceAddresses addresses;
+    for (size_t i = num_resolved; i < missed.size(); ++i) {
+      addresses.push_back(
+          static_cast<unsigned char *>(stacktrace[missed[i]].address) - 1);
+    }
+    RelativeStackTrace relative(addresses);
+    for (size_t i = 0; i < relative.size(); ++i) {
+      Symbol& symbol = symbols_[missed[num_resolved + i]];
+      symbol.address = reinterpret_cast<size_t>(addresses[i].address);
+      if (relative[i].module == RelativeFrame::MODULE_NONE) {
+        continue;
+      }
+      symbol.object_name = relative_module_get(relative[i].module).path;
+      symbol.object_offset = (size_t)relative[i].offset;
+    }
+  }
+
+  Symbolize *symbolizer_get(size_t index) {
+    if (symbolizers_[index] == NULL) {
+      symbolizers_[index] = symbolize_create_backend(backends_[index]);
+    }
+    return symbolizers_[index];
+  }
+
+  int level_;
+  // Settings of the symbol cache this symbolizer was created with.
+  uint64_t settings_;
+  bool has_perf_map_;
+  vector<SymbolizeBackend> backends_;
+  // Created on demand, frames often get resolved by the first ones.
+  vector<Symbolize *> symbolizers_;
+
+  // Per-frame state of the trace which is being resolved.
+  vector<int> levels_;
+  // Index of the backend which resolved the frame.
+  vector<size_t> resolved_by_;
+  // Frames which are passed to a backend.
+  StackTraceAddresses addresses_;
+  vector<size_t> indices_;
+};
+
+}  // namespace
+
+Symbolize *symbolize_create_backend(SymbolizeBackend backend,
+                                    StackTrace *stacktrace) {
+  switch (backend) {
+#ifdef BACKTRACE_HAS_EXECINFO
+    case SYMBOLIZE_EXECINFO:
+      return symbolize_create_execinfo(stacktrace);
+#endif
+#ifdef BACKTRACE_HAS_ELF
+    case SYMBOLIZE_ELF:
+      return symbolize_create_elf(stacktrace);
+#endif
+#ifdef BACKTRACE_HAS_BFD
+    case SYMBOLIZE_BFD:
+      return symbolize_create_bfd(stacktrace);
+#endif
+#ifdef BACKTRACE_HAS_SYM_FROM_ADDR
+    case SYMBOLIZE_SYM_FROM_ADDR:
+      return symbolize_create_sym_from_addr(stacktrace);
+#endif
+#ifdef BACKTRACE_HAS_PERF_MAP
+    case SYMBOLIZE_PERF_MAP:
+      return symbolize_create_perf_map(stacktrace);
+#endif
+    default:
+      return symbolize_create_stub(stacktrace);
+  }
+}
+
+Symbolize *symbolize_create_cascade(const vector<SymbolizeBackend>& backends,
+                                    SymbolizeDetail detail,
+                                    uint64_t settings,
+                                    StackTrace *stacktrace) {
+  return new SymbolizeCascade(backends, detail, settings, stacktrace);
+}
+
+}  // namespace internal
+}  // namespace bt
@@ -0,0 +1,245 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "backtrace/symbolize.h"
+
+#ifdef BACKTRACE_HAS_ELF
+
+#include <dlfcn.h>
+#include <link.h>
+
+#include "backtrace/demangle.h"
+#include "backtrace/dwarf_info.h"
+#include "backtrace/dwarf_line.h"
+#include "backtrace/elf_file.h"
+#include "backtrace/elf_function_table.h"
+#include "backtrace/module_table.h"
+#include "backtrace/object_cache.h"
+#include "backtrace/stats.h"
+
+namespace bt {
+namespace internal {
+
+namespace {
+
+// Symbols information of a single object, read directly from its ELF
+// sections without help of any external library.
+class ElfSymbols {
+ public:
+  explicit ElfSymbols(const string& object_name)
+      : elf_(object_name),
+        function_table_(NULL),
+        line_table_(NULL),
+        dwarf_info_(NULL) {
+    if (elf_.is_open()) {
+      stats_add(STATS_OBJECTS_OPENED);
+      function_table_ = new ElfFunctionTable(&elf_);
+      dwarf_info_ = new DwarfInfo(&elf_);
+      line_table_ = new DwarfLineTable(&elf_, dwarf_info_);
+    }
+  }
+
+  ~ElfSymbols() {
+    delete function_table_;
+    delete line_table_;
+    delete dwarf_info_;
+  }
+
+  // Estimated heap memory used by the decoded symbol data. File mapping is
+  // not counted, it is backed by the page cache.
+  size_t memory_usage() const {
+    size_t memory_usage = sizeof(*this);
+    if (function_table_ != NULL) {
+      memory_usage += function_table_->memory_usage();
+    }
+    if (line_table_ != NULL) {
+      memory_usage += line_table_->memory_usage();
+    }
+    if (dwarf_info_ != NULL) {
+      memory_usage += dwarf_info_->memory_usage();
+    }
+    return memory_usage;
+  }
+
+  // Resolve given address into a symbol description, load bias is the
+  // difference between run-time and link-time addresses of the object.
+  bool resolve(void *address,
+               uint64_t load_bias,
+               Symbol *symbol) {
+    if (line_table_ == NULL) {
+      return false;
+    }
+    uint64_t elf_address = (uint64_t)address - load_bias;
+    // Symbol table also has local symbols, which dladdr() does not see.
+    const char *function_name;
+    uint64_t function_offset;
+    string dwarf_function_name;
+    if (function_table_->find(elf_address,
+                              &function_name,
+                              &function_offset)) {
+      symbol->function_name = demangle(function_name);
+      symbol->function_offset = function_offset;
+    } else if (dwarf_info_->find_function(elf_address,
+                                          &dwarf_function_name,
+                                          &function_offset)) {
+      // Stripped object, possibly with split debug information.
+      symbol->function_name = demangle(dwarf_function_name);
+      symbol->function_offset = function_offset;
+    }
+    string file_name;
+    int line_number;
+    if (!line_table_->find(elf_address, &file_name, &line_number)) {
+      return false;
+    }
+    symbol->file_name = file_name;
+    symbol->line_number = (line_number != 0) ? line_number
+                                             : Symbol::LINE_NONE;
+    return true;
+  }
+
+ private:
+  ElfFile elf_;
+  ElfFunctionTable *function_table_;
+  DwarfLineTable *line_table_;
+  DwarfInfo *dwarf_info_;
+};
+
+// Sybolize implementation using built-in ELF and DWARF reader.
+class SymbolizeElf : public Symbolize {
+ public:
+  SymbolizeElf() : Symbolize() {
+  }
+
+  explicit SymbolizeElf(StackTrace *stacktrace)
+      : Symbolize(stacktrace) {
+    if (stacktrace_ != NULL) {
+      resolve(*stacktrace_);
+    }
+  }
+
+  void resolve(const StackTrace& stacktrace) {
+    symbols_.clear();
+    symbols_.resize(stacktrace.size());
+    for (size_t i = 0; i < stacktrace.size(); ++i) {
+      unsigned char *address =
+              reinterpret_cast<unsigned char*>(stacktrace[i].address);
+      resolve(reinterpret_cast<void*>(address - 1), &symbols_[i]);
+    }
+  }
+
+ private:
+  // Perform all the magic to resolve information about particular address.
+  bool resolve(void *address, Symbol *symbol) {
+    Dl_info symbol_info;
+    struct link_map *link_map = NULL;
+    if (dladdr1(address,
+                &symbol_info,
+                reinterpret_cast<void **>(&link_map),
+                RTLD_DL_LINKMAP) == 0) {
+      return false;
+    }
+    if (symbol_info.dli_fname == NULL || link_map == NULL) {
+      return false;
+    }
+    // For the main executable dladdr() reports argv[0], which is not
+    // necessarily a valid path.
+    string object_name = symbol_info.dli_fname;
+    if (link_map->l_name == NULL || link_map->l_name[0] == '\0') {
+      object_name = "/proc/self/exe";
+    }
+    symbol->object_name = symbol_info.dli_fname;
+    symbol->address = (size_t)address;
+    if (symbol_info.dli_sname != NULL) {
+      symbol->function_name = demangle(symbol_info.dli_sname);
+      symbol->function_offset = (size_t)address -
+                                (size_t)symbol_info.dli_saddr;
+    }
+    ElfSymbols& elf_symbols = elf_objects_.get(object_name);
+    elf_symbols.resolve(address, link_map->l_addr, symbol);
+    if (symbol->function_name.empty()) {
+      // Offset within the object, same as execinfo gives for the frames
+      // it could not resolve.
+      symbol->function_offset = (size_t)address - link_map->l_addr;
+    }
+    return true;
+  }
+
+  ObjectCache<ElfSymbols> elf_objects_;
+};
+
+// Symbolize implementation for addresses which belong to a different
+// address space, described by a module table.
+class SymbolizeElfModules : public Symbolize {
+ public:
+  SymbolizeElfModules(const vector<Module>& modules, StackTrace *stacktrace)
+      : Symbolize(stacktrace),
+        modules_(modules) {
+    if (stacktrace_ != NULL) {
+      resolve(*stacktrace_);
+    }
+  }
+
+  void resolve(const StackTrace& stacktrace) {
+    symbols_.clear();
+    symbols_.resize(stacktrace.size());
+    for (size_t i = 0; i < stacktrace.size(); ++i) {
+      uintptr_t address =
+              reinterpret_cast<uintptr_t>(stacktrace[i].address) - 1;
+      resolve(address, &symbols_[i]);
+    }
+  }
+
+ private:
+  bool resolve(uintptr_t address, Symbol *symbol) {
+    symbol->address = (size_t)address;
+    const Module *module = module_table_find(modules_, address);
+    if (module == NULL) {
+      return false;
+    }
+    symbol->object_name = module->path;
+    ElfSymbols& elf_symbols = elf_objects_.get(module->path);
+    elf_symbols.resolve(reinterpret_cast<void *>(address),
+                        module->load_bias,
+                        symbol);
+    if (symbol->function_name.empty()) {
+      symbol->function_offset = (size_t)(address - module->load_bias);
+    }
+    return true;
+  }
+
+  vector<Module> modules_;
+  ObjectCache<ElfSymbols> elf_objects_;
+};
+
+}  // namespace
+
+Symbolize *symbolize_create_elf(StackTrace *stacktrace) {
+  return new SymbolizeElf(stacktrace);
+}
+
+Symbolize *symbolize_create_elf_modules(const vector<Module>& modules,
+                                        StackTrace *stacktrace) {
+  return new SymbolizeElfModules(modules, stacktrace);
+}
+
+}  // namespace internal
+}  // namespace bt
+
+#endif  // BACKTRACE_HAS_ELF
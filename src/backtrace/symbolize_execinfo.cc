@@ -76,16 +76,26 @@ class SymbolizeExecinfo : public Symbolize {
                        str.size() - addr_start - 2));
     // Get function name and offset.
     size_t function_start = str.find_last_of('(');
-    assert(addr_start != string::npos);
+    if (function_start == string::npos || function_start > addr_start) {
+      // Address does not belong to any object, JIT code for example.
+      symbol->function_name = "";
+      symbol->function_offset = Symbol::OFFSET_NONE;
+      symbol->object_name = "";
+      return;
+    }
     string function_and_offset =
             str.substr(function_start + 1, addr_start - function_start - 3);
     if (function_and_offset.size()) {
       size_t plus = function_and_offset.find_last_of('+');
-      assert(plus != string::npos);
-      symbol->function_name = demangle(function_and_offset.substr(0, plus));
-      symbol->function_offset = hex_cast<size_t>(
-              function_and_offset.substr(plus + 1,
-                      function_and_offset.size() - plus - 1));
+      if (plus != string::npos) {
+        symbol->function_name = demangle(function_and_offset.substr(0, plus));
+        symbol->function_offset = hex_cast<size_t>(
+                function_and_offset.substr(plus + 1,
+                        function_and_offset.size() - plus - 1));
+      } else {
+        symbol->function_name = demangle(function_and_offset);
+        symbol->function_offset = Symbol::OFFSET_NONE;
+      }
     } else {
       symbol->function_name = "";
       symbol->function_offset = 0x00;
@@ -0,0 +1,390 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "backtrace/symbolize_helper.h"
+
+#ifdef BACKTRACE_HAS_EXECINFO
+
+#include <errno.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#  include <sys/prctl.h>
+#  include <sys/syscall.h>
+#endif
+#ifdef BACKTRACE_HAS_ELF
+#  include <link.h>
+#endif
+
+#include "backtrace/backtrace.h"
+#include "backtrace/stacktrace.h"
+#include "backtrace/symbolize.h"
+
+#ifndef MSG_NOSIGNAL
+#  define MSG_NOSIGNAL 0
+#endif
+
+// How long parent waits for the helper to respond.
+#define HELPER_TIMEOUT_MS 5000
+// How long print() waits for another request to finish, before it gives
+// up on the helper. Lock might be held by a thread which crashed while
+// talking to the helper, or even by the very thread which calls print().
+#define HELPER_LOCK_TIMEOUT_MS 1000
+
+namespace bt {
+namespace internal {
+
+namespace {
+
+bool write_all(int fd, const void *data, size_t size) {
+  const char *ptr = reinterpret_cast<const char *>(data);
+  while (size > 0) {
+    ssize_t written = write(fd, ptr, size);
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written <= 0) {
+      return false;
+    }
+    ptr += written;
+    size -= written;
+  }
+  return true;
+}
+
+// Same as write_all(), but does not raise SIGPIPE if the other side of a
+// socket is gone.
+bool send_all(int socket, const void *data, size_t size) {
+  const char *ptr = reinterpret_cast<const char *>(data);
+  while (size > 0) {
+    ssize_t sent = send(socket, ptr, size, MSG_NOSIGNAL);
+    if (sent < 0 && errno == EINTR) {
+      continue;
+    }
+    if (sent <= 0) {
+      return false;
+    }
+    ptr += sent;
+    size -= sent;
+  }
+  return true;
+}
+
+// Read exactly given number of bytes, waiting at most timeout_ms for each
+// portion of data. Negative timeout means wait forever.
+bool read_all(int fd, void *data, size_t size, int timeout_ms) {
+  char *ptr = reinterpret_cast<char *>(data);
+  while (size > 0) {
+    if (timeout_ms >= 0) {
+      struct pollfd pfd;
+      pfd.fd = fd;
+      pfd.events = POLLIN;
+      pfd.revents = 0;
+      int result = poll(&pfd, 1, timeout_ms);
+      if (result < 0 && errno == EINTR) {
+        continue;
+      }
+      if (result <= 0) {
+        return false;
+      }
+    }
+    ssize_t num_read = read(fd, ptr, size);
+    if (num_read < 0 && errno == EINTR) {
+      continue;
+    }
+    if (num_read <= 0) {
+      return false;
+    }
+    ptr += num_read;
+    size -= num_read;
+  }
+  return true;
+}
+
+// Write addresses in hexadecimal form, used when helper is not available.
+void write_raw_addresses(void * const *addresses, size_t size, int fd) {
+  static const char digits[] = "0123456789abcdef";
+  for (size_t i = 0; i < size; ++i) {
+    char buffer[2 * sizeof(void *) + 4];
+    char *ptr = buffer + sizeof(buffer);
+    *--ptr = '\n';
+    uintptr_t address = reinterpret_cast<uintptr_t>(addresses[i]);
+    do {
+      *--ptr = digits[address & 0xf];
+      address >>= 4;
+    } while (address != 0);
+    *--ptr = 'x';
+    *--ptr = '0';
+    write_all(fd, ptr, buffer + sizeof(buffer) - ptr);
+  }
+}
+
+#ifdef BACKTRACE_HAS_ELF
+int collect_module_address_cb(struct dl_phdr_info *info,
+                              size_t /*size*/,
+                              void *data) {
+  StackTraceAddresses *addresses =
+      reinterpret_cast<StackTraceAddresses *>(data);
+  for (int i = 0; i < info->dlpi_phnum; ++i) {
+    const ElfW(Phdr)& phdr = info->dlpi_phdr[i];
+    if (phdr.p_type == PT_LOAD && (phdr.p_flags & PF_X)) {
+      // Symbolizers are looking at the instruction before return address,
+      // so point past the segment start.
+      addresses->push_back(
+          reinterpret_cast<void *>(info->dlpi_addr + phdr.p_vaddr + 1));
+      break;
+    }
+  }
+  return 0;
+}
+#endif
+
+#ifdef __linux__
+// Layout of entries returned by getdents64, glibc does not declare it.
+struct LinuxDirent64 {
+  uint64_t d_ino;
+  int64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[1];
+};
+#endif
+
+// Close all file descriptors except the given one, so the helper does
+// not keep pipes, sockets and locked files of the parent open. Runs in
+// a freshly forked child, so no memory is allocated here.
+void close_inherited_fds(int keep) {
+#if defined(__linux__) && defined(SYS_close_range)
+  if ((keep == 0 || syscall(SYS_close_range, 0, keep - 1, 0) == 0) &&
+      syscall(SYS_close_range, keep + 1, ~0U, 0) == 0) {
+    return;
+  }
+#endif
+#ifdef __linux__
+  int dir = open("/proc/self/fd", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (dir != -1) {
+    char buffer[4096];
+    long size;
+    while ((size = syscall(SYS_getdents64, dir, buffer,
+                           sizeof(buffer))) > 0) {
+      for (long offset = 0; offset < size;) {
+        const LinuxDirent64 *entry =
+            reinterpret_cast<const LinuxDirent64 *>(buffer + offset);
+        offset += entry->d_reclen;
+        int fd = 0;
+        const char *ptr = entry->d_name;
+        if (*ptr < '0' || *ptr > '9') {
+          continue;
+        }
+        while (*ptr >= '0' && *ptr <= '9') {
+          fd = fd * 10 + (*ptr++ - '0');
+        }
+        if (fd != keep && fd != dir) {
+          close(fd);
+        }
+      }
+    }
+    close(dir);
+    return;
+  }
+#endif
+  long max_fd = sysconf(_SC_OPEN_MAX);
+  if (max_fd < 0 || max_fd > 65536) {
+    max_fd = 65536;
+  }
+  for (int fd = 0; fd < max_fd; ++fd) {
+    if (fd != keep) {
+      close(fd);
+    }
+  }
+}
+
+void spin_lock(volatile int *lock) {
+  while (__sync_lock_test_and_set(lock, 1)) {
+    while (*lock) {
+    }
+  }
+}
+
+// Returns false if the lock is still taken after timeout_ms.
+bool spin_lock_timed(volatile int *lock, int timeout_ms) {
+  for (int i = 0; __sync_lock_test_and_set(lock, 1); ++i) {
+    if (i >= timeout_ms) {
+      return false;
+    }
+    struct timespec ts = {0, 1000000};
+    nanosleep(&ts, NULL);
+  }
+  return true;
+}
+
+void spin_unlock(volatile int *lock) {
+  __sync_lock_release(lock);
+}
+
+}  // namespace
+
+SymbolizeHelper& SymbolizeHelper::instance() {
+  static SymbolizeHelper helper;
+  return helper;
+}
+
+SymbolizeHelper::SymbolizeHelper()
+    : socket_(-1),
+      pid_(-1),
+      lock_(0) {
+}
+
+SymbolizeHelper::~SymbolizeHelper() {
+  stop();
+}
+
+bool SymbolizeHelper::start() {
+  stop();
+  // Make sure unwinder is loaded, so backtrace() does not allocate memory
+  // when it's called from a crash handler.
+  void *dummy[1];
+  backtrace(dummy, 1);
+  int sockets[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0) {
+    return false;
+  }
+  pid_t parent_pid = getpid();
+  pid_t pid = fork();
+  if (pid == -1) {
+    close(sockets[0]);
+    close(sockets[1]);
+    return false;
+  }
+  if (pid == 0) {
+    close_inherited_fds(sockets[1]);
+#ifdef __linux__
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+#endif
+    if (getppid() == parent_pid) {
+      helper_main(sockets[1]);
+    }
+    _exit(0);
+  }
+  close(sockets[1]);
+  spin_lock(&lock_);
+  socket_ = sockets[0];
+  pid_ = pid;
+  spin_unlock(&lock_);
+  return true;
+}
+
+void SymbolizeHelper::stop() {
+  spin_lock(&lock_);
+  int socket = socket_;
+  pid_t pid = pid_;
+  socket_ = -1;
+  pid_ = -1;
+  spin_unlock(&lock_);
+  if (socket != -1) {
+    // Helper exits once its side of the socket is closed.
+    close(socket);
+  }
+  if (pid != -1) {
+    waitpid(pid, NULL, 0);
+  }
+}
+
+bool SymbolizeHelper::print(void * const *addresses, size_t size, int fd) {
+  if (!spin_lock_timed(&lock_, HELPER_LOCK_TIMEOUT_MS)) {
+    // Symbols of dynamic symbol table only, but still better than raw
+    // addresses.
+    backtrace_symbols_fd(addresses, (int)size, fd);
+    return false;
+  }
+  bool ok = false;
+  if (socket_ != -1) {
+    uint32_t num_addresses = (uint32_t)size;
+    uint32_t length = 0;
+    ok = send_all(socket_, &num_addresses, sizeof(num_addresses)) &&
+         send_all(socket_, addresses, size * sizeof(void *)) &&
+         read_all(socket_, &length, sizeof(length), HELPER_TIMEOUT_MS);
+    while (ok && length > 0) {
+      char buffer[4096];
+      size_t chunk_size = length < sizeof(buffer) ? length : sizeof(buffer);
+      ok = read_all(socket_, buffer, chunk_size, HELPER_TIMEOUT_MS) &&
+           write_all(fd, buffer, chunk_size);
+      length -= chunk_size;
+    }
+  }
+  if (!ok) {
+    if (socket_ != -1) {
+      // Protocol state is unknown after an error, so helper can not be
+      // used anymore. It is reaped by stop() or exits with the parent.
+      close(socket_);
+      socket_ = -1;
+    }
+    write_raw_addresses(addresses, size, fd);
+  }
+  spin_unlock(&lock_);
+  return ok;
+}
+
+void SymbolizeHelper::helper_main(int socket) {
+  Symbolize *symbolize = Symbolize::create();
+  // Pre-load symbols of all the objects, so the first request from the
+  // parent does not pay for that.
+#ifdef BACKTRACE_HAS_ELF
+  StackTraceAddresses modules;
+  dl_iterate_phdr(collect_module_address_cb, &modules);
+  symbolize->resolve(modules);
+#endif
+  vector<void *> addresses;
+  for (;;) {
+    uint32_t num_addresses;
+    if (!read_all(socket, &num_addresses, sizeof(num_addresses), -1) ||
+        num_addresses > BACKTRACE_MAX_DEPTH * 16) {
+      break;
+    }
+    addresses.resize(num_addresses);
+    if (num_addresses != 0 &&
+        !read_all(socket, &addresses[0], num_addresses * sizeof(void *), -1)) {
+      break;
+    }
+    StackTraceAddresses stacktrace(addresses.empty() ? NULL : &addresses[0],
+                                   addresses.size());
+    symbolize->resolve(stacktrace);
+    string text = symbolize_format(*symbolize);
+    uint32_t length = (uint32_t)text.size();
+    if (!send_all(socket, &length, sizeof(length)) ||
+        !send_all(socket, text.data(), text.size())) {
+      break;
+    }
+  }
+  delete symbolize;
+  close(socket);
+}
+
+}  // namespace internal
+}  // namespace bt
+
+#endif  // BACKTRACE_HAS_EXECINFO
@@ -0,0 +1,86 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef __SYMBOLIZE_HELPER_H__
+#define __SYMBOLIZE_HELPER_H__
+
+#include "backtrace/backtrace_util.h"
+
+#ifdef BACKTRACE_HAS_EXECINFO
+
+#include <sys/types.h>
+
+namespace bt {
+namespace internal {
+
+// Child process which symbolizes stack traces on behalf of its parent.
+//
+// Helper is forked at initialization time, so it shares address space
+// layout with the parent and is able to symbolize its addresses. All the
+// symbolizer state lives in the helper, parent only sends raw addresses
+// over a socket and copies text it gets back to a file descriptor, which
+// makes it possible to print stack traces from a crash handler. Helper
+// closes all the other file descriptors it inherits, so it does not keep
+// pipes or files of the parent open.
+//
+// Objects which are loaded by the parent after the helper was started are
+// not known to the helper, start() could be called again to re-fork it.
+class SymbolizeHelper {
+ public:
+  static SymbolizeHelper& instance();
+
+  // Fork helper process, stopping the previous one if any.
+  bool start();
+
+  // Stop helper process and wait for it to terminate.
+  void stop();
+
+  bool is_running() const { return socket_ != -1; }
+
+  // Write symbolized stack trace of the given addresses to a file
+  // descriptor. Only async-signal-safe calls are used here.
+  //
+  // Returns false if the helper is not running or does not respond, raw
+  // addresses are written to the file descriptor in this case. If another
+  // request does not finish in time, for example because a thread crashed
+  // in the middle of it, addresses are symbolized in-process using the
+  // dynamic symbol table instead.
+  bool print(void * const *addresses, size_t size, int fd);
+
+ private:
+  SymbolizeHelper();
+  ~SymbolizeHelper();
+
+  // Main loop of the helper process.
+  static void helper_main(int socket);
+
+  int socket_;
+  pid_t pid_;
+  // Serializes requests from multiple threads, spin lock since mutexes are
+  // not async-signal-safe.
+  volatile int lock_;
+};
+
+}  // namespace internal
+}  // namespace bt
+
+#endif  // BACKTRACE_HAS_EXECINFO
+
+#endif  // __SYMBOLIZE_HELPER_H__
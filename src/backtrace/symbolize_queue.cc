@@ -0,0 +1,163 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "backtrace/symbolize_queue.h"
+
+namespace bt {
+
+const SymbolizeQueue::Ticket SymbolizeQueue::TICKET_NONE;
+
+SymbolizeQueue::SymbolizeQueue(size_t max_pending)
+    : max_pending_(max_pending),
+      next_ticket_(TICKET_NONE + 1),
+      done_ticket_(TICKET_NONE),
+      num_dropped_(0),
+      stop_(false),
+      symbolize_(NULL),
+      thread_(thread_main, this) {
+  thread_.start();
+}
+
+SymbolizeQueue::~SymbolizeQueue() {
+  {
+    internal::MutexLock lock(&mutex_);
+    stop_ = true;
+    pending_condition_.notify_all();
+  }
+  thread_.join();
+  delete symbolize_;
+}
+
+SymbolizeQueue::Ticket SymbolizeQueue::submit(StackTrace *stacktrace,
+                                              Callback callback,
+                                              void *user_data) {
+  internal::MutexLock lock(&mutex_);
+  if (pending_.size() >= max_pending_ || stop_) {
+    ++num_dropped_;
+    delete stacktrace;
+    return TICKET_NONE;
+  }
+  Request request;
+  request.ticket = next_ticket_++;
+  request.stacktrace = stacktrace;
+  request.callback = callback;
+  request.user_data = user_data;
+  pending_.push_back(request);
+  pending_condition_.notify_one();
+  return request.ticket;
+}
+
+bool SymbolizeQueue::wait(Ticket ticket, vector<Symbol> *symbols) {
+  internal::MutexLock lock(&mutex_);
+  if (ticket == TICKET_NONE || ticket >= next_ticket_) {
+    return false;
+  }
+  while (done_ticket_ < ticket) {
+    done_condition_.wait(&mutex_);
+  }
+  map<Ticket, vector<Symbol> >::iterator it = results_.find(ticket);
+  if (it == results_.end()) {
+    return false;
+  }
+  symbols->swap(it->second);
+  results_.erase(it);
+  return true;
+}
+
+void SymbolizeQueue::flush() {
+  internal::MutexLock lock(&mutex_);
+  Ticket ticket = next_ticket_ - 1;
+  while (done_ticket_ < ticket) {
+    done_condition_.wait(&mutex_);
+  }
+}
+
+uint64_t SymbolizeQueue::num_dropped() const {
+  internal::MutexLock lock(&mutex_);
+  return num_dropped_;
+}
+
+void SymbolizeQueue::thread_main(void *queue_v) {
+  SymbolizeQueue *queue = reinterpret_cast<SymbolizeQueue *>(queue_v);
+  queue->run();
+}
+
+void SymbolizeQueue::run() {
+  vector<Request> batch;
+  for (;;) {
+    {
+      internal::MutexLock lock(&mutex_);
+      while (pending_.empty() && !stop_) {
+        pending_condition_.wait(&mutex_);
+      }
+      if (pending_.empty()) {
+        // Stop was requested and everything is symbolized.
+        return;
+      }
+      batch.assign(pending_.begin(), pending_.end());
+      pending_.clear();
+    }
+    process(batch);
+  }
+}
+
+void SymbolizeQueue::process(const vector<Request>& batch) {
+  if (symbolize_ == NULL) {
+    symbolize_ = Symbolize::create();
+  }
+  // Resolve all the unique addresses of the batch in one go, this way
+  // every object is only looked up once. Addresses which were resolved
+  // before come from the symbol cache, and the new ones are added to it.
+  StackTraceAddresses addresses;
+  map<void *, size_t> indices;
+  for (size_t i = 0; i < batch.size(); ++i) {
+    const StackTrace& stacktrace = *batch[i].stacktrace;
+    for (size_t j = 0; j < stacktrace.size(); ++j) {
+      void *address = stacktrace[j].address;
+      if (indices.find(address) == indices.end()) {
+        indices[address] = addresses.size();
+        addresses.push_back(address);
+      }
+    }
+  }
+  if (addresses.size() != 0) {
+    symbolize_->resolve(addresses);
+  }
+  // Deliver results in the submission order.
+  for (size_t i = 0; i < batch.size(); ++i) {
+    const Request& request = batch[i];
+    vector<Symbol> symbols(request.stacktrace->size());
+    for (size_t j = 0; j < symbols.size(); ++j) {
+      symbols[j] = symbolize_->at(indices[(*request.stacktrace)[j].address]);
+    }
+    delete request.stacktrace;
+    if (request.callback != NULL) {
+      request.callback(symbols, request.user_data);
+    }
+    internal::MutexLock lock(&mutex_);
+    if (request.callback == NULL) {
+      results_[request.ticket].swap(symbols);
+    }
+    done_ticket_ = request.ticket;
+    done_condition_.notify_all();
+  }
+}
+
+}  // namespace bt
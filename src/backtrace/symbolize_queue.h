@@ -0,0 +1,112 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef __SYMBOLIZE_QUEUE_H__
+#define __SYMBOLIZE_QUEUE_H__
+
+#include <deque>
+#include <stdint.h>
+
+#include "backtrace/backtrace_util.h"
+#include "backtrace/stacktrace.h"
+#include "backtrace/symbolize.h"
+
+namespace bt {
+
+// Queue which symbolizes stack traces on a background thread.
+//
+// Submitting a trace only costs an enqueue, so it is possible to capture
+// traces on a latency sensitive thread and get them symbolized later.
+// Pending traces are symbolized in batches, every unique address is only
+// resolved once per batch. Symbols are cached between batches by the
+// process-wide symbol cache, which is shared with synchronous symbolization
+// and forgets objects which get unloaded.
+//
+// Results are delivered in the order traces were submitted, either to a
+// callback which is invoked from the background thread, or kept until
+// wait() is called for the ticket.
+class SymbolizeQueue {
+ public:
+  typedef uint64_t Ticket;
+
+  // Callback which is invoked once trace is symbolized.
+  typedef void (*Callback)(const vector<Symbol>& symbols, void *user_data);
+
+  // Ticket which is returned when trace could not be queued.
+  static const Ticket TICKET_NONE = 0;
+
+  // Maximum number of pending traces, new ones are dropped when there are
+  // this many traces waiting to be symbolized.
+  explicit SymbolizeQueue(size_t max_pending = 4096);
+
+  // Symbolizes all the pending traces before returning.
+  ~SymbolizeQueue();
+
+  // Submit stack trace to be symbolized, queue takes ownership over it.
+  //
+  // If callback is NULL, symbols are kept until wait() is called for the
+  // returned ticket.
+  Ticket submit(StackTrace *stacktrace,
+                Callback callback = NULL,
+                void *user_data = NULL);
+
+  // Wait for the trace to be symbolized, only valid for tickets which were
+  // submitted without callback. Returns false for unknown tickets.
+  bool wait(Ticket ticket, vector<Symbol> *symbols);
+
+  // Wait until all traces submitted so far are symbolized.
+  void flush();
+
+  // Number of traces which were dropped because queue was full.
+  uint64_t num_dropped() const;
+
+ private:
+  struct Request {
+    Ticket ticket;
+    StackTrace *stacktrace;
+    Callback callback;
+    void *user_data;
+  };
+
+  static void thread_main(void *queue_v);
+  void run();
+  void process(const vector<Request>& batch);
+
+  size_t max_pending_;
+  mutable internal::Mutex mutex_;
+  internal::ConditionVariable pending_condition_;
+  internal::ConditionVariable done_condition_;
+  std::deque<Request> pending_;
+  map<Ticket, vector<Symbol> > results_;
+  Ticket next_ticket_;
+  // Last ticket which was symbolized.
+  Ticket done_ticket_;
+  uint64_t num_dropped_;
+  bool stop_;
+
+  // Only accessed from the background thread.
+  Symbolize *symbolize_;
+
+  internal::Thread thread_;
+};
+
+}  // namespace bt
+
+#endif  // __SYMBOLIZE_QUEUE_H__
@@ -0,0 +1,316 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "backtrace/thread_dump.h"
+
+#ifdef BACKTRACE_HAS_THREAD_DUMP
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <execinfo.h>
+#include <sched.h>
+#include <signal.h>
+#include <sstream>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "backtrace/backtrace.h"
+#include "backtrace/symbolize.h"
+
+// Frames of the signal handler and signal trampoline, which are not
+// interesting for the dump.
+#define HANDLER_FRAMES 2
+
+// Value passed along with the signal packs generation of the dump and
+// index of the slot into 32 bits, so it fits into sival_ptr everywhere.
+// Generation wraps around, it only needs to tell apart recent dumps.
+#define SLOT_INDEX_BITS 20
+#define SLOT_INDEX_MASK ((1u << SLOT_INDEX_BITS) - 1)
+
+namespace bt {
+namespace internal {
+
+namespace {
+
+// Per-thread slot which is filled in by the signal handler.
+struct Slot {
+  volatile int done;
+  int depth;
+  char name[17];
+  void *frames[BACKTRACE_MAX_DEPTH + HANDLER_FRAMES];
+};
+
+struct Dump {
+  uint32_t generation;
+  Slot *slots;
+  size_t num_slots;
+  volatile int num_done;
+};
+
+Mutex dump_mutex;
+bool handler_installed = false;
+uint32_t dump_generation = 0;
+// Dump which is currently in progress, accessed by the signal handler.
+Dump *volatile current_dump = NULL;
+// Number of signal handlers which might be accessing current dump.
+volatile int num_active_handlers = 0;
+
+int dump_signal_get() {
+  return SIGRTMIN + BACKTRACE_THREAD_DUMP_SIGNAL;
+}
+
+void dump_signal_handler(int /*signum*/, siginfo_t *info, void * /*ucontext*/) {
+  int saved_errno = errno;
+  __sync_fetch_and_add(&num_active_handlers, 1);
+  Dump *dump = current_dump;
+  uint32_t value = (uint32_t)(uintptr_t)info->si_value.sival_ptr;
+  uint32_t generation = value >> SLOT_INDEX_BITS;
+  uint32_t index = value & SLOT_INDEX_MASK;
+  if (info->si_code == SI_QUEUE && dump != NULL &&
+      dump->generation == generation && index < dump->num_slots) {
+    Slot& slot = dump->slots[index];
+    // Cheaper than reading comm from procfs afterwards.
+    prctl(PR_GET_NAME, slot.name, 0, 0, 0);
+    slot.depth = backtrace(slot.frames,
+                           BACKTRACE_MAX_DEPTH + HANDLER_FRAMES);
+    __sync_synchronize();
+    slot.done = 1;
+    __sync_fetch_and_add(&dump->num_done, 1);
+  }
+  __sync_fetch_and_sub(&num_active_handlers, 1);
+  errno = saved_errno;
+}
+
+bool handler_install() {
+  if (handler_installed) {
+    return true;
+  }
+  // Make sure unwinder is loaded, so backtrace() does not allocate memory
+  // from within signal handler.
+  void *dummy[1];
+  backtrace(dummy, 1);
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_sigaction = dump_signal_handler;
+  action.sa_flags = SA_SIGINFO | SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  if (sigaction(dump_signal_get(), &action, NULL) != 0) {
+    return false;
+  }
+  handler_installed = true;
+  return true;
+}
+
+string thread_name_get(long tid) {
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/self/task/%ld/comm", tid);
+  int fd = open(path, O_RDONLY);
+  if (fd == -1) {
+    return "";
+  }
+  char name[64];
+  ssize_t length = read(fd, name, sizeof(name) - 1);
+  close(fd);
+  if (length < 0) {
+    return "";
+  }
+  name[length] = '\0';
+  if (length > 0 && name[length - 1] == '\n') {
+    name[length - 1] = '\0';
+  }
+  return name;
+}
+
+}  // namespace
+
+bool thread_dump_capture(int timeout_ms, vector<ThreadStackTrace> *threads) {
+  MutexLock lock(&dump_mutex);
+  if (!handler_install()) {
+    return false;
+  }
+  // Gather identifiers of all the threads.
+  vector<long> tids;
+  DIR *dir = opendir("/proc/self/task");
+  if (dir == NULL) {
+    return false;
+  }
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL) {
+    if (entry->d_name[0] != '.') {
+      tids.push_back(atol(entry->d_name));
+    }
+  }
+  closedir(dir);
+  // Allocate slots for all the threads before signalling them.
+  Dump dump;
+  dump.generation = ++dump_generation & (~0u >> SLOT_INDEX_BITS);
+  dump.num_slots = tids.size();
+  dump.slots = new Slot[dump.num_slots];
+  dump.num_done = 0;
+  for (size_t i = 0; i < dump.num_slots; ++i) {
+    dump.slots[i].done = 0;
+    dump.slots[i].depth = 0;
+    dump.slots[i].name[0] = '\0';
+  }
+  __sync_synchronize();
+  current_dump = &dump;
+  pid_t pid = getpid();
+  long self_tid = syscall(SYS_gettid);
+  size_t num_signalled = 0;
+  for (size_t i = 0; i < tids.size(); ++i) {
+    if (tids[i] == self_tid || i > SLOT_INDEX_MASK) {
+      continue;
+    }
+    siginfo_t info;
+    memset(&info, 0, sizeof(info));
+    info.si_signo = dump_signal_get();
+    info.si_code = SI_QUEUE;
+    info.si_pid = pid;
+    info.si_uid = getuid();
+    info.si_value.sival_ptr = (void *)(uintptr_t)(
+        (dump.generation << SLOT_INDEX_BITS) | (uint32_t)i);
+    if (syscall(SYS_rt_tgsigqueueinfo,
+                pid, tids[i], info.si_signo, &info) == 0) {
+      ++num_signalled;
+    }
+  }
+  // Calling thread is captured directly, while others are busy.
+  threads->clear();
+  threads->resize(tids.size());
+  for (size_t i = 0; i < tids.size(); ++i) {
+    if (tids[i] == self_tid) {
+      // Skip frame of this function.
+      void *frames[BACKTRACE_MAX_DEPTH + 1];
+      int depth = backtrace(frames, BACKTRACE_MAX_DEPTH + 1);
+      (*threads)[i].stacktrace = StackTraceAddresses(frames + 1, depth - 1);
+      (*threads)[i].captured = true;
+      prctl(PR_GET_NAME, dump.slots[i].name, 0, 0, 0);
+    }
+  }
+  // Wait for the handlers.
+  uint64_t deadline = time_monotonic_ns() + (uint64_t)timeout_ms * 1000000;
+  while ((size_t)dump.num_done < num_signalled &&
+         time_monotonic_ns() < deadline) {
+    struct timespec ts = {0, 20000};
+    nanosleep(&ts, NULL);
+  }
+  // Make sure no handler is touching the slots before they are freed,
+  // late handlers will see there's no dump in progress.
+  current_dump = NULL;
+  __sync_synchronize();
+  while (num_active_handlers != 0) {
+    sched_yield();
+  }
+  for (size_t i = 0; i < tids.size(); ++i) {
+    ThreadStackTrace& thread = (*threads)[i];
+    thread.tid = tids[i];
+    const Slot& slot = dump.slots[i];
+    if (slot.name[0] != '\0') {
+      thread.name = slot.name;
+    } else {
+      thread.name = thread_name_get(tids[i]);
+    }
+    if (slot.done && slot.depth > HANDLER_FRAMES) {
+      thread.stacktrace = StackTraceAddresses(slot.frames + HANDLER_FRAMES,
+                                              slot.depth - HANDLER_FRAMES);
+      thread.captured = true;
+    }
+  }
+  delete [] dump.slots;
+  return true;
+}
+
+string thread_dump_format(const vector<ThreadStackTrace>& threads) {
+  // Group threads with identical stacks.
+  typedef map<vector<void *>, vector<size_t> > StackGroups;
+  StackGroups groups;
+  vector<vector<void *> > group_order;
+  for (size_t i = 0; i < threads.size(); ++i) {
+    const StackTrace& stacktrace = threads[i].stacktrace;
+    vector<void *> addresses(stacktrace.size());
+    for (size_t j = 0; j < stacktrace.size(); ++j) {
+      addresses[j] = stacktrace[j].address;
+    }
+    if (!threads[i].captured) {
+      // Group all the threads which did not respond together.
+      addresses.clear();
+    }
+    vector<size_t>& group = groups[addresses];
+    if (group.empty()) {
+      group_order.push_back(addresses);
+    }
+    group.push_back(i);
+  }
+  // Symbolize every unique address once.
+  map<void *, Symbol> symbols;
+  StackTraceAddresses unique_addresses;
+  for (StackGroups::const_iterator it = groups.begin();
+       it != groups.end();
+       ++it) {
+    for (size_t i = 0; i < it->first.size(); ++i) {
+      if (symbols.insert(std::make_pair(it->first[i], Symbol())).second) {
+        unique_addresses.push_back(it->first[i]);
+      }
+    }
+  }
+  Symbolize *symbolize = Symbolize::create();
+  symbolize->resolve(unique_addresses);
+  for (size_t i = 0; i < unique_addresses.size(); ++i) {
+    symbols[unique_addresses[i].address] = symbolize->at(i);
+  }
+  delete symbolize;
+  // Format groups in the order they were first seen.
+  std::stringstream ss;
+  for (size_t i = 0; i < group_order.size(); ++i) {
+    const vector<void *>& addresses = group_order[i];
+    const vector<size_t>& group = groups[addresses];
+    ss << (group.size() == 1 ? "Thread" : "Threads");
+    for (size_t j = 0; j < group.size(); ++j) {
+      const ThreadStackTrace& thread = threads[group[j]];
+      ss << (j == 0 ? " " : ", ") << thread.tid;
+      if (!thread.name.empty()) {
+        ss << " (" << thread.name << ")";
+      }
+    }
+    if (!threads[group[0]].captured) {
+      ss << ":\n        (did not respond)\n";
+      continue;
+    }
+    ss << ":\n";
+    vector<Symbol> group_symbols(addresses.size());
+    for (size_t j = 0; j < addresses.size(); ++j) {
+      group_symbols[j] = symbols[addresses[j]];
+    }
+    ss << symbolize_format(group_symbols);
+  }
+  return ss.str();
+}
+
+}  // namespace internal
+}  // namespace bt
+
+#endif  // BACKTRACE_HAS_THREAD_DUMP
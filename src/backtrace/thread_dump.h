@@ -0,0 +1,71 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef __THREAD_DUMP_H__
+#define __THREAD_DUMP_H__
+
+#include "backtrace/backtrace_util.h"
+#include "backtrace/stacktrace.h"
+
+#if defined(__linux__) && defined(BACKTRACE_HAS_EXECINFO)
+#  define BACKTRACE_HAS_THREAD_DUMP
+#endif
+
+#ifdef BACKTRACE_HAS_THREAD_DUMP
+
+// Real-time signal used to interrupt threads, relative to SIGRTMIN.
+#ifndef BACKTRACE_THREAD_DUMP_SIGNAL
+#  define BACKTRACE_THREAD_DUMP_SIGNAL 4
+#endif
+
+namespace bt {
+namespace internal {
+
+// Stack trace of a single thread of the process.
+struct ThreadStackTrace {
+  long tid;
+  string name;
+  // False if thread did not respond within the timeout.
+  bool captured;
+  StackTraceAddresses stacktrace;
+
+  ThreadStackTrace()
+  : tid(0),
+    captured(false) {}
+};
+
+// Capture stack traces of all threads of the current process.
+//
+// Every thread is interrupted with a dedicated real-time signal and its
+// handler captures raw addresses into a slot which was allocated upfront.
+// Threads which did not respond within the timeout are reported with
+// captured set to false.
+bool thread_dump_capture(int timeout_ms, vector<ThreadStackTrace> *threads);
+
+// Symbolize all the traces at once and format them as a human-readable
+// text. Threads with identical stacks are grouped together.
+string thread_dump_format(const vector<ThreadStackTrace>& threads);
+
+}  // namespace internal
+}  // namespace bt
+
+#endif  // BACKTRACE_HAS_THREAD_DUMP
+
+#endif  // __THREAD_DUMP_H__
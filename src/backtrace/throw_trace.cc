@@ -0,0 +1,136 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "backtrace/throw_trace.h"
+
+#ifdef BACKTRACE_HAS_THROW_TRACE
+
+#include <cstdlib>
+#include <dlfcn.h>
+#include <exception>
+#include <execinfo.h>
+#include <typeinfo>
+
+// Number of in-flight exceptions remembered per thread.
+#define NUM_SLOTS 8
+
+namespace bt {
+
+namespace {
+
+struct ThrowSlot {
+  const void *exception_object;
+  int depth;
+  void *frames[BACKTRACE_THROW_TRACE_DEPTH];
+};
+
+struct ThrowTraces {
+  ThrowSlot slots[NUM_SLOTS];
+  unsigned int next_slot;
+};
+
+typedef void (*CxaThrowFunction)(void *, std::type_info *, void (*)(void *));
+
+__thread ThrowTraces throw_traces;
+volatile bool throw_trace_enabled = true;
+CxaThrowFunction real_cxa_throw = NULL;
+
+// Frames of the interposer itself, which are not interesting.
+#define INTERPOSER_FRAMES 1
+
+__attribute__((noinline)) void throw_trace_capture(
+    const void *exception_object) {
+  ThrowTraces& traces = throw_traces;
+  ThrowSlot& slot = traces.slots[traces.next_slot % NUM_SLOTS];
+  ++traces.next_slot;
+  slot.exception_object = NULL;
+  void *frames[BACKTRACE_THROW_TRACE_DEPTH + INTERPOSER_FRAMES + 1];
+  int depth = backtrace(frames,
+                        BACKTRACE_THROW_TRACE_DEPTH + INTERPOSER_FRAMES + 1);
+  // Skip this function and the interposer.
+  int skip = INTERPOSER_FRAMES + 1;
+  slot.depth = 0;
+  for (int i = skip; i < depth; ++i) {
+    slot.frames[slot.depth++] = frames[i];
+  }
+  slot.exception_object = exception_object;
+}
+
+}  // namespace
+
+void throw_trace_set_enabled(bool enabled) {
+  throw_trace_enabled = enabled;
+}
+
+bool throw_trace_get(const void *exception_object,
+                     StackTraceAddresses *stacktrace) {
+  if (exception_object == NULL) {
+    return false;
+  }
+  const ThrowTraces& traces = throw_traces;
+  // Look from the most recent one, so reused addresses are resolved to the
+  // latest exception.
+  for (unsigned int i = 0; i < NUM_SLOTS; ++i) {
+    const ThrowSlot& slot =
+        traces.slots[(traces.next_slot - 1 - i) % NUM_SLOTS];
+    if (slot.exception_object == exception_object) {
+      *stacktrace = StackTraceAddresses(slot.frames, slot.depth);
+      return true;
+    }
+  }
+  return false;
+}
+
+#if __cplusplus >= 201103L
+bool throw_trace_current(StackTraceAddresses *stacktrace) {
+  std::exception_ptr exception = std::current_exception();
+  if (!exception) {
+    return false;
+  }
+  // Both libstdc++ and libc++ represent exception_ptr as a pointer to the
+  // thrown object.
+  const void *exception_object =
+      *reinterpret_cast<void * const *>(&exception);
+  return throw_trace_get(exception_object, stacktrace);
+}
+#endif
+
+}  // namespace bt
+
+extern "C" __attribute__((noreturn)) void __cxa_throw(
+    void *exception_object,
+    std::type_info *type_info,
+    void (*destructor)(void *)) {
+  if (bt::throw_trace_enabled) {
+    bt::throw_trace_capture(exception_object);
+  }
+  if (bt::real_cxa_throw == NULL) {
+    bt::real_cxa_throw = reinterpret_cast<bt::CxaThrowFunction>(
+        dlsym(RTLD_NEXT, "__cxa_throw"));
+    if (bt::real_cxa_throw == NULL) {
+      abort();
+    }
+  }
+  bt::real_cxa_throw(exception_object, type_info, destructor);
+  // Real function never returns.
+  abort();
+}
+
+#endif  // BACKTRACE_HAS_THROW_TRACE
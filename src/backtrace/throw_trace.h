@@ -0,0 +1,70 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef __THROW_TRACE_H__
+#define __THROW_TRACE_H__
+
+#include "backtrace/backtrace_util.h"
+#include "backtrace/stacktrace.h"
+
+#if defined(WITH_THROW_TRACE) && defined(BACKTRACE_HAS_EXECINFO) && \
+    defined(__GNUC__)
+#  define BACKTRACE_HAS_THROW_TRACE
+#endif
+
+#ifdef BACKTRACE_HAS_THROW_TRACE
+
+// Maximum number of frames captured at throw time.
+#ifndef BACKTRACE_THROW_TRACE_DEPTH
+#  define BACKTRACE_THROW_TRACE_DEPTH 32
+#endif
+
+namespace bt {
+
+// Stack traces of thrown C++ exceptions.
+//
+// When the library is built with throw trace support, __cxa_throw is
+// interposed and raw addresses of the throw site are stored in a small
+// thread-local ring buffer, keyed by the exception object. Nothing is
+// allocated and nothing is symbolized on the throw path, traces are only
+// symbolized if a handler asks for them.
+//
+// Only traces of exceptions thrown by the calling thread are known, and
+// only a few most recently thrown exceptions per thread are remembered.
+
+// Enable or disable capturing, enabled by default.
+void throw_trace_set_enabled(bool enabled);
+
+// Get throw site of the given exception object. For exceptions caught by
+// reference the object is the address of the caught reference, as long as
+// it is caught by its dynamic type or a non-virtual primary base.
+bool throw_trace_get(const void *exception_object,
+                     StackTraceAddresses *stacktrace);
+
+#if __cplusplus >= 201103L
+// Get throw site of the exception which is currently being handled.
+bool throw_trace_current(StackTraceAddresses *stacktrace);
+#endif
+
+}  // namespace bt
+
+#endif  // BACKTRACE_HAS_THROW_TRACE
+
+#endif  // __THROW_TRACE_H__
@@ -0,0 +1,173 @@
+// Copyright (C) 2016 libbacktrace-cc authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "backtrace/backtrace.h"
+
+// Exit code of the child when minidumps are not supported.
+#define EXIT_UNSUPPORTED 77
+
+// Chains of functions which crash, they are to be neither inlined nor
+// turned into tail calls.
+#define NOINLINE __attribute__((noinline))
+
+static volatile int sink = 0;
+
+NOINLINE static void abort_level3(void) {
+  abort();
+}
+
+NOINLINE static void abort_level2(void) {
+  abort_level3();
+  ++sink;
+}
+
+NOINLINE static void abort_level1(void) {
+  abort_level2();
+  ++sink;
+}
+
+// Leaf function which does not set up a frame.
+NOINLINE static void segv_leaf(volatile int *pointer) {
+  *pointer = 1;
+}
+
+NOINLINE static void segv_level2(void) {
+  segv_leaf((volatile int *)(uintptr_t)sink);
+  ++sink;
+}
+
+NOINLINE static void segv_level1(void) {
+  segv_level2();
+  ++sink;
+}
+
+NOINLINE static void null_call_level2(void) {
+  void (*function)(void) = (void (*)(void))(uintptr_t)sink;
+  function();
+  ++sink;
+}
+
+NOINLINE static void null_call_level1(void) {
+  null_call_level2();
+  ++sink;
+}
+
+// Crash in a child process and check that the crashed thread of its
+// minidump contains the chain of functions, innermost first.
+static int test_crash(const char *name,
+                      void (*crash)(void),
+                      int expected_signal,
+                      const char * const *chain,
+                      int chain_size) {
+  char filename[] = "/tmp/backtrace_test_minidump_XXXXXX";
+  int fd = mkstemp(filename);
+  if (fd == -1) {
+    fprintf(stderr, "%s: unable to create minidump file\n", name);
+    return 1;
+  }
+  close(fd);
+  pid_t pid = fork();
+  if (pid == 0) {
+    if (backtrace_minidump_install(filename) != 0) {
+      _exit(EXIT_UNSUPPORTED);
+    }
+    crash();
+    _exit(EXIT_SUCCESS);
+  }
+  int status;
+  waitpid(pid, &status, 0);
+  if (WIFEXITED(status) && WEXITSTATUS(status) == EXIT_UNSUPPORTED) {
+    printf("%s: minidumps are not supported, skipped\n", name);
+    unlink(filename);
+    return 0;
+  }
+  if (!WIFSIGNALED(status) || WTERMSIG(status) != expected_signal) {
+    fprintf(stderr, "%s: child did not die of signal %d\n",
+            name, expected_signal);
+    unlink(filename);
+    return 1;
+  }
+  FILE *fp = tmpfile();
+  int result = backtrace_minidump_print(filename, fp);
+  unlink(filename);
+  if (result != 0) {
+    fprintf(stderr, "%s: unable to read the minidump\n", name);
+    fclose(fp);
+    return 1;
+  }
+  long size = ftell(fp);
+  char *text = (char *)malloc(size + 1);
+  rewind(fp);
+  size = (long)fread(text, 1, size, fp);
+  text[size] = '\0';
+  fclose(fp);
+  // Crashed thread is printed first.
+  char *next_thread = strstr(text, "\nThread ");
+  if (next_thread != NULL) {
+    next_thread[1] = '\0';
+  }
+  const char *position = text;
+  for (int i = 0; i < chain_size; ++i) {
+    char pattern[256];
+    // Function names are followed by the argument list.
+    snprintf(pattern, sizeof(pattern), " %s(", chain[i]);
+    const char *found = strstr(position, pattern);
+    if (found == NULL) {
+      fprintf(stderr, "%s: %s is missing from the crashed thread:\n%s",
+              name, chain[i], text);
+      free(text);
+      return 1;
+    }
+    position = found + strlen(pattern);
+  }
+  printf("%s: ok\n", name);
+  free(text);
+  return 0;
+}
+
+int main(void) {
+  static const char * const abort_chain[] = {
+    "abort", "abort_level3", "abort_level2", "abort_level1", "main",
+  };
+  static const char * const segv_chain[] = {
+    "segv_leaf", "segv_level2", "segv_level1", "main",
+  };
+  static const char * const null_call_chain[] = {
+    "null_call_level2", "null_call_level1", "main",
+  };
+  int num_failed = 0;
+  num_failed += test_crash("abort", abort_level1, SIGABRT, abort_chain,
+                           sizeof(abort_chain) / sizeof(*abort_chain));
+  num_failed += test_crash("segv", segv_level1, SIGSEGV, segv_chain,
+                           sizeof(segv_chain) / sizeof(*segv_chain));
+  num_failed += test_crash("null_call", null_call_level1, SIGSEGV,
+                           null_call_chain,
+                           sizeof(null_call_chain) /
+                               sizeof(*null_call_chain));
+  return num_failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}